@@ -0,0 +1,89 @@
+import argparse
+import csv
+import math
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+# Times analyze.py against the stream_analytics tool on the same synthetic
+# export and checks that both write the same CSVs.
+#
+#   pio run -e stream_analytics
+#   python analytics/benchmark_stream.py --tool .pio/build/stream_analytics/program --days 365
+
+OUTPUTS = ['basic_statistics.csv', 'daily_session_mean.csv', 'session_trends.csv', 'correlation_matrix.csv',
+           'high_turbidity_anomalies.csv', 'unsafe_ph_anomalies.csv']
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--tool', default='.pio/build/stream_analytics/program')
+parser.add_argument('--days', type=int, default=365)
+parser.add_argument('--nodes', type=int, default=1)
+parser.add_argument('--jobs', type=int, default=0)
+parser.add_argument('--tolerance', type=float, default=1e-9, help='relative (absolute below 1) for numbers that differ')
+args = parser.parse_args()
+
+tool = os.path.abspath(args.tool)
+script = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'analyze.py')
+work = tempfile.mkdtemp(prefix='stream_bench_')
+os.makedirs(os.path.join(work, 'analytics'))
+data = os.path.join(work, 'analytics', 'collected_data.json')
+
+
+def timed(command, **kwargs):
+    start = time.perf_counter()
+    subprocess.run(command, check=True, stdout=subprocess.DEVNULL, **kwargs)
+    return time.perf_counter() - start
+
+
+# Step 1: Synthetic export, every session reading of the period
+subprocess.run([tool, '--synthesize', str(args.days), '--nodes', str(args.nodes), data], check=True)
+size_mb = os.path.getsize(data) / 1e6
+
+# Step 2: Both analyses over it (analyze.py reads and writes relative to its working directory)
+python_seconds = timed([sys.executable, script], cwd=work, env=dict(os.environ, MPLBACKEND='Agg'))
+tool_output = os.path.join(work, 'stream')
+os.makedirs(tool_output)
+tool_seconds = timed([tool, '--jobs', str(args.jobs), '--out', tool_output, data])
+
+
+# Step 3: Same rows and labels; numbers equal, or within tolerance where the
+# sums of pandas round differently (correlations near zero are compared
+# absolutely, as their relative error is all cancellation)
+def compare(name):
+    with open(os.path.join(work, 'analytics', 'output', name)) as f:
+        expected = list(csv.reader(f))
+    with open(os.path.join(tool_output, name)) as f:
+        actual = list(csv.reader(f))
+    if len(expected) != len(actual):
+        return False, 0, math.inf
+    differing, worst = 0, 0.0
+    for row_e, row_a in zip(expected, actual):
+        if len(row_e) != len(row_a):
+            return False, differing, math.inf
+        for e, a in zip(row_e, row_a):
+            if e == a:
+                continue
+            try:
+                x, y = float(e), float(a)
+            except ValueError:
+                return False, differing, math.inf
+            differing += 1
+            worst = max(worst, abs(x - y) / max(abs(x), 1.0))
+    return worst <= args.tolerance, differing, worst
+
+
+print(f'{args.days} days, {args.nodes} node(s), {size_mb:.0f} MB of JSON')
+print(f'analyze.py      {python_seconds:10.2f} s')
+print(f'stream_analytics {tool_seconds:9.2f} s   ({python_seconds / tool_seconds:.0f}x)')
+print(f'\n{"output":32} {"match":6} {"differing":>9} {"max diff":>12}')
+failed = False
+for name in OUTPUTS:
+    ok, differing, worst = compare(name)
+    failed = failed or not ok
+    print(f'{name:32} {"yes" if ok else "NO":6} {differing:9} {worst:12.1e}')
+
+shutil.rmtree(work)
+sys.exit(1 if failed else 0)
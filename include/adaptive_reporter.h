@@ -0,0 +1,134 @@
+#ifndef ADAPTIVE_REPORTER_H
+#define ADAPTIVE_REPORTER_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "reading.h"
+
+// Decides which averaged readings are worth publishing. A subscriber holds the
+// last published value of each channel, so a reading is only sent when that
+// held value would be wrong by more than the channel's deadband:
+//
+//   deadband   |value - last published| exceeds the channel's deadband
+//   drift      a two-sided CUSUM of (value - last published) beyond a slack of
+//              cusumSlack * deadband passes cusumLimit * deadband, catching a
+//              slow drift that never crosses the deadband in one step
+//   heartbeat  nothing was published for heartbeatSeconds (liveness)
+//   alarm      the reading is outside the safe limits (pH, turbidity); every
+//              reading is then sent until holdReadings after it is back inside
+//
+// Publishing resets the reference and the sums of every channel. No allocation;
+// the state is a few floats per channel.
+class AdaptiveReporter {
+public:
+    enum Reason { SUPPRESSED, FIRST, DEADBAND, DRIFT, HEARTBEAT, ALARM };
+
+    struct Limits {
+        float phMin = 6.5f;          // Unsafe pH rule of analytics/analyze.py
+        float phMax = 8.5f;
+        float turbidityMax = 2.0f;   // High-turbidity rule of analytics/analyze.py
+    };
+
+private:
+    float deadband[SENSOR_CHANNEL_COUNT];
+    float reference[SENSOR_CHANNEL_COUNT];
+    float upper[SENSOR_CHANNEL_COUNT];   // CUSUM of rises above the reference
+    float lower[SENSOR_CHANNEL_COUNT];   // CUSUM of falls below it
+    float cusumSlack;
+    float cusumLimit;
+    uint32_t heartbeatSeconds;
+    uint32_t holdReadings;
+    Limits limits;
+
+    bool started = false;
+    uint32_t lastPublished = 0;
+    uint32_t escalated = 0;              // Readings still to send at full rate
+    uint32_t counts[ALARM + 1] = {};
+
+    bool alarm(const WaterReading& reading) const {
+        float ph = reading.values[CH_PH];
+        return ph < limits.phMin || ph > limits.phMax || reading.values[CH_TURBIDITY] > limits.turbidityMax;
+    }
+
+    Reason check(const WaterReading& reading) {
+        if (!started) return FIRST;
+        if (alarm(reading)) {
+            escalated = holdReadings + 1;
+        }
+        if (escalated > 0) {
+            escalated--;
+            return ALARM;
+        }
+        Reason reason = SUPPRESSED;
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            float error = reading.values[c] - reference[c];
+            if (fabsf(error) > deadband[c]) {
+                reason = DEADBAND;
+            }
+            float slack = cusumSlack * deadband[c];
+            upper[c] = fmaxf(0.0f, upper[c] + error - slack);
+            lower[c] = fmaxf(0.0f, lower[c] - error - slack);
+            if (reason == SUPPRESSED && (upper[c] > cusumLimit * deadband[c] || lower[c] > cusumLimit * deadband[c])) {
+                reason = DRIFT;
+            }
+        }
+        if (reason == SUPPRESSED && reading.timestamp - lastPublished >= heartbeatSeconds) {
+            reason = HEARTBEAT;
+        }
+        return reason;
+    }
+
+public:
+    // deadbands are indexed by SensorChannel, in the channel's units
+    AdaptiveReporter(const float* deadbands, float slack = 0.25f, float limit = 2.0f,
+                     uint32_t heartbeat = 300, uint32_t hold = 3)
+        : cusumSlack(slack), cusumLimit(limit), heartbeatSeconds(heartbeat), holdReadings(hold) {
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            deadband[c] = deadbands[c];
+            reference[c] = upper[c] = lower[c] = 0.0f;
+        }
+    }
+
+    void setLimits(const Limits& alarmLimits) { limits = alarmLimits; }
+
+    // Next reading is published whatever its value (e.g. after a restart of the subscriber)
+    void reset() {
+        started = false;
+        escalated = 0;
+    }
+
+    // Why the reading should be published, or SUPPRESSED. A published reading
+    // becomes the new reference.
+    Reason evaluate(const WaterReading& reading) {
+        Reason reason = check(reading);
+        counts[reason]++;
+        if (reason != SUPPRESSED) {
+            started = true;
+            lastPublished = reading.timestamp;
+            for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+                reference[c] = reading.values[c];
+                upper[c] = lower[c] = 0.0f;
+            }
+        }
+        return reason;
+    }
+
+    bool escalating() const { return escalated > 0; }
+
+    // Readings evaluated with the given outcome
+    uint32_t count(Reason reason) const { return counts[reason]; }
+
+    uint32_t evaluated() const {
+        uint32_t total = 0;
+        for (uint32_t n : counts) total += n;
+        return total;
+    }
+
+    static const char* name(Reason reason) {
+        static const char* const names[] = {"suppressed", "first", "deadband", "drift", "heartbeat", "alarm"};
+        return names[reason];
+    }
+};
+
+#endif // ADAPTIVE_REPORTER_H
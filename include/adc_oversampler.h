@@ -0,0 +1,223 @@
+#ifndef ADC_OVERSAMPLER_H
+#define ADC_OVERSAMPLER_H
+
+#include <atomic>
+#include "config.h"
+#include "hal.h"
+#include "spsc_queue.h"
+
+#ifndef NATIVE_BUILD
+#include <esp_timer.h>
+#endif
+
+// One conversion of every channel
+template <size_t Channels>
+struct AdcFrame {
+    uint16_t codes[Channels];
+};
+
+// Sums of consecutive frames, what the capture context hands over
+template <size_t Channels>
+struct AdcBlock {
+    uint32_t sums[Channels];
+    uint32_t frames;
+};
+
+// Boxcar decimator: averages every block added since the last emit() into one
+// rounded code per channel. Averaging N frames of independent noise improves
+// SNR by sqrt(N).
+template <size_t Channels>
+class Decimator {
+private:
+    uint64_t sums[Channels];
+    uint32_t count = 0;
+
+public:
+    Decimator() { reset(); }
+
+    void reset() {
+        for (size_t c = 0; c < Channels; c++) sums[c] = 0;
+        count = 0;
+    }
+
+    void add(const AdcBlock<Channels>& block) {
+        for (size_t c = 0; c < Channels; c++) sums[c] += block.sums[c];
+        count += block.frames;
+    }
+
+    // Writes the averages to out and starts a new block; returns the number of
+    // frames that were averaged (0 leaves out untouched)
+    uint32_t emit(int* out) {
+        uint32_t n = count;
+        if (n > 0) {
+            for (size_t c = 0; c < Channels; c++) {
+                out[c] = (int)((sums[c] + n / 2) / n);
+            }
+        }
+        reset();
+        return n;
+    }
+};
+
+// Frames from the capture context (timer or conversion-ready interrupt) to the
+// sampling loop, decimated on the capture side: each frame is added to running
+// sums, handed over as one block every few frames. The ring holds blocks, not
+// frames, so a longer sample interval takes longer blocks (setIntervalFrames())
+// rather than a larger ring. While the ring is full the open block keeps
+// summing instead of dropping frames; only frames that would overflow its sums
+// are dropped (dropCount()).
+template <size_t Channels, size_t Capacity>
+class BlockRing {
+private:
+    // 16-bit codes summed in 32 bits
+    static const uint32_t MAX_BLOCK_FRAMES = UINT32_MAX / UINT16_MAX;
+
+    SpscQueue<AdcBlock<Channels>, Capacity> ring;
+    AdcBlock<Channels> open = {};   // Capture side
+    std::atomic<uint32_t> blockFrames{1};
+    std::atomic<uint32_t> dropped{0};
+
+public:
+    // Capture side
+    void add(const uint16_t* codes) {
+        if (open.frames >= MAX_BLOCK_FRAMES) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        for (size_t c = 0; c < Channels; c++) open.sums[c] += codes[c];
+        open.frames++;
+        if (open.frames >= blockFrames.load(std::memory_order_relaxed) && ring.size() < Capacity) {
+            ring.push(open);
+            open = {};
+        }
+    }
+
+    // Sampling side: blocks short enough for the ring to hold two intervals of
+    // intervalFrames, so a sweep misses at most the last block (it goes to the next)
+    void setIntervalFrames(uint32_t intervalFrames) {
+        uint32_t frames = (intervalFrames * 2 + Capacity - 1) / Capacity;
+        blockFrames.store(frames > 0 ? frames : 1, std::memory_order_relaxed);
+    }
+
+    // Sampling side: adds every block handed over so far to decimator
+    void drainInto(Decimator<Channels>& decimator) {
+        const AdcBlock<Channels>* block;
+        while ((block = ring.peek()) != nullptr) {
+            decimator.add(*block);
+            ring.release();
+        }
+    }
+
+    uint32_t framesPerBlock() const { return blockFrames.load(std::memory_order_relaxed); }
+    uint32_t dropCount() const { return dropped.load(std::memory_order_relaxed); }
+};
+
+// ADC source that samples every sensor channel in the background at
+// ADC_OVERSAMPLE_RATE_HZ and, at each sweep, returns the mean of all frames
+// captured since the previous sweep (give it the sweep interval with
+// setSampleInterval()). Plugs in as the hal ADC source, so
+// WaterSensors and the conversions above it are unchanged.
+//
+// On the ESP32 the capture runs from an esp_timer callback; in the native build
+// pump() replays the frames that would have been captured since the last call,
+// using the simulated board clock.
+template <size_t Channels, size_t RingBlocks>
+class OversamplingAdc : public hal::AdcSource {
+private:
+    uint8_t pins[Channels];
+    hal::AdcSource* upstream = nullptr;
+    BlockRing<Channels, RingBlocks> blocks;
+    Decimator<Channels> decimator;
+    int latest[Channels];
+    uint32_t lastSweepFrames = 0;
+    uint32_t periodMicros = 0;
+
+#ifndef NATIVE_BUILD
+    esp_timer_handle_t timer = nullptr;
+
+    static void onTimer(void* arg) {
+        static_cast<OversamplingAdc*>(arg)->captureFrame();
+    }
+#else
+    unsigned long lastCaptureMicros = 0;
+#endif
+
+public:
+    // channelPins holds Channels pins
+    explicit OversamplingAdc(const uint8_t* channelPins) {
+        for (size_t c = 0; c < Channels; c++) {
+            pins[c] = channelPins[c];
+            latest[c] = 0;
+        }
+    }
+
+    // Starts background capture from the current hal ADC source. Install this
+    // object as the hal source afterwards.
+    bool begin(uint32_t rateHz) {
+        if (rateHz == 0) return false;
+        upstream = hal::adcSource;
+        periodMicros = 1000000UL / rateHz;
+#ifndef NATIVE_BUILD
+        esp_timer_create_args_t args = {};
+        args.callback = &OversamplingAdc::onTimer;
+        args.arg = this;
+        args.name = "adc_oversample";
+        if (esp_timer_create(&args, &timer) != ESP_OK) {
+            return false;
+        }
+        return esp_timer_start_periodic(timer, periodMicros) == ESP_OK;
+#else
+        lastCaptureMicros = hal::micros();
+        return true;
+#endif
+    }
+
+    // Sizes the capture blocks for sweeps intervalMs apart. Call after begin().
+    void setSampleInterval(uint32_t intervalMs) {
+        if (periodMicros > 0) blocks.setIntervalFrames(intervalMs * 1000 / periodMicros);
+    }
+
+    // Reads one frame (all channels) into the open block. Capture context only.
+    void captureFrame() {
+        uint16_t codes[Channels];
+        for (size_t c = 0; c < Channels; c++) {
+            codes[c] = (uint16_t)upstream->read(pins[c]);
+        }
+        blocks.add(codes);
+    }
+
+#ifdef NATIVE_BUILD
+    // Captures the frames due since the last call, at most one ring's worth
+    void pump() {
+        if (periodMicros == 0) return;
+        unsigned long now = hal::micros();
+        uint32_t due = (now - lastCaptureMicros) / periodMicros;
+        lastCaptureMicros += due * periodMicros;
+        if (due > RingBlocks * blocks.framesPerBlock()) due = RingBlocks * blocks.framesPerBlock();
+        while (due--) {
+            captureFrame();
+        }
+    }
+#endif
+
+    void beginSweep() override {
+#ifdef NATIVE_BUILD
+        pump();
+#endif
+        blocks.drainInto(decimator);
+        lastSweepFrames = decimator.emit(latest);
+    }
+
+    int read(uint8_t pin) override {
+        for (size_t c = 0; c < Channels; c++) {
+            if (pins[c] == pin) return latest[c];
+        }
+        return 0;
+    }
+
+    // Frames averaged into the current values (diagnostics)
+    uint32_t framesPerSweep() const { return lastSweepFrames; }
+    uint32_t overruns() const { return blocks.dropCount(); }
+};
+
+#endif // ADC_OVERSAMPLER_H
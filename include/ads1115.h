@@ -0,0 +1,240 @@
+#ifndef ADS1115_H
+#define ADS1115_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "config.h"
+#include "hal.h"
+#include "adc_oversampler.h"
+
+// Registers and timing of the TI ADS1115 (16-bit, 4 inputs, I2C), shared by
+// the driver below and the bus model of the native build (native/ads1115_sim.h)
+namespace ads1115 {
+
+static const uint8_t REG_CONVERSION = 0;
+static const uint8_t REG_CONFIG = 1;
+static const uint8_t REG_LO_THRESH = 2;
+static const uint8_t REG_HI_THRESH = 3;
+
+static const uint16_t CONFIG_OS = 0x8000;           // Write: start a conversion; read: 1 when idle
+static const uint16_t CONFIG_MUX_SINGLE = 0x4000;   // AINx against GND, x in bits 13:12
+static const uint16_t CONFIG_MODE_SINGLE = 0x0100;  // Power down after each conversion
+static const uint16_t CONFIG_COMP_QUE_MASK = 0x0003;  // 11 disables ALERT/RDY
+
+inline uint16_t configWord(uint8_t input, uint8_t pga, uint8_t rate) {
+    return CONFIG_OS | CONFIG_MUX_SINGLE | (uint16_t)((input & 3) << 12) | (uint16_t)((pga & 7) << 9) |
+           CONFIG_MODE_SINGLE | (uint16_t)((rate & 7) << 5);
+}
+
+// Nominal conversion time of a data rate setting (8 to 860 samples/s)
+inline uint32_t conversionMicros(uint8_t rate) {
+    static const uint16_t SPS[8] = {8, 16, 32, 64, 128, 250, 475, 860};
+    return (1000000UL + SPS[rate & 7] - 1) / SPS[rate & 7];
+}
+
+// Input of a full-scale code (+32767) for a PGA setting
+inline float fullScale(uint8_t pga) {
+    static const float VOLTS[8] = {6.144f, 4.096f, 2.048f, 1.024f, 0.512f, 0.256f, 0.256f, 0.256f};
+    return VOLTS[pga & 7];
+}
+
+}  // namespace ads1115
+
+#ifndef NATIVE_BUILD
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+// ADS1115 scanning Inputs single-ended inputs continuously, as an ADC source
+// for the channel registry (attach() it as ADC_BUS_ADS1115). Like
+// OversamplingAdc, every full scan is one frame in a ring, and each sweep
+// returns the mean of the frames captured since the previous one.
+//
+// The part has one converter behind a multiplexer, so a scan is a chain of
+// single-shot conversions. The ALERT/RDY pin signals the end of each one
+// (no polling of the config register): its falling edge wakes a task that
+// services the bus. Pipelined, the service starts the next input's conversion
+// first and then reads the finished result, which stays in the conversion
+// register until the new conversion completes; the bus transfer overlaps the
+// conversion instead of sitting between two. Unpipelined it reads, then starts.
+//
+// In the native build the interrupt runs service() directly at the simulated
+// board time and the bus is native::Ads1115Sim.
+template <size_t Inputs, size_t RingBlocks>
+class Ads1115 : public hal::AdcSource {
+private:
+    uint8_t inputs[Inputs];
+    uint8_t address;
+    uint8_t alertPin;
+    uint8_t pga;
+    uint8_t rate;
+    bool pipelined;
+    hal::I2cBus* bus = nullptr;
+
+    // Service side (the task, or the interrupt in the native build)
+    size_t converting = 0;          // scan position of the conversion in progress
+    AdcFrame<Inputs> frame;
+    std::atomic<uint32_t> lastReadyMicros{0};
+    std::atomic<uint32_t> conversionCount{0};
+    std::atomic<uint32_t> busErrorCount{0};
+    uint32_t restartCount = 0;
+
+    BlockRing<Inputs, RingBlocks> blocks;
+    Decimator<Inputs> decimator;
+    int latest[Inputs];
+    uint32_t lastSweepFrames = 0;
+
+#ifndef NATIVE_BUILD
+    TaskHandle_t task = nullptr;
+
+    static void IRAM_ATTR onAlert(void* arg) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(static_cast<Ads1115*>(arg)->task, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+
+    static void serviceTask(void* arg) {
+        Ads1115* adc = static_cast<Ads1115*>(arg);
+        TickType_t timeout = pdMS_TO_TICKS(4 * ads1115::conversionMicros(adc->rate) / 1000 + 1);
+        for (;;) {
+            if (ulTaskNotifyTake(pdTRUE, timeout) > 0) {
+                adc->service();
+            } else {
+                adc->restartIfStalled();
+            }
+        }
+    }
+#else
+    static void onAlert(void* arg) { static_cast<Ads1115*>(arg)->service(); }
+#endif
+
+    bool writeRegister(uint8_t reg, uint16_t value) {
+        uint8_t data[3] = {reg, (uint8_t)(value >> 8), (uint8_t)value};
+        return bus->write(address, data, sizeof(data));
+    }
+
+    bool readConversion(uint16_t& value) {
+        uint8_t pointer = ads1115::REG_CONVERSION;
+        uint8_t data[2];
+        if (!bus->write(address, &pointer, 1) || !bus->read(address, data, sizeof(data))) {
+            return false;
+        }
+        int16_t code = (int16_t)((data[0] << 8) | data[1]);
+        value = code > 0 ? (uint16_t)code : 0;   // Single-ended inputs read a few codes below 0 at ground
+        return true;
+    }
+
+    bool startConversion(size_t position) {
+        converting = position;
+        return writeRegister(ads1115::REG_CONFIG, ads1115::configWord(inputs[position], pga, rate));
+    }
+
+    // Stores the result of scan position done; a full scan becomes a frame
+    void store(size_t done, uint16_t value) {
+        frame.codes[done] = value;
+        conversionCount.fetch_add(1, std::memory_order_relaxed);
+        if (done == Inputs - 1) blocks.add(frame.codes);
+    }
+
+public:
+    // channelInputs holds Inputs multiplexer inputs (0-3); pga and rate are the
+    // config register settings (ads1115::fullScale, ads1115::conversionMicros)
+    Ads1115(const uint8_t* channelInputs, uint8_t i2cAddress, uint8_t alertGpio, uint8_t gain,
+            uint8_t dataRate, bool pipelineConversions)
+        : address(i2cAddress), alertPin(alertGpio), pga(gain), rate(dataRate), pipelined(pipelineConversions) {
+        for (size_t i = 0; i < Inputs; i++) {
+            inputs[i] = channelInputs[i];
+            frame.codes[i] = 0;
+            latest[i] = 0;
+        }
+    }
+
+    // Sets ALERT/RDY to conversion-ready mode and starts scanning on hal::i2cBus;
+    // false if the converter does not answer
+    bool begin() {
+        bus = hal::i2cBus;
+        if (bus == nullptr) return false;
+        // A high threshold with its MSB set and a low one without turns ALERT into RDY
+        if (!writeRegister(ads1115::REG_HI_THRESH, 0x8000) || !writeRegister(ads1115::REG_LO_THRESH, 0x0000)) {
+            return false;
+        }
+        pinMode(alertPin, INPUT_PULLUP);   // Open-drain output
+#ifndef NATIVE_BUILD
+        if (task == nullptr &&
+            xTaskCreatePinnedToCore(serviceTask, "ads1115", ADS1115_TASK_STACK, this, ADS1115_TASK_PRIORITY,
+                                    &task, SAMPLING_TASK_CORE) != pdPASS) {
+            return false;
+        }
+#endif
+        attachInterruptArg(digitalPinToInterrupt(alertPin), onAlert, this, FALLING);
+        lastReadyMicros.store(hal::micros(), std::memory_order_relaxed);
+        return startConversion(0);
+    }
+
+    // Sizes the capture blocks for sweeps intervalMs apart
+    void setSampleInterval(uint32_t intervalMs) {
+        blocks.setIntervalFrames(intervalMs * 1000 / (ads1115::conversionMicros(rate) * Inputs));
+    }
+
+    // Stops scanning after the conversion in progress
+    void end() {
+        detachInterrupt(digitalPinToInterrupt(alertPin));
+    }
+
+    // One conversion has finished (ALERT/RDY fell). Service context only.
+    void service() {
+        lastReadyMicros.store(hal::micros(), std::memory_order_relaxed);
+        size_t done = converting;
+        size_t next = done + 1 < Inputs ? done + 1 : 0;
+        uint16_t value;
+        bool ok;
+        if (pipelined) {
+            ok = startConversion(next) && readConversion(value);
+        } else {
+            ok = readConversion(value) && startConversion(next);
+        }
+        if (ok) {
+            store(done, value);
+        } else {
+            // The chain stops here; restartIfStalled() picks it up again
+            busErrorCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Starts the scan over when no conversion has finished for four conversion
+    // times (a lost edge or a failed transfer). Service context only.
+    void restartIfStalled() {
+        uint32_t quiet = hal::micros() - lastReadyMicros.load(std::memory_order_relaxed);
+        if (quiet > 4 * ads1115::conversionMicros(rate)) {
+            restartCount++;
+            lastReadyMicros.store(hal::micros(), std::memory_order_relaxed);
+            if (!startConversion(0)) busErrorCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void beginSweep() override {
+#ifdef NATIVE_BUILD
+        if (bus != nullptr) restartIfStalled();
+#endif
+        blocks.drainInto(decimator);
+        lastSweepFrames = decimator.emit(latest);
+    }
+
+    int read(uint8_t input) override {
+        for (size_t i = 0; i < Inputs; i++) {
+            if (inputs[i] == input) return latest[i];
+        }
+        return 0;
+    }
+
+    float voltsPerCode() override { return ads1115::fullScale(pga) / 32768.0f; }
+
+    // Diagnostics
+    uint32_t conversions() const { return conversionCount.load(std::memory_order_relaxed); }
+    uint32_t busErrors() const { return busErrorCount.load(std::memory_order_relaxed); }
+    uint32_t restarts() const { return restartCount; }
+    uint32_t framesPerSweep() const { return lastSweepFrames; }
+    uint32_t overruns() const { return blocks.dropCount(); }
+};
+
+#endif // ADS1115_H
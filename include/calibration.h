@@ -0,0 +1,202 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <Preferences.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "conversion_tables.h"
+#include "reading.h"
+
+// Multi-point calibration of a channel: probe voltages recorded in reference
+// solutions (buffers, conductivity or formazin standards) and the values they
+// stand for. The curve through them is either piecewise linear (extended
+// along the end segments) or a least-squares polynomial of degree 1 to 3.
+// Channels without points keep the factory conversion of conversion_tables.h.
+struct CalibrationCurve {
+    static const size_t POINTS_MAX = CALIBRATION_POINTS_MAX;
+    static const size_t DEGREE_MAX = 3;
+
+    uint8_t count = 0;                 // 0: factory conversion
+    uint8_t degree = 0;                // 0: piecewise linear, else polynomial degree
+    uint8_t reserved[2] = {};
+    float volts[POINTS_MAX] = {};      // Ascending
+    float values[POINTS_MAX] = {};
+    float coefficients[DEGREE_MAX + 1] = {};   // Polynomial, constant term first
+
+    bool calibrated() const { return count > 0; }
+
+    float evaluate(float voltage) const {
+        if (degree > 0) {
+            float value = coefficients[degree];
+            for (int d = degree - 1; d >= 0; d--) value = value * voltage + coefficients[d];
+            return value;
+        }
+        size_t i = 1;
+        while (i + 1 < count && voltage > volts[i]) i++;
+        return values[i - 1] + (voltage - volts[i - 1]) * (values[i] - values[i - 1]) / (volts[i] - volts[i - 1]);
+    }
+
+    // Sorts the points and fits the polynomial. False (curve unusable) for
+    // fewer than two points, two at the same voltage, or a degree the points
+    // cannot determine.
+    bool fit() {
+        if (count < 2 || count > POINTS_MAX || degree > DEGREE_MAX || degree >= count) return false;
+        for (size_t i = 1; i < count; i++) {
+            for (size_t j = i; j > 0 && volts[j] < volts[j - 1]; j--) {
+                float v = volts[j];
+                volts[j] = volts[j - 1];
+                volts[j - 1] = v;
+                float x = values[j];
+                values[j] = values[j - 1];
+                values[j - 1] = x;
+            }
+        }
+        for (size_t i = 1; i < count; i++) {
+            if (!(volts[i] > volts[i - 1])) return false;
+        }
+        for (float& c : coefficients) c = 0.0f;
+        if (degree == 0) return true;
+
+        // Normal equations, solved by Gaussian elimination with partial pivoting
+        const size_t n = degree + 1;
+        double a[DEGREE_MAX + 1][DEGREE_MAX + 2] = {};
+        for (size_t p = 0; p < count; p++) {
+            double powers[2 * DEGREE_MAX + 1];
+            powers[0] = 1.0;
+            for (size_t k = 1; k <= 2 * degree; k++) powers[k] = powers[k - 1] * volts[p];
+            for (size_t r = 0; r < n; r++) {
+                for (size_t c = 0; c < n; c++) a[r][c] += powers[r + c];
+                a[r][n] += powers[r] * values[p];
+            }
+        }
+        for (size_t col = 0; col < n; col++) {
+            size_t pivot = col;
+            for (size_t r = col + 1; r < n; r++) {
+                if (fabs(a[r][col]) > fabs(a[pivot][col])) pivot = r;
+            }
+            if (fabs(a[pivot][col]) < 1e-12) return false;
+            for (size_t c = 0; c <= n; c++) {
+                double t = a[col][c];
+                a[col][c] = a[pivot][c];
+                a[pivot][c] = t;
+            }
+            for (size_t r = 0; r < n; r++) {
+                if (r == col) continue;
+                double factor = a[r][col] / a[col][col];
+                for (size_t c = col; c <= n; c++) a[r][c] -= factor * a[col][c];
+            }
+        }
+        for (size_t d = 0; d < n; d++) coefficients[d] = (float)(a[d][n] / a[d][d]);
+        return true;
+    }
+};
+
+// Calibration of every channel, in SensorChannel order
+struct Calibration {
+    CalibrationCurve curves[SENSOR_CHANNEL_COUNT];
+
+    bool operator==(const Calibration& other) const { return memcmp(this, &other, sizeof(Calibration)) == 0; }
+    bool operator!=(const Calibration& other) const { return !(*this == other); }
+};
+
+// A calibrated curve resampled at every CODES_PER_SEGMENT on-chip ADC codes,
+// so a sample costs a segment lookup and one multiply-add, like the factory
+// tables. The position may be fractional (a temperature-compensated code).
+// Channels that cannot go negative are held at zero.
+class CalibrationTable {
+public:
+    static const int CODES_PER_SEGMENT = 32;
+    static const int SEGMENTS = conversion::ADC_CODES / CODES_PER_SEGMENT;
+
+private:
+    float base[SEGMENTS];
+    float slope[SEGMENTS];
+
+public:
+    void build(const CalibrationCurve& curve, bool negative) {
+        float previous = 0.0f;
+        for (int s = 0; s <= SEGMENTS; s++) {
+            float value = curve.evaluate(conversion::rawToVoltage(s * CODES_PER_SEGMENT));
+            if (!negative && value < 0.0f) value = 0.0f;
+            if (s > 0) {
+                base[s - 1] = previous;
+                slope[s - 1] = (value - previous) / CODES_PER_SEGMENT;
+            }
+            previous = value;
+        }
+    }
+
+    float at(float code) const {
+        if (code < 0.0f) code = 0.0f;
+        int s = (int)code / CODES_PER_SEGMENT;
+        if (s >= SEGMENTS) s = SEGMENTS - 1;
+        return base[s] + slope[s] * (code - (float)(s * CODES_PER_SEGMENT));
+    }
+};
+
+// Calibration in NVS (Preferences) next to the settings, written only when it
+// changes. A record for a different channel count is ignored.
+class CalibrationStore {
+private:
+    static const uint32_t RECORD_VERSION = 1;
+    static constexpr const char* KEY = "calibration";
+
+    struct Record {
+        uint32_t version;
+        uint32_t channels;
+        Calibration calibration;
+    };
+
+    Calibration stored;
+    bool haveStored = false;
+
+public:
+    // false (and calibration untouched) if nothing valid is stored
+    bool load(Calibration& calibration) {
+        Preferences prefs;
+        if (!prefs.begin(SETTINGS_NAMESPACE, true)) {
+            return false;
+        }
+        Record record;
+        bool ok = prefs.getBytesLength(KEY) == sizeof(record) &&
+                  prefs.getBytes(KEY, &record, sizeof(record)) == sizeof(record) &&
+                  record.version == RECORD_VERSION && record.channels == SENSOR_CHANNEL_COUNT;
+        prefs.end();
+        for (size_t c = 0; ok && c < SENSOR_CHANNEL_COUNT; c++) {
+            CalibrationCurve& curve = record.calibration.curves[c];
+            ok = !curve.calibrated() || curve.fit();
+        }
+        if (ok) {
+            calibration = record.calibration;
+            stored = record.calibration;
+            haveStored = true;
+        }
+        return ok;
+    }
+
+    bool save(const Calibration& calibration) {
+        if (haveStored && calibration == stored) {
+            return true;
+        }
+        Preferences prefs;
+        if (!prefs.begin(SETTINGS_NAMESPACE, false)) {
+            return false;
+        }
+        Record record;
+        record.version = RECORD_VERSION;
+        record.channels = SENSOR_CHANNEL_COUNT;
+        record.calibration = calibration;
+        bool ok = prefs.putBytes(KEY, &record, sizeof(record)) == sizeof(record);
+        prefs.end();
+        if (ok) {
+            stored = calibration;
+            haveStored = true;
+        }
+        return ok;
+    }
+};
+
+#endif // CALIBRATION_H
@@ -0,0 +1,237 @@
+#ifndef CHANNEL_REGISTRY_H
+#define CHANNEL_REGISTRY_H
+
+#include <Arduino.h>
+#include "calibration.h"
+#include "channels.h"
+#include "conversion_tables.h"
+#include "hal.h"
+#include "streaming_stats.h"
+
+// Run-time side of a channel table (channels.h). The state of a sweep is kept
+// as parallel arrays (codes, voltages, values) rather than one struct per
+// channel, so each stage of a sweep is one tight loop over every channel and
+// more probes only make the loops longer. Channels with a filterWindow above 1
+// get one of FilterSlots moving averages of up to MaxFilterWindow samples.
+//
+// Bus ADC_BUS_ONCHIP reads through hal::adcSource as it is at the time of the
+// sweep; other buses read from the source attach()ed to them, and read 0 until
+// one is. Codes become volts at the step size of their source; the lookup
+// tables are indexed by on-chip codes, so channels on other buses always take
+// the float kernel.
+//
+// A channel given a calibration curve converts through that curve instead,
+// resampled into a CalibrationTable for on-chip codes. Channels with a
+// temperatureCoefficient are converted after the others, at their voltage (or
+// code) referred to 25 °C by the smoothed value of the temperature channel.
+template <size_t Channels, size_t FilterSlots, size_t MaxFilterWindow>
+class ChannelRegistry {
+private:
+    const ChannelSpec* specs;
+    uint8_t pins[Channels];
+    uint8_t buses[Channels];
+    const float* tables[Channels];
+    float (*kernels[Channels])(float);
+    int8_t filterSlots[Channels];           // -1 without a moving average
+    float coefficients[Channels];           // Temperature compensation, 0 for none
+    float gains[Channels];                  // Compensation of the last sweep, 1 for none
+    bool calibrated[Channels];
+    CalibrationCurve curves[Channels];
+    CalibrationTable calibrationTables[Channels];
+
+    size_t temperatureChannel;
+    bool compensating = false;
+    uint32_t temperatureSamples = 0;
+    float temperature = TDS_DEFAULT_TEMPERATURE;
+
+    int codes[Channels];
+    float voltages[Channels];
+    float values[Channels];
+
+    hal::AdcSource* sources[ADC_BUS_COUNT] = {};
+    float voltsPerCode[ADC_BUS_COUNT];
+    uint8_t busesUsed = 0;                  // bit per bus with at least one channel
+    StreamingStats<1, MaxFilterWindow> filters[FilterSlots > 0 ? FilterSlots : 1];
+
+    // Value of channel c from this sweep, at gain times its code or voltage
+    float convert(size_t c, float gain) const {
+#if SENSOR_CONVERSION_LUT
+        if (buses[c] == ADC_BUS_ONCHIP) {
+            if (calibrated[c]) return calibrationTables[c].at(codes[c] * gain);
+            int code = gain == 1.0f ? codes[c] : (int)(codes[c] * gain + 0.5f);
+            return tables[c][conversion::tableIndex(code)];
+        }
+#endif
+        return evaluate(c, voltages[c] * gain);
+    }
+
+    // EWMA of the temperature channel; a plain running mean until it has
+    // seen enough samples, so start-up does not hang on the first sample
+    void updateTemperature(float sample) {
+        if (sample < TEMPERATURE_COMPENSATION_MIN) sample = TEMPERATURE_COMPENSATION_MIN;
+        if (sample > TEMPERATURE_COMPENSATION_MAX) sample = TEMPERATURE_COMPENSATION_MAX;
+        temperatureSamples++;
+        float weight = 1.0f / temperatureSamples;
+        if (weight < TEMPERATURE_SMOOTHING) weight = TEMPERATURE_SMOOTHING;
+        temperature += weight * (sample - temperature);
+    }
+
+public:
+    // temperatureSource is the channel that compensates the others (any
+    // uncompensated one; out of range for no compensation)
+    ChannelRegistry(const ChannelSpec (&table)[Channels], size_t temperatureSource)
+        : specs(table), temperatureChannel(temperatureSource) {
+        size_t slot = 0;
+        for (size_t c = 0; c < Channels; c++) {
+            pins[c] = table[c].pin;
+            buses[c] = table[c].bus;
+            tables[c] = table[c].table->data();
+            kernels[c] = table[c].convert;
+            coefficients[c] = table[c].temperatureCoefficient;
+            gains[c] = 1.0f;
+            calibrated[c] = false;
+            compensating = compensating || coefficients[c] != 0.0f;
+            filterSlots[c] = -1;
+            if (table[c].filterWindow > 1 && slot < FilterSlots) {
+                filterSlots[c] = (int8_t)slot;
+                filters[slot++].setWindow(table[c].filterWindow);
+            }
+            busesUsed |= (uint8_t)(1u << buses[c]);
+            codes[c] = 0;
+            voltages[c] = values[c] = 0.0f;
+        }
+        for (uint8_t b = 0; b < ADC_BUS_COUNT; b++) {
+            voltsPerCode[b] = VOLTAGE_REF / ADC_RESOLUTION;
+        }
+        if (temperatureChannel >= Channels || coefficients[temperatureChannel] != 0.0f) {
+            compensating = false;
+        }
+        for (size_t c = 0; c < Channels && !compensating; c++) coefficients[c] = 0.0f;
+    }
+
+    // Source of an external bus (ADC_BUS_ONCHIP always follows hal::adcSource)
+    void attach(uint8_t bus, hal::AdcSource* source) {
+        if (bus != ADC_BUS_ONCHIP && bus < ADC_BUS_COUNT) sources[bus] = source;
+    }
+
+    // Configures the on-chip input pins
+    void begin() {
+        for (size_t c = 0; c < Channels; c++) {
+            if (buses[c] == ADC_BUS_ONCHIP) pinMode(pins[c], INPUT);
+        }
+    }
+
+    // Reads, converts and filters every channel
+    void sweep() {
+        sources[ADC_BUS_ONCHIP] = hal::adcSource;
+        for (uint8_t b = 0; b < ADC_BUS_COUNT; b++) {
+            if ((busesUsed & (1u << b)) && sources[b] != nullptr) {
+                sources[b]->beginSweep();
+                voltsPerCode[b] = sources[b]->voltsPerCode();
+            }
+        }
+        for (size_t c = 0; c < Channels; c++) {
+            hal::AdcSource* source = sources[buses[c]];
+            codes[c] = source != nullptr ? source->read(pins[c]) : 0;
+        }
+        for (size_t c = 0; c < Channels; c++) {
+            voltages[c] = codes[c] * voltsPerCode[buses[c]];
+        }
+        for (size_t c = 0; c < Channels; c++) {
+            if (coefficients[c] == 0.0f) values[c] = convert(c, 1.0f);
+        }
+        if (compensating) {
+            updateTemperature(values[temperatureChannel]);
+            for (size_t c = 0; c < Channels; c++) {
+                if (coefficients[c] == 0.0f) continue;
+                gains[c] = 1.0f / (1.0f + coefficients[c] * (temperature - 25.0f));
+                values[c] = convert(c, gains[c]);
+            }
+        }
+        for (size_t c = 0; c < Channels; c++) {
+            if (filterSlots[c] >= 0) {
+                StreamingStats<1, MaxFilterWindow>& filter = filters[filterSlots[c]];
+                filter.push(&values[c]);
+                values[c] = filter.mean();
+            }
+        }
+    }
+
+    // Converts through curve from the next sweep on; an uncalibrated curve
+    // restores the factory conversion
+    void setCalibration(size_t channel, const CalibrationCurve& curve) {
+        calibrated[channel] = curve.calibrated();
+        curves[channel] = curve;
+        if (curve.calibrated()) calibrationTables[channel].build(curve, specs[channel].negative);
+    }
+
+    const CalibrationCurve& calibration(size_t channel) const { return curves[channel]; }
+
+    // Value of channel at a voltage (calibration applied, no compensation)
+    float evaluate(size_t channel, float voltage) const {
+        if (!calibrated[channel]) return kernels[channel](voltage);
+        float value = curves[channel].evaluate(voltage);
+        return value < 0.0f && !specs[channel].negative ? 0.0f : value;
+    }
+
+    // Smoothed temperature the compensated channels were last referred from
+    float compensationTemperature() const { return temperature; }
+
+    // Moving average length of a filtered channel (others stay unfiltered)
+    void setFilterWindow(size_t channel, size_t window) {
+        if (filterSlots[channel] >= 0 && window > 0 && window <= MaxFilterWindow) {
+            // History is kept, so the new window applies from the next reading
+            filters[filterSlots[channel]].setWindow(window);
+        }
+    }
+
+    size_t filterWindow(size_t channel) const {
+        return filterSlots[channel] >= 0 ? filters[filterSlots[channel]].window() : 1;
+    }
+
+    size_t count() const { return Channels; }
+    const ChannelSpec& spec(size_t channel) const { return specs[channel]; }
+
+    float value(size_t channel) const { return values[channel]; }
+    float voltage(size_t channel) const { return voltages[channel]; }
+    int raw(size_t channel) const { return codes[channel]; }
+
+    // Value of the last sweep before the moving average (for comparison)
+    float unfiltered(size_t channel) const { return evaluate(channel, voltages[channel] * gains[channel]); }
+
+    // Values of the last sweep, one per channel
+    void copyValues(float* out) const {
+        for (size_t c = 0; c < Channels; c++) out[c] = values[c];
+    }
+
+    // One line with every channel: "ph 7.00 tds 312.4 ..." when compact, else
+    // label, value, unit, raw code and voltage of each
+    void print(Print& out, bool compact) const {
+        for (size_t c = 0; c < Channels; c++) {
+            const ChannelSpec& channel = specs[c];
+            if (compact) {
+                if (c > 0) out.print(' ');
+                out.print(channel.tag);
+                out.print(' ');
+                out.print(values[c], channel.decimals);
+                continue;
+            }
+            if (c > 0) out.print("   ");
+            out.print(channel.label);
+            out.print(": ");
+            out.print(values[c], channel.decimals);
+            if (channel.unit[0] != '\0') {
+                out.print(' ');
+                out.print(channel.unit);
+            }
+            out.print(" (Raw: ");
+            out.print(codes[c]);
+            out.print(", Voltage: ");
+            out.print(voltages[c], 2);
+            out.print("V)");
+        }
+        out.println();
+    }
+};
+
+#endif // CHANNEL_REGISTRY_H
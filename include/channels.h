@@ -0,0 +1,126 @@
+#ifndef CHANNELS_H
+#define CHANNELS_H
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "conversion_tables.h"
+#include "reading.h"
+
+// Declaration of one sensor channel: where its code comes from, how the code
+// becomes a value, how the value is filtered and how it is published.
+struct ChannelSpec {
+    const char* key;                   // JSON key, CSV column
+    const char* tag;                   // Short console name (LOG_COMPACT)
+    const char* label;                 // Console name
+    const char* unit;                  // Console unit, "" for none
+    uint8_t pin;                       // Pin or input number on its bus
+    uint8_t bus;                       // ADC_BUS_ONCHIP, or an external ADC attached to the registry
+    const conversion::Table* table;    // Code -> value (SENSOR_CONVERSION_LUT)
+    float (*convert)(float voltage);   // Voltage -> value (float path)
+    uint8_t decimals;                  // Published precision
+    bool negative;                     // Can go below zero (flash log encoding)
+    uint8_t filterWindow;              // Moving average ahead of the statistics, 1 for none
+    float minDeviation;                // Outlier filter floor (OUTLIER_MIN_DEV_*)
+    float deadband;                    // Adaptive reporting deadband (ADAPTIVE_DEADBAND_*)
+    float temperatureCoefficient;      // Per °C: voltage / (1 + k (T - 25)) is converted, 0 for none
+};
+
+static const uint8_t ADC_BUS_ONCHIP = 0;   // hal::adcSource (oversampled when ADC_OVERSAMPLING)
+static const uint8_t ADC_BUS_ADS1115 = 1;  // External ADS1115 (EXTERNAL_ADC, ads1115.h)
+static const uint8_t ADC_BUS_COUNT = 4;
+
+#if TDS_TEMPERATURE_COMPENSATION
+#define TDS_COMPENSATION_COEFFICIENT TDS_TEMPERATURE_COEFFICIENT
+#else
+#define TDS_COMPENSATION_COEFFICIENT 0.0f
+#endif
+
+// The node's channels in SensorChannel order, standard probes first. An extra
+// probe is one more line here plus SENSOR_CHANNELS in config.h, e.g. a second
+// temperature probe on input 1 of the ADS1115:
+//
+//   {"temperature_2m", "t2m", "Temperature 2 m", "°C", 1, ADC_BUS_ADS1115, &conversion::TEMPERATURE_TABLE,
+//    conversion::voltageToTemperature, 1, true, 1, OUTLIER_MIN_DEV_TEMPERATURE, ADAPTIVE_DEADBAND_TEMPERATURE, 0.0f},
+inline constexpr ChannelSpec CHANNELS[SENSOR_CHANNEL_COUNT] = {
+#if EXTERNAL_ADC
+    {"ph", "ph", "pH", "", PH_ADS_INPUT, ADC_BUS_ADS1115, &conversion::PH_TABLE, conversion::voltageToPH,
+     2, true, PH_WINDOW, OUTLIER_MIN_DEV_PH, ADAPTIVE_DEADBAND_PH, 0.0f},
+#else
+    {"ph", "ph", "pH", "", PH_PIN, ADC_BUS_ONCHIP, &conversion::PH_TABLE, conversion::voltageToPH,
+     2, true, PH_WINDOW, OUTLIER_MIN_DEV_PH, ADAPTIVE_DEADBAND_PH, 0.0f},
+#endif
+    {"tds", "tds", "TDS", "ppm", TDS_PIN, ADC_BUS_ONCHIP, &conversion::TDS_TABLE, conversion::voltageToTDS,
+     1, false, 1, OUTLIER_MIN_DEV_TDS, ADAPTIVE_DEADBAND_TDS, TDS_COMPENSATION_COEFFICIENT},
+    {"turbidity", "ntu", "Turbidity", "NTU", TURBIDITY_PIN, ADC_BUS_ONCHIP, &conversion::TURBIDITY_TABLE,
+     conversion::voltageToTurbidity, 2, false, 1, OUTLIER_MIN_DEV_TURBIDITY, ADAPTIVE_DEADBAND_TURBIDITY, 0.0f},
+    {"temperature", "t", "Temperature", "°C", TEMP_PIN, ADC_BUS_ONCHIP, &conversion::TEMPERATURE_TABLE,
+     conversion::voltageToTemperature, 1, true, 1, OUTLIER_MIN_DEV_TEMPERATURE, ADAPTIVE_DEADBAND_TEMPERATURE, 0.0f},
+};
+
+// Every entry filled in and on a known bus
+constexpr bool channelsDeclared() {
+    for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        if (CHANNELS[c].key == nullptr || CHANNELS[c].table == nullptr || CHANNELS[c].convert == nullptr ||
+            CHANNELS[c].bus >= ADC_BUS_COUNT) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(channelsDeclared(), "CHANNELS needs one complete entry per SENSOR_CHANNELS");
+
+// Fixed-point scale that keeps a channel's published precision
+constexpr float channelScale(size_t channel) {
+    float scale = 1.0f;
+    for (uint8_t d = 0; d < CHANNELS[channel].decimals; d++) scale *= 10.0f;
+    return scale;
+}
+
+constexpr std::array<float, SENSOR_CHANNEL_COUNT> channelScales() {
+    std::array<float, SENSOR_CHANNEL_COUNT> scales{};
+    for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) scales[c] = channelScale(c);
+    return scales;
+}
+
+// One field of every channel as an array, e.g. channelField(&ChannelSpec::deadband)
+template <typename T>
+constexpr std::array<T, SENSOR_CHANNEL_COUNT> channelField(T ChannelSpec::*field) {
+    std::array<T, SENSOR_CHANNEL_COUNT> values{};
+    for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) values[c] = CHANNELS[c].*field;
+    return values;
+}
+
+constexpr size_t countChannels(bool (*match)(const ChannelSpec&)) {
+    size_t n = 0;
+    for (const ChannelSpec& spec : CHANNELS) n += match(spec) ? 1 : 0;
+    return n;
+}
+
+constexpr bool hasFilter(const ChannelSpec& spec) { return spec.filterWindow > 1; }
+
+constexpr size_t busChannelCount(uint8_t bus) {
+    size_t n = 0;
+    for (const ChannelSpec& spec : CHANNELS) n += spec.bus == bus ? 1 : 0;
+    return n;
+}
+
+// Channels with a moving average, and channels on each ADC
+static const size_t FILTERED_CHANNEL_COUNT = countChannels(hasFilter);
+static const size_t ONCHIP_CHANNEL_COUNT = busChannelCount(ADC_BUS_ONCHIP);
+static const size_t ADS1115_CHANNEL_COUNT = busChannelCount(ADC_BUS_ADS1115);
+
+// Pins (inputs) of the channels on one bus, in table order: what the
+// oversampler or an external ADC scans. N is busChannelCount(bus).
+template <size_t N>
+constexpr std::array<uint8_t, N> busPins(uint8_t bus) {
+    std::array<uint8_t, N> pins{};
+    size_t n = 0;
+    for (const ChannelSpec& spec : CHANNELS) {
+        if (spec.bus == bus && n < N) pins[n++] = spec.pin;
+    }
+    return pins;
+}
+
+#endif // CHANNELS_H
@@ -0,0 +1,242 @@
+#ifndef COMMAND_HANDLER_H
+#define COMMAND_HANDLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+#include "settings.h"
+#include "calibration.h"
+#include "channels.h"
+
+// Parser and dispatcher for messages on MQTT_COMMAND_TOPIC.
+// A command is a list of name=value pairs, or a flat JSON object with the
+// same names (quotes, braces, commas and ':' are accepted as punctuation):
+//
+//   sample_interval=250 publish_interval=1000
+//   {"window":10,"batch":12,"log":"quiet"}
+//   defaults          back to the config.h settings (calibration is kept)
+//   status            only report the current settings
+//   cal_ph=0.905:4.01/1.578:7.00/2.232:10.01
+//   cal_turbidity=poly2/0.05:0/0.9:10/2.0:40/2.9:100
+//   cal_tds=factory   back to the conversion of conversion_tables.h
+//
+// Names and bounds are SETTING_FIELDS (settings.h); log also takes quiet,
+// averages or samples. cal_<key> (key from channels.h) sets the calibration
+// of a channel from volts:value points, piecewise linear or, after polyN/,
+// a least-squares polynomial of degree N (calibration.h). A command is
+// applied as a whole or not at all. The
+// parser works in place on the MQTT buffer: no copies and no allocation, and
+// anything longer than MAX_COMMAND_LENGTH is rejected unread.
+class CommandHandler {
+public:
+    static const size_t MAX_COMMAND_LENGTH = 256;
+
+private:
+    Settings& settings;
+    Calibration& calibration;
+    bool pending = false;
+    bool changed = false;
+    bool calibrationChanged = false;
+    char result[64] = "ok";
+
+    static bool separator(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',' || c == ';' ||
+               c == '{' || c == '}' || c == '"' || c == '\'';
+    }
+
+    static bool equals(const char* text, size_t length, const char* word) {
+        return strlen(word) == length && memcmp(text, word, length) == 0;
+    }
+
+    // Unsigned decimal; false on anything else or overflow
+    static bool parseNumber(const char* text, size_t length, uint32_t& value) {
+        if (length == 0 || length > 10) return false;
+        uint64_t v = 0;
+        for (size_t i = 0; i < length; i++) {
+            if (text[i] < '0' || text[i] > '9') return false;
+            v = v * 10 + (uint64_t)(text[i] - '0');
+        }
+        if (v > 0xFFFFFFFFULL) return false;
+        value = (uint32_t)v;
+        return true;
+    }
+
+    static bool parseLogLevel(const char* text, size_t length, uint32_t& value) {
+        if (equals(text, length, "quiet")) {
+            value = LOG_QUIET;
+        } else if (equals(text, length, "averages")) {
+            value = LOG_AVERAGES;
+        } else if (equals(text, length, "samples")) {
+            value = LOG_SAMPLES;
+        } else {
+            return parseNumber(text, length, value);
+        }
+        return true;
+    }
+
+    // Decimal with optional sign and fraction (no exponent)
+    static bool parseDecimal(const char* text, size_t length, float& value) {
+        size_t i = length > 0 && text[0] == '-' ? 1 : 0;
+        double v = 0.0, scale = 1.0;
+        bool digits = false, point = false;
+        for (size_t start = i; i < length; i++) {
+            if (text[i] == '.' && !point) {
+                point = true;
+                continue;
+            }
+            if (text[i] < '0' || text[i] > '9' || i - start > 12) return false;
+            digits = true;
+            if (point) {
+                scale /= 10.0;
+                v += (text[i] - '0') * scale;
+            } else {
+                v = v * 10.0 + (text[i] - '0');
+            }
+        }
+        if (!digits) return false;
+        value = (float)(text[0] == '-' ? -v : v);
+        return true;
+    }
+
+    // "factory", or "[polyN/]volts:value/volts:value/..."; the curve is fitted
+    static bool parseCurve(const char* text, size_t length, CalibrationCurve& curve) {
+        curve = CalibrationCurve();
+        if (equals(text, length, "factory")) return true;
+        size_t pos = 0;
+        if (length > 6 && memcmp(text, "poly", 4) == 0 && text[5] == '/') {
+            if (text[4] < '1' || text[4] > '0' + (int)CalibrationCurve::DEGREE_MAX) return false;
+            curve.degree = (uint8_t)(text[4] - '0');
+            pos = 6;
+        }
+        while (pos < length) {
+            size_t end = pos;
+            while (end < length && text[end] != '/') end++;
+            const char* colon = (const char*)memchr(text + pos, ':', end - pos);
+            if (colon == nullptr || curve.count >= CalibrationCurve::POINTS_MAX) return false;
+            size_t voltsLength = colon - (text + pos);
+            if (!parseDecimal(text + pos, voltsLength, curve.volts[curve.count]) ||
+                !parseDecimal(colon + 1, end - pos - voltsLength - 1, curve.values[curve.count])) {
+                return false;
+            }
+            curve.count++;
+            pos = end + 1;
+        }
+        return curve.fit();
+    }
+
+    static int findChannel(const char* key, size_t length) {
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            if (equals(key, length, CHANNELS[c].key)) return (int)c;
+        }
+        return -1;
+    }
+
+    void reject(const char* reason, const char* name, size_t length) {
+        if (length > 24) length = 24;
+        snprintf(result, sizeof(result), "error: %s %.*s", reason, (int)length, name);
+    }
+
+public:
+    CommandHandler(Settings& current, Calibration& currentCalibration)
+        : settings(current), calibration(currentCalibration) {}
+
+    // Parses and applies one command message (not NUL-terminated)
+    void handle(const char* text, size_t length) {
+        pending = true;
+        if (length > MAX_COMMAND_LENGTH) {
+            strcpy(result, "error: command too long");
+            return;
+        }
+
+        Settings updated = settings;
+        Calibration updatedCalibration = calibration;
+        size_t pos = 0;
+        while (pos < length) {
+            while (pos < length && separator(text[pos])) pos++;
+            if (pos >= length) break;
+
+            size_t nameStart = pos;
+            while (pos < length && !separator(text[pos]) && text[pos] != '=' && text[pos] != ':') pos++;
+            const char* name = text + nameStart;
+            size_t nameLength = pos - nameStart;
+
+            while (pos < length && (text[pos] == ' ' || text[pos] == '"')) pos++;
+            if (pos >= length || (text[pos] != '=' && text[pos] != ':')) {
+                if (equals(name, nameLength, "defaults")) {
+                    updated = Settings();
+                } else if (!equals(name, nameLength, "status")) {
+                    reject("unknown command", name, nameLength);
+                    return;
+                }
+                continue;
+            }
+            pos++;
+
+            while (pos < length && (text[pos] == ' ' || text[pos] == '"')) pos++;
+            size_t valueStart = pos;
+            while (pos < length && !separator(text[pos])) pos++;
+            const char* value = text + valueStart;
+            size_t valueLength = pos - valueStart;
+
+            if (nameLength > 4 && memcmp(name, "cal_", 4) == 0) {
+                int channel = findChannel(name + 4, nameLength - 4);
+                if (channel < 0) {
+                    reject("unknown channel", name, nameLength);
+                    return;
+                }
+                if (!parseCurve(value, valueLength, updatedCalibration.curves[channel])) {
+                    reject("bad calibration for", name, nameLength);
+                    return;
+                }
+                continue;
+            }
+
+            const SettingField* field = findSetting(name, nameLength);
+            if (field == nullptr) {
+                reject("unknown setting", name, nameLength);
+                return;
+            }
+            uint32_t number;
+            bool parsed = field->member == &Settings::logLevel ? parseLogLevel(value, valueLength, number)
+                                                               : parseNumber(value, valueLength, number);
+            if (!parsed || number < field->min || number > field->max) {
+                reject("bad value for", name, nameLength);
+                size_t used = strlen(result);
+                snprintf(result + used, sizeof(result) - used, " (%lu to %lu)", (unsigned long)field->min,
+                         (unsigned long)field->max);
+                return;
+            }
+            updated.*field->member = number;
+        }
+
+        if (updated.publishIntervalMs < updated.sampleIntervalMs) {
+            strcpy(result, "error: publish_interval below sample_interval");
+            return;
+        }
+        // Several commands may come in before takePending(); keep what each altered
+        changed = changed || updated != settings;
+        settings = updated;
+        calibrationChanged = calibrationChanged || updatedCalibration != calibration;
+        calibration = updatedCalibration;
+        strcpy(result, "ok");
+    }
+
+    // True once after the commands handled since the last call; the flags
+    // tell whether any of them altered the settings or the calibration
+    bool takePending(bool& settingsChanged, bool& calibrationUpdated) {
+        if (!pending) return false;
+        pending = false;
+        settingsChanged = changed;
+        calibrationUpdated = calibrationChanged;
+        changed = false;
+        calibrationChanged = false;
+        return true;
+    }
+
+    // "ok" or "error: ..." for the last command
+    const char* lastResult() const { return result; }
+};
+
+#endif // COMMAND_HANDLER_H
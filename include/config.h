@@ -7,24 +7,136 @@
 #define TURBIDITY_PIN 35
 #define TEMP_PIN 32         
 
+// Sensor channels, declared in channels.h. The first four are the standard
+// probes above; extra probes (e.g. a depth profile behind an external ADC or
+// multiplexer) are appended to that table and counted here.
+#define SENSOR_CHANNELS 4
+
 // ADC settings
 #define VOLTAGE_REF 3.3f    
 #define ADC_RESOLUTION 4095.0f
 
-// Timing constants
+// Background oversampling: every channel is captured at ADC_OVERSAMPLE_RATE_HZ
+// and averaged per SAMPLE_INTERVAL (set ADC_OVERSAMPLING to 0 for one analogRead per sample)
+#define ADC_OVERSAMPLING 1
+#define ADC_OVERSAMPLE_RATE_HZ 1000
+#define ADC_OVERSAMPLE_RING_BLOCKS 256   // Blocks of summed frames, sized to hold two sample intervals
+
+// External 16-bit ADC (TI ADS1115 on I2C) for the pH probe, whose ~59 mV/pH
+// signal gets ~0.8 mV steps from the on-chip ADC and 0.125 mV from this one.
+// It scans its inputs continuously, paced by its ALERT/RDY line (ads1115.h).
+#define EXTERNAL_ADC 0
+#define PH_ADS_INPUT 0                 // ADS1115 input (AIN0-3) of the pH probe
+#define ADS1115_ADDRESS 0x48           // ADDR pin to GND
+#define ADS1115_ALERT_PIN 27           // GPIO wired to ALERT/RDY
+#define ADS1115_PGA 1                  // +/-4.096 V full scale
+#define ADS1115_DATA_RATE 7            // 860 samples/s
+#define ADS1115_PIPELINED 1            // Start the next conversion before reading the last
+#define ADS1115_RING_BLOCKS 256        // Blocks of summed scans, as ADC_OVERSAMPLE_RING_BLOCKS
+#define ADS1115_TASK_PRIORITY 6        // Above the sampling task
+#define ADS1115_TASK_STACK 2048
+#define I2C_SDA_PIN 21
+#define I2C_SCL_PIN 22
+#define I2C_CLOCK_HZ 400000
+
+// Convert raw codes through compile-time lookup tables (conversion_tables.h) instead of float math
+#define SENSOR_CONVERSION_LUT 1
+
+// Multi-point calibration set over MQTT (cal_<channel> commands, calibration.h),
+// kept in NVS; calibrated channels convert through a RAM table per channel
+#define CALIBRATION_POINTS_MAX 8
+
+// Timing constants (defaults; settings.h makes them adjustable at run time)
 #define SAMPLE_INTERVAL 1000   // Sample interval in ms
 #define MQTT_PUBLISH_INTERVAL 5000  // Publish to MQTT every 5 seconds
+#define SAMPLE_WINDOW 5        // Samples averaged per published reading
+#define SAMPLE_WINDOW_MAX 60   // Largest averaging window the statistics can be set to
+#define PH_WINDOW 5            // pH moving average window
+#define PH_WINDOW_MAX 10
 #define SERIAL_BAUD_RATE 9600
 
+// Console verbosity
+#define LOG_QUIET 0                // Network events and errors only
+#define LOG_AVERAGES 1             // Plus every averaged reading
+#define LOG_SAMPLES 2              // Plus every individual sample
+#define LOG_LEVEL LOG_SAMPLES
+#define LOG_MAX_LEVEL LOG_SAMPLES  // Output above this level is compiled out
+#define LOG_COMPACT 0              // 1: one short line per sample and per average
+
+// Buffered console (log_buffer.h): output is formatted into a RAM ring and
+// handed to the UART only as fast as its TX buffer drains (from loop(), or the
+// network task with SAMPLING_TASKS), so printing never stalls sampling. Lines
+// that do not fit the ring are dropped and counted. 0 writes to Serial directly.
+#define LOG_BUFFERED 1
+#define LOG_BUFFER_SIZE 4096       // Bytes per ring (one per core with SAMPLING_TASKS), power of two
+#define LOG_LINE_MAX 256
+#define LOG_UART_TX_BUFFER 1024    // UART driver TX buffer, emptied by its interrupt
+
+// Duty-cycled low-power mode for battery nodes: wake on the RTC timer once per
+// window, take a sampling burst, and bring WiFi/MQTT up only every
+// LOW_POWER_FLUSH_WINDOWS windows (see power_manager.h; battery life for a
+// configuration can be predicted with the energy model tool)
+#define LOW_POWER_MODE 0
+#define LOW_POWER_DEEP_SLEEP 1         // 0 = light sleep (RAM kept, faster wake, higher sleep current)
+#define LOW_POWER_WINDOW_SECONDS 60    // One averaged reading per window
+#define LOW_POWER_BURST_SAMPLES 5      // Oversampled samples averaged per window
+#define LOW_POWER_BURST_SPACING 100    // ms between burst samples
+#define LOW_POWER_FLUSH_WINDOWS 10     // Windows between WiFi/MQTT flushes
+#define LOW_POWER_CONNECT_TIMEOUT 15000  // ms a flush waits for the MQTT connection
+#define LOW_POWER_MIN_SLEEP 100        // ms slept even when a window overran
+#define SENSOR_POWER_PIN -1            // GPIO switching the sensor supply in low-power mode, -1 if not
+                                       // wired (needs a pull-down so the supply stays off in deep sleep)
+#define SENSOR_WARMUP_MS 2000          // Settling time after powering the sensors
+
+// Sampling and networking run as separate FreeRTOS tasks on the ESP32 (the
+// native build has no scheduler and the low-power mode sleeps instead, so
+// both run from loop())
+#if !defined(NATIVE_BUILD) && !LOW_POWER_MODE
+#define SAMPLING_TASKS 1
+#else
+#define SAMPLING_TASKS 0
+#endif
+#define SAMPLING_TASK_CORE 1
+#define SAMPLING_TASK_PRIORITY 5
+#define SAMPLING_TASK_STACK 4096
+#define NETWORK_TASK_CORE 0
+#define NETWORK_TASK_PRIORITY 1
+#define NETWORK_TASK_STACK 8192     // TLS handshakes need the room
+#define NETWORK_TASK_PERIOD 10      // ms between network service passes
+#define READING_QUEUE_LENGTH 16     // Averaged readings buffered between the tasks (power of two)
+
+// Store-and-forward: readings that cannot be published are appended to a flash
+// log ("readings" partition in partitions.csv) and drained after reconnecting
+#define STORE_AND_FORWARD 1
+#define STORE_PARTITION_LABEL "readings"
+#define STORE_NATIVE_FLASH_SIZE (64 * 1024)  // Emulated log size in the native build
+#define STORE_DRAIN_BATCH 10        // Stored readings published per drain pass
+#define STORE_DRAIN_INTERVAL 1000   // ms between drain passes
+
+// Outlier rejection (Hampel filter) between sampling and averaging
+#define OUTLIER_FILTER 1
+#define OUTLIER_WINDOW 7            // Samples of history the median is taken over
+#define OUTLIER_THRESHOLD 3.0f      // Rejection limit in robust standard deviations
+#define OUTLIER_MIN_DEV_PH 0.15f    // Deviations below these are never rejected
+#define OUTLIER_MIN_DEV_TDS 8.0f
+#define OUTLIER_MIN_DEV_TURBIDITY 0.25f
+#define OUTLIER_MIN_DEV_TEMPERATURE 1.5f
+
 // pH sensor calibration constants
 #define PH_CALIBRATION_SLOPE -0.22f   // 3.3 * (3850/4095) / (14-0)   3850 is the maximum adc value practically reaching
 #define PH_7_VOLTAGE 1.58f
-static const int MAX_PH_WINDOW_SIZE = 10; // Maximum possible window size
 
 // TDS sensor calibration constants
 #define TDS_TEMPERATURE_COEFFICIENT 0.02f
 #define TDS_CALIBRATION_FACTOR 0.5f  
 #define TDS_DEFAULT_TEMPERATURE 25.0f
+// Conductivity rises ~2 %/°C, so the TDS voltage is referred to 25 °C using
+// the water temperature. The temperature probe is noisy, so the estimate is
+// an EWMA of its samples, limited to the probe's range.
+#define TDS_TEMPERATURE_COMPENSATION 1
+#define TEMPERATURE_SMOOTHING 0.02f          // EWMA weight of each sample (~50 samples time constant)
+#define TEMPERATURE_COMPENSATION_MIN 0.0f    // Celsius
+#define TEMPERATURE_COMPENSATION_MAX 50.0f
 
 // Turbidity sensor calibration constsnts (Didn't able to deduce anything, whatever the Turbidity, output voltage < 0.2V)
 #define TURBIDITY_CLEAR_VOLTAGE 0.0f 
@@ -41,6 +153,10 @@ static const int MAX_PH_WINDOW_SIZE = 10; // Maximum possible window size
 // WiFi Configuration
 #define WIFI_SSID "Chiki Chiki Bamba"
 #define WIFI_PASSWORD "DiscreteFourierTransform"
+#define WIFI_FAST_CONNECT 1              // Rejoin the cached channel/BSSID without scanning
+#define WIFI_FAST_CONNECT_TIMEOUT 3000   // ms before a cached-channel attempt falls back to a scan
+#define WIFI_CONNECT_TIMEOUT 20000       // ms a connection attempt may take in total
+#define WIFI_RETRY_INTERVAL 30000        // ms between attempts after one has failed
 
 // MQTT Configuration
 #define MQTT_BROKER "5df16d8a5a1c438294a51cb556f6df87.s1.eu.hivemq.cloud"  
@@ -49,5 +165,100 @@ static const int MAX_PH_WINDOW_SIZE = 10; // Maximum possible window size
 #define MQTT_PASSWORD "Swqms123"  
 #define MQTT_DATA_TOPIC "reservoir/water_quality/data"  // Topic for publishing sensor data
 #define MQTT_COMMAND_TOPIC "reservoir/water_quality/commands"  // Topic for receiving commands
+#define MQTT_STATUS_TOPIC "reservoir/water_quality/status"  // Current settings, after every command
+#define MQTT_STATUS_BUFFER_SIZE 1024  // Settings plus every calibration curve
+#define MQTT_METRICS_TOPIC "reservoir/water_quality/metrics"  // Timing histograms and heap (metrics.h)
+
+// Settings changed over MQTT_COMMAND_TOPIC are kept in NVS under this namespace
+#define SETTINGS_NAMESPACE "swqms"
+
+// TLS session resumption: the session ticket of the last broker connection is
+// kept across reconnects, so a reconnect skips the certificate exchange and key
+// agreement of a full handshake. Off (plain WiFiClientSecure) until verified
+// against the broker on an ESP32.
+#define TLS_SESSION_RESUMPTION 0
+// The cached session holds the session's master secret. With 1 it is kept in
+// RTC no-init memory so it also survives resets and deep sleep, where it stays
+// readable until overwritten; with 0 it is in ordinary RAM and lost at reset.
+#define TLS_SESSION_PERSIST 0
+#define TLS_SESSION_CACHE_SIZE 2048   // Bytes for the serialised session (ticket included)
+#define TLS_HANDSHAKE_TIMEOUT 10000   // ms
+
+// Readings taken before the first NTP sync are held in RAM and published with
+// corrected timestamps once the clock is set
+#define NTP_BACKFILL_CAPACITY 32
+
+// Hot-path metrics (metrics.h): loop, sample lateness, network, MQTT and
+// publish timings plus heap low-water marks, published on MQTT_METRICS_TOPIC
+// every METRICS_INTERVAL ms (at every flush in low-power mode) and printed on
+// the console when 'm' is typed on serial. 0 compiles the timers out.
+#define METRICS_ENABLED 1
+#define METRICS_INTERVAL 60000
+#define METRICS_BUFFER_SIZE 1536      // Bytes for the metrics JSON, must fit MQTT_BUFFER_SIZE
+
+// Adaptive reporting (adaptive_reporter.h): an averaged reading is only
+// published when a channel moved past its deadband since the last published
+// one, a CUSUM detects a slower drift, ADAPTIVE_HEARTBEAT seconds passed, or
+// the reading is outside the safe limits (then every reading is sent until
+// ADAPTIVE_ALARM_HOLD after it is back inside). 0 (the default) publishes
+// every reading, the fixed-rate stream analyze.py and the Node-RED flow expect;
+// the "adaptive" command switches it at run time.
+#define ADAPTIVE_REPORTING 0
+#define ADAPTIVE_DEADBAND_PH 0.1f
+#define ADAPTIVE_DEADBAND_TDS 5.0f           // ppm
+#define ADAPTIVE_DEADBAND_TURBIDITY 0.1f     // NTU
+#define ADAPTIVE_DEADBAND_TEMPERATURE 0.5f   // Celsius
+#define ADAPTIVE_CUSUM_SLACK 0.25f           // Drift allowance per reading, in deadbands
+#define ADAPTIVE_CUSUM_LIMIT 2.0f            // CUSUM alarm level, in deadbands
+#define ADAPTIVE_HEARTBEAT 300               // s without a publish before one is forced
+#define ADAPTIVE_ALARM_HOLD 3                // Readings sent at full rate after an alarm clears
+#define ALARM_PH_MIN 6.5f                    // Safe limits, as analytics/analyze.py
+#define ALARM_PH_MAX 8.5f
+#define ALARM_TURBIDITY_MAX 2.0f             // NTU
+
+// Session summaries (session_aggregator.h): the averaged readings of each
+// analytics session (Morning 06:00-07:59, Afternoon 12:00-13:59, Evening
+// 18:00-19:59 local time, as analytics/analyze.py) are aggregated on the device
+// and published on MQTT_SESSION_TOPIC when the session closes, followed by a
+// day summary after the last session of the day. SESSION_REPORTING is the
+// default of the "sessions" setting: 0 off, 1 summaries and every reading,
+// 2 summaries and only the readings taken in a session (or outside the safe
+// limits). 0 for SESSION_SUMMARIES compiles it out.
+#define SESSION_SUMMARIES 1
+#define SESSION_REPORTING 1
+#define SESSION_UTC_OFFSET 19800      // s, local time of the sessions (as configTime() in setup())
+#define SESSION_CLOSE_DELAY 5         // s after the end of a session before it is closed
+#define SESSION_SUMMARY_QUEUE 8       // Closed summaries held while MQTT is down
+#define MQTT_SESSION_TOPIC "reservoir/water_quality/sessions"
+#define MQTT_SESSION_BUFFER_SIZE 1024  // Bytes for the summary JSON, must fit MQTT_BUFFER_SIZE
+
+// QoS 1 delivery (reliable_publisher.h): readings, batches and session
+// summaries are published at QoS 1 and kept until the broker's PUBACK. Up to
+// MQTT_INFLIGHT_WINDOW messages are in flight at once; one not acknowledged
+// within MQTT_ACK_TIMEOUT is sent again (the timeout doubling each time) up
+// to MQTT_MAX_RETRIES times. While the window is full, and once a message is
+// given up on or still unacknowledged at a low-power disconnect, its readings
+// go to the store-and-forward log (summaries back to their queue). 0
+// publishes everything at QoS 0.
+#define MQTT_QOS1 1
+#define MQTT_INFLIGHT_WINDOW 8
+// Bytes per in-flight message (whole packet). Must hold the largest reading,
+// batch and summary (checked at compile time); a JSON batch needs about
+// MQTT_BUFFER_SIZE. The window costs MQTT_INFLIGHT_WINDOW times this.
+#define MQTT_INFLIGHT_PACKET_MAX (MQTT_BATCH_FORMAT == PAYLOAD_JSON ? MQTT_BUFFER_SIZE : MQTT_SESSION_BUFFER_SIZE + 64)
+#define MQTT_ACK_TIMEOUT 3000          // ms
+#define MQTT_MAX_RETRIES 4
+
+// Batched publishing: MQTT_BATCH_SIZE averaged readings are sent as one message
+// on MQTT_BATCH_TOPIC (1 keeps one JSON message per reading on MQTT_DATA_TOPIC;
+// 12 sends one message per minute). The batch size can be changed at run time
+// up to MQTT_BATCH_MAX (1 compiles batching out).
+#define PAYLOAD_JSON 0
+#define PAYLOAD_BINARY 1              // Packed delta encoding (payload_codec.h)
+#define MQTT_BATCH_SIZE 1
+#define MQTT_BATCH_MAX 16             // A JSON batch of 16 still fits MQTT_BUFFER_SIZE
+#define MQTT_BATCH_FORMAT PAYLOAD_BINARY
+#define MQTT_BATCH_TOPIC "reservoir/water_quality/batch"
+#define MQTT_BUFFER_SIZE 2048         // PubSubClient packet buffer, must hold a whole batch
 
 #endif // CONFIG_H
\ No newline at end of file
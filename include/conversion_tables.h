@@ -0,0 +1,89 @@
+#ifndef CONVERSION_TABLES_H
+#define CONVERSION_TABLES_H
+
+#include <array>
+#include "config.h"
+
+// Sensor conversion kernels.
+// Every conversion is a pure function of the 12-bit ADC code, so besides the
+// float path the same constexpr functions generate one 4096-entry table per
+// channel at compile time (placed in flash). With SENSOR_CONVERSION_LUT the
+// per-sample cost is a single load; the tables are bit-exact with the float
+// path as long as the float path is not contracted into FMAs (-ffp-contract=off).
+namespace conversion {
+
+static const int ADC_CODES = 4096;
+
+// Convert raw ADC value to voltage
+constexpr float rawToVoltage(int rawValue) {
+    return rawValue * (VOLTAGE_REF / ADC_RESOLUTION);
+}
+
+// Convert pH voltage to pH value
+constexpr float voltageToPH(float voltage) {
+    return 7.0f - ((voltage - PH_7_VOLTAGE) / PH_CALIBRATION_SLOPE);
+}
+
+// Convert TDS voltage to TDS value (ppm)
+// https://randomnerdtutorials.com/arduino-tds-water-quality-sensor/
+constexpr float voltageToTDS(float voltage) {
+    return (133.42f * voltage * voltage * voltage -
+            255.86f * voltage * voltage +
+            857.39f * voltage) * TDS_CALIBRATION_FACTOR;
+}
+
+// Helper function to map float values
+constexpr float mapRange(float x, float in_min, float in_max, float out_min, float out_max) {
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+// Convert turbidity voltage to NTU (linear interpolation between clear and muddy water)
+constexpr float voltageToTurbidity(float voltage) {
+    if (voltage > VOLTAGE_REF) voltage = VOLTAGE_REF; // Safety check
+    return mapRange(voltage, TURBIDITY_CLEAR_VOLTAGE, TURBIDITY_MUDDY_VOLTAGE,
+                    TURBIDITY_CLEAR_NTU, TURBIDITY_MUDDY_NTU);
+}
+
+// Assumed linear Conversion
+constexpr float voltageToTemperature(float voltage) {
+    return (voltage - TEMP_30_VOLTAGE) / (TEMP_45_VOLTAGE - TEMP_30_VOLTAGE) *15 + 30;
+}
+
+typedef std::array<float, ADC_CODES> Table;
+
+template <float (*Convert)(float)>
+constexpr Table makeTable() {
+    Table table{};
+    for (int raw = 0; raw < ADC_CODES; raw++) {
+        table[raw] = Convert(rawToVoltage(raw));
+    }
+    return table;
+}
+
+inline constexpr Table PH_TABLE = makeTable<voltageToPH>();
+inline constexpr Table TDS_TABLE = makeTable<voltageToTDS>();
+inline constexpr Table TURBIDITY_TABLE = makeTable<voltageToTurbidity>();
+inline constexpr Table TEMPERATURE_TABLE = makeTable<voltageToTemperature>();
+
+// Clamp a code into table range (oversampled or external sources may overshoot)
+constexpr int tableIndex(int raw) {
+    return raw < 0 ? 0 : (raw >= ADC_CODES ? ADC_CODES - 1 : raw);
+}
+
+// Compares every table entry against the float path evaluated at run time.
+// Returns the number of mismatching entries (0 means bit-exact).
+inline int verifyTables() {
+    int mismatches = 0;
+    for (volatile int raw = 0; raw < ADC_CODES; raw++) {
+        float voltage = rawToVoltage(raw);
+        if (PH_TABLE[raw] != voltageToPH(voltage)) mismatches++;
+        if (TDS_TABLE[raw] != voltageToTDS(voltage)) mismatches++;
+        if (TURBIDITY_TABLE[raw] != voltageToTurbidity(voltage)) mismatches++;
+        if (TEMPERATURE_TABLE[raw] != voltageToTemperature(voltage)) mismatches++;
+    }
+    return mismatches;
+}
+
+}  // namespace conversion
+
+#endif // CONVERSION_TABLES_H
@@ -0,0 +1,196 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <Arduino.h>
+#ifndef NATIVE_BUILD
+#include <Wire.h>
+#endif
+#include "config.h"
+#include "log_buffer.h"
+
+// Hardware abstraction for the acquisition pipeline.
+// Sensors, the MQTT client and the main loop reach the ADC, the clock and the
+// console only through here, so the same code runs on the ESP32 and in the
+// native build (see native/) against a replayed ADC trace.
+namespace hal {
+
+// Source of raw 12-bit ADC codes, addressed by GPIO pin
+class AdcSource {
+public:
+    virtual ~AdcSource() {}
+    virtual int read(uint8_t pin) = 0;
+
+    // Called once before each sweep over the channels
+    virtual void beginSweep() {}
+
+    // Input voltage of one code step (the on-chip 12-bit ADC by default)
+    virtual float voltsPerCode() { return VOLTAGE_REF / ADC_RESOLUTION; }
+};
+
+// Two-wire bus to external converters, addressed by 7-bit device address
+class I2cBus {
+public:
+    virtual ~I2cBus() {}
+    virtual bool write(uint8_t address, const uint8_t* data, size_t length) = 0;
+    virtual bool read(uint8_t address, uint8_t* data, size_t length) = 0;
+};
+
+// Millisecond/microsecond time base
+class Clock {
+public:
+    virtual ~Clock() {}
+    virtual unsigned long millis() = 0;
+    virtual unsigned long micros() = 0;
+    virtual void delay(unsigned long ms) = 0;
+};
+
+// Board clock (simulated board time in the native build)
+class ArduinoClock : public Clock {
+public:
+    unsigned long millis() override { return ::millis(); }
+    unsigned long micros() override { return ::micros(); }
+    void delay(unsigned long ms) override { ::delay(ms); }
+};
+
+#ifndef NATIVE_BUILD
+// On-chip ADC
+class ArduinoAdc : public AdcSource {
+public:
+    int read(uint8_t pin) override { return ::analogRead(pin); }
+};
+
+// Wire (I2C controller 0)
+class ArduinoI2c : public I2cBus {
+public:
+    bool begin(int sda, int scl, uint32_t frequency) { return Wire.begin(sda, scl, frequency); }
+
+    bool write(uint8_t address, const uint8_t* data, size_t length) override {
+        Wire.beginTransmission(address);
+        Wire.write(data, length);
+        return Wire.endTransmission() == 0;
+    }
+
+    bool read(uint8_t address, uint8_t* data, size_t length) override {
+        if (Wire.requestFrom(address, (uint8_t)length) != length) return false;
+        for (size_t i = 0; i < length; i++) data[i] = (uint8_t)Wire.read();
+        return true;
+    }
+};
+
+inline ArduinoAdc defaultAdc;
+inline AdcSource* adcSource = &defaultAdc;
+inline ArduinoI2c defaultI2c;
+inline I2cBus* i2cBus = &defaultI2c;
+#else
+// Installed by the host harness (see native/native_hal.h)
+inline AdcSource* adcSource = nullptr;
+inline I2cBus* i2cBus = nullptr;
+#endif
+
+inline ArduinoClock defaultClock;
+inline Clock* clockSource = &defaultClock;
+
+inline void setAdcSource(AdcSource* source) { adcSource = source; }
+inline void setClock(Clock* clock) { clockSource = clock; }
+inline void setI2cBus(I2cBus* bus) { i2cBus = bus; }
+
+inline void beginSweep() { adcSource->beginSweep(); }
+inline int analogRead(uint8_t pin) { return adcSource->read(pin); }
+inline unsigned long millis() { return clockSource->millis(); }
+inline unsigned long micros() { return clockSource->micros(); }
+inline void delay(unsigned long ms) { clockSource->delay(ms); }
+
+// Wall-clock time, Unix seconds UTC (NTP-backed RTC on the board). Until the
+// first NTP sync it counts seconds since power-on instead (see time_sync.h).
+#ifndef NATIVE_BUILD
+inline time_t now() { return time(nullptr); }
+#else
+inline time_t now() { return native::wallTime(); }
+#endif
+
+// Storage kept across resets and deep sleep but not power loss (RTC memory on
+// the board). It is not initialised at boot, so check its contents before use.
+#ifndef NATIVE_BUILD
+#define HAL_NOINIT RTC_NOINIT_ATTR
+#else
+#define HAL_NOINIT
+#endif
+
+// Cycle counter for timing short sections (CCOUNT on the ESP32: one cycle of
+// the core it is read on, wrapping every ~18 s at 240 MHz)
+inline uint32_t cycles() { return ESP.getCycleCount(); }
+inline uint32_t cyclesPerMicrosecond() { return ESP.getCpuFreqMHz(); }
+
+// Heap: free bytes now, lowest since boot, and the largest block that can be allocated
+inline uint32_t freeHeap() { return ESP.getFreeHeap(); }
+inline uint32_t minFreeHeap() { return ESP.getMinFreeHeap(); }
+inline uint32_t largestFreeBlock() { return ESP.getMaxAllocHeap(); }
+
+#if LOG_BUFFERED
+// Console output goes to a RAM ring per writer (log_buffer.h) and reaches the
+// UART through drainConsole(). With SAMPLING_TASKS the writers are the tasks
+// pinned to each core, so the ring is picked by core.
+#if SAMPLING_TASKS
+static const size_t CONSOLE_RINGS = 2;
+inline size_t consoleWriter() { return xPortGetCoreID(); }
+#else
+static const size_t CONSOLE_RINGS = 1;
+inline size_t consoleWriter() { return 0; }
+#endif
+
+inline LogRing<LOG_BUFFER_SIZE, LOG_LINE_MAX> consoleRings[CONSOLE_RINGS];
+inline size_t drainingRing = 0;
+
+inline Print& console() { return consoleRings[consoleWriter()]; }
+
+// Moves buffered lines to the UART, only as many bytes as its TX buffer has
+// room for, so it never blocks. Call from one place only (loop() or the
+// network task). A line is finished before another ring's lines go out.
+inline void drainConsole() {
+    for (size_t i = 0; i < CONSOLE_RINGS; i++) {
+        int room = Serial.availableForWrite();
+        if (room <= 0) {
+            return;
+        }
+        consoleRings[drainingRing].drain(Serial, (size_t)room);
+        if (consoleRings[drainingRing].midLine()) {
+            return;   // The UART filled up inside a line; it continues next time
+        }
+        drainingRing = (drainingRing + 1) % CONSOLE_RINGS;
+    }
+}
+
+// Writes out everything buffered, waiting for the UART (e.g. before deep sleep)
+inline void flushConsole() {
+    for (size_t i = 0; i < CONSOLE_RINGS; i++) {
+        consoleRings[i].drain(Serial, (size_t)-1);
+    }
+    Serial.flush();
+}
+
+// Bytes written to the console so far (as the UART will carry them)
+inline uint64_t consoleBytes() {
+    uint64_t total = 0;
+    for (size_t i = 0; i < CONSOLE_RINGS; i++) total += consoleRings[i].bytesWritten();
+    return total;
+}
+#else
+inline Print& console() { return Serial; }
+inline void drainConsole() {}
+inline void flushConsole() { Serial.flush(); }
+#endif
+
+inline void consoleBegin(unsigned long baud) {
+#if LOG_BUFFERED && !defined(NATIVE_BUILD)
+    // The UART interrupt empties this while the firmware carries on
+    Serial.setTxBufferSize(LOG_UART_TX_BUFFER);
+#endif
+    Serial.begin(baud);
+}
+
+// Next byte received on the console, -1 if none
+inline int consoleRead() { return Serial.available() > 0 ? Serial.read() : -1; }
+
+}  // namespace hal
+
+#endif // HAL_H
@@ -0,0 +1,223 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Allocation-free JSON writer for the publish path.
+// Writes straight into a caller-owned buffer, always NUL-terminated; once
+// something does not fit, ok() turns false and length() reports 0.
+//
+// number() prints exactly what printf("%.Nf") prints for a float (correctly
+// rounded, ties to even, "-0.00" for small negatives) but without printf: on
+// the ESP32, newlib's float formatting goes through dtoa, which allocates. The
+// float is split into mantissa and exponent and scaled with integer arithmetic,
+// so there is no intermediate rounding. timestamp() prints the same local-time
+// string the firmware has always published, without gmtime().
+class JsonWriter {
+private:
+    char* out;
+    size_t capacity;
+    size_t used = 0;
+    bool overflow = false;
+    bool needComma = false;
+
+    static const int MAX_DECIMALS = 4;
+
+    void put(char c) {
+        if (used + 1 < capacity) {
+            out[used++] = c;
+            out[used] = '\0';
+        } else {
+            overflow = true;
+        }
+    }
+
+    void put(const char* s) {
+        while (*s) put(*s++);
+    }
+
+    // Unsigned decimal, zero-padded to at least minDigits
+    void putUnsigned(uint64_t v, int minDigits = 1) {
+        char digits[20];
+        int n = 0;
+        do {
+            digits[n++] = (char)('0' + v % 10);
+            v /= 10;
+        } while (v);
+        while (n < minDigits) digits[n++] = '0';
+        while (n) put(digits[--n]);
+    }
+
+    // Integer part of a float >= 2^64 (exact: mantissa * 2^exponent in base 1e9)
+    void putLargeInteger(uint32_t mantissa, int exponent) {
+        uint32_t limbs[5] = {mantissa % 1000000000u, mantissa / 1000000000u, 0, 0, 0};
+        for (int i = 0; i < exponent; i++) {
+            uint32_t carry = 0;
+            for (int l = 0; l < 5; l++) {
+                uint32_t v = limbs[l] * 2 + carry;
+                carry = v >= 1000000000u;
+                limbs[l] = carry ? v - 1000000000u : v;
+            }
+        }
+        int top = 4;
+        while (top > 0 && limbs[top] == 0) top--;
+        putUnsigned(limbs[top]);
+        while (top--) putUnsigned(limbs[top], 9);
+    }
+
+    void separator() {
+        if (needComma) put(',');
+        needComma = true;
+    }
+
+    // YYYY-MM-DD of days since 1970-01-01 (proleptic Gregorian)
+    void putDate(int64_t days) {
+        days += 719468;
+        int64_t era = days / 146097;
+        uint32_t dayOfEra = (uint32_t)(days - era * 146097);
+        uint32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        uint32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        uint32_t mp = (5 * dayOfYear + 2) / 153;
+        uint32_t day = dayOfYear - (153 * mp + 2) / 5 + 1;
+        uint32_t month = mp < 10 ? mp + 3 : mp - 9;
+        uint64_t year = (uint64_t)(yearOfEra + era * 400) + (month <= 2);
+
+        putUnsigned(year, 4);
+        put('-');
+        putUnsigned(month, 2);
+        put('-');
+        putUnsigned(day, 2);
+    }
+
+public:
+    JsonWriter(char* buffer, size_t size) : out(buffer), capacity(size) {
+        if (capacity) out[0] = '\0';
+    }
+
+    void beginObject() { separator(); put('{'); needComma = false; }
+    void endObject() { put('}'); needComma = true; }
+    void beginArray() { separator(); put('['); needComma = false; }
+    void endArray() { put(']'); needComma = true; }
+
+    // Object key; the value written next belongs to it
+    void key(const char* name) {
+        separator();
+        put('"');
+        put(name);
+        put("\":");
+        needComma = false;
+    }
+
+    // Plain string value (callers only pass identifiers and timestamps, so no escaping)
+    void string(const char* value) {
+        separator();
+        put('"');
+        put(value);
+        put('"');
+    }
+
+    // Same text as printf("%.<decimals>f", value)
+    void number(float value, int decimals) {
+        separator();
+        if (decimals < 0) decimals = 0;
+        if (decimals > MAX_DECIMALS) decimals = MAX_DECIMALS;
+
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        bool negative = bits >> 31;
+        int biased = (bits >> 23) & 0xFF;
+        uint32_t mantissa = bits & 0x7FFFFF;
+
+        if (biased == 0xFF) {
+            if (negative) put('-');
+            put(mantissa ? "nan" : "inf");
+            return;
+        }
+        if (negative) put('-');
+
+        // value = mantissa * 2^exponent
+        int exponent;
+        if (biased == 0) {
+            exponent = -149;
+        } else {
+            mantissa |= 0x800000;
+            exponent = biased - 150;
+        }
+
+        uint64_t pow10 = 1;
+        for (int i = 0; i < decimals; i++) pow10 *= 10;
+
+        if (exponent >= 0) {
+            // An integer: no rounding needed
+            if (exponent <= 40) {
+                putUnsigned((uint64_t)mantissa << exponent);
+            } else {
+                putLargeInteger(mantissa, exponent);
+            }
+            if (decimals > 0) {
+                put('.');
+                for (int i = 0; i < decimals; i++) put('0');
+            }
+            return;
+        }
+
+        // mantissa * 10^decimals / 2^shift, rounded half to even. The product is
+        // below 2^38, so for shift >= 40 the result is 0.
+        int shift = -exponent;
+        uint64_t scaled = (uint64_t)mantissa * pow10;
+        uint64_t q = 0;
+        if (shift < 40) {
+            q = scaled >> shift;
+            uint64_t remainder = scaled & ((1ULL << shift) - 1);
+            uint64_t half = 1ULL << (shift - 1);
+            if (remainder > half || (remainder == half && (q & 1))) {
+                q++;
+            }
+        }
+
+        putUnsigned(q / pow10);
+        if (decimals > 0) {
+            put('.');
+            putUnsigned(q % pow10, decimals);
+        }
+    }
+
+    void number(unsigned long value) {
+        separator();
+        putUnsigned(value);
+    }
+
+    // Published time string: the timestamp shifted to local time (UTC+05:30)
+    // in the fixed format YYYY-MM-DDTHH:MM:SS.000+00:00
+    void timestamp(uint32_t unixTime) {
+        separator();
+        int64_t local = (int64_t)unixTime + 19800; // Add 5 hours 30 minutes (5*3600 + 30*60 = 19800)
+        uint32_t secondOfDay = (uint32_t)(local % 86400);
+
+        put('"');
+        putDate(local / 86400);
+        put('T');
+        putUnsigned(secondOfDay / 3600, 2);
+        put(':');
+        putUnsigned(secondOfDay / 60 % 60, 2);
+        put(':');
+        putUnsigned(secondOfDay % 60, 2);
+        put(".000+00:00\"");
+    }
+
+    // Date string "YYYY-MM-DD" of days since 1970-01-01
+    void date(int64_t days) {
+        separator();
+        put('"');
+        putDate(days);
+        put('"');
+    }
+
+    bool ok() const { return !overflow; }
+    size_t length() const { return overflow ? 0 : used; }
+    const char* c_str() const { return out; }
+};
+
+#endif // JSON_WRITER_H
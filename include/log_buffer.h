@@ -0,0 +1,101 @@
+#ifndef LOG_BUFFER_H
+#define LOG_BUFFER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Console output that never waits for the UART. Writes are staged per line and
+// each complete line is copied into a byte ring (or dropped, and counted, when
+// the ring is full); drain() later moves bytes from the ring to the real
+// console. One writer and one drainer, like SpscQueue: the writer owns the
+// staging line and head, the drainer owns tail. Lines longer than LineMax are
+// committed in LineMax pieces.
+template <size_t Capacity, size_t LineMax = 256>
+class LogRing : public Print {
+    static_assert(Capacity >= 2 * LineMax && (Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of two of at least two lines");
+
+private:
+    char data[Capacity];
+    std::atomic<uint32_t> head{0};   // written by the writer
+    std::atomic<uint32_t> tail{0};   // written by the drainer
+    std::atomic<uint32_t> dropped{0};
+    uint32_t droppedReported = 0;    // drainer side
+    bool lineOpen = false;           // drainer stopped inside a line
+
+    char line[LineMax];
+    size_t lineLength = 0;
+    uint64_t written = 0;
+
+    void commit() {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (Capacity - (h - tail.load(std::memory_order_acquire)) < lineLength) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            for (size_t i = 0; i < lineLength; i++) {
+                data[(h + i) & (Capacity - 1)] = line[i];
+            }
+            head.store(h + (uint32_t)lineLength, std::memory_order_release);
+        }
+        lineLength = 0;
+    }
+
+public:
+    using Print::write;
+
+    size_t write(uint8_t c) override {
+        line[lineLength++] = (char)c;
+        if (c == '\n' || lineLength == LineMax) {
+            commit();
+        }
+        written++;
+        return 1;
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        for (size_t i = 0; i < size; i++) {
+            write(buffer[i]);
+        }
+        return size;
+    }
+
+    // Drainer side: writes up to limit bytes to out; false if the ring is empty
+    // afterwards. Dropped lines are reported once the ring has emptied.
+    bool drain(Print& out, size_t limit) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        uint32_t h = head.load(std::memory_order_acquire);
+        while (t != h && limit > 0) {
+            size_t offset = t & (Capacity - 1);
+            size_t run = h - t;
+            if (run > Capacity - offset) run = Capacity - offset;
+            if (run > limit) run = limit;
+            out.write((const uint8_t*)&data[offset], run);
+            lineOpen = data[(offset + run - 1)] != '\n';
+            t += (uint32_t)run;
+            limit -= run;
+            tail.store(t, std::memory_order_release);
+        }
+        if (t != h) {
+            return true;
+        }
+        uint32_t lost = dropped.load(std::memory_order_relaxed);
+        if (lost != droppedReported && !lineOpen) {
+            out.print("[log: ");
+            out.print((unsigned long)(lost - droppedReported));
+            out.println(" lines dropped]");
+            droppedReported = lost;
+        }
+        return false;
+    }
+
+    // Drainer side: the last drain() stopped before the end of a line
+    bool midLine() const { return lineOpen; }
+
+    // Bytes given to the ring by the writer (dropped ones included)
+    uint64_t bytesWritten() const { return written; }
+    uint32_t droppedLines() const { return dropped.load(std::memory_order_relaxed); }
+};
+
+#endif // LOG_BUFFER_H
@@ -0,0 +1,180 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "hal.h"
+#include "json_writer.h"
+
+// Histogram of durations in microseconds with fixed power-of-two buckets:
+// bucket 0 holds 0 us, bucket b (1 <= b < BUCKETS - 1) holds [2^(b-1), 2^b) us
+// and the last one everything from 2^(BUCKETS-2) us (~4 s) up. record() is a
+// count-leading-zeros and three adds, so it can stay on in production.
+class Histogram {
+public:
+    static const size_t BUCKETS = 24;
+
+private:
+    uint32_t buckets[BUCKETS] = {};
+    uint32_t total = 0;
+    uint64_t sumUs = 0;
+    uint32_t maxUs = 0;
+
+public:
+    void record(uint32_t us) {
+        size_t b = us == 0 ? 0 : 32 - __builtin_clz(us);
+        buckets[b < BUCKETS ? b : BUCKETS - 1]++;
+        total++;
+        sumUs += us;
+        if (us > maxUs) maxUs = us;
+    }
+
+    void reset() { *this = Histogram(); }
+
+    uint32_t count() const { return total; }
+    uint32_t maximum() const { return maxUs; }
+    uint32_t mean() const { return total > 0 ? (uint32_t)(sumUs / total) : 0; }
+    uint32_t bucket(size_t b) const { return buckets[b]; }
+
+    // Upper edge of the bucket holding quantile q (0..1), capped at the maximum
+    uint32_t percentile(float q) const {
+        if (total == 0) return 0;
+        // Nearest rank: the smallest value with at least q of the samples at or below it
+        uint32_t rank = (uint32_t)ceilf(q * total);
+        rank = rank > 0 ? rank - 1 : 0;
+        uint32_t seen = 0;
+        for (size_t b = 0; b < BUCKETS; b++) {
+            seen += buckets[b];
+            if (seen > rank) {
+                uint32_t edge = (1u << b) - 1;
+                return edge < maxUs ? edge : maxUs;
+            }
+        }
+        return maxUs;
+    }
+};
+
+#if METRICS_ENABLED
+// Times its scope into a histogram (nothing if the histogram is nullptr)
+class ScopedTimer {
+private:
+    Histogram* histogram;
+    uint32_t start;
+
+public:
+    explicit ScopedTimer(Histogram* target) : histogram(target), start(hal::cycles()) {}
+    ~ScopedTimer() {
+        if (histogram != nullptr) histogram->record((hal::cycles() - start) / hal::cyclesPerMicrosecond());
+    }
+};
+#else
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram*) {}
+};
+#endif
+
+// Hot-path timings of the firmware, published on MQTT_METRICS_TOPIC every
+// METRICS_INTERVAL and then started afresh. Each histogram has one writer
+// (the loop, or one of the two tasks); the network side reads and resets them
+// without locking, so a report can be off by a sample taken at that moment.
+struct Metrics {
+    enum Timer { LOOP, SAMPLE_LATENESS, NETWORK, MQTT_LOOP, MQTT_CONNECT, PUBLISH, PUBLISH_ACK, TIMER_COUNT };
+
+    Histogram timers[TIMER_COUNT];
+    unsigned long periodStart = 0;
+    uint32_t lowestFreeHeap = 0xFFFFFFFFu;
+    uint32_t lowestLargestBlock = 0xFFFFFFFFu;
+
+    static const char* name(size_t timer) {
+        static const char* const names[TIMER_COUNT] = {"loop", "sample_late", "network", "mqtt_loop",
+                                                       "mqtt_connect", "publish", "publish_ack"};
+        return names[timer];
+    }
+
+    Histogram* operator[](Timer timer) { return &timers[timer]; }
+
+    // Heap low-water marks of the period. Finding the largest block walks the
+    // heap, so call this about once a second rather than per sample.
+    void sampleHeap() {
+        uint32_t free = hal::freeHeap();
+        uint32_t largest = hal::largestFreeBlock();
+        if (free < lowestFreeHeap) lowestFreeHeap = free;
+        if (largest < lowestLargestBlock) lowestLargestBlock = largest;
+    }
+
+    void reset() {
+        for (Histogram& h : timers) h.reset();
+        lowestFreeHeap = lowestLargestBlock = 0xFFFFFFFFu;
+        periodStart = hal::millis();
+    }
+
+    // {"period_ms":..,"heap":{..},"loop":{"n":..,"mean":..,"p50":..,"p99":..,"max":..,"buckets":[..]},..}
+    // Times in microseconds; bucket arrays stop at the last non-empty bucket.
+    void writeJson(JsonWriter& json) const {
+        json.key("period_ms");
+        json.number((unsigned long)(hal::millis() - periodStart));
+        json.key("heap");
+        json.beginObject();
+        json.key("free");
+        json.number((unsigned long)hal::freeHeap());
+        json.key("min_free");
+        json.number((unsigned long)hal::minFreeHeap());
+        json.key("period_min_free");
+        json.number((unsigned long)(lowestFreeHeap == 0xFFFFFFFFu ? hal::freeHeap() : lowestFreeHeap));
+        json.key("largest_block");
+        json.number((unsigned long)(lowestLargestBlock == 0xFFFFFFFFu ? hal::largestFreeBlock() : lowestLargestBlock));
+        json.endObject();
+        for (size_t t = 0; t < TIMER_COUNT; t++) {
+            const Histogram& h = timers[t];
+            json.key(name(t));
+            json.beginObject();
+            json.key("n");
+            json.number((unsigned long)h.count());
+            json.key("mean");
+            json.number((unsigned long)h.mean());
+            json.key("p50");
+            json.number((unsigned long)h.percentile(0.5f));
+            json.key("p99");
+            json.number((unsigned long)h.percentile(0.99f));
+            json.key("max");
+            json.number((unsigned long)h.maximum());
+            size_t used = Histogram::BUCKETS;
+            while (used > 0 && h.bucket(used - 1) == 0) used--;
+            json.key("buckets");
+            json.beginArray();
+            for (size_t b = 0; b < used; b++) json.number((unsigned long)h.bucket(b));
+            json.endArray();
+            json.endObject();
+        }
+    }
+
+    // Human-readable dump of the current period (times in us)
+    void print(Print& out) const {
+        out.println("===== METRICS (us) =====");
+        out.print("period ");
+        out.print(hal::millis() - periodStart);
+        out.print(" ms, heap free ");
+        out.print(hal::freeHeap());
+        out.print(" (min ");
+        out.print(hal::minFreeHeap());
+        out.print("), largest block ");
+        out.println(hal::largestFreeBlock());
+        char line[96];
+        snprintf(line, sizeof(line), "%-13s %8s %8s %8s %8s %8s", "timer", "n", "mean", "p50", "p99", "max");
+        out.println(line);
+        for (size_t t = 0; t < TIMER_COUNT; t++) {
+            const Histogram& h = timers[t];
+            snprintf(line, sizeof(line), "%-13s %8lu %8lu %8lu %8lu %8lu", name(t), (unsigned long)h.count(),
+                     (unsigned long)h.mean(), (unsigned long)h.percentile(0.5f), (unsigned long)h.percentile(0.99f),
+                     (unsigned long)h.maximum());
+            out.println(line);
+        }
+        out.println("========================");
+    }
+};
+
+#endif // METRICS_H
@@ -6,10 +6,39 @@
 #include <WiFiClientSecure.h>  // Changed from WiFiClient to WiFiClientSecure
 #include <PubSubClient.h>
 #include "config.h"
+#include "hal.h"
+#include "reading.h"
+#include "channels.h"
+#include "payload_codec.h"
+#include "json_writer.h"
+#include "settings.h"
+#include "command_handler.h"
+#include "calibration.h"
+#include "metrics.h"
+#if SESSION_SUMMARIES
+#include "session_aggregator.h"
+#endif
+#if TLS_SESSION_RESUMPTION
+#include "tls_transport.h"
+#endif
+#if MQTT_QOS1
+#include "reliable_publisher.h"
+#endif
 
+#if MQTT_QOS1
+class MQTTClient : private DeliveryListener {
+#else
 class MQTTClient {
+#endif
 private:
+#if TLS_SESSION_RESUMPTION
+    ResumableTlsClient espClient;  // WiFiClientSecure that resumes the previous TLS session
+#else
     WiFiClientSecure espClient;  // Changed from WiFiClient to WiFiClientSecure
+#endif
+#if MQTT_QOS1
+    ReliablePublisher reliable;  // QoS 1 window between PubSubClient and the TLS client
+#endif
     PubSubClient client;
     
     unsigned long lastReconnectAttempt = 0;
@@ -19,68 +48,229 @@ private:
     
     // Buffer for JSON messages
     char jsonBuffer[256];
+    char statusBuffer[MQTT_STATUS_BUFFER_SIZE];
     
-    // Callback function for incoming messages
+#if MQTT_BATCH_MAX > 1
+    // Buffer for batch messages (the packet also carries the header and topic)
+#if MQTT_BATCH_FORMAT == PAYLOAD_BINARY
+    uint8_t batchBuffer[payload::binaryMaxLength(MQTT_BATCH_MAX, sizeof(deviceId) - 1)];
+#else
+    uint8_t batchBuffer[MQTT_BUFFER_SIZE - sizeof(MQTT_BATCH_TOPIC) - 8];
+#endif
+#endif
+    
+#if METRICS_ENABLED
+    char metricsBuffer[METRICS_BUFFER_SIZE];
+#endif
+    
+#if SESSION_SUMMARIES
+    char sessionBuffer[MQTT_SESSION_BUFFER_SIZE];
+#endif
+    
+#if MQTT_QOS1
+    // The largest reading, batch and summary fit a slot of the window, so
+    // publishData() never has to fall back to QoS 0
+    static_assert(ReliablePublisher::slotBytes(sizeof(MQTT_DATA_TOPIC) - 1, sizeof(jsonBuffer) - 1) <= MQTT_INFLIGHT_PACKET_MAX,
+                  "A reading message does not fit MQTT_INFLIGHT_PACKET_MAX");
+#if MQTT_BATCH_MAX > 1
+    static_assert(ReliablePublisher::slotBytes(sizeof(MQTT_BATCH_TOPIC) - 1, sizeof(batchBuffer)) <= MQTT_INFLIGHT_PACKET_MAX,
+                  "A batch of MQTT_BATCH_MAX does not fit MQTT_INFLIGHT_PACKET_MAX");
+#endif
+#if SESSION_SUMMARIES
+    static_assert(ReliablePublisher::slotBytes(sizeof(MQTT_SESSION_TOPIC) - 1, sizeof(sessionBuffer) - 1) <= MQTT_INFLIGHT_PACKET_MAX,
+                  "A session summary does not fit MQTT_INFLIGHT_PACKET_MAX");
+#endif
+#endif
+    
+    // Where messages on MQTT_COMMAND_TOPIC go (see setCommandHandler())
+    static inline CommandHandler* commandHandler = nullptr;
+    
+#if MQTT_QOS1
+    // What each slot of the in-flight window carries, to hand back if the
+    // broker never acknowledges it
+    struct Sent {
+        size_t count;                      // Readings; 0 for a session summary
+        union {
+            WaterReading readings[MQTT_BATCH_MAX];
+#if SESSION_SUMMARIES
+            SessionSummary summary;
+#endif
+        };
+    };
+    Sent sent[MQTT_INFLIGHT_WINDOW];
+    size_t queuedSlot = MQTT_INFLIGHT_WINDOW;  // Slot of the last message publishData() queued
+#endif
+    
+    // Where undelivered readings and summaries go (see setUndeliveredHandler())
+    void (*undeliveredReading)(const WaterReading& reading) = nullptr;
+#if SESSION_SUMMARIES
+    SessionAggregator* sessionQueue = nullptr;
+#endif
+    
+    // Connect and client.loop() times go here (see setMetrics())
+    Metrics* metrics = nullptr;
+    
+    Histogram* timer(Metrics::Timer which) {
+        return metrics != nullptr ? (*metrics)[which] : nullptr;
+    }
+    
+    // Callback function for incoming messages; the payload is parsed where it
+    // lies in the PubSubClient buffer
     static void callback(char* topic, byte* payload, unsigned int length) {
-        // Convert payload to string for easier handling
-        char message[length + 1];
-        for (unsigned int i = 0; i < length; i++) {
-            message[i] = (char)payload[i];
-        }
-        message[length] = '\0';
+        hal::console().print("Message received on topic: ");
+        hal::console().print(topic);
+        hal::console().print(", Message: ");
+        hal::console().write(payload, length < CommandHandler::MAX_COMMAND_LENGTH ? length : CommandHandler::MAX_COMMAND_LENGTH);
+        hal::console().println();
         
-        Serial.print("Message received on topic: ");
-        Serial.print(topic);
-        Serial.print(", Message: ");
-        Serial.println(message);
+        if (commandHandler != nullptr && strcmp(topic, MQTT_COMMAND_TOPIC) == 0) {
+            commandHandler->handle((const char*)payload, length);
+        }
+    }
+    
+    // Readings and summaries: at QoS 1 through the in-flight window (false
+    // while it is full, so the caller keeps them for later)
+    bool publishData(const char* topic, const uint8_t* payload, size_t length, bool retained) {
+#if MQTT_QOS1
+        queuedSlot = MQTT_INFLIGHT_WINDOW;
+        return reliable.publish(topic, payload, length, retained, &queuedSlot);
+#else
+        return client.publish(topic, payload, (unsigned int)length, retained);
+#endif
+    }
+    
+#if MQTT_QOS1
+    // Copies the readings of the message publishData() just queued at QoS 1
+    void keep(const WaterReading* readings, size_t count) {
+        if (queuedSlot >= MQTT_INFLIGHT_WINDOW) return;
+        memcpy(sent[queuedSlot].readings, readings, count * sizeof(WaterReading));
+        sent[queuedSlot].count = count;
+    }
+    
+#if SESSION_SUMMARIES
+    void keep(const SessionSummary& summary) {
+        if (queuedSlot >= MQTT_INFLIGHT_WINDOW) return;
+        sent[queuedSlot].summary = summary;
+        sent[queuedSlot].count = 0;
+    }
+#endif
+    
+    // A message given up on or abandoned: back to store-and-forward
+    void undelivered(size_t slot) override {
+        const Sent& message = sent[slot];
+#if SESSION_SUMMARIES
+        if (message.count == 0) {
+            if (sessionQueue != nullptr) sessionQueue->requeue(message.summary);
+            return;
+        }
+#endif
+        for (size_t i = 0; i < message.count && undeliveredReading != nullptr; i++) {
+            undeliveredReading(message.readings[i]);
+        }
     }
+#endif
     
     // Attempt to reconnect to MQTT broker
     bool reconnect() {
         if (WiFi.status() != WL_CONNECTED) {
-            Serial.println("WiFi not connected. Cannot reconnect to MQTT.");
+            hal::console().println("WiFi not connected. Cannot reconnect to MQTT.");
             return false;
         }
         
-        Serial.print("Attempting MQTT connection...");
+        hal::console().print("Attempting MQTT connection...");
+        // TCP, TLS handshake and CONNECT, all blocking
+        ScopedTimer connectTimer(timer(Metrics::MQTT_CONNECT));
         
         // Create a random client ID
         if (client.connect(deviceId, MQTT_USERNAME, MQTT_PASSWORD)) {
-            Serial.println("connected");
+#if TLS_SESSION_RESUMPTION
+            hal::console().print(espClient.resumedSession() ? "connected (TLS session resumed, "
+                                                             : "connected (full TLS handshake, ");
+            hal::console().print(espClient.lastHandshakeMs());
+            hal::console().println(" ms)");
+#else
+            hal::console().println("connected");
+#endif
             
             client.subscribe(MQTT_COMMAND_TOPIC);
             
             return true;
         } else {
-            Serial.print("failed, rc=");
-            Serial.print(client.state());
-            Serial.println(" try again in 5 seconds");
+            hal::console().print("failed, rc=");
+            hal::console().print(client.state());
+            hal::console().println(" try again in 5 seconds");
             return false;
         }
     }
 
 public:
+#if MQTT_QOS1
+    MQTTClient() : reliable(espClient), client(reliable) {
+        reliable.setListener(this);
+#else
     MQTTClient() : client(espClient) {
+#endif
         uint8_t mac[6];
         WiFi.macAddress(mac);
         sprintf(deviceId, "ESP32_%02X%02X%02X", mac[3], mac[4], mac[5]);
     }
     
+#if TLS_SESSION_RESUMPTION
+    // Where the TLS session is kept between connections (survives resets if HAL_NOINIT)
+    void setSessionCache(TlsSessionCache& cache) {
+        espClient.setSessionCache(&cache);
+    }
+    
+    unsigned long tlsHandshakes() const { return espClient.fullHandshakes(); }
+    unsigned long tlsResumptions() const { return espClient.resumedHandshakes(); }
+#endif
+    
+    // Connection and client.loop() timings are recorded once this is set
+    void setMetrics(Metrics* target) {
+        metrics = target;
+#if MQTT_QOS1
+        reliable.setAckTimer(timer(Metrics::PUBLISH_ACK));
+#endif
+    }
+    
+    // Commands are only handled once a handler is set
+    void setCommandHandler(CommandHandler* handler) {
+        commandHandler = handler;
+    }
+    
+    // Readings of QoS 1 messages the broker never acknowledged go to handler
+    // (e.g. the store-and-forward log); without one they are lost
+    void setUndeliveredHandler(void (*handler)(const WaterReading& reading)) {
+        undeliveredReading = handler;
+    }
+    
+#if SESSION_SUMMARIES
+    // Summaries the broker never acknowledged are queued here again
+    void setSessionQueue(SessionAggregator* queue) {
+        sessionQueue = queue;
+    }
+#endif
+    
     void init() {
         espClient.setInsecure();
         
         client.setServer(MQTT_BROKER, MQTT_PORT);
+#if MQTT_BATCH_MAX > 1 || METRICS_ENABLED || SESSION_SUMMARIES
+        // The default 256-byte packet buffer only fits a single reading, not a batch, the metrics or a summary
+        client.setBufferSize(MQTT_BUFFER_SIZE);
+#endif
         
         // Set callback function for incoming messages
         client.setCallback(callback);
         
-        Serial.println("MQTT client initialized with TLS support");
+        hal::console().println("MQTT client initialized with TLS support");
     }
     
     void connect() {
         if (!client.connected()) {
-            long now = millis();
-            if (now - lastReconnectAttempt > reconnectInterval) {
+            long now = hal::millis();
+            // The first attempt after boot (or after a successful connection) is immediate
+            if (lastReconnectAttempt == 0 || now - lastReconnectAttempt > reconnectInterval) {
                 lastReconnectAttempt = now;
                 if (reconnect()) {
                     lastReconnectAttempt = 0;
@@ -95,28 +285,235 @@ public:
         }
         
         if (client.connected()) {
+            ScopedTimer loopTimer(timer(Metrics::MQTT_LOOP));
             client.loop();
+#if MQTT_QOS1
+            // After the loop has read the acks
+            reliable.poll();
+#endif
         }
     }
     
+#if MQTT_QOS1
+    const ReliablePublisher& delivery() const { return reliable; }
+#endif
+    
     bool isConnected() {
         return client.connected();
     }
     
-    // Send water quality data via MQTT
-    bool publishWaterData(String time, float ph, float tds, float turbidity, float temperature) {
+    // Messages still in flight are handed back first (see setUndeliveredHandler())
+    void disconnect() {
+#if MQTT_QOS1
+        reliable.abandon();
+#endif
+        client.disconnect();
+        lastReconnectAttempt = 0;
+    }
+    
+    // Send water quality data via MQTT (timestamp in Unix seconds, UTC)
+    bool publishWaterData(const WaterReading& reading) {
         if (!client.connected()) {
             return false;
         }
         
-        // Create JSON message
-        snprintf(jsonBuffer, sizeof(jsonBuffer),
-                "{\"deviceId\":\"%s\",\"timestamp\":\"%s\",\"ph\":%.2f,\"tds\":%.1f,\"turbidity\":%.2f,\"temperature\":%.1f}",
-                deviceId, time.c_str(), ph, tds, turbidity, temperature);
+        // Create JSON message directly in jsonBuffer, without touching the heap
+        if (formatWaterData(jsonBuffer, sizeof(jsonBuffer), reading) == 0) {
+            return false;
+        }
         
         // Publish to water quality topic
-        return client.publish(MQTT_DATA_TOPIC, jsonBuffer, true);
+        if (!publishData(MQTT_DATA_TOPIC, (const uint8_t*)jsonBuffer, strlen(jsonBuffer), true)) {
+            return false;
+        }
+#if MQTT_QOS1
+        keep(&reading, 1);
+#endif
+        return true;
+    }
+    
+    // The single-reading message, one key per channel (channels.h):
+    // {"deviceId":"...","timestamp":"...","ph":7.00,"tds":300.0,"turbidity":1.00,"temperature":25.0}
+    size_t formatWaterData(char* buffer, size_t size, const WaterReading& reading) const {
+        JsonWriter json(buffer, size);
+        json.beginObject();
+        json.key("deviceId");
+        json.string(deviceId);
+        json.key("timestamp");
+        json.timestamp(reading.timestamp);
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            json.key(CHANNELS[c].key);
+            json.number(reading.values[c], CHANNELS[c].decimals);
+        }
+        json.endObject();
+        return json.length();
+    }
+    
+    // Current settings and calibration and the outcome of the last command on
+    // MQTT_STATUS_TOPIC (calibrated channels only, volts first in each point):
+    // {"deviceId":"...","result":"ok","sample_interval":1000,...,
+    //  "calibration":{"ph":{"fit":"piecewise","points":[[0.905,4.01],...]}}}
+    bool publishStatus(const Settings& settings, const Calibration& calibration, const char* result) {
+        if (!client.connected()) {
+            return false;
+        }
+        
+        JsonWriter json(statusBuffer, sizeof(statusBuffer));
+        json.beginObject();
+        json.key("deviceId");
+        json.string(deviceId);
+        json.key("result");
+        json.string(result);
+        for (size_t i = 0; i < SETTING_FIELD_COUNT; i++) {
+            json.key(SETTING_FIELDS[i].name);
+            json.number((unsigned long)(settings.*SETTING_FIELDS[i].member));
+        }
+        json.key("calibration");
+        json.beginObject();
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            const CalibrationCurve& curve = calibration.curves[c];
+            if (!curve.calibrated()) continue;
+            static const char* const fits[] = {"piecewise", "poly1", "poly2", "poly3"};
+            json.key(CHANNELS[c].key);
+            json.beginObject();
+            json.key("fit");
+            json.string(fits[curve.degree]);
+            json.key("points");
+            json.beginArray();
+            for (size_t p = 0; p < curve.count; p++) {
+                json.beginArray();
+                json.number(curve.volts[p], 4);
+                json.number(curve.values[p], CHANNELS[c].decimals);
+                json.endArray();
+            }
+            json.endArray();
+            json.endObject();
+        }
+        json.endObject();
+        json.endObject();
+        if (!json.ok()) {
+            return false;
+        }
+        return client.publish(MQTT_STATUS_TOPIC, statusBuffer, true);
+    }
+    
+#if METRICS_ENABLED
+    // Publish the timing histograms and heap figures of the current period
+    bool publishMetrics(const Metrics& current) {
+        if (!client.connected()) {
+            return false;
+        }
+        
+        JsonWriter json(metricsBuffer, sizeof(metricsBuffer));
+        json.beginObject();
+        json.key("deviceId");
+        json.string(deviceId);
+        json.key("uptime_s");
+        json.number(hal::millis() / 1000);
+#if MQTT_QOS1
+        json.key("qos1");
+        json.beginObject();
+        json.key("delivered");
+        json.number(reliable.delivered());
+        json.key("retried");
+        json.number(reliable.retried());
+        json.key("dropped");
+        json.number(reliable.dropped());
+        json.key("in_flight");
+        json.number((unsigned long)reliable.inFlight());
+        json.endObject();
+#endif
+        current.writeJson(json);
+        json.endObject();
+        if (!json.ok()) {
+            hal::console().println("Metrics do not fit METRICS_BUFFER_SIZE");
+            return false;
+        }
+        return client.publish(MQTT_METRICS_TOPIC, metricsBuffer);
+    }
+#endif
+    
+#if SESSION_SUMMARIES
+    // A closed session (or day) summary on MQTT_SESSION_TOPIC; minimum and
+    // maximum in the channel's precision, mean and spread one decimal finer:
+    // {"deviceId":"...","date":"2026-10-17","session":"Morning","from":"...","to":"...",
+    //  "count":1440,"unsafe_ph":0,"high_turbidity":2,"mean":{"ph":7.198,...},
+    //  "std":{...},"min":{...},"max":{...}}
+    bool publishSessionSummary(const SessionSummary& summary) {
+        if (!client.connected()) {
+            return false;
+        }
+        
+        JsonWriter json(sessionBuffer, sizeof(sessionBuffer));
+        json.beginObject();
+        json.key("deviceId");
+        json.string(deviceId);
+        json.key("date");
+        json.date(summary.day);
+        json.key("session");
+        json.string(summary.name());
+        json.key("from");
+        json.timestamp(summary.first);
+        json.key("to");
+        json.timestamp(summary.last);
+        json.key("count");
+        json.number((unsigned long)summary.count);
+        json.key("unsafe_ph");
+        json.number((unsigned long)summary.unsafePh);
+        json.key("high_turbidity");
+        json.number((unsigned long)summary.highTurbidity);
+        static const char* const statistics[] = {"mean", "std", "min", "max"};
+        for (size_t s = 0; s < 4; s++) {
+            json.key(statistics[s]);
+            json.beginObject();
+            for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+                float value = s == 0 ? summary.mean[c] : s == 1 ? summary.stddev(c) : s == 2 ? summary.min[c] : summary.max[c];
+                json.key(CHANNELS[c].key);
+                json.number(value, s < 2 ? CHANNELS[c].decimals + 1 : CHANNELS[c].decimals);
+            }
+            json.endObject();
+        }
+        json.endObject();
+        if (!json.ok()) {
+            hal::console().println("Session summary does not fit MQTT_SESSION_BUFFER_SIZE");
+            return false;
+        }
+        if (!publishData(MQTT_SESSION_TOPIC, (const uint8_t*)sessionBuffer, json.length(), false)) {
+            return false;
+        }
+#if MQTT_QOS1
+        keep(summary);
+#endif
+        return true;
+    }
+#endif
+    
+#if MQTT_BATCH_MAX > 1
+    // Send several readings as one message in MQTT_BATCH_FORMAT
+    bool publishBatch(const WaterReading* readings, size_t count) {
+        if (!client.connected()) {
+            return false;
+        }
+        
+#if MQTT_BATCH_FORMAT == PAYLOAD_BINARY
+        size_t length = payload::encodeBinary(batchBuffer, sizeof(batchBuffer), deviceId, readings, count);
+#else
+        size_t length = payload::encodeJson((char*)batchBuffer, sizeof(batchBuffer), deviceId, readings, count);
+#endif
+        if (length == 0) {
+            hal::console().println("Batch does not fit in MQTT_BUFFER_SIZE");
+            return false;
+        }
+        
+        if (!publishData(MQTT_BATCH_TOPIC, batchBuffer, length, true)) {
+            return false;
+        }
+#if MQTT_QOS1
+        keep(readings, count);
+#endif
+        return true;
     }
+#endif
 };
 
 #endif 
\ No newline at end of file
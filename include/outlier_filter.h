@@ -0,0 +1,107 @@
+#ifndef OUTLIER_FILTER_H
+#define OUTLIER_FILTER_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Causal Hampel filter over a fixed number of channels.
+// Each new value is compared with the median of the previous `window` raw
+// values of its channel; if it lies further than threshold * 1.4826 * MAD
+// (the MAD scaled to a standard deviation) and further than the channel's
+// minimum deviation, it is replaced by that median and counted as rejected.
+// The raw value still enters the history, so a genuine step change is accepted
+// once it fills half the window. No allocation: all storage is sized by Capacity.
+template <size_t Channels, size_t Capacity>
+class HampelFilter {
+private:
+    float history[Channels][Capacity];
+    size_t windowSize;
+    size_t stored = 0;
+    size_t next = 0;
+    float threshold;
+    float minDeviation[Channels];
+    uint32_t rejectedCount[Channels];
+
+    // Median of n values, sorting scratch in place (n is small)
+    static float median(float* scratch, size_t n) {
+        for (size_t i = 1; i < n; i++) {
+            float v = scratch[i];
+            size_t j = i;
+            while (j > 0 && scratch[j - 1] > v) {
+                scratch[j] = scratch[j - 1];
+                j--;
+            }
+            scratch[j] = v;
+        }
+        return (n % 2) ? scratch[n / 2] : 0.5f * (scratch[n / 2 - 1] + scratch[n / 2]);
+    }
+
+public:
+    HampelFilter(size_t window = Capacity, float thresholdSigmas = 3.0f)
+        : windowSize(window < 3 ? 3 : (window > Capacity ? Capacity : window)),
+          threshold(thresholdSigmas) {
+        static_assert(Capacity >= 3, "Hampel filter needs at least three samples");
+        for (size_t c = 0; c < Channels; c++) {
+            minDeviation[c] = 0.0f;
+            rejectedCount[c] = 0;
+        }
+    }
+
+    // Window length in samples, clamped to [3, Capacity]. History restarts.
+    void setWindow(size_t window) {
+        windowSize = window < 3 ? 3 : (window > Capacity ? Capacity : window);
+        stored = next = 0;
+    }
+    size_t window() const { return windowSize; }
+
+    void setThreshold(float sigmas) { threshold = sigmas; }
+
+    // Deviations smaller than this are never rejected (guards against MAD == 0
+    // on quantised or very quiet signals)
+    void setMinDeviation(size_t channel, float deviation) { minDeviation[channel] = deviation; }
+
+    // Filters values in place; returns the number of channels replaced
+    size_t apply(float* values) {
+        size_t replaced = 0;
+        size_t n = stored;
+        float scratch[Capacity];
+
+        for (size_t c = 0; c < Channels; c++) {
+            float x = values[c];
+            if (n >= 3) {
+                for (size_t i = 0; i < n; i++) scratch[i] = history[c][i];
+                float med = median(scratch, n);
+                for (size_t i = 0; i < n; i++) scratch[i] = fabsf(history[c][i] - med);
+                float limit = threshold * 1.4826f * median(scratch, n);
+                if (limit < minDeviation[c]) limit = minDeviation[c];
+
+                if (fabsf(x - med) > limit) {
+                    values[c] = med;
+                    rejectedCount[c]++;
+                    replaced++;
+                }
+            }
+            history[c][next] = x;
+        }
+
+        next = (next + 1) % windowSize;
+        if (stored < windowSize) stored++;
+        return replaced;
+    }
+
+    uint32_t rejected(size_t channel) const { return rejectedCount[channel]; }
+
+    uint32_t totalRejected() const {
+        uint32_t total = 0;
+        for (size_t c = 0; c < Channels; c++) total += rejectedCount[c];
+        return total;
+    }
+
+    // Clears the rejection counters (e.g. at the end of each publish window)
+    void resetCounters() {
+        for (size_t c = 0; c < Channels; c++) rejectedCount[c] = 0;
+    }
+};
+
+#endif // OUTLIER_FILTER_H
@@ -0,0 +1,224 @@
+#ifndef PAYLOAD_CODEC_H
+#define PAYLOAD_CODEC_H
+
+#include <math.h>
+#include <string.h>
+#include "reading.h"
+#include "channels.h"
+#include "json_writer.h"
+
+// Encodings for batches of averaged readings published as one MQTT message.
+//
+// JSON: {"deviceId":"...","readings":[{<same fields as the single message>},...]}
+//
+// Binary (packed, delta-encoded, little-endian):
+//
+//   version(1) count(1) idLength(1) deviceId(idLength) baseTimestamp(4, Unix UTC)
+//   version 2 only: channels(1), then per channel decimals(1) keyLength(1) key
+//   then per reading: dt, then every channel's value * 10^decimals
+//
+// Every per-reading field is a zigzag varint holding the difference from the
+// previous reading (the first reading's values are relative to 0, its dt to
+// baseTimestamp). Values keep exactly the published precision; a steady
+// reading costs about 6 bytes instead of ~150 bytes of JSON.
+//
+// Version 1 carries the four standard channels (pH*100, TDS*10, turbidity*100,
+// temperature*10); a node with extra probes (channels.h) sends version 2,
+// which describes its channels once per message.
+namespace payload {
+
+static const uint8_t BINARY_VERSION = SENSOR_CHANNEL_COUNT == STANDARD_CHANNEL_COUNT ? 1 : 2;
+
+// Fixed-point scale of each channel, matching the published decimals
+static constexpr std::array<float, SENSOR_CHANNEL_COUNT> CHANNEL_SCALE = channelScales();
+
+// Bounded append-only writer; once anything does not fit, length() is 0
+class Writer {
+private:
+    uint8_t* out;
+    size_t capacity;
+    size_t used = 0;
+    bool overflow = false;
+
+public:
+    Writer(uint8_t* buffer, size_t size) : out(buffer), capacity(size) {}
+
+    void byte(uint8_t b) {
+        if (used < capacity) {
+            out[used++] = b;
+        } else {
+            overflow = true;
+        }
+    }
+
+    void bytes(const void* data, size_t length) {
+        const uint8_t* p = (const uint8_t*)data;
+        while (length--) byte(*p++);
+    }
+
+    void varint(uint32_t v) {
+        while (v >= 0x80) {
+            byte((uint8_t)(v | 0x80));
+            v >>= 7;
+        }
+        byte((uint8_t)v);
+    }
+
+    void zigzag(int32_t v) { varint(((uint32_t)v << 1) ^ (uint32_t)(v >> 31)); }
+
+    size_t length() const { return overflow ? 0 : used; }
+};
+
+// Bounded reader for the binary format
+class Reader {
+private:
+    const uint8_t* in;
+    size_t size;
+    size_t pos = 0;
+    bool failed = false;
+
+public:
+    Reader(const uint8_t* data, size_t length) : in(data), size(length) {}
+
+    uint8_t byte() {
+        if (pos < size) return in[pos++];
+        failed = true;
+        return 0;
+    }
+
+    uint32_t varint() {
+        uint32_t v = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            uint8_t b = byte();
+            v |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        failed = true;
+        return 0;
+    }
+
+    int32_t zigzag() {
+        uint32_t v = varint();
+        return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+    }
+
+    bool ok() const { return !failed; }
+};
+
+// Longest binary batch of count readings (every varint at its 5 bytes)
+constexpr size_t binaryMaxLength(size_t count, size_t idLength) {
+    size_t length = 3 + idLength + 4 + count * (1 + SENSOR_CHANNEL_COUNT) * 5;
+    if (BINARY_VERSION >= 2) {
+        length++;
+        for (const ChannelSpec& channel : CHANNELS) {
+            length += 2;
+            for (const char* k = channel.key; *k != '\0'; k++) length++;
+        }
+    }
+    return length;
+}
+
+// Returns the encoded length, or 0 if the batch does not fit in size bytes
+inline size_t encodeBinary(uint8_t* buffer, size_t size, const char* deviceId,
+                           const WaterReading* readings, size_t count) {
+    size_t idLength = strlen(deviceId);
+    if (count == 0 || count > 255 || idLength > 255) return 0;
+
+    Writer w(buffer, size);
+    w.byte(BINARY_VERSION);
+    w.byte((uint8_t)count);
+    w.byte((uint8_t)idLength);
+    w.bytes(deviceId, idLength);
+    uint32_t base = readings[0].timestamp;
+    w.byte(base & 0xFF);
+    w.byte((base >> 8) & 0xFF);
+    w.byte((base >> 16) & 0xFF);
+    w.byte((base >> 24) & 0xFF);
+    if (BINARY_VERSION >= 2) {
+        w.byte((uint8_t)SENSOR_CHANNEL_COUNT);
+        for (const ChannelSpec& channel : CHANNELS) {
+            size_t keyLength = strlen(channel.key);
+            w.byte(channel.decimals);
+            w.byte((uint8_t)keyLength);
+            w.bytes(channel.key, keyLength);
+        }
+    }
+
+    uint32_t previousTime = base;
+    int32_t previous[SENSOR_CHANNEL_COUNT] = {0};
+    for (size_t i = 0; i < count; i++) {
+        w.zigzag((int32_t)(readings[i].timestamp - previousTime));
+        previousTime = readings[i].timestamp;
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            int32_t scaled = (int32_t)lroundf(readings[i].values[c] * CHANNEL_SCALE[c]);
+            w.zigzag(scaled - previous[c]);
+            previous[c] = scaled;
+        }
+    }
+    return w.length();
+}
+
+// Decodes a binary batch (the Node-RED flow does the same in JavaScript).
+// Returns the number of readings, or 0 if the message is malformed, has more
+// than maxReadings readings or other channels than this build.
+inline size_t decodeBinary(const uint8_t* data, size_t length, char* deviceId, size_t idSize,
+                           WaterReading* readings, size_t maxReadings) {
+    Reader r(data, length);
+    if (r.byte() != BINARY_VERSION) return 0;
+    size_t count = r.byte();
+    size_t idLength = r.byte();
+    if (count == 0 || count > maxReadings || idLength >= idSize) return 0;
+    for (size_t i = 0; i < idLength; i++) deviceId[i] = (char)r.byte();
+    deviceId[idLength] = '\0';
+    uint32_t timestamp = r.byte();
+    timestamp |= (uint32_t)r.byte() << 8;
+    timestamp |= (uint32_t)r.byte() << 16;
+    timestamp |= (uint32_t)r.byte() << 24;
+    if (BINARY_VERSION >= 2) {
+        if (r.byte() != SENSOR_CHANNEL_COUNT) return 0;
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            if (r.byte() != CHANNELS[c].decimals) return 0;
+            size_t keyLength = r.byte();
+            while (keyLength--) r.byte();
+        }
+    }
+
+    int32_t scaled[SENSOR_CHANNEL_COUNT] = {0};
+    for (size_t i = 0; i < count; i++) {
+        timestamp += (uint32_t)r.zigzag();
+        readings[i].timestamp = timestamp;
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            scaled[c] += r.zigzag();
+            readings[i].values[c] = scaled[c] / CHANNEL_SCALE[c];
+        }
+    }
+    return r.ok() ? count : 0;
+}
+
+// Returns the encoded length (without terminator), or 0 if it does not fit
+inline size_t encodeJson(char* buffer, size_t size, const char* deviceId,
+                         const WaterReading* readings, size_t count) {
+    JsonWriter json(buffer, size);
+    json.beginObject();
+    json.key("deviceId");
+    json.string(deviceId);
+    json.key("readings");
+    json.beginArray();
+    for (size_t i = 0; i < count; i++) {
+        json.beginObject();
+        json.key("timestamp");
+        json.timestamp(readings[i].timestamp);
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            json.key(CHANNELS[c].key);
+            json.number(readings[i].values[c], CHANNELS[c].decimals);
+        }
+        json.endObject();
+    }
+    json.endArray();
+    json.endObject();
+    return json.length();
+}
+
+}  // namespace payload
+
+#endif // PAYLOAD_CODEC_H
@@ -0,0 +1,119 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "hal.h"
+#include "reading.h"
+
+#ifndef NATIVE_BUILD
+#include <esp_sleep.h>
+// Kept across deep sleep (RTC slow memory); initialised only on a cold boot
+#define POWER_RTC_STATE RTC_DATA_ATTR
+#else
+#define POWER_RTC_STATE
+#endif
+
+// State of the duty-cycled low-power mode that has to survive sleep.
+// Declare the one instance with POWER_RTC_STATE so deep sleep keeps it.
+struct PowerState {
+    uint32_t magic;
+    uint32_t wakeCount;                       // Windows since the cold boot
+    uint32_t windowsSinceFlush;
+    uint32_t flushCount;
+    uint32_t awakeMs;                         // Total time awake since the cold boot
+    uint32_t bufferedCount;
+    WaterReading buffered[LOW_POWER_FLUSH_WINDOWS];  // Readings waiting for the next flush
+};
+
+// Duty cycle: wake on the RTC timer once per LOW_POWER_WINDOW_SECONDS, take a
+// sampling burst, buffer the averaged reading in RTC memory, bring WiFi/MQTT
+// up every LOW_POWER_FLUSH_WINDOWS windows to send the buffer, then sleep for
+// the rest of the window. With deep sleep every window restarts from setup();
+// with light sleep (and in the native build, where sleeping just advances the
+// simulated clock) sleepUntilNextWindow() returns and loop() carries on.
+class PowerManager {
+private:
+    static const uint32_t STATE_MAGIC = 0x50574D31;  // "PWM1"
+
+    PowerState& state;
+    bool coldStart = false;
+    unsigned long windowStart = 0;
+
+public:
+    explicit PowerManager(PowerState& rtcState) : state(rtcState) {}
+
+    // Call first thing in setup(); resets the state on a cold boot
+    void begin() {
+#ifndef NATIVE_BUILD
+        coldStart = esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER || state.magic != STATE_MAGIC;
+#else
+        coldStart = state.magic != STATE_MAGIC;
+#endif
+        if (coldStart) {
+            memset(&state, 0, sizeof(state));
+            state.magic = STATE_MAGIC;
+        }
+    }
+
+    bool coldBoot() const { return coldStart; }
+
+    // Marks the start of a sampling window (awake time is measured from here)
+    void beginWindow() {
+        windowStart = hal::millis();
+        state.wakeCount++;
+        state.windowsSinceFlush++;
+    }
+
+    // Buffers a reading until the next flush; false if the buffer is full
+    bool buffer(const WaterReading& reading) {
+        if (state.bufferedCount >= LOW_POWER_FLUSH_WINDOWS) {
+            return false;
+        }
+        state.buffered[state.bufferedCount++] = reading;
+        return true;
+    }
+
+    bool flushDue() const {
+        return state.windowsSinceFlush >= LOW_POWER_FLUSH_WINDOWS || state.bufferedCount >= LOW_POWER_FLUSH_WINDOWS;
+    }
+
+    // Writable so timestamps taken before NTP sync can be corrected in place
+    WaterReading* bufferedReadings() { return state.buffered; }
+    size_t bufferedCount() const { return state.bufferedCount; }
+
+    // Called after a flush attempt; the readings are either sent or in the flash log
+    void flushed() {
+        state.bufferedCount = 0;
+        state.windowsSinceFlush = 0;
+        state.flushCount++;
+    }
+
+    uint32_t wakes() const { return state.wakeCount; }
+    uint32_t flushes() const { return state.flushCount; }
+    uint32_t totalAwakeMs() const { return state.awakeMs; }
+
+    // Sleeps away the rest of the window. Does not return with deep sleep on the board.
+    void sleepUntilNextWindow() {
+        unsigned long awake = hal::millis() - windowStart;
+        state.awakeMs += awake;
+
+        uint64_t windowUs = (uint64_t)LOW_POWER_WINDOW_SECONDS * 1000000ULL;
+        uint64_t awakeUs = (uint64_t)awake * 1000ULL;
+        uint64_t sleepUs = awakeUs + LOW_POWER_MIN_SLEEP * 1000ULL < windowUs ? windowUs - awakeUs
+                                                                             : LOW_POWER_MIN_SLEEP * 1000ULL;
+#ifndef NATIVE_BUILD
+        hal::console().flush();
+        esp_sleep_enable_timer_wakeup(sleepUs);
+#if LOW_POWER_DEEP_SLEEP
+        esp_deep_sleep_start();
+#else
+        esp_light_sleep_start();
+#endif
+#else
+        native::boardClock().advanceMicros(sleepUs);
+#endif
+    }
+};
+
+#endif // POWER_MANAGER_H
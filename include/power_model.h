@@ -0,0 +1,103 @@
+#ifndef POWER_MODEL_H
+#define POWER_MODEL_H
+
+#include <stddef.h>
+#include "config.h"
+
+// Energy/time budget of the duty-cycled low-power mode.
+// Pure arithmetic, shared by the firmware (battery estimate at cold boot) and
+// the host energy model in src/tools/energy_model. Currents are in mA and
+// durations in ms; the defaults are typical ESP32 DevKit figures and should be
+// replaced with measurements of the actual board and sensors.
+namespace power {
+
+struct PowerProfile {
+    float activeCurrent = 45.0f;       // CPU running, radio off (sampling burst, boot)
+    float wifiCurrent = 120.0f;        // Average while associating, TLS handshake and publishing
+    float deepSleepCurrent = 0.01f;    // RTC timer and RTC memory only
+    float lightSleepCurrent = 0.8f;    // RAM and CPU state retained
+    float alwaysOnCurrent = 110.0f;    // Current firmware: busy loop with WiFi associated
+    float sensorCurrent = 40.0f;       // pH, TDS, turbidity and temperature boards together
+    float regulatorCurrent = 0.05f;    // Quiescent draw of the regulator, always present
+    bool sensorsGated = SENSOR_POWER_PIN >= 0;  // Sensors switched off while sleeping
+    float sensorWarmupMs = SENSOR_WARMUP_MS;    // Settling time after powering gated sensors
+    float bootMs = 250.0f;             // Deep-sleep wake until setup() runs
+    float connectMs = 3000.0f;         // WiFi association, DHCP and MQTT/TLS connect
+    float publishMs = 150.0f;          // Per MQTT message
+    float batteryMah = 2500.0f;
+    float usableFraction = 0.8f;       // Capacity usable before brown-out
+};
+
+struct DutyCycle {
+    float windowSeconds = LOW_POWER_WINDOW_SECONDS;
+    int burstSamples = LOW_POWER_BURST_SAMPLES;
+    float burstSpacingMs = LOW_POWER_BURST_SPACING;
+    int flushWindows = LOW_POWER_FLUSH_WINDOWS;
+    bool deepSleep = LOW_POWER_DEEP_SLEEP;
+    int batchSize = MQTT_BATCH_SIZE;
+};
+
+// Charge per phase over one flush period (flushWindows windows), in mAh
+struct EnergyBudget {
+    float periodSeconds = 0;
+    float awakeMs = 0;           // Per flush period
+    float radioMs = 0;
+    float sampling = 0;          // Boot and sampling bursts
+    float radio = 0;             // WiFi connect and publishing
+    float sleep = 0;
+    float sensors = 0;
+    float regulator = 0;
+
+    float total() const { return sampling + radio + sleep + sensors + regulator; }
+    float averageCurrent() const { return periodSeconds > 0 ? total() * 3600.0f / periodSeconds : 0; }
+    float dutyCycle() const { return periodSeconds > 0 ? awakeMs / (periodSeconds * 1000.0f) : 0; }
+};
+
+inline float mAh(float mA, float ms) { return mA * ms / 3600000.0f; }
+
+inline EnergyBudget estimate(const PowerProfile& profile, const DutyCycle& cycle) {
+    EnergyBudget budget;
+    int windows = cycle.flushWindows > 0 ? cycle.flushWindows : 1;
+    int batch = cycle.batchSize > 0 ? cycle.batchSize : 1;
+    budget.periodSeconds = cycle.windowSeconds * windows;
+    float periodMs = budget.periodSeconds * 1000.0f;
+
+    float burstMs = cycle.burstSamples * cycle.burstSpacingMs;
+    float wakeMs = (cycle.deepSleep ? profile.bootMs : 0.0f) + burstMs;
+    if (profile.sensorsGated) wakeMs += profile.sensorWarmupMs;
+    int messages = (windows + batch - 1) / batch;
+    budget.radioMs = profile.connectMs + messages * profile.publishMs;
+    budget.awakeMs = wakeMs * windows + budget.radioMs;
+    if (budget.awakeMs > periodMs) budget.awakeMs = periodMs;
+
+    float sleepMs = periodMs - budget.awakeMs;
+    float sleepCurrent = cycle.deepSleep ? profile.deepSleepCurrent : profile.lightSleepCurrent;
+    budget.sampling = mAh(profile.activeCurrent, wakeMs * windows);
+    budget.radio = mAh(profile.wifiCurrent, budget.radioMs);
+    budget.sleep = mAh(sleepCurrent, sleepMs);
+    float sensorMs = profile.sensorsGated ? (profile.sensorWarmupMs + burstMs) * windows : periodMs;
+    budget.sensors = mAh(profile.sensorCurrent, sensorMs);
+    budget.regulator = mAh(profile.regulatorCurrent, periodMs);
+    return budget;
+}
+
+// The existing always-connected firmware over the same period
+inline EnergyBudget estimateAlwaysOn(const PowerProfile& profile, float periodSeconds) {
+    EnergyBudget budget;
+    budget.periodSeconds = periodSeconds;
+    budget.awakeMs = periodSeconds * 1000.0f;
+    budget.radioMs = budget.awakeMs;
+    budget.radio = mAh(profile.alwaysOnCurrent, budget.awakeMs);
+    budget.sensors = mAh(profile.sensorCurrent, budget.awakeMs);
+    budget.regulator = mAh(profile.regulatorCurrent, budget.awakeMs);
+    return budget;
+}
+
+inline float batteryDays(const PowerProfile& profile, const EnergyBudget& budget) {
+    float current = budget.averageCurrent();
+    return current > 0 ? profile.batteryMah * profile.usableFraction / (current * 24.0f) : 0;
+}
+
+}  // namespace power
+
+#endif // POWER_MODEL_H
@@ -0,0 +1,27 @@
+#ifndef READING_H
+#define READING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+// Channel order used wherever readings are handled as arrays. The four
+// standard probes come first; extra probes from channels.h follow them.
+enum SensorChannel {
+    CH_PH,
+    CH_TDS,
+    CH_TURBIDITY,
+    CH_TEMPERATURE,
+    STANDARD_CHANNEL_COUNT
+};
+
+static const size_t SENSOR_CHANNEL_COUNT = SENSOR_CHANNELS;
+static_assert(SENSOR_CHANNEL_COUNT >= STANDARD_CHANNEL_COUNT, "The standard probes cannot be left out");
+
+// One averaged reading as handed from sampling to publishing
+struct WaterReading {
+    uint32_t timestamp;                    // Unix time (UTC) when the average was taken
+    float values[SENSOR_CHANNEL_COUNT];    // Indexed by SensorChannel
+};
+
+#endif // READING_H
@@ -0,0 +1,381 @@
+#ifndef READING_LOG_H
+#define READING_LOG_H
+
+#include <math.h>
+#include <string.h>
+#include "reading.h"
+#include "channels.h"
+
+#ifndef NATIVE_BUILD
+#include <esp_partition.h>
+#endif
+
+// Raw NOR-flash region the log lives in. Writes may only clear bits; a sector
+// must be erased (all bytes back to 0xFF) before it can be rewritten.
+class LogStorage {
+public:
+    virtual ~LogStorage() {}
+    virtual size_t size() = 0;
+    virtual size_t sectorSize() = 0;
+    virtual bool read(size_t offset, void* data, size_t length) = 0;
+    virtual bool write(size_t offset, const void* data, size_t length) = 0;
+    virtual bool eraseSector(size_t sector) = 0;
+};
+
+#ifndef NATIVE_BUILD
+// Data partition from partitions.csv
+class PartitionStorage : public LogStorage {
+private:
+    const char* label;
+    const esp_partition_t* partition = nullptr;
+
+public:
+    explicit PartitionStorage(const char* partitionLabel) : label(partitionLabel) {}
+
+    bool begin() {
+        partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+        return partition != nullptr;
+    }
+
+    size_t size() override { return partition ? partition->size : 0; }
+    size_t sectorSize() override { return SPI_FLASH_SEC_SIZE; }
+
+    bool read(size_t offset, void* data, size_t length) override {
+        return partition && esp_partition_read(partition, offset, data, length) == ESP_OK;
+    }
+
+    bool write(size_t offset, const void* data, size_t length) override {
+        return partition && esp_partition_write(partition, offset, data, length) == ESP_OK;
+    }
+
+    bool eraseSector(size_t sector) override {
+        return partition && esp_partition_erase_range(partition, sector * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE) == ESP_OK;
+    }
+};
+#endif
+
+// Store-and-forward log of averaged readings for WiFi/MQTT outages.
+//
+// The storage is used as a ring of sectors, each starting with a header that
+// carries an increasing sequence number, followed by fixed-size records:
+//
+//   state(1) crc8(1) timestamp(4) then value*10^decimals(2) per channel, padded to 4 bytes
+//
+// which is 16 bytes for the four standard channels (pH*100, TDS*10,
+// turbidity*100, temperature*10). Values keep exactly the precision that is
+// published; channels that cannot go negative are stored unsigned. Sectors
+// written with another channel table are treated as blank. Appends go strictly
+// forward through every sector, so wear is spread evenly, and a sector is only
+// erased when the head moves onto it (any unsent records in it are dropped and
+// counted). The head moves as soon as its sector fills, so it always points at
+// a free slot. Marking a record as sent only clears bits in its state byte, which
+// needs no erase. RAM use is a few cursors; begin() rebuilds them from flash
+// after a reset.
+class ReadingLog {
+private:
+    static const uint32_t SECTOR_MAGIC = 0x4C515753;  // "SWQL"
+    static const size_t HEADER_SIZE = 16;
+    static const size_t RECORD_SIZE = (6 + 2 * SENSOR_CHANNEL_COUNT + 3) / 4 * 4;
+
+    // Record layout named in the sector header; the standard four channels keep
+    // the erased value, as before there was a choice
+    static const uint32_t LAYOUT = SENSOR_CHANNEL_COUNT == STANDARD_CHANNEL_COUNT ? 0xFFFFFFFF : SENSOR_CHANNEL_COUNT;
+
+    static const uint8_t STATE_EMPTY = 0xFF;
+    static const uint8_t STATE_STORED = 0x7F;
+    static const uint8_t STATE_SENT = 0x3F;
+
+    struct SectorHeader {
+        uint32_t magic;
+        uint32_t sequence;
+        uint32_t layout;
+        uint32_t reserved;
+    };
+
+    struct Record {
+        uint8_t state;
+        uint8_t crc;
+        uint8_t timestamp[4];
+        uint8_t values[RECORD_SIZE - 6];   // 2 bytes per channel, then padding
+    };
+    static_assert(sizeof(Record) == RECORD_SIZE, "Record layout must be packed");
+
+    LogStorage& storage;
+    size_t sectors = 0;
+    size_t slotsPerSector = 0;
+    bool ready = false;
+
+    size_t headSector = 0;     // sector being appended to
+    size_t headSlot = 0;       // next free slot in it (always < slotsPerSector)
+    uint32_t headSequence = 0;
+    size_t tailSector = 0;     // position at or before the oldest pending record
+    size_t tailSlot = 0;
+
+    uint32_t pendingCount = 0;
+    uint32_t droppedCount = 0;
+    uint32_t eraseCount = 0;
+
+    static uint8_t crc8(const uint8_t* data, size_t length) {
+        uint8_t crc = 0;
+        while (length--) {
+            crc ^= *data++;
+            for (int i = 0; i < 8; i++) {
+                crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+            }
+        }
+        return crc;
+    }
+
+    static void putU16(uint8_t* p, uint16_t v) { p[0] = v & 0xFF; p[1] = v >> 8; }
+    static uint16_t getU16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+    static long scaled(float value, float scale, long lo, long hi) {
+        long v = lroundf(value * scale);
+        return v < lo ? lo : (v > hi ? hi : v);
+    }
+
+    size_t recordOffset(size_t sector, size_t slot) const {
+        return sector * storage.sectorSize() + HEADER_SIZE + slot * RECORD_SIZE;
+    }
+
+    bool readHeader(size_t sector, SectorHeader& header) {
+        return storage.read(sector * storage.sectorSize(), &header, sizeof(header)) && header.magic == SECTOR_MAGIC &&
+               header.layout == LAYOUT;
+    }
+
+    uint8_t readState(size_t sector, size_t slot) {
+        uint8_t state = STATE_EMPTY;
+        storage.read(recordOffset(sector, slot), &state, 1);
+        return state;
+    }
+
+    bool slotErased(size_t sector, size_t slot) {
+        uint8_t raw[RECORD_SIZE];
+        if (!storage.read(recordOffset(sector, slot), raw, sizeof(raw))) return false;
+        for (size_t i = 0; i < sizeof(raw); i++) {
+            if (raw[i] != 0xFF) return false;
+        }
+        return true;
+    }
+
+    bool startSector(size_t sector, uint32_t sequence) {
+        if (!storage.eraseSector(sector)) return false;
+        eraseCount++;
+        SectorHeader header = {SECTOR_MAGIC, sequence, LAYOUT, 0xFFFFFFFF};
+        if (!storage.write(sector * storage.sectorSize(), &header, sizeof(header))) return false;
+        headSector = sector;
+        headSlot = 0;
+        headSequence = sequence;
+        return true;
+    }
+
+    // Moves the head to the next sector, dropping whatever is still pending there
+    bool advanceSector() {
+        size_t next = (headSector + 1) % sectors;
+        SectorHeader header;
+        if (readHeader(next, header)) {
+            for (size_t slot = 0; slot < slotsPerSector; slot++) {
+                if (readState(next, slot) == STATE_STORED) {
+                    droppedCount++;
+                    pendingCount--;
+                }
+            }
+            if (tailSector == next) {
+                tailSector = (next + 1) % sectors;
+                tailSlot = 0;
+            }
+        }
+        return startSector(next, headSequence + 1);
+    }
+
+    bool validRecord(const Record& record) const {
+        return record.crc == crc8(record.timestamp, RECORD_SIZE - 2);
+    }
+
+    static void decode(const Record& record, WaterReading& reading) {
+        reading.timestamp = (uint32_t)record.timestamp[0] | ((uint32_t)record.timestamp[1] << 8) |
+                            ((uint32_t)record.timestamp[2] << 16) | ((uint32_t)record.timestamp[3] << 24);
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            uint16_t v = getU16(record.values + 2 * c);
+            reading.values[c] = (CHANNELS[c].negative ? (float)(int16_t)v : (float)v) / channelScale(c);
+        }
+    }
+
+    bool atHead(size_t sector, size_t slot) const {
+        return sector == headSector && slot == headSlot;
+    }
+
+    void step(size_t& sector, size_t& slot) const {
+        if (++slot >= slotsPerSector) {
+            slot = 0;
+            sector = (sector + 1) % sectors;
+        }
+    }
+
+public:
+    explicit ReadingLog(LogStorage& flash) : storage(flash) {}
+
+    // Mounts the log, rebuilding the cursors from flash or formatting it if empty
+    bool begin() {
+        size_t sectorSize = storage.sectorSize();
+        sectors = sectorSize ? storage.size() / sectorSize : 0;
+        if (sectors < 2 || sectorSize < HEADER_SIZE + RECORD_SIZE) {
+            return false;
+        }
+        slotsPerSector = (sectorSize - HEADER_SIZE) / RECORD_SIZE;
+        pendingCount = 0;
+
+        // The newest sector is the one with the highest sequence number
+        bool found = false;
+        SectorHeader header;
+        for (size_t s = 0; s < sectors; s++) {
+            if (readHeader(s, header) && (!found || header.sequence > headSequence)) {
+                found = true;
+                headSector = s;
+                headSequence = header.sequence;
+            }
+        }
+        if (!found) {
+            ready = startSector(0, 1);
+            tailSector = tailSlot = 0;
+            return ready;
+        }
+
+        headSlot = 0;
+        while (headSlot < slotsPerSector && !slotErased(headSector, headSlot)) {
+            headSlot++;
+        }
+
+        // The oldest data starts at the first formatted sector after the head
+        tailSector = (headSector + 1) % sectors;
+        while (tailSector != headSector && !readHeader(tailSector, header)) {
+            tailSector = (tailSector + 1) % sectors;
+        }
+        tailSlot = 0;
+
+        bool tailFound = false;
+        size_t sector = tailSector, slot = 0;
+        size_t used = ((headSector + sectors - tailSector) % sectors) * slotsPerSector + headSlot;
+        for (size_t i = 0; i < used; i++) {
+            if (readState(sector, slot) == STATE_STORED) {
+                if (!tailFound) {
+                    tailFound = true;
+                    tailSector = sector;
+                    tailSlot = slot;
+                }
+                pendingCount++;
+            }
+            step(sector, slot);
+        }
+        if (!tailFound) {
+            tailSector = headSector;
+            tailSlot = headSlot;
+        }
+
+        // A reset right after the last slot of a sector was written
+        if (headSlot >= slotsPerSector && !advanceSector()) {
+            return false;
+        }
+
+        ready = true;
+        return true;
+    }
+
+    bool append(const WaterReading& reading) {
+        if (!ready) return false;
+
+        Record record;
+        memset(&record, 0xFF, sizeof(record));
+        record.state = STATE_STORED;
+        record.timestamp[0] = reading.timestamp & 0xFF;
+        record.timestamp[1] = (reading.timestamp >> 8) & 0xFF;
+        record.timestamp[2] = (reading.timestamp >> 16) & 0xFF;
+        record.timestamp[3] = (reading.timestamp >> 24) & 0xFF;
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            long v = CHANNELS[c].negative ? scaled(reading.values[c], channelScale(c), -32768, 32767)
+                                          : scaled(reading.values[c], channelScale(c), 0, 65535);
+            putU16(record.values + 2 * c, (uint16_t)v);
+        }
+        record.crc = crc8(record.timestamp, RECORD_SIZE - 2);
+
+        if (!storage.write(recordOffset(headSector, headSlot), &record, sizeof(record))) {
+            return false;
+        }
+        headSlot++;
+        pendingCount++;
+        if (headSlot >= slotsPerSector) {
+            advanceSector();
+        }
+        return true;
+    }
+
+    // Oldest reading not yet marked as sent
+    bool peek(WaterReading& reading) {
+        if (!ready || pendingCount == 0) return false;
+
+        while (!atHead(tailSector, tailSlot)) {
+            Record record;
+            if (storage.read(recordOffset(tailSector, tailSlot), &record, sizeof(record)) &&
+                record.state == STATE_STORED) {
+                if (validRecord(record)) {
+                    decode(record, reading);
+                    return true;
+                }
+                // Torn or corrupted record: retire it
+                uint8_t sent = STATE_SENT;
+                storage.write(recordOffset(tailSector, tailSlot), &sent, 1);
+                droppedCount++;
+                pendingCount--;
+            }
+            step(tailSector, tailSlot);
+        }
+        pendingCount = 0;
+        return false;
+    }
+
+    // Marks the reading returned by peek() as delivered
+    bool markSent() {
+        if (!ready || pendingCount == 0) return false;
+        uint8_t sent = STATE_SENT;
+        if (!storage.write(recordOffset(tailSector, tailSlot), &sent, 1)) {
+            return false;
+        }
+        pendingCount--;
+        step(tailSector, tailSlot);
+        return true;
+    }
+
+    // Up to maxCount oldest pending readings, without consuming them
+    size_t peekBatch(WaterReading* readings, size_t maxCount) {
+        if (maxCount == 0 || !peek(readings[0])) return 0;
+
+        size_t count = 1;
+        size_t sector = tailSector, slot = tailSlot;
+        step(sector, slot);
+        while (count < maxCount && !atHead(sector, slot)) {
+            Record record;
+            if (storage.read(recordOffset(sector, slot), &record, sizeof(record)) &&
+                record.state == STATE_STORED && validRecord(record)) {
+                decode(record, readings[count++]);
+            }
+            step(sector, slot);
+        }
+        return count;
+    }
+
+    // Marks the count readings returned by peekBatch() as delivered
+    bool markSent(size_t count) {
+        WaterReading reading;
+        for (size_t i = 0; i < count; i++) {
+            if (!peek(reading) || !markSent()) return false;
+        }
+        return true;
+    }
+
+    uint32_t pending() const { return pendingCount; }
+    uint32_t dropped() const { return droppedCount; }
+    uint32_t erases() const { return eraseCount; }
+    size_t capacity() const { return sectors * slotsPerSector; }
+};
+
+#endif // READING_LOG_H
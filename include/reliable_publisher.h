@@ -0,0 +1,313 @@
+#ifndef RELIABLE_PUBLISHER_H
+#define RELIABLE_PUBLISHER_H
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "hal.h"
+#include "metrics.h"
+
+// QoS 1 publishing for PubSubClient, which itself only publishes at QoS 0 and
+// ignores PUBACKs. This class is the Client PubSubClient talks through: it
+// passes every byte on to the real transport (the TLS client), writes QoS 1
+// PUBLISH packets to it directly, and follows the packets PubSubClient reads
+// to pick out the broker's PUBACKs.
+//
+// Messages in flight are kept, encoded, in a fixed table of
+// MQTT_INFLIGHT_WINDOW slots, each with its packet identifier. Up to that many
+// are sent without waiting for an ack (pipelined). One not acknowledged within
+// MQTT_ACK_TIMEOUT is sent again with the DUP flag, the timeout doubling each
+// time, and given up after MQTT_MAX_RETRIES. After a reconnect (CONNACK)
+// every message still in flight is sent again. When the window is full,
+// publish() returns false and the caller keeps the message (e.g. in the
+// reading log). A message given up on, or still in flight when abandon() is
+// called before a disconnect, is handed back to the DeliveryListener by its
+// slot, so the owner can store it again instead of losing it.
+// No allocation; the window costs MQTT_INFLIGHT_WINDOW * MQTT_INFLIGHT_PACKET_MAX bytes.
+
+// Told what became of each message publish() took, by the slot it was given
+class DeliveryListener {
+public:
+    virtual ~DeliveryListener() {}
+    virtual void delivered(size_t) {}
+    virtual void undelivered(size_t slot) = 0;
+};
+
+class ReliablePublisher : public Client {
+private:
+    struct Slot {
+        bool used;
+        uint8_t retries;
+        uint16_t packetId;
+        uint16_t length;
+        unsigned long firstSent;           // millis() of the first send (ack latency)
+        unsigned long lastSent;
+        uint8_t packet[MQTT_INFLIGHT_PACKET_MAX];
+    };
+
+    // Where the bytes PubSubClient reads stand in the current packet
+    enum ReadState { HEADER, LENGTH, BODY };
+
+    Client& transport;
+    Slot slots[MQTT_INFLIGHT_WINDOW];
+    size_t used = 0;
+    uint16_t nextPacketId = 1;
+    bool sessionUp = false;                // CONNACK accepted on this connection
+    Histogram* ackTimer = nullptr;
+    DeliveryListener* listener = nullptr;
+
+    ReadState readState = HEADER;
+    uint8_t packetType = 0;
+    uint32_t remaining = 0;
+    uint32_t lengthMultiplier = 1;
+    uint8_t body[2];                       // First bytes of the body (PUBACK packet id, CONNACK code)
+    uint32_t bodyRead = 0;
+
+    unsigned long deliveredCount = 0;
+    unsigned long retriedCount = 0;
+    unsigned long droppedCount = 0;
+
+    static size_t remainingLength(const char* topic, size_t length) { return 2 + strlen(topic) + 2 + length; }
+
+    static constexpr size_t packetSize(size_t remaining) {
+        return 1 + (remaining < 128 ? 1 : remaining < 16384 ? 2 : 3) + remaining;
+    }
+
+    // An identifier no message in flight uses (0 is not allowed)
+    uint16_t allocatePacketId() {
+        for (;;) {
+            uint16_t id = nextPacketId++;
+            if (nextPacketId == 0) nextPacketId = 1;
+            bool taken = false;
+            for (size_t i = 0; i < MQTT_INFLIGHT_WINDOW && !taken; i++) {
+                taken = slots[i].used && slots[i].packetId == id;
+            }
+            if (!taken) return id;
+        }
+    }
+
+    bool send(Slot& slot) {
+        slot.lastSent = hal::millis();
+        return transport.write(slot.packet, slot.length) == slot.length;
+    }
+
+    void acknowledged(uint16_t packetId) {
+        for (size_t i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+            Slot& slot = slots[i];
+            if (!slot.used || slot.packetId != packetId) continue;
+            if (ackTimer != nullptr) {
+                ackTimer->record((hal::millis() - slot.firstSent) * 1000UL);
+            }
+            slot.used = false;
+            used--;
+            deliveredCount++;
+            if (listener != nullptr) listener->delivered(i);
+            return;
+        }
+        // Ack of a message already dropped, or a second ack after a retransmission
+    }
+
+    void packetRead() {
+        if (packetType == 4 && bodyRead == 2) {  // PUBACK
+            acknowledged((uint16_t)((body[0] << 8) | body[1]));
+        } else if (packetType == 2 && bodyRead == 2 && body[1] == 0) {  // CONNACK, accepted
+            sessionUp = true;
+            resendAll();
+        }
+    }
+
+    // Follows the packet framing of bytes on their way to PubSubClient
+    void track(const uint8_t* data, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            uint8_t c = data[i];
+            switch (readState) {
+                case HEADER:
+                    packetType = c >> 4;
+                    remaining = 0;
+                    lengthMultiplier = 1;
+                    bodyRead = 0;
+                    readState = LENGTH;
+                    break;
+                case LENGTH:
+                    remaining += (c & 0x7F) * lengthMultiplier;
+                    lengthMultiplier *= 128;
+                    if ((c & 0x80) == 0) {
+                        readState = remaining > 0 ? BODY : HEADER;
+                        if (remaining == 0) packetRead();
+                    }
+                    break;
+                case BODY:
+                    if (bodyRead < sizeof(body)) body[bodyRead] = c;
+                    bodyRead++;
+                    if (--remaining == 0) {
+                        readState = HEADER;
+                        packetRead();
+                    }
+                    break;
+            }
+        }
+    }
+
+    void resendAll() {
+        for (size_t i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+            Slot& slot = slots[i];
+            if (!slot.used) continue;
+            slot.packet[0] |= 0x08;  // DUP
+            retriedCount++;
+            send(slot);
+        }
+    }
+
+    void connectionReset() {
+        sessionUp = false;
+        readState = HEADER;
+    }
+
+public:
+    explicit ReliablePublisher(Client& client) : transport(client) {
+        memset(slots, 0, sizeof(slots));
+    }
+
+    // Time from the first send of a message to its ack is recorded here
+    void setAckTimer(Histogram* timer) { ackTimer = timer; }
+
+    // Where acks and undelivered messages are reported
+    void setListener(DeliveryListener* target) { listener = target; }
+
+    // Queues a QoS 1 PUBLISH and sends it; false if not connected, the window
+    // is full or the packet does not fit MQTT_INFLIGHT_PACKET_MAX. The slot
+    // the message took goes to *slotIndex (for the DeliveryListener).
+    bool publish(const char* topic, const uint8_t* payload, size_t length, bool retained,
+                 size_t* slotIndex = nullptr) {
+        if (!sessionUp || !transport.connected() || used >= MQTT_INFLIGHT_WINDOW || !fits(topic, length)) {
+            return false;
+        }
+        size_t topicLength = strlen(topic);
+
+        Slot* slot = slots;
+        while (slot->used) slot++;
+        slot->packetId = allocatePacketId();
+        uint8_t* p = slot->packet;
+        *p++ = (uint8_t)(0x32 | (retained ? 0x01 : 0x00));  // PUBLISH, QoS 1
+        size_t rest = remainingLength(topic, length);
+        do {
+            uint8_t digit = rest % 128;
+            rest /= 128;
+            if (rest > 0) digit |= 0x80;
+            *p++ = digit;
+        } while (rest > 0);
+        *p++ = (uint8_t)(topicLength >> 8);
+        *p++ = (uint8_t)(topicLength & 0xFF);
+        memcpy(p, topic, topicLength);
+        p += topicLength;
+        *p++ = (uint8_t)(slot->packetId >> 8);
+        *p++ = (uint8_t)(slot->packetId & 0xFF);
+        memcpy(p, payload, length);
+        p += length;
+        slot->length = (uint16_t)(p - slot->packet);
+        slot->retries = 0;
+        slot->used = true;
+        slot->firstSent = hal::millis();
+        used++;
+        if (slotIndex != nullptr) *slotIndex = (size_t)(slot - slots);
+        // A failed write is retried on timeout like a lost packet
+        send(*slot);
+        return true;
+    }
+
+    // Whether a message fits a slot of the window
+    static bool fits(const char* topic, size_t length) {
+        return packetSize(remainingLength(topic, length)) <= MQTT_INFLIGHT_PACKET_MAX;
+    }
+
+    // Bytes a slot needs for a payload of length bytes on a topicLength-byte topic
+    static constexpr size_t slotBytes(size_t topicLength, size_t length) {
+        return packetSize(2 + topicLength + 2 + length);
+    }
+
+    // Sends messages whose ack is overdue again and hands back those out of
+    // retries; call after PubSubClient::loop() has read the incoming packets
+    void poll() {
+        if (!sessionUp || used == 0 || !transport.connected()) return;
+        unsigned long now = hal::millis();
+        for (size_t i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+            Slot& slot = slots[i];
+            if (!slot.used || now - slot.lastSent < ((unsigned long)MQTT_ACK_TIMEOUT << slot.retries)) continue;
+            if (slot.retries >= MQTT_MAX_RETRIES) {
+                slot.used = false;
+                used--;
+                droppedCount++;
+                if (listener != nullptr) listener->undelivered(i);
+                continue;
+            }
+            slot.retries++;
+            slot.packet[0] |= 0x08;  // DUP
+            retriedCount++;
+            send(slot);
+        }
+    }
+
+    // Hands back every message still in flight and empties the window; call
+    // before a disconnect the window does not outlive (e.g. deep sleep)
+    void abandon() {
+        for (size_t i = 0; i < MQTT_INFLIGHT_WINDOW; i++) {
+            if (!slots[i].used) continue;
+            slots[i].used = false;
+            used--;
+            if (listener != nullptr) listener->undelivered(i);
+        }
+    }
+
+    size_t inFlight() const { return used; }
+    bool windowFull() const { return used >= MQTT_INFLIGHT_WINDOW; }
+    unsigned long delivered() const { return deliveredCount; }
+    unsigned long retried() const { return retriedCount; }
+    unsigned long dropped() const { return droppedCount; }
+
+    // Client, passed through to the transport
+    int connect(IPAddress ip, uint16_t port) override {
+        connectionReset();
+        return transport.connect(ip, port);
+    }
+
+    int connect(const char* host, uint16_t port) override {
+        connectionReset();
+        return transport.connect(host, port);
+    }
+
+    using Print::write;
+    size_t write(uint8_t c) override { return transport.write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t size) override { return transport.write(buf, size); }
+
+    int available() override { return transport.available(); }
+
+    int read() override {
+        int c = transport.read();
+        if (c >= 0) {
+            uint8_t byte = (uint8_t)c;
+            track(&byte, 1);
+        }
+        return c;
+    }
+
+    int read(uint8_t* buf, size_t size) override {
+        int n = transport.read(buf, size);
+        if (n > 0) track(buf, (size_t)n);
+        return n;
+    }
+
+    int peek() override { return transport.peek(); }
+    void flush() override { transport.flush(); }
+
+    void stop() override {
+        connectionReset();
+        transport.stop();
+    }
+
+    uint8_t connected() override { return transport.connected(); }
+    operator bool() override { return connected(); }
+};
+
+#endif // RELIABLE_PUBLISHER_H
@@ -0,0 +1,267 @@
+#ifndef SESSION_AGGREGATOR_H
+#define SESSION_AGGREGATOR_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "reading.h"
+#include "adaptive_reporter.h"
+
+// The collection sessions of analytics/analyze.py, in local time. A session
+// runs from its start to one second before start + SESSION_LENGTH (07:59:59).
+enum DaySession { SESSION_MORNING, SESSION_AFTERNOON, SESSION_EVENING, SESSION_COUNT, OUTSIDE_SESSION = SESSION_COUNT };
+
+static const char* const SESSION_NAMES[SESSION_COUNT] = {"Morning", "Afternoon", "Evening"};
+static const uint32_t SESSION_START[SESSION_COUNT] = {6 * 3600, 12 * 3600, 18 * 3600};  // Local seconds of day
+static const uint32_t SESSION_LENGTH = 2 * 3600;
+
+// Aggregate of the readings of one session, or of all sessions of a day.
+// Mean and spread are kept as running (Welford) sums, which stay accurate in
+// float over long sessions and can be merged into the day summary.
+struct SessionSummary {
+    uint32_t day;                          // Local days since 1970-01-01
+    uint32_t session;                      // DaySession, SESSION_COUNT for the whole day
+    uint32_t first;                        // Unix time of the first and last reading
+    uint32_t last;
+    uint32_t count;
+    uint32_t unsafePh;                     // Readings breaking the rules of analyze.py
+    uint32_t highTurbidity;
+    float mean[SENSOR_CHANNEL_COUNT];
+    float m2[SENSOR_CHANNEL_COUNT];        // Sum of squared deviations from the mean
+    float min[SENSOR_CHANNEL_COUNT];
+    float max[SENSOR_CHANNEL_COUNT];
+
+    bool wholeDay() const { return session == SESSION_COUNT; }
+    const char* name() const { return wholeDay() ? "Day" : SESSION_NAMES[session]; }
+
+    // Sample standard deviation (n - 1, as pandas)
+    float stddev(size_t c) const { return count > 1 ? sqrtf(m2[c] / (float)(count - 1)) : 0.0f; }
+
+    void start(uint32_t localDay, uint32_t daySession) {
+        memset(this, 0, sizeof(*this));
+        day = localDay;
+        session = daySession;
+    }
+
+    void add(const WaterReading& reading) {
+        if (count == 0) first = reading.timestamp;
+        last = reading.timestamp;
+        count++;
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            float value = reading.values[c];
+            float delta = value - mean[c];
+            mean[c] += delta / (float)count;
+            m2[c] += delta * (value - mean[c]);
+            if (count == 1 || value < min[c]) min[c] = value;
+            if (count == 1 || value > max[c]) max[c] = value;
+        }
+    }
+
+    // Pooled aggregate of both (Chan et al.)
+    void merge(const SessionSummary& other) {
+        if (other.count == 0) return;
+        if (count == 0) {
+            uint32_t keepDay = day, keepSession = session;
+            *this = other;
+            day = keepDay;
+            session = keepSession;
+            return;
+        }
+        float n = (float)count + (float)other.count;
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            float delta = other.mean[c] - mean[c];
+            mean[c] += delta * (float)other.count / n;
+            m2[c] += other.m2[c] + delta * delta * (float)count * (float)other.count / n;
+            if (other.min[c] < min[c]) min[c] = other.min[c];
+            if (other.max[c] > max[c]) max[c] = other.max[c];
+        }
+        if (other.first < first) first = other.first;
+        if (other.last > last) last = other.last;
+        count += other.count;
+        unsafePh += other.unsafePh;
+        highTurbidity += other.highTurbidity;
+    }
+};
+
+// State of the aggregator. Declare the one instance with POWER_RTC_STATE in
+// low-power mode, so deep sleep does not lose the open session.
+struct SessionState {
+    uint32_t magic;
+    SessionSummary open;                   // Session being aggregated (count 0: none)
+    SessionSummary day;                    // Sessions of the current day closed so far
+    SessionSummary closed[SESSION_SUMMARY_QUEUE];  // Waiting to be published, oldest first
+    uint32_t closedHead;
+    uint32_t closedCount;
+    uint32_t lastClosedKey;                // day * SESSION_COUNT + session of the last closed session
+    uint32_t late;                         // Readings of a session already closed
+    uint32_t dropped;                      // Summaries lost to a full queue
+};
+
+// Session and daily aggregates of the averaged readings, kept on the device
+// so the standard reports (daily_session_mean, session_trends) need only the
+// summaries. add() takes every reading with a valid timestamp; a session is
+// closed by the first reading after it or by close() once the clock has
+// passed its end by SESSION_CLOSE_DELAY. The day summary (all sessions of a
+// day pooled) is closed with the day's last session, or by a reading of a
+// later day. Closed summaries queue up until the network side has published
+// them. Local time is UTC + SESSION_UTC_OFFSET.
+class SessionAggregator {
+private:
+    static const uint32_t STATE_MAGIC = 0x53455331;  // "SES1"
+
+    SessionState& state;
+    AdaptiveReporter::Limits limits;
+
+    static uint32_t localTime(uint32_t timestamp) { return timestamp + SESSION_UTC_OFFSET; }
+
+    static uint32_t key(uint32_t day, uint32_t session) { return day * SESSION_COUNT + session; }
+
+    // Unix time at which the summary's session ends
+    static uint32_t sessionEnd(const SessionSummary& summary) {
+        return summary.day * 86400 + SESSION_START[summary.session] + SESSION_LENGTH - SESSION_UTC_OFFSET;
+    }
+
+    void queue(const SessionSummary& summary) {
+        if (state.closedCount == SESSION_SUMMARY_QUEUE) {
+            state.closedHead = (state.closedHead + 1) % SESSION_SUMMARY_QUEUE;
+            state.closedCount--;
+            state.dropped++;
+        }
+        state.closed[(state.closedHead + state.closedCount) % SESSION_SUMMARY_QUEUE] = summary;
+        state.closedCount++;
+    }
+
+    void closeDay() {
+        if (state.day.count > 0) {
+            queue(state.day);
+        }
+        state.day.count = 0;
+    }
+
+    void closeSession() {
+        SessionSummary& open = state.open;
+        if (state.day.count > 0 && state.day.day != open.day) {
+            closeDay();
+        }
+        if (state.day.count == 0) {
+            state.day.start(open.day, SESSION_COUNT);
+        }
+        state.day.merge(open);
+        queue(open);
+        state.lastClosedKey = key(open.day, open.session);
+        if (open.session == SESSION_COUNT - 1) {
+            closeDay();
+        }
+        open.count = 0;
+    }
+
+public:
+    explicit SessionAggregator(SessionState& sessionState) : state(sessionState) {}
+
+    // Resets the state unless it holds sessions from before a deep sleep
+    void begin(bool coldBoot = true) {
+        if (coldBoot || state.magic != STATE_MAGIC) {
+            memset(&state, 0, sizeof(state));
+            state.magic = STATE_MAGIC;
+        }
+    }
+
+    void setLimits(const AdaptiveReporter::Limits& alarmLimits) { limits = alarmLimits; }
+
+    // Session of a Unix timestamp
+    static DaySession sessionOf(uint32_t timestamp) {
+        uint32_t secondOfDay = localTime(timestamp) % 86400;
+        for (uint32_t s = 0; s < SESSION_COUNT; s++) {
+            if (secondOfDay >= SESSION_START[s] && secondOfDay < SESSION_START[s] + SESSION_LENGTH) {
+                return (DaySession)s;
+            }
+        }
+        return OUTSIDE_SESSION;
+    }
+
+    // The unsafe-pH or high-turbidity rule of analyze.py
+    bool alarm(const WaterReading& reading) const {
+        float ph = reading.values[CH_PH];
+        return ph < limits.phMin || ph > limits.phMax || reading.values[CH_TURBIDITY] > limits.turbidityMax;
+    }
+
+    // Adds a reading with a Unix timestamp to its session; returns the session
+    DaySession add(const WaterReading& reading) {
+        close(reading.timestamp, 0);
+        DaySession session = sessionOf(reading.timestamp);
+        uint32_t day = localTime(reading.timestamp) / 86400;
+        if (state.day.count > 0 && state.day.day < day) {
+            closeDay();
+        }
+        if (session == OUTSIDE_SESSION) {
+            return session;
+        }
+        uint32_t readingKey = key(day, session);
+        bool opened = state.open.count > 0;
+        if (opened && readingKey > key(state.open.day, state.open.session)) {
+            closeSession();
+            opened = false;
+        }
+        if ((opened && readingKey != key(state.open.day, state.open.session)) ||
+            (!opened && state.lastClosedKey != 0 && readingKey <= state.lastClosedKey)) {
+            state.late++;
+            return session;
+        }
+        if (!opened) {
+            state.open.start(day, session);
+        }
+        state.open.add(reading);
+        if (reading.values[CH_PH] < limits.phMin || reading.values[CH_PH] > limits.phMax) {
+            state.open.unsafePh++;
+        }
+        if (reading.values[CH_TURBIDITY] > limits.turbidityMax) {
+            state.open.highTurbidity++;
+        }
+        return session;
+    }
+
+    // Closes the open session (and the day) once now (Unix time) is delay
+    // seconds past its end
+    void close(uint32_t now, uint32_t delay = SESSION_CLOSE_DELAY) {
+        if (state.open.count > 0 && now >= sessionEnd(state.open) + delay) {
+            closeSession();
+        }
+        if (state.day.count > 0 && localTime(now - delay) / 86400 > state.day.day) {
+            closeDay();
+        }
+    }
+
+    // Oldest closed summary not yet published; false if there is none
+    bool peek(SessionSummary& summary) const {
+        if (state.closedCount == 0) return false;
+        summary = state.closed[state.closedHead];
+        return true;
+    }
+
+    void pop() {
+        if (state.closedCount == 0) return;
+        state.closedHead = (state.closedHead + 1) % SESSION_SUMMARY_QUEUE;
+        state.closedCount--;
+    }
+
+    // Puts a summary taken off the queue back in front (its publish was not
+    // acknowledged); dropped if the queue has filled up meanwhile
+    void requeue(const SessionSummary& summary) {
+        if (state.closedCount == SESSION_SUMMARY_QUEUE) {
+            state.dropped++;
+            return;
+        }
+        state.closedHead = (state.closedHead + SESSION_SUMMARY_QUEUE - 1) % SESSION_SUMMARY_QUEUE;
+        state.closed[state.closedHead] = summary;
+        state.closedCount++;
+    }
+
+    const SessionSummary& current() const { return state.open; }
+    uint32_t pending() const { return state.closedCount; }
+    uint32_t late() const { return state.late; }
+    uint32_t dropped() const { return state.dropped; }
+};
+
+#endif // SESSION_AGGREGATOR_H
@@ -0,0 +1,131 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <Preferences.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+
+// Settings that can be changed at run time over MQTT_COMMAND_TOPIC
+// (command_handler.h). The config.h values are the defaults; changes are
+// kept in NVS and loaded again at boot.
+struct Settings {
+    uint32_t sampleIntervalMs = SAMPLE_INTERVAL;
+    uint32_t publishIntervalMs = MQTT_PUBLISH_INTERVAL;
+    uint32_t sampleWindow = SAMPLE_WINDOW;
+    uint32_t phWindow = PH_WINDOW;
+    uint32_t batchSize = MQTT_BATCH_SIZE;
+    uint32_t logLevel = LOG_LEVEL;
+    uint32_t adaptiveReporting = ADAPTIVE_REPORTING;
+    uint32_t sessionReporting = SESSION_REPORTING;
+
+    // Whole samples per published reading
+    uint32_t samplesPerPublish() const {
+        uint32_t samples = publishIntervalMs / sampleIntervalMs;
+        return samples > 0 ? samples : 1;
+    }
+
+    bool operator==(const Settings& other) const { return memcmp(this, &other, sizeof(Settings)) == 0; }
+    bool operator!=(const Settings& other) const { return !(*this == other); }
+};
+
+// Longest sample interval. The background capture sizes its blocks to the
+// interval (BlockRing), so the ring does not limit it.
+static const uint32_t SAMPLE_INTERVAL_MAX = 60000;
+
+// Name (as used in commands and the status message) and bounds of each setting
+struct SettingField {
+    const char* name;
+    uint32_t Settings::*member;
+    uint32_t min;
+    uint32_t max;
+};
+
+static const SettingField SETTING_FIELDS[] = {
+    {"sample_interval", &Settings::sampleIntervalMs, 100, SAMPLE_INTERVAL_MAX},
+    {"publish_interval", &Settings::publishIntervalMs, 100, 3600000},
+    {"window", &Settings::sampleWindow, 1, SAMPLE_WINDOW_MAX},
+    {"ph_window", &Settings::phWindow, 1, PH_WINDOW_MAX},
+    {"batch", &Settings::batchSize, 1, MQTT_BATCH_MAX},
+    {"log", &Settings::logLevel, LOG_QUIET, LOG_MAX_LEVEL},
+    {"adaptive", &Settings::adaptiveReporting, 0, 1},
+    {"sessions", &Settings::sessionReporting, 0, 2},
+};
+static const size_t SETTING_FIELD_COUNT = sizeof(SETTING_FIELDS) / sizeof(SETTING_FIELDS[0]);
+
+inline const SettingField* findSetting(const char* name, size_t length) {
+    for (size_t i = 0; i < SETTING_FIELD_COUNT; i++) {
+        if (strlen(SETTING_FIELDS[i].name) == length && memcmp(SETTING_FIELDS[i].name, name, length) == 0) {
+            return &SETTING_FIELDS[i];
+        }
+    }
+    return nullptr;
+}
+
+// Every field in bounds and at least one sample per publish
+inline bool validSettings(const Settings& settings) {
+    for (size_t i = 0; i < SETTING_FIELD_COUNT; i++) {
+        uint32_t value = settings.*SETTING_FIELDS[i].member;
+        if (value < SETTING_FIELDS[i].min || value > SETTING_FIELDS[i].max) return false;
+    }
+    return settings.publishIntervalMs >= settings.sampleIntervalMs;
+}
+
+// Settings in NVS (Preferences), one versioned blob. Only written when the
+// settings actually change, so repeated or retained commands cost no flash wear.
+class SettingsStore {
+private:
+    static const uint32_t RECORD_VERSION = 3;
+    static constexpr const char* KEY = "settings";
+
+    struct Record {
+        uint32_t version;
+        Settings settings;
+    };
+
+    Settings stored;
+    bool haveStored = false;
+
+public:
+    // false (and settings untouched) if nothing valid is stored
+    bool load(Settings& settings) {
+        Preferences prefs;
+        if (!prefs.begin(SETTINGS_NAMESPACE, true)) {
+            return false;
+        }
+        Record record;
+        bool ok = prefs.getBytesLength(KEY) == sizeof(record) &&
+                  prefs.getBytes(KEY, &record, sizeof(record)) == sizeof(record) &&
+                  record.version == RECORD_VERSION && validSettings(record.settings);
+        prefs.end();
+        if (ok) {
+            settings = record.settings;
+            stored = record.settings;
+            haveStored = true;
+        }
+        return ok;
+    }
+
+    bool save(const Settings& settings) {
+        if (haveStored && settings == stored) {
+            return true;
+        }
+        Preferences prefs;
+        if (!prefs.begin(SETTINGS_NAMESPACE, false)) {
+            return false;
+        }
+        Record record;
+        record.version = RECORD_VERSION;
+        record.settings = settings;
+        bool ok = prefs.putBytes(KEY, &record, sizeof(record)) == sizeof(record);
+        prefs.end();
+        if (ok) {
+            stored = settings;
+            haveStored = true;
+        }
+        return ok;
+    }
+};
+
+#endif // SETTINGS_H
@@ -0,0 +1,75 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock-free bounded queue for exactly one producer and one consumer
+// (e.g. the sampling task and the network task, or an ADC capture interrupt
+// and the sampling loop). Each side only writes its own index; acquire/release
+// ordering publishes the element before the index that makes it visible.
+// Capacity must be a power of two.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+private:
+    T items[Capacity];
+    std::atomic<uint32_t> head{0};  // written by the producer
+    std::atomic<uint32_t> tail{0};  // written by the consumer
+    std::atomic<uint32_t> dropped{0};
+
+public:
+    // Producer side; returns false (and counts a drop) when full
+    bool push(const T& item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= Capacity) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        items[h & (Capacity - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; returns false when empty
+    bool pop(T& item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items[t & (Capacity - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; oldest element without removing it
+    const T* peek() const {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &items[t & (Capacity - 1)];
+    }
+
+    // Consumer side; removes the element peek() returned (no copy)
+    void release() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Either side. Tail is read first, so the head read after it is never
+    // behind it; the consumer may still pop and the producer refill between
+    // the two reads, so the count is clamped to Capacity.
+    size_t size() const {
+        uint32_t t = tail.load(std::memory_order_acquire);
+        uint32_t n = head.load(std::memory_order_acquire) - t;
+        return n < Capacity ? n : Capacity;
+    }
+
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return Capacity; }
+    uint32_t dropCount() const { return dropped.load(std::memory_order_relaxed); }
+};
+
+#endif // SPSC_QUEUE_H
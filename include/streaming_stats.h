@@ -0,0 +1,203 @@
+#ifndef STREAMING_STATS_H
+#define STREAMING_STATS_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Sliding-window statistics for a fixed number of channels.
+// push() is O(1) (amortised for min/max): running sums give mean and variance,
+// monotonic index queues give min and max, and an EWMA runs alongside. The
+// last MaxWindow samples are always kept, so setWindow() can grow or shrink the
+// window at run time without losing history.
+//
+// Sums are taken relative to a per-channel reference value to avoid float
+// cancellation in the variance, and are recomputed from history once per
+// MaxWindow pushes so rounding drift cannot accumulate.
+template <size_t Channels, size_t MaxWindow>
+class StreamingStats {
+    static_assert(MaxWindow > 0, "MaxWindow must be positive");
+
+private:
+    float history[MaxWindow][Channels];
+    uint32_t pushed = 0;      // total samples pushed (sequence number of the next one)
+    size_t windowSize = MaxWindow;
+
+    float reference[Channels];
+    float sum[Channels];
+    float sumSq[Channels];
+
+    // Monotonic queues of sequence numbers: values increasing (min) / decreasing (max)
+    uint32_t minQueue[Channels][MaxWindow];
+    uint32_t maxQueue[Channels][MaxWindow];
+    size_t minHead[Channels], minCount[Channels];
+    size_t maxHead[Channels], maxCount[Channels];
+
+    float ewmaValue[Channels];
+    float ewmaAlpha = 0.2f;
+
+    uint32_t sinceResync = 0;
+
+    float& at(uint32_t seq, size_t channel) {
+        return history[seq % MaxWindow][channel];
+    }
+
+    size_t stored() const {
+        return pushed < MaxWindow ? pushed : MaxWindow;
+    }
+
+    // Adds sample seq to one monotonic queue. Expired entries leave from the
+    // front first so the queue never holds more than the window.
+    template <typename Dominates>
+    void queueSlide(uint32_t* queue, size_t& head, size_t& count, size_t channel,
+                    uint32_t seq, float x, uint32_t oldest, Dominates dominates) {
+        while (count > 0 && queue[head] < oldest) {
+            head = (head + 1) % MaxWindow;
+            count--;
+        }
+        while (count > 0 && dominates(x, at(queue[(head + count - 1) % MaxWindow], channel))) {
+            count--;
+        }
+        queue[(head + count) % MaxWindow] = seq;
+        count++;
+    }
+
+    void slide(size_t channel, uint32_t seq, float x) {
+        uint32_t oldest = seq + 1 >= windowSize ? seq + 1 - (uint32_t)windowSize : 0;
+        queueSlide(minQueue[channel], minHead[channel], minCount[channel], channel, seq, x, oldest,
+                   [](float a, float b) { return a <= b; });
+        queueSlide(maxQueue[channel], maxHead[channel], maxCount[channel], channel, seq, x, oldest,
+                   [](float a, float b) { return a >= b; });
+    }
+
+    // Rebuilds sums and min/max queues from the samples currently in the window
+    void resync() {
+        size_t n = count();
+        uint32_t first = pushed - (uint32_t)n;
+        for (size_t c = 0; c < Channels; c++) {
+            sum[c] = sumSq[c] = 0.0f;
+            minHead[c] = minCount[c] = maxHead[c] = maxCount[c] = 0;
+            if (n > 0) reference[c] = at(first, c);
+        }
+        for (uint32_t seq = first; seq < pushed; seq++) {
+            for (size_t c = 0; c < Channels; c++) {
+                float d = at(seq, c) - reference[c];
+                sum[c] += d;
+                sumSq[c] += d * d;
+                slide(c, seq, at(seq, c));
+            }
+        }
+        sinceResync = 0;
+    }
+
+public:
+    StreamingStats() { clear(); }
+
+    explicit StreamingStats(size_t window) {
+        clear();
+        setWindow(window);
+    }
+
+    void clear() {
+        pushed = 0;
+        sinceResync = 0;
+        for (size_t c = 0; c < Channels; c++) {
+            reference[c] = sum[c] = sumSq[c] = ewmaValue[c] = 0.0f;
+            minHead[c] = minCount[c] = maxHead[c] = maxCount[c] = 0;
+        }
+    }
+
+    // Window length in samples, clamped to [1, MaxWindow]. History is kept.
+    void setWindow(size_t window) {
+        if (window < 1) window = 1;
+        if (window > MaxWindow) window = MaxWindow;
+        windowSize = window;
+        resync();
+    }
+
+    size_t window() const { return windowSize; }
+
+    // Smoothing factor for the EWMA, in (0, 1]
+    void setEwmaAlpha(float alpha) {
+        if (alpha > 0.0f && alpha <= 1.0f) ewmaAlpha = alpha;
+    }
+
+    void push(const float* values) {
+        uint32_t seq = pushed;
+        bool full = count() == windowSize;
+        uint32_t evicted = seq - (uint32_t)windowSize;
+
+        for (size_t c = 0; c < Channels; c++) {
+            float x = values[c];
+            if (seq == 0) {
+                reference[c] = x;
+                ewmaValue[c] = x;
+            } else {
+                ewmaValue[c] += ewmaAlpha * (x - ewmaValue[c]);
+            }
+            if (full) {
+                // Read the evicted sample before its slot can be overwritten
+                float old = at(evicted, c) - reference[c];
+                sum[c] -= old;
+                sumSq[c] -= old * old;
+            }
+            float d = x - reference[c];
+            sum[c] += d;
+            sumSq[c] += d * d;
+            at(seq, c) = x;
+        }
+        pushed++;
+        for (size_t c = 0; c < Channels; c++) {
+            slide(c, seq, values[c]);
+        }
+
+        if (++sinceResync >= MaxWindow) {
+            resync();
+        }
+    }
+
+    // Single-channel convenience
+    void push(float value) {
+        static_assert(Channels == 1, "push(float) is only for single-channel stats");
+        push(&value);
+    }
+
+    // Samples currently in the window
+    size_t count() const {
+        size_t n = stored();
+        return n < windowSize ? n : windowSize;
+    }
+
+    float mean(size_t channel = 0) const {
+        size_t n = count();
+        return n > 0 ? reference[channel] + sum[channel] / n : 0.0f;
+    }
+
+    // Sample variance (n - 1 denominator, as in the analytics scripts)
+    float variance(size_t channel = 0) const {
+        size_t n = count();
+        if (n < 2) return 0.0f;
+        float m = sum[channel] / n;
+        float v = (sumSq[channel] - n * m * m) / (n - 1);
+        return v > 0.0f ? v : 0.0f;
+    }
+
+    float stddev(size_t channel = 0) const { return sqrtf(variance(channel)); }
+
+    float min(size_t channel = 0) const {
+        return minCount[channel] > 0 ? history[minQueue[channel][minHead[channel]] % MaxWindow][channel] : 0.0f;
+    }
+
+    float max(size_t channel = 0) const {
+        return maxCount[channel] > 0 ? history[maxQueue[channel][maxHead[channel]] % MaxWindow][channel] : 0.0f;
+    }
+
+    float ewma(size_t channel = 0) const { return ewmaValue[channel]; }
+
+    // Most recent sample
+    float last(size_t channel = 0) const {
+        return pushed > 0 ? history[(pushed - 1) % MaxWindow][channel] : 0.0f;
+    }
+};
+
+#endif // STREAMING_STATS_H
@@ -0,0 +1,61 @@
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <stdint.h>
+#include "hal.h"
+#include "reading.h"
+
+// Timestamps for readings taken before NTP has synchronised the clock.
+// Until SNTP sets it, the board's time() counts seconds since power-on (and
+// keeps counting through deep sleep), so such readings carry a small
+// "provisional" timestamp. update() watches for the moment the clock jumps to
+// real time and records the offset, after which resolve() converts provisional
+// timestamps to Unix time. Sampling can therefore start at boot instead of
+// waiting for NTP.
+class TimeSync {
+private:
+    uint32_t lastProvisional = 0;        // Clock reading at the last unsynchronised update()
+    unsigned long lastProvisionalMillis = 0;  // millis() when that second was first seen
+    bool seenProvisional = false;
+    int64_t offset = 0;
+    bool offsetKnown = false;
+
+public:
+    // Anything earlier than this is seconds since power-on, not Unix time
+    static const uint32_t MIN_VALID_EPOCH = 1600000000UL;  // 2020-09-13
+
+    static bool provisional(uint32_t timestamp) { return timestamp < MIN_VALID_EPOCH; }
+
+    bool synced() const { return hal::now() >= MIN_VALID_EPOCH; }
+
+    // Call regularly (every network pass); cheap
+    void update() {
+        uint32_t now = (uint32_t)hal::now();
+        if (provisional(now)) {
+            if (!seenProvisional || now != lastProvisional) {
+                lastProvisional = now;
+                lastProvisionalMillis = hal::millis();
+            }
+            seenProvisional = true;
+        } else if (!offsetKnown && seenProvisional) {
+            // Where the unsynchronised clock would be now, extrapolated from its last reading
+            uint32_t wouldBe = lastProvisional + (hal::millis() - lastProvisionalMillis) / 1000;
+            offset = (int64_t)now - wouldBe;
+            offsetKnown = true;
+        }
+    }
+
+    // Converts a provisional timestamp to Unix time; false while that is not yet possible
+    bool resolve(WaterReading& reading) const {
+        if (!provisional(reading.timestamp)) return true;
+        if (!offsetKnown) return false;
+        reading.timestamp = (uint32_t)(reading.timestamp + offset);
+        return true;
+    }
+
+    // True once provisional timestamps can never be resolved (the clock was
+    // already synchronised when this object first looked at it)
+    bool unresolvable() const { return synced() && !offsetKnown; }
+};
+
+#endif // TIME_SYNC_H
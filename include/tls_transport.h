@@ -0,0 +1,332 @@
+#ifndef TLS_TRANSPORT_H
+#define TLS_TRANSPORT_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "hal.h"
+
+// Serialised TLS session of the last broker connection, master secret
+// included. Declared with HAL_NOINIT only with TLS_SESSION_PERSIST.
+struct TlsSessionCache {
+    uint32_t magic;
+    uint32_t length;
+    uint8_t data[TLS_SESSION_CACHE_SIZE];
+};
+
+static const uint32_t TLS_SESSION_MAGIC = 0x544C5331;  // "TLS1"
+
+#ifndef NATIVE_BUILD
+#include <WiFi.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+
+// Drop-in for WiFiClientSecure (with setInsecure()) that resumes the previous
+// TLS session. WiFiClientSecure always runs a full handshake: certificate
+// chain, ECDHE and, on the ESP32, a couple of seconds of bignum arithmetic.
+// Here the session (with the server's ticket) is saved after each handshake
+// and offered on the next connect; when the broker accepts the ticket the
+// handshake is a single round trip with symmetric crypto only. A rejected or
+// expired ticket costs nothing extra: the server just runs a full handshake
+// and issues a new one.
+class ResumableTlsClient : public Client {
+private:
+    WiFiClient tcp;
+    TlsSessionCache* cache = nullptr;
+
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_ssl_config conf;
+    mbedtls_ssl_context ssl;
+    bool contexts = false;
+    bool open = false;
+    int peeked = -1;
+
+    bool resumed = false;
+    unsigned long handshakeMs = 0;
+    unsigned long fullCount = 0;
+    unsigned long resumedCount = 0;
+
+    static int sendCallback(void* context, const unsigned char* buf, size_t length) {
+        WiFiClient* client = (WiFiClient*)context;
+        if (!client->connected()) return MBEDTLS_ERR_NET_CONN_RESET;
+        size_t n = client->write(buf, length);
+        return n > 0 ? (int)n : MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+
+    static int receiveCallback(void* context, unsigned char* buf, size_t length) {
+        WiFiClient* client = (WiFiClient*)context;
+        if (!client->available()) {
+            return client->connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+        }
+        int n = client->read(buf, length);
+        return n > 0 ? n : MBEDTLS_ERR_SSL_WANT_READ;
+    }
+
+    static bool retry(int rc) {
+        return rc == MBEDTLS_ERR_SSL_WANT_READ || rc == MBEDTLS_ERR_SSL_WANT_WRITE;
+    }
+
+    void freeContexts() {
+        if (!contexts) return;
+        mbedtls_ssl_free(&ssl);
+        mbedtls_ssl_config_free(&conf);
+        mbedtls_ctr_drbg_free(&drbg);
+        mbedtls_entropy_free(&entropy);
+        contexts = false;
+    }
+
+    // Offers the cached session (loaded into session) to the server; false if there is none
+    bool loadSession(mbedtls_ssl_session& session) {
+        if (cache == nullptr || cache->magic != TLS_SESSION_MAGIC || cache->length > sizeof(cache->data)) {
+            return false;
+        }
+        bool ok = mbedtls_ssl_session_load(&session, cache->data, cache->length) == 0 &&
+                  mbedtls_ssl_set_session(&ssl, &session) == 0;
+        if (!ok) cache->magic = 0;
+        return ok;
+    }
+
+    void saveSession(const mbedtls_ssl_session& session) {
+        if (cache == nullptr) return;
+        size_t length = 0;
+        cache->magic = 0;
+        if (mbedtls_ssl_session_save(&session, cache->data, sizeof(cache->data), &length) == 0) {
+            cache->length = (uint32_t)length;
+            cache->magic = TLS_SESSION_MAGIC;
+        } else if (length > sizeof(cache->data)) {
+            hal::console().println("TLS session larger than TLS_SESSION_CACHE_SIZE, not cached");
+        }
+    }
+
+    // TLS over the already connected tcp socket
+    int handshake(const char* host) {
+        mbedtls_entropy_init(&entropy);
+        mbedtls_ctr_drbg_init(&drbg);
+        mbedtls_ssl_config_init(&conf);
+        mbedtls_ssl_init(&ssl);
+        contexts = true;
+
+        if (mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy, nullptr, 0) != 0 ||
+            mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                        MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+            stop();
+            return 0;
+        }
+        // No certificate verification, as WiFiClientSecure::setInsecure()
+        mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_NONE);
+        mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &drbg);
+        mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+        if (mbedtls_ssl_setup(&ssl, &conf) != 0 || mbedtls_ssl_set_hostname(&ssl, host) != 0) {
+            stop();
+            return 0;
+        }
+        mbedtls_ssl_set_bio(&ssl, &tcp, sendCallback, receiveCallback, nullptr);
+        mbedtls_ssl_session offeredSession;
+        mbedtls_ssl_session_init(&offeredSession);
+        bool offered = loadSession(offeredSession);
+
+        unsigned long start = hal::millis();
+        int rc;
+        while ((rc = mbedtls_ssl_handshake(&ssl)) != 0) {
+            if (!retry(rc) || hal::millis() - start > TLS_HANDSHAKE_TIMEOUT) {
+                hal::console().print("TLS handshake failed, mbedtls error -0x");
+                hal::console().println((unsigned long)-rc, HEX);
+                if (offered) cache->magic = 0;   // Do not offer a session the server chokes on again
+                mbedtls_ssl_session_free(&offeredSession);
+                stop();
+                return 0;
+            }
+            hal::delay(1);
+        }
+
+        handshakeMs = hal::millis() - start;
+        // A resumed session keeps the master secret of the one offered, a full
+        // handshake derives a new one. (The session ID tells nothing: with a
+        // ticket the client sends a random one, RFC 5077 section 3.4.)
+        mbedtls_ssl_session session;
+        mbedtls_ssl_session_init(&session);
+        bool current = mbedtls_ssl_get_session(&ssl, &session) == 0;
+        resumed = offered && current &&
+                  memcmp(session.master, offeredSession.master, sizeof(session.master)) == 0;
+        if (current) {
+            saveSession(session);
+        } else if (cache != nullptr) {
+            cache->magic = 0;
+        }
+        mbedtls_ssl_session_free(&session);
+        mbedtls_ssl_session_free(&offeredSession);
+        if (resumed) {
+            resumedCount++;
+        } else {
+            fullCount++;
+        }
+        open = true;
+        return 1;
+    }
+
+public:
+    ~ResumableTlsClient() { stop(); }
+
+    // Sessions are saved to and resumed from here; nullptr disables resumption
+    void setSessionCache(TlsSessionCache* sessionCache) { cache = sessionCache; }
+
+    // Certificates are never verified (the firmware has always used setInsecure())
+    void setInsecure() {}
+
+    int connect(IPAddress ip, uint16_t port) override {
+        stop();
+        return tcp.connect(ip, port) ? handshake(nullptr) : 0;
+    }
+
+    int connect(const char* host, uint16_t port) override {
+        stop();
+        return tcp.connect(host, port) ? handshake(host) : 0;
+    }
+
+    using Print::write;
+    size_t write(uint8_t c) override { return write(&c, 1); }
+
+    size_t write(const uint8_t* buf, size_t size) override {
+        if (!open) return 0;
+        size_t sent = 0;
+        unsigned long start = hal::millis();
+        while (sent < size) {
+            int rc = mbedtls_ssl_write(&ssl, buf + sent, size - sent);
+            if (rc > 0) {
+                sent += rc;
+            } else if (!retry(rc) || hal::millis() - start > TLS_HANDSHAKE_TIMEOUT) {
+                stop();
+                break;
+            } else {
+                hal::delay(1);   // Socket buffer full; let the WiFi task drain it
+            }
+        }
+        return sent;
+    }
+
+    int available() override {
+        if (!open) return 0;
+        // A zero-length read processes pending records without consuming data
+        int rc = mbedtls_ssl_read(&ssl, nullptr, 0);
+        if (rc < 0 && !retry(rc)) {
+            stop();
+            return 0;
+        }
+        return (int)mbedtls_ssl_get_bytes_avail(&ssl) + (peeked >= 0 ? 1 : 0);
+    }
+
+    int read(uint8_t* buf, size_t size) override {
+        if (!open || size == 0) return -1;
+        size_t n = 0;
+        if (peeked >= 0) {
+            buf[n++] = (uint8_t)peeked;
+            peeked = -1;
+        }
+        if (n < size) {
+            int rc = mbedtls_ssl_read(&ssl, buf + n, size - n);
+            if (rc > 0) {
+                n += rc;
+            } else if (!retry(rc) && n == 0) {
+                stop();   // Peer closed the connection (rc 0) or a fatal error
+            }
+        }
+        return n > 0 ? (int)n : -1;
+    }
+
+    int read() override {
+        uint8_t c;
+        return read(&c, 1) == 1 ? c : -1;
+    }
+
+    int peek() override {
+        if (peeked < 0 && open) {
+            uint8_t c;
+            if (mbedtls_ssl_read(&ssl, &c, 1) == 1) peeked = c;
+        }
+        return peeked;
+    }
+
+    void flush() override {}
+
+    void stop() override {
+        if (open) mbedtls_ssl_close_notify(&ssl);
+        open = false;
+        peeked = -1;
+        tcp.stop();
+        freeContexts();
+    }
+
+    uint8_t connected() override {
+        return open && (tcp.connected() || peeked >= 0 || mbedtls_ssl_get_bytes_avail(&ssl) > 0);
+    }
+
+    operator bool() override { return connected(); }
+
+    bool resumedSession() const { return resumed; }
+    unsigned long lastHandshakeMs() const { return handshakeMs; }
+    unsigned long fullHandshakes() const { return fullCount; }
+    unsigned long resumedHandshakes() const { return resumedCount; }
+};
+#else
+#include <WiFiClientSecure.h>
+
+// Host stand-in: the loopback pipe of WiFiClientSecure plus the time a
+// handshake would take on the board, FULL_HANDSHAKE_MS or RESUMED_HANDSHAKE_MS
+// (added to the simulated clock). The "ticket" is just its issue time; like
+// the broker's, it is only accepted for TICKET_LIFETIME_S.
+class ResumableTlsClient : public WiFiClientSecure {
+private:
+    static const unsigned long FULL_HANDSHAKE_MS = 1800;
+    static const unsigned long RESUMED_HANDSHAKE_MS = 250;
+    static const uint64_t TICKET_LIFETIME_S = 7200;
+
+    TlsSessionCache* cache = nullptr;
+    bool resumed = false;
+    unsigned long handshakeMs = 0;
+    unsigned long fullCount = 0;
+    unsigned long resumedCount = 0;
+
+    bool ticketValid() const {
+        if (cache == nullptr || cache->magic != TLS_SESSION_MAGIC || cache->length != sizeof(uint64_t)) {
+            return false;
+        }
+        uint64_t issued;
+        memcpy(&issued, cache->data, sizeof(issued));
+        uint64_t now = native::boardClock().microseconds;
+        return now >= issued && now - issued < TICKET_LIFETIME_S * 1000000ULL;
+    }
+
+public:
+    void setSessionCache(TlsSessionCache* sessionCache) { cache = sessionCache; }
+
+    int connect(IPAddress, uint16_t port) override { return connect("", port); }
+
+    int connect(const char* host, uint16_t port) override {
+        if (!WiFiClientSecure::connect(host, port)) return 0;
+        resumed = ticketValid();
+        handshakeMs = resumed ? RESUMED_HANDSHAKE_MS : FULL_HANDSHAKE_MS;
+        native::boardClock().advanceMillis(handshakeMs);
+        if (resumed) {
+            resumedCount++;
+        } else {
+            fullCount++;
+        }
+        if (cache != nullptr) {
+            uint64_t issued = native::boardClock().microseconds;
+            memcpy(cache->data, &issued, sizeof(issued));
+            cache->length = sizeof(issued);
+            cache->magic = TLS_SESSION_MAGIC;
+        }
+        return 1;
+    }
+
+    bool resumedSession() const { return resumed; }
+    unsigned long lastHandshakeMs() const { return handshakeMs; }
+    unsigned long fullHandshakes() const { return fullCount; }
+    unsigned long resumedHandshakes() const { return resumedCount; }
+};
+#endif
+
+#endif // TLS_TRANSPORT_H
@@ -4,64 +4,140 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include "config.h"
+#include "hal.h"
 
+// Channel and BSSID of the last access point joined. Declare the one instance
+// with HAL_NOINIT so it survives resets and deep sleep.
+struct WiFiCache {
+    uint32_t magic;
+    int32_t channel;
+    uint8_t bssid[6];
+    uint16_t check;
+};
+
+// Non-blocking WiFi connection. init() only starts an attempt and
+// wifi_reconnect() advances it, so sampling runs while the link comes up.
+// With WIFI_FAST_CONNECT the first attempt goes straight to the cached
+// channel/BSSID, which skips the scan (a few hundred ms instead of seconds);
+// if that does not associate within WIFI_FAST_CONNECT_TIMEOUT (the access
+// point moved or changed channel) it falls back to a full scan.
 class WiFiManager {
 private:
-    unsigned long lastWiFiCheckTime = 0;
-    const unsigned long wifiCheckInterval = 30000; // 30 seconds between WiFi checks
-    bool wasConnected = false;
-    
-public:
-    void init() {
-        Serial.println("Connecting to WiFi...");
-        
-        // Connect to WiFi network
-        WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-        
-        // Wait for connection (with timeout)
-        unsigned long startTime = millis();
-        while (WiFi.status() != WL_CONNECTED && millis() - startTime < 20000) {
-            delay(500);
-            Serial.print(".");
+    enum State { IDLE, CONNECTING, CONNECTED, WAIT_RETRY };
+
+    static const uint32_t CACHE_MAGIC = 0x57464331;  // "WFC1"
+
+    WiFiCache& cache;
+    State state = IDLE;
+    bool usingCache = false;
+    unsigned long attemptStart = 0;
+    unsigned long connectStart = 0;   // First attempt of the current connection
+
+    static uint16_t checksum(const WiFiCache& entry) {
+        uint16_t sum = (uint16_t)entry.channel;
+        for (int i = 0; i < 6; i++) {
+            sum = (uint16_t)((sum << 3 | sum >> 13) ^ entry.bssid[i]);
         }
-        
-        if (WiFi.status() == WL_CONNECTED) {
-            Serial.println();
-            Serial.print("Connected to WiFi network. IP address: ");
-            Serial.println(WiFi.localIP());
-            wasConnected = true;
+        return sum;
+    }
+
+    bool cacheValid() const {
+        return cache.magic == CACHE_MAGIC && cache.check == checksum(cache) &&
+               cache.channel >= 1 && cache.channel <= 14;
+    }
+
+    void saveCache() {
+        uint8_t* bssid = WiFi.BSSID();
+        if (bssid == nullptr) return;
+        cache.channel = WiFi.channel();
+        memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+        cache.check = checksum(cache);
+        cache.magic = CACHE_MAGIC;
+    }
+
+    void beginAttempt(bool fast) {
+        usingCache = fast && WIFI_FAST_CONNECT && cacheValid();
+        if (usingCache) {
+            WiFi.begin(WIFI_SSID, WIFI_PASSWORD, cache.channel, cache.bssid);
         } else {
-            Serial.println();
-            Serial.println("Failed to connect to WiFi. Will retry later.");
+            WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
         }
+        attemptStart = hal::millis();
+        state = CONNECTING;
     }
-    
+
+    void connected() {
+        state = CONNECTED;
+        saveCache();
+        hal::console().print("Connected to WiFi network in ");
+        hal::console().print(hal::millis() - connectStart);
+        hal::console().print(usingCache ? " ms (cached channel " : " ms (scan, channel ");
+        hal::console().print((int)cache.channel);
+        hal::console().print("). IP address: ");
+        hal::console().println(WiFi.localIP());
+    }
+
+public:
+    explicit WiFiManager(WiFiCache& rtcCache) : cache(rtcCache) {}
+
+    // Starts connecting and returns at once; call wifi_reconnect() regularly
+    void init() {
+        hal::console().println("Connecting to WiFi...");
+        WiFi.mode(WIFI_STA);
+        connectStart = hal::millis();
+        beginAttempt(true);
+    }
+
+    // Advances the connection state machine; also notices a lost link and
+    // reconnects, trying the cached access point first
     void wifi_reconnect() {
-        unsigned long currentTime = millis();
-        
-        // Check WiFi connection periodically
-        if (currentTime - lastWiFiCheckTime > wifiCheckInterval) {
-            lastWiFiCheckTime = currentTime;
-            
-            if (WiFi.status() != WL_CONNECTED) {
-                if (wasConnected) {
-                    Serial.println("WiFi connection lost. Reconnecting...");
-                    wasConnected = false;
+        unsigned long elapsed = hal::millis() - attemptStart;
+        bool linked = WiFi.status() == WL_CONNECTED;
+
+        switch (state) {
+            case IDLE:
+                break;
+            case CONNECTING:
+                if (linked) {
+                    connected();
+                } else if (usingCache && elapsed > WIFI_FAST_CONNECT_TIMEOUT) {
+                    hal::console().println("Cached WiFi channel/BSSID did not answer, scanning...");
+                    WiFi.disconnect();
+                    beginAttempt(false);
+                } else if (elapsed > WIFI_CONNECT_TIMEOUT) {
+                    hal::console().println("Failed to connect to WiFi. Will retry later.");
+                    state = WAIT_RETRY;
+                    attemptStart = hal::millis();
+                }
+                break;
+            case CONNECTED:
+                if (!linked) {
+                    hal::console().println("WiFi connection lost. Reconnecting...");
+                    connectStart = hal::millis();
+                    beginAttempt(true);
+                }
+                break;
+            case WAIT_RETRY:
+                if (linked) {
+                    connected();
+                } else if (elapsed > WIFI_RETRY_INTERVAL) {
+                    connectStart = hal::millis();
+                    beginAttempt(true);
                 }
-                
-                WiFi.reconnect();
-            } else if (!wasConnected) {
-                Serial.println("WiFi reconnected!");
-                Serial.print("IP Address: ");
-                Serial.println(WiFi.localIP());
-                wasConnected = true;
-            }
+                break;
         }
     }
-    
+
+    // Turns the radio off until the next init()
+    void shutdown() {
+        WiFi.disconnect(true);
+        WiFi.mode(WIFI_OFF);
+        state = IDLE;
+    }
+
     bool isConnected() {
         return WiFi.status() == WL_CONNECTED;
     }
 };
 
-#endif 
\ No newline at end of file
+#endif
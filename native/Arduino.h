@@ -0,0 +1,429 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+// Minimal Arduino core stand-in for the native (host) build.
+// Only what the firmware headers actually use is provided. Board time is
+// simulated: millis()/micros() return a counter that delay() and the host
+// harness advance, so a replayed run is deterministic and faster than real time.
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define IRAM_ATTR
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define DEC 10
+#define HEX 16
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_byte_near(addr) pgm_read_byte(addr)
+
+namespace native {
+
+// Simulated board clock shared by millis()/micros()/delay(). Device models
+// schedule events on it (a conversion finishing, an interrupt line going
+// low); advancing the clock runs the events due in time order, with the clock
+// set to each event's time while it runs. Time that passes inside an event
+// (e.g. a blocking bus transfer) just moves the clock on, and the outer
+// advance then runs whatever fell due meanwhile.
+struct BoardClock {
+    uint64_t microseconds = 0;
+    std::multimap<uint64_t, std::function<void()>> events;
+    bool dispatching = false;
+
+    void advanceMicros(uint64_t us) { advanceTo(microseconds + us); }
+    void advanceMillis(uint64_t ms) { advanceTo(microseconds + ms * 1000ULL); }
+
+    void schedule(uint64_t atMicros, std::function<void()> event) {
+        events.emplace(atMicros, std::move(event));
+    }
+
+    void advanceTo(uint64_t target) {
+        if (dispatching) {
+            if (target > microseconds) microseconds = target;
+            return;
+        }
+        dispatching = true;
+        while (!events.empty() && events.begin()->first <= (target > microseconds ? target : microseconds)) {
+            auto next = events.begin();
+            if (next->first > microseconds) microseconds = next->first;
+            std::function<void()> event = std::move(next->second);
+            events.erase(next);
+            event();
+        }
+        dispatching = false;
+        if (target > microseconds) microseconds = target;
+    }
+};
+
+inline BoardClock& boardClock() {
+    static BoardClock clock;
+    return clock;
+}
+
+// Simulated SNTP. Like the board's RTC, the clock counts seconds since boot
+// until configTime() has been called and the network has been up for
+// NTP_DELAY_MS (WiFi.status() reports when it is); from then on it is the
+// host's time, advancing with the board clock.
+struct SntpClient {
+    static const uint64_t NTP_DELAY_MS = 1500;
+
+    bool requested = false;
+    bool scheduled = false;
+    bool synced = false;
+    uint64_t syncAtMicros = 0;
+
+    void networkUp() {
+        if (requested && !scheduled) {
+            scheduled = true;
+            syncAtMicros = boardClock().microseconds + NTP_DELAY_MS * 1000ULL;
+        }
+    }
+};
+
+inline SntpClient& sntp() {
+    static SntpClient client;
+    return client;
+}
+
+// Unix time NTP reports at board time 0 (the host's clock at start-up unless set)
+inline time_t& bootTime() {
+    static time_t boot = time(nullptr);
+    return boot;
+}
+
+// Wall-clock time that advances with the simulated board clock
+inline time_t wallTime() {
+    time_t bootTime = native::bootTime();
+    SntpClient& client = sntp();
+    if (!client.synced && client.scheduled && boardClock().microseconds >= client.syncAtMicros) {
+        client.synced = true;
+    }
+    time_t uptime = (time_t)(boardClock().microseconds / 1000000ULL);
+    return client.synced ? bootTime + uptime : uptime;
+}
+
+// GPIO interrupt handlers (attachInterruptArg); device models raise the edges
+struct InterruptHandler {
+    void (*handler)(void*) = nullptr;
+    void* arg = nullptr;
+};
+
+inline InterruptHandler& interruptHandler(uint8_t pin) {
+    static InterruptHandler handlers[64];
+    return handlers[pin & 63];
+}
+
+// An edge on pin: runs its handler, if one is attached, at the current board time
+inline void raiseInterrupt(uint8_t pin) {
+    InterruptHandler& h = interruptHandler(pin);
+    if (h.handler != nullptr) h.handler(h.arg);
+}
+
+}  // namespace native
+
+inline unsigned long millis() { return (unsigned long)(native::boardClock().microseconds / 1000ULL); }
+inline unsigned long micros() { return (unsigned long)native::boardClock().microseconds; }
+inline void delay(unsigned long ms) { native::boardClock().advanceMillis(ms); }
+inline void delayMicroseconds(unsigned int us) { native::boardClock().advanceMicros(us); }
+inline void yield() {}
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+
+inline uint8_t digitalPinToInterrupt(uint8_t pin) { return pin; }
+inline void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int) {
+    native::interruptHandler(pin) = {handler, arg};
+}
+inline void detachInterrupt(uint8_t pin) { native::interruptHandler(pin) = {}; }
+
+// Starts the simulated SNTP client (see native::SntpClient)
+inline void configTime(long, int, const char*, const char* = nullptr, const char* = nullptr) {
+    native::sntp().requested = true;
+}
+
+class String {
+private:
+    std::string buffer;
+
+public:
+    String() {}
+    String(const char* str) : buffer(str ? str : "") {}
+    String(const std::string& str) : buffer(str) {}
+
+    const char* c_str() const { return buffer.c_str(); }
+    unsigned int length() const { return (unsigned int)buffer.size(); }
+};
+
+class Print;
+
+class Printable {
+public:
+    virtual ~Printable() {}
+    virtual size_t printTo(Print& p) const = 0;
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+
+    // Bytes that can be written without blocking
+    virtual int availableForWrite() { return 0; }
+
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while (size--) {
+            n += write(*buffer++);
+        }
+        return n;
+    }
+
+    size_t write(const char* str) {
+        return str ? write((const uint8_t*)str, strlen(str)) : 0;
+    }
+
+    size_t print(const char* str) { return write(str); }
+    size_t print(const String& str) { return write(str.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int n, int base = DEC) { return printNumber((long)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return printNumber((unsigned long)n, base); }
+    size_t print(long n, int base = DEC) { return printNumber(n, base); }
+    size_t print(unsigned long n, int base = DEC) { return printNumber(n, base); }
+    size_t print(double n, int digits = 2) { return printFloat(n, digits); }
+    size_t print(const Printable& x) { return x.printTo(*this); }
+
+    size_t println() { return write("\r\n"); }
+
+    template <typename T>
+    size_t println(T value) {
+        size_t n = print(value);
+        return n + println();
+    }
+
+    template <typename T>
+    size_t println(T value, int format) {
+        size_t n = print(value, format);
+        return n + println();
+    }
+
+private:
+    size_t printNumber(long n, int base) {
+        if (n < 0 && base == DEC) {
+            size_t t = print('-');
+            return t + printNumber((unsigned long)(-n), base);
+        }
+        return printNumber((unsigned long)n, base);
+    }
+
+    size_t printNumber(unsigned long n, int base) {
+        char buf[8 * sizeof(long) + 1];
+        char* str = &buf[sizeof(buf) - 1];
+        *str = '\0';
+        if (base < 2) base = 10;
+        do {
+            char c = n % base;
+            n /= base;
+            *--str = c < 10 ? c + '0' : c + 'A' - 10;
+        } while (n);
+        return write(str);
+    }
+
+    // Same algorithm as the Arduino core so host output matches the board
+    size_t printFloat(double number, int digits) {
+        if (std::isnan(number)) return print("nan");
+        if (std::isinf(number)) return print("inf");
+        if (number > 4294967040.0) return print("ovf");
+        if (number < -4294967040.0) return print("ovf");
+
+        size_t n = 0;
+        if (number < 0.0) {
+            n += print('-');
+            number = -number;
+        }
+
+        double rounding = 0.5;
+        for (int i = 0; i < digits; ++i) {
+            rounding /= 10.0;
+        }
+        number += rounding;
+
+        unsigned long intPart = (unsigned long)number;
+        double remainder = number - (double)intPart;
+        n += print(intPart);
+
+        if (digits > 0) {
+            n += print('.');
+        }
+        while (digits-- > 0) {
+            remainder *= 10.0;
+            unsigned int toPrint = (unsigned int)remainder;
+            n += print(toPrint);
+            remainder -= toPrint;
+        }
+        return n;
+    }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() {}
+};
+
+class IPAddress : public Printable {
+private:
+    uint8_t octets[4];
+
+public:
+    IPAddress() : octets{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets{a, b, c, d} {}
+
+    uint8_t operator[](int index) const { return octets[index]; }
+
+    size_t printTo(Print& p) const override {
+        size_t n = 0;
+        for (int i = 0; i < 4; i++) {
+            n += p.print((unsigned int)octets[i]);
+            if (i < 3) n += p.print('.');
+        }
+        return n;
+    }
+};
+
+class Client : public Stream {
+public:
+    virtual int connect(IPAddress ip, uint16_t port) = 0;
+    virtual int connect(const char* host, uint16_t port) = 0;
+    using Print::write;
+    virtual size_t write(uint8_t c) override = 0;
+    virtual size_t write(const uint8_t* buf, size_t size) override = 0;
+    virtual int available() override = 0;
+    virtual int read() override = 0;
+    virtual int read(uint8_t* buf, size_t size) = 0;
+    virtual int peek() override = 0;
+    virtual void flush() override = 0;
+    virtual void stop() = 0;
+    virtual uint8_t connected() = 0;
+    virtual operator bool() = 0;
+};
+
+// Console stand-in: writes to stdout and counts bytes so the host build can
+// model how long the same output would hold the UART at a given baud rate.
+// availableForWrite() follows a UART shifting 10 bits per byte at that rate
+// (in simulated time) behind its TX buffer and 128-byte FIFO; writes never
+// block, but anything beyond that room is where the board would have waited.
+class HostSerial : public Stream {
+private:
+    static const size_t UART_FIFO = 128;
+
+    unsigned long baudRate = 0;
+    uint64_t bytesWritten = 0;
+    bool echo = true;
+    size_t txBufferSize = 0;
+    uint64_t busyUntilUs = 0;   // When the UART has sent everything written so far
+
+    void transmit(size_t size) {
+        bytesWritten += size;
+        if (baudRate == 0) return;
+        uint64_t now = native::boardClock().microseconds;
+        if (busyUntilUs < now) busyUntilUs = now;
+        busyUntilUs += size * 10000000ULL / baudRate;
+    }
+
+public:
+    void begin(unsigned long baud) { baudRate = baud; }
+    unsigned long baud() const { return baudRate; }
+    void setTxBufferSize(size_t size) { txBufferSize = size; }
+
+    void setEcho(bool enabled) { echo = enabled; }
+    uint64_t totalBytesWritten() const { return bytesWritten; }
+
+    int availableForWrite() override {
+        if (baudRate == 0) return 4096;
+        uint64_t now = native::boardClock().microseconds;
+        uint64_t queued = busyUntilUs > now ? ((busyUntilUs - now) * baudRate + 9999999ULL) / 10000000ULL : 0;
+        size_t room = txBufferSize + UART_FIFO;
+        return queued >= room ? 0 : (int)(room - queued);
+    }
+
+    using Print::write;
+    size_t write(uint8_t c) override {
+        transmit(1);
+        if (echo) fputc(c, stdout);
+        return 1;
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        transmit(size);
+        if (echo) fwrite(buffer, 1, size, stdout);
+        return size;
+    }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override { fflush(stdout); }
+
+    operator bool() const { return true; }
+};
+
+inline HostSerial Serial;
+
+// ESP object stand-in. The cycle counter runs on the host's steady clock at
+// 1000 "MHz" (one count per nanosecond), so timings are real host time, not
+// simulated board time. The heap has no meaning on the host: it reports what
+// the harness sets (typical free heap of the firmware with WiFi and TLS up).
+class EspClass {
+private:
+    uint32_t freeHeap = 180000;
+    uint32_t minFreeHeap = 180000;
+    uint32_t maxAlloc = 110000;
+
+public:
+    uint32_t getCycleCount() {
+        return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    uint32_t getCpuFreqMHz() { return 1000; }
+    uint32_t getFreeHeap() { return freeHeap; }
+    uint32_t getMinFreeHeap() { return minFreeHeap; }
+    uint32_t getMaxAllocHeap() { return maxAlloc; }
+
+    // Host-only: heap figures reported from now on
+    void setHeap(uint32_t free, uint32_t largestBlock) {
+        freeHeap = free;
+        maxAlloc = largestBlock;
+        if (free < minFreeHeap) minFreeHeap = free;
+    }
+};
+
+inline EspClass ESP;
+
+#endif // NATIVE_ARDUINO_H
@@ -0,0 +1,73 @@
+#ifndef NATIVE_PREFERENCES_H
+#define NATIVE_PREFERENCES_H
+
+// NVS (Preferences) stand-in for the native build: the same API over an
+// in-memory key/value map shared by every Preferences object, so values
+// survive end()/begin() like NVS (but not the host process). Only the
+// blob accessors the firmware uses are provided.
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class Preferences {
+private:
+    std::string ns;
+    bool opened = false;
+    bool readOnly = false;
+
+    static std::map<std::string, std::vector<uint8_t>>& storage() {
+        static std::map<std::string, std::vector<uint8_t>> values;
+        return values;
+    }
+
+    static unsigned long& writeCount() {
+        static unsigned long count = 0;
+        return count;
+    }
+
+    std::string path(const char* key) const { return ns + "/" + key; }
+
+public:
+    bool begin(const char* name, bool readOnlyMode = false, const char* = nullptr) {
+        ns = name;
+        readOnly = readOnlyMode;
+        opened = true;
+        if (readOnly) {
+            // As on the board, a namespace that was never written cannot be opened read-only
+            auto it = storage().lower_bound(ns + "/");
+            opened = it != storage().end() && it->first.compare(0, ns.size() + 1, ns + "/") == 0;
+        }
+        return opened;
+    }
+
+    void end() { opened = false; }
+
+    size_t getBytesLength(const char* key) {
+        if (!opened) return 0;
+        auto it = storage().find(path(key));
+        return it == storage().end() ? 0 : it->second.size();
+    }
+
+    size_t getBytes(const char* key, void* buf, size_t maxLen) {
+        if (!opened) return 0;
+        auto it = storage().find(path(key));
+        if (it == storage().end() || it->second.size() > maxLen) return 0;
+        memcpy(buf, it->second.data(), it->second.size());
+        return it->second.size();
+    }
+
+    size_t putBytes(const char* key, const void* value, size_t len) {
+        if (!opened || readOnly) return 0;
+        const uint8_t* bytes = (const uint8_t*)value;
+        storage()[path(key)].assign(bytes, bytes + len);
+        writeCount()++;
+        return len;
+    }
+
+    // Host-only: number of putBytes() calls so far (flash wear on the board)
+    static unsigned long writes() { return writeCount(); }
+};
+
+#endif // NATIVE_PREFERENCES_H
@@ -0,0 +1,291 @@
+#ifndef NATIVE_PUBSUBCLIENT_H
+#define NATIVE_PUBSUBCLIENT_H
+
+// PubSubClient stand-in for the native build. Mirrors the subset of the
+// knolleary/PubSubClient 2.8 API the firmware uses and, like the real library,
+// speaks MQTT 3.1.1 over whatever Client it is given, so byte counts and
+// buffer-size limits behave the same on the host as on the board.
+
+#include <Arduino.h>
+#include <functional>
+
+#define MQTT_VERSION 4
+#define MQTT_MAX_PACKET_SIZE 256
+#define MQTT_KEEPALIVE 15
+#define MQTT_SOCKET_TIMEOUT 15
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+
+#define MQTTCONNECT 1 << 4
+#define MQTTPUBLISH 3 << 4
+#define MQTTSUBSCRIBE 8 << 4
+#define MQTTPINGREQ 12 << 4
+#define MQTTPINGRESP 13 << 4
+#define MQTTDISCONNECT 14 << 4
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+class PubSubClient {
+private:
+    Client* _client;
+    uint8_t* buffer;
+    uint16_t bufferSize;
+    uint16_t keepAlive = MQTT_KEEPALIVE;
+    uint16_t nextMsgId = 0;
+    unsigned long lastOutActivity = 0;
+    unsigned long lastInActivity = 0;
+    bool pingOutstanding = false;
+    int _state = MQTT_DISCONNECTED;
+    MQTT_CALLBACK_SIGNATURE;
+
+    // Writes the fixed header in front of a packet whose body starts at buffer[5]
+    size_t writePacket(uint8_t header, uint16_t length) {
+        uint8_t lenBuf[4];
+        uint8_t llen = 0;
+        uint16_t len = length;
+        do {
+            uint8_t digit = len % 128;
+            len /= 128;
+            if (len > 0) digit |= 0x80;
+            lenBuf[llen++] = digit;
+        } while (len > 0);
+
+        buffer[4 - llen] = header;
+        for (int i = 0; i < llen; i++) {
+            buffer[5 - llen + i] = lenBuf[i];
+        }
+        size_t total = 1 + llen + length;
+        size_t written = _client->write(buffer + (4 - llen), total);
+        lastOutActivity = millis();
+        return written == total;
+    }
+
+    uint16_t writeString(const char* string, uint16_t pos) {
+        uint16_t length = (uint16_t)strlen(string);
+        buffer[pos++] = (uint8_t)(length >> 8);
+        buffer[pos++] = (uint8_t)(length & 0xFF);
+        memcpy(buffer + pos, string, length);
+        return pos + length;
+    }
+
+    bool readByte(uint8_t* result) {
+        unsigned long start = millis();
+        while (!_client->available()) {
+            if (millis() - start >= (unsigned long)MQTT_SOCKET_TIMEOUT * 1000UL) return false;
+            delay(1);
+        }
+        *result = (uint8_t)_client->read();
+        return true;
+    }
+
+    // Reads one packet into buffer; returns its total length or 0
+    uint32_t readPacket(uint8_t* headerLength) {
+        uint32_t len = 0;
+        if (!readByte(&buffer[len++])) return 0;
+
+        uint32_t multiplier = 1;
+        uint32_t length = 0;
+        uint8_t digit = 0;
+        do {
+            if (len == 5) {
+                _state = MQTT_DISCONNECTED;
+                _client->stop();
+                return 0;
+            }
+            if (!readByte(&digit)) return 0;
+            buffer[len++] = digit;
+            length += (digit & 127) * multiplier;
+            multiplier <<= 7;
+        } while ((digit & 128) != 0);
+        *headerLength = (uint8_t)(len - 1);
+
+        for (uint32_t i = 0; i < length; i++) {
+            uint8_t c;
+            if (!readByte(&c)) return 0;
+            if (len < bufferSize) {
+                buffer[len] = c;
+            }
+            len++;
+        }
+        return len > bufferSize ? 0 : len;
+    }
+
+public:
+    PubSubClient(Client& client) : _client(&client) {
+        bufferSize = 0;
+        buffer = nullptr;
+        setBufferSize(MQTT_MAX_PACKET_SIZE);
+    }
+
+    ~PubSubClient() { free(buffer); }
+
+    PubSubClient& setServer(const char*, uint16_t) { return *this; }
+    PubSubClient& setClient(Client& client) {
+        _client = &client;
+        return *this;
+    }
+    PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE) {
+        this->callback = callback;
+        return *this;
+    }
+    PubSubClient& setKeepAlive(uint16_t seconds) {
+        keepAlive = seconds;
+        return *this;
+    }
+
+    bool setBufferSize(uint16_t size) {
+        if (size == 0) return false;
+        uint8_t* newBuffer = (uint8_t*)realloc(buffer, size);
+        if (newBuffer == nullptr) return false;
+        buffer = newBuffer;
+        bufferSize = size;
+        return true;
+    }
+    uint16_t getBufferSize() { return bufferSize; }
+
+    bool connect(const char* id, const char* user, const char* pass) {
+        if (connected()) return true;
+
+        if (!_client->connect("", 1883)) {
+            _state = MQTT_CONNECT_FAILED;
+            return false;
+        }
+
+        const uint8_t header[9] = {0x00, 0x04, 'M', 'Q', 'T', 'T', MQTT_VERSION, 0, 0};
+        uint16_t length = 5;
+        memcpy(buffer + length, header, sizeof(header));
+        length += sizeof(header);
+
+        uint8_t flags = 0x02;  // clean session
+        if (user != nullptr) flags |= 0x80;
+        if (pass != nullptr) flags |= 0x40;
+        buffer[length - 2] = flags;
+        buffer[length++] = (uint8_t)(keepAlive >> 8);
+        buffer[length++] = (uint8_t)(keepAlive & 0xFF);
+
+        length = writeString(id, length);
+        if (user != nullptr) length = writeString(user, length);
+        if (pass != nullptr) length = writeString(pass, length);
+
+        writePacket(MQTTCONNECT, length - 5);
+
+        lastInActivity = lastOutActivity = millis();
+        uint8_t llen;
+        uint32_t len = readPacket(&llen);
+        if (len == 4 && buffer[3] == 0) {
+            lastInActivity = millis();
+            pingOutstanding = false;
+            _state = MQTT_CONNECTED;
+            return true;
+        }
+        _state = len == 4 ? buffer[3] : MQTT_CONNECTION_TIMEOUT;
+        _client->stop();
+        return false;
+    }
+
+    void disconnect() {
+        buffer[0] = MQTTDISCONNECT;
+        buffer[1] = 0;
+        _client->write(buffer, 2);
+        _state = MQTT_DISCONNECTED;
+        _client->flush();
+        _client->stop();
+    }
+
+    bool connected() {
+        if (_client == nullptr) return false;
+        bool rc = _client->connected();
+        if (!rc) {
+            if (_state == MQTT_CONNECTED) {
+                _state = MQTT_CONNECTION_LOST;
+                _client->flush();
+                _client->stop();
+            }
+        } else {
+            return _state == MQTT_CONNECTED;
+        }
+        return rc;
+    }
+
+    int state() { return _state; }
+
+    bool publish(const char* topic, const char* payload) {
+        return publish(topic, payload, false);
+    }
+
+    bool publish(const char* topic, const char* payload, bool retained) {
+        return publish(topic, (const uint8_t*)payload, payload ? (unsigned int)strlen(payload) : 0, retained);
+    }
+
+    bool publish(const char* topic, const uint8_t* payload, unsigned int plength, bool retained) {
+        if (!connected()) return false;
+        if (bufferSize < 5 + 2 + strlen(topic) + plength) {
+            // Too long for the packet buffer, exactly like the real library
+            return false;
+        }
+        uint16_t length = writeString(topic, 5);
+        memcpy(buffer + length, payload, plength);
+        length += plength;
+        uint8_t header = MQTTPUBLISH;
+        if (retained) header |= 1;
+        return writePacket(header, length - 5);
+    }
+
+    bool subscribe(const char* topic, uint8_t qos = 0) {
+        if (!connected()) return false;
+        uint16_t length = 5;
+        nextMsgId++;
+        if (nextMsgId == 0) nextMsgId = 1;
+        buffer[length++] = (uint8_t)(nextMsgId >> 8);
+        buffer[length++] = (uint8_t)(nextMsgId & 0xFF);
+        length = writeString(topic, length);
+        buffer[length++] = qos;
+        return writePacket(MQTTSUBSCRIBE | 0x02, length - 5);
+    }
+
+    bool loop() {
+        if (!connected()) return false;
+
+        unsigned long t = millis();
+        if ((t - lastInActivity > keepAlive * 1000UL) || (t - lastOutActivity > keepAlive * 1000UL)) {
+            if (pingOutstanding) {
+                _state = MQTT_CONNECTION_TIMEOUT;
+                _client->stop();
+                return false;
+            }
+            buffer[0] = MQTTPINGREQ;
+            buffer[1] = 0;
+            _client->write(buffer, 2);
+            lastOutActivity = t;
+            lastInActivity = t;
+            pingOutstanding = true;
+        }
+
+        while (_client->available()) {
+            uint8_t llen;
+            uint32_t len = readPacket(&llen);
+            if (len == 0) break;
+            lastInActivity = millis();
+
+            uint8_t type = buffer[0] & 0xF0;
+            if (type == MQTTPUBLISH && callback) {
+                uint16_t tl = (uint16_t)((buffer[llen + 1] << 8) + buffer[llen + 2]);
+                // Shift the topic down one byte to make room for its terminator
+                memmove(buffer + llen + 2, buffer + llen + 3, tl);
+                buffer[llen + 2 + tl] = 0;
+                char* topic = (char*)buffer + llen + 2;
+                uint8_t* payload = buffer + llen + 3 + tl;
+                callback(topic, payload, len - llen - 3 - tl);
+            } else if (type == MQTTPINGRESP) {
+                pingOutstanding = false;
+            }
+        }
+        return true;
+    }
+};
+
+#endif // NATIVE_PUBSUBCLIENT_H
@@ -0,0 +1,105 @@
+#ifndef NATIVE_WIFI_H
+#define NATIVE_WIFI_H
+
+// WiFi stand-in for the native build. The link is "up" unless a harness takes
+// it down with WiFi.setLinkUp(false) to simulate an outage.
+//
+// Association takes simulated time: SCAN_CONNECT_MS after a plain begin(),
+// HINTED_CONNECT_MS when begin() is given the access point's channel and
+// BSSID. A hint that no longer matches the access point (see
+// setAccessPoint()) never associates, as on the board.
+
+#include <Arduino.h>
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum {
+    WIFI_OFF = 0,
+    WIFI_STA = 1
+} wifi_mode_t;
+
+class WiFiClass {
+private:
+    static const uint64_t SCAN_CONNECT_MS = 2500;
+    static const uint64_t HINTED_CONNECT_MS = 300;
+    static const uint64_t NEVER = ~0ULL;
+
+    bool started = false;
+    bool linkUp = true;
+    uint64_t associatedAtMicros = 0;
+    uint8_t mac[6] = {0x24, 0x6F, 0x28, 0x00, 0x01, 0x10};
+    int32_t apChannel = 6;
+    uint8_t apBssid[6] = {0x9C, 0x53, 0x22, 0x4A, 0x10, 0x3E};
+    unsigned long associations = 0;
+
+    void associateIn(uint64_t ms) {
+        started = true;
+        associatedAtMicros = ms == NEVER ? NEVER : native::boardClock().microseconds + ms * 1000ULL;
+        associations++;
+    }
+
+public:
+    wl_status_t begin(const char* ssid, const char* passphrase = nullptr) {
+        return begin(ssid, passphrase, 0, nullptr);
+    }
+
+    wl_status_t begin(const char*, const char*, int32_t channel, const uint8_t* bssid, bool connect = true) {
+        if (!connect) return status();
+        if (channel == 0 && bssid == nullptr) {
+            associateIn(SCAN_CONNECT_MS);
+        } else if ((channel == 0 || channel == apChannel) && (bssid == nullptr || memcmp(bssid, apBssid, 6) == 0)) {
+            associateIn(HINTED_CONNECT_MS);
+        } else {
+            associateIn(NEVER);
+        }
+        return status();
+    }
+
+    bool disconnect(bool = false) {
+        started = false;
+        return true;
+    }
+
+    bool mode(wifi_mode_t) { return true; }
+
+    bool reconnect() {
+        associateIn(SCAN_CONNECT_MS);
+        return false;
+    }
+
+    wl_status_t status() {
+        bool up = started && linkUp && native::boardClock().microseconds >= associatedAtMicros;
+        if (up) native::sntp().networkUp();
+        return up ? WL_CONNECTED : WL_DISCONNECTED;
+    }
+
+    int32_t channel() { return status() == WL_CONNECTED ? apChannel : 0; }
+    uint8_t* BSSID() { return status() == WL_CONNECTED ? apBssid : nullptr; }
+
+    uint8_t* macAddress(uint8_t* out) {
+        memcpy(out, mac, sizeof(mac));
+        return out;
+    }
+
+    IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+
+    // Host-only controls
+    void setLinkUp(bool up) { linkUp = up; }
+    void setMacAddress(const uint8_t* address) { memcpy(mac, address, sizeof(mac)); }
+    void setAccessPoint(int32_t channel, const uint8_t* bssid) {
+        apChannel = channel;
+        memcpy(apBssid, bssid, sizeof(apBssid));
+    }
+    unsigned long associationAttempts() const { return associations; }
+};
+
+inline WiFiClass WiFi;
+
+#endif // NATIVE_WIFI_H
@@ -0,0 +1,84 @@
+#ifndef NATIVE_WIFI_CLIENT_SECURE_H
+#define NATIVE_WIFI_CLIENT_SECURE_H
+
+// TLS client stand-in for the native build: a byte pipe to the in-process
+// LoopbackBroker instead of a socket. There is no TLS, so setInsecure() and
+// certificate setters are accepted and ignored.
+
+#include <Arduino.h>
+#include "WiFi.h"
+#include "loopback_broker.h"
+
+class WiFiClientSecure : public Client {
+private:
+    LoopbackBroker* broker = &LoopbackBroker::instance();
+    std::shared_ptr<LoopbackBroker::Session> session;
+
+public:
+    void setInsecure() {}
+    void setBroker(LoopbackBroker* target) { broker = target; }
+
+    int connect(IPAddress, uint16_t port) override { return connect("", port); }
+
+    int connect(const char*, uint16_t) override {
+        stop();
+        if (WiFi.status() != WL_CONNECTED) {
+            return 0;
+        }
+        session = broker->open();
+        return session ? 1 : 0;
+    }
+
+    using Print::write;
+    size_t write(uint8_t c) override { return write(&c, 1); }
+
+    size_t write(const uint8_t* buf, size_t size) override {
+        if (!connected()) return 0;
+        broker->receive(*session, buf, size);
+        return size;
+    }
+
+    int available() override {
+        return session ? (int)session->outbound.size() : 0;
+    }
+
+    int read() override {
+        if (!session || session->outbound.empty()) return -1;
+        uint8_t c = session->outbound.front();
+        session->outbound.pop_front();
+        return c;
+    }
+
+    int read(uint8_t* buf, size_t size) override {
+        size_t n = 0;
+        while (n < size && session && !session->outbound.empty()) {
+            buf[n++] = session->outbound.front();
+            session->outbound.pop_front();
+        }
+        return n > 0 ? (int)n : -1;
+    }
+
+    int peek() override {
+        if (!session || session->outbound.empty()) return -1;
+        return session->outbound.front();
+    }
+
+    void flush() override {}
+
+    void stop() override {
+        if (session) {
+            broker->close(session);
+            session.reset();
+        }
+    }
+
+    uint8_t connected() override {
+        if (!session) return 0;
+        // Unread data keeps the connection readable after the peer closes, like a socket
+        return (session->open && WiFi.status() == WL_CONNECTED) || !session->outbound.empty();
+    }
+
+    operator bool() override { return connected(); }
+};
+
+#endif // NATIVE_WIFI_CLIENT_SECURE_H
@@ -0,0 +1,117 @@
+#ifndef NATIVE_ADS1115_SIM_H
+#define NATIVE_ADS1115_SIM_H
+
+// ADS1115 on an I2C bus for the native build: the registers, the single-shot
+// conversion timing of the data rate, the ALERT/RDY edge at the end of each
+// conversion and the time each transfer holds the bus, all on the simulated
+// board clock. A transfer blocks for its length at the bus clock (9 bits per
+// byte plus start and stop), so driver timing and throughput come out as on
+// the board; the inputs are sampled from a callback when a conversion ends.
+
+#include <Arduino.h>
+#include <functional>
+#include "hal.h"
+#include "ads1115.h"
+
+namespace native {
+
+class Ads1115Sim : public hal::I2cBus {
+private:
+    uint8_t address;
+    uint8_t alertPin;
+    uint32_t clockHz;
+    std::function<float(uint8_t input)> inputVolts;
+    bool present = true;
+
+    uint8_t pointer = 0;
+    uint16_t registers[4] = {0, 0x8583, 0x8000, 0x7FFF};   // Power-on values
+    bool converting = false;
+    std::multimap<uint64_t, std::function<void()>>::iterator completion;
+
+    // Counters
+    unsigned long startCount = 0;
+    unsigned long completedCount = 0;
+    unsigned long ignoredCount = 0;
+    uint64_t busyMicros = 0;
+
+    void transfer(size_t bytes) {
+        uint64_t us = ((bytes + 1) * 9 + 2) * 1000000ULL / clockHz;
+        busyMicros += us;
+        boardClock().advanceMicros(us);
+    }
+
+    void finishConversion(uint16_t config) {
+        converting = false;
+        completedCount++;
+        float volts = inputVolts((config >> 12) & 3);
+        long code = lroundf(volts / ads1115::fullScale((config >> 9) & 7) * 32768.0f);
+        if (code > 32767) code = 32767;
+        if (code < -32768) code = -32768;
+        registers[ads1115::REG_CONVERSION] = (uint16_t)(int16_t)code;
+        registers[ads1115::REG_CONFIG] |= ads1115::CONFIG_OS;
+        // Conversion-ready mode: high threshold MSB set, low threshold MSB clear, comparator on
+        bool readyMode = (registers[ads1115::REG_HI_THRESH] & 0x8000) && !(registers[ads1115::REG_LO_THRESH] & 0x8000) &&
+                         (config & ads1115::CONFIG_COMP_QUE_MASK) != ads1115::CONFIG_COMP_QUE_MASK;
+        if (readyMode) raiseInterrupt(alertPin);
+    }
+
+    void writeConfig(uint16_t value) {
+        if (!(value & ads1115::CONFIG_OS)) {
+            registers[ads1115::REG_CONFIG] = value;
+            return;
+        }
+        if (converting) {
+            ignoredCount++;   // The device only starts a conversion when idle
+            return;
+        }
+        registers[ads1115::REG_CONFIG] = value & ~ads1115::CONFIG_OS;
+        converting = true;
+        startCount++;
+        uint64_t done = boardClock().microseconds + ads1115::conversionMicros((value >> 5) & 7);
+        completion = boardClock().events.emplace(done, [this, value]() { finishConversion(value); });
+    }
+
+public:
+    Ads1115Sim(uint8_t i2cAddress, uint8_t alertGpio, uint32_t busHz, std::function<float(uint8_t)> volts)
+        : address(i2cAddress), alertPin(alertGpio), clockHz(busHz), inputVolts(std::move(volts)) {}
+
+    ~Ads1115Sim() {
+        if (converting) boardClock().events.erase(completion);
+    }
+
+    // An absent device NACKs its address
+    void setPresent(bool answering) { present = answering; }
+
+    bool write(uint8_t to, const uint8_t* data, size_t length) override {
+        transfer(present && to == address ? length : 0);
+        if (!present || to != address || length == 0) return false;
+        pointer = data[0] & 3;
+        if (length >= 3) {
+            uint16_t value = (uint16_t)((data[1] << 8) | data[2]);
+            if (pointer == ads1115::REG_CONFIG) {
+                writeConfig(value);
+            } else if (pointer != ads1115::REG_CONVERSION) {
+                registers[pointer] = value;
+            }
+        }
+        return true;
+    }
+
+    bool read(uint8_t from, uint8_t* data, size_t length) override {
+        // Latched at the start of the transfer
+        uint16_t value = registers[pointer];
+        transfer(present && from == address ? length : 0);
+        if (!present || from != address) return false;
+        for (size_t i = 0; i < length; i++) data[i] = i % 2 == 0 ? (uint8_t)(value >> 8) : (uint8_t)value;
+        return true;
+    }
+
+    unsigned long started() const { return startCount; }
+    unsigned long completed() const { return completedCount; }
+    unsigned long ignoredStarts() const { return ignoredCount; }
+    uint64_t busMicros() const { return busyMicros; }
+};
+
+}  // namespace native
+
+#endif // NATIVE_ADS1115_SIM_H
@@ -0,0 +1,75 @@
+#ifndef NATIVE_FLASH_EMULATOR_H
+#define NATIVE_FLASH_EMULATOR_H
+
+// NOR flash stand-in for the native build: erased bytes read 0xFF, writes can
+// only clear bits, and erases are counted per sector so wear can be inspected.
+// Optionally backed by a file so the contents survive between host runs.
+
+#include <Arduino.h>
+#include <vector>
+#include "reading_log.h"
+
+namespace native {
+
+class FlashEmulator : public LogStorage {
+private:
+    std::vector<uint8_t> bytes;
+    std::vector<uint32_t> erases;
+    size_t sector;
+    std::string path;
+
+    void persist() {
+        if (path.empty()) return;
+        FILE* file = fopen(path.c_str(), "wb");
+        if (file == nullptr) return;
+        fwrite(bytes.data(), 1, bytes.size(), file);
+        fclose(file);
+    }
+
+public:
+    FlashEmulator(size_t totalSize, size_t sectorBytes)
+        : bytes(totalSize, 0xFF), erases(totalSize / sectorBytes, 0), sector(sectorBytes) {}
+
+    // Loads the image from path (if present) and writes every change back to it
+    void attachFile(const char* imagePath) {
+        path = imagePath;
+        FILE* file = fopen(imagePath, "rb");
+        if (file == nullptr) return;
+        size_t n = fread(bytes.data(), 1, bytes.size(), file);
+        (void)n;
+        fclose(file);
+    }
+
+    size_t size() override { return bytes.size(); }
+    size_t sectorSize() override { return sector; }
+
+    bool read(size_t offset, void* data, size_t length) override {
+        if (offset + length > bytes.size()) return false;
+        memcpy(data, bytes.data() + offset, length);
+        return true;
+    }
+
+    bool write(size_t offset, const void* data, size_t length) override {
+        if (offset + length > bytes.size()) return false;
+        const uint8_t* src = (const uint8_t*)data;
+        for (size_t i = 0; i < length; i++) {
+            bytes[offset + i] &= src[i];
+        }
+        persist();
+        return true;
+    }
+
+    bool eraseSector(size_t index) override {
+        if (index >= erases.size()) return false;
+        memset(bytes.data() + index * sector, 0xFF, sector);
+        erases[index]++;
+        persist();
+        return true;
+    }
+
+    uint32_t eraseCount(size_t index) const { return erases[index]; }
+};
+
+}  // namespace native
+
+#endif // NATIVE_FLASH_EMULATOR_H
@@ -0,0 +1,345 @@
+#ifndef NATIVE_LOOPBACK_BROKER_H
+#define NATIVE_LOOPBACK_BROKER_H
+
+// In-process MQTT 3.1.1 broker stand-in for the native build.
+// Speaks the wire protocol (CONNECT, PUBLISH QoS 0/1, SUBSCRIBE, PINGREQ,
+// DISCONNECT) to WiFiClientSecure stand-ins, so the firmware's MQTT code runs
+// unmodified on the host. Subscriptions match exact topics or a trailing '#'.
+// Subscribers are indexed by filter, so a publish costs the same with one
+// client or thousands (fleet_sim). setFaults() makes the link lossy and slow:
+// PUBLISH packets and PUBACKs are lost at random (seeded, so runs repeat) and
+// acks reach the client later on the board clock, out of order with jitter.
+
+#include <Arduino.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class LoopbackBroker {
+public:
+    struct Session {
+        bool open = true;
+        std::string clientId;
+        std::vector<uint8_t> inbound;   // bytes from the client not yet parsed
+        std::deque<uint8_t> outbound;   // bytes waiting to be read by the client
+        std::vector<std::string> subscriptions;
+        uint64_t lastDelivery = 0;      // deliver() call that last wrote to it
+    };
+
+    typedef std::function<void(const std::string& topic, const uint8_t* payload, size_t length)> PublishHandler;
+
+    struct Faults {
+        double publishLoss = 0.0;       // Share of PUBLISH packets from clients that never arrive
+        double ackLoss = 0.0;           // Share of PUBACKs that never reach the client
+        unsigned long latencyMs = 0;    // Delay of each PUBACK
+        unsigned long jitterMs = 0;     // Plus up to this much, uniformly
+    };
+
+private:
+    std::unordered_map<Session*, std::shared_ptr<Session>> sessions;
+    std::unordered_map<std::string, std::unordered_set<Session*>> subscribers;  // by filter
+    std::set<std::string> wildcards;    // Filters ending in '#'
+    uint64_t deliveries = 0;
+    PublishHandler publishHandler;
+
+    bool online = true;
+    bool logPublishes = false;
+
+    unsigned long connectCount = 0;
+    unsigned long publishCount = 0;
+    unsigned long long payloadBytes = 0;
+
+    Faults faults;
+    std::mt19937 faultRandom;
+    unsigned long lostPublishCount = 0;
+    unsigned long lostAckCount = 0;
+    unsigned long duplicateCount = 0;
+
+    bool chance(double probability) {
+        return probability > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(faultRandom) < probability;
+    }
+
+    static void pushPuback(Session& session, uint16_t packetId) {
+        const uint8_t puback[] = {0x40, 0x02, (uint8_t)(packetId >> 8), (uint8_t)(packetId & 0xFF)};
+        session.outbound.insert(session.outbound.end(), puback, puback + sizeof(puback));
+    }
+
+    // Sends a PUBACK now, or after the injected latency if the session is still open then
+    void acknowledge(Session& session, uint16_t packetId) {
+        if (chance(faults.ackLoss)) {
+            lostAckCount++;
+            return;
+        }
+        unsigned long delayMs = faults.latencyMs;
+        if (faults.jitterMs > 0) {
+            delayMs += std::uniform_int_distribution<unsigned long>(0, faults.jitterMs)(faultRandom);
+        }
+        auto found = sessions.find(&session);
+        if (delayMs == 0 || found == sessions.end()) {
+            pushPuback(session, packetId);
+            return;
+        }
+        std::weak_ptr<Session> target = found->second;
+        native::BoardClock& clock = native::boardClock();
+        clock.schedule(clock.microseconds + delayMs * 1000ULL, [target, packetId]() {
+            std::shared_ptr<Session> later = target.lock();
+            if (later && later->open) pushPuback(*later, packetId);
+        });
+    }
+
+    // Text payloads are printed as-is, binary ones as a hex dump
+    static void logPayload(const std::string& topic, const uint8_t* payload, size_t length) {
+        bool text = true;
+        for (size_t i = 0; i < length && text; i++) {
+            text = payload[i] >= 0x20 && payload[i] < 0x7F;
+        }
+        if (text) {
+            printf("[broker] %s %.*s\n", topic.c_str(), (int)length, (const char*)payload);
+            return;
+        }
+        printf("[broker] %s (%zu bytes)", topic.c_str(), length);
+        for (size_t i = 0; i < length; i++) {
+            printf(" %02x", payload[i]);
+        }
+        printf("\n");
+    }
+
+    static bool topicMatches(const std::string& filter, const std::string& topic) {
+        if (!filter.empty() && filter.back() == '#') {
+            return topic.compare(0, filter.size() - 1, filter, 0, filter.size() - 1) == 0;
+        }
+        return filter == topic;
+    }
+
+    static void appendRemainingLength(std::deque<uint8_t>& out, size_t length) {
+        do {
+            uint8_t digit = length % 128;
+            length /= 128;
+            if (length > 0) digit |= 0x80;
+            out.push_back(digit);
+        } while (length > 0);
+    }
+
+    static uint16_t readU16(const uint8_t* p) {
+        return (uint16_t)((p[0] << 8) | p[1]);
+    }
+
+    // Each matching session gets the message once, however many of its filters match
+    void deliver(const std::string& topic, const uint8_t* payload, size_t length) {
+        deliveries++;
+        auto send = [&](Session* session) {
+            if (!session->open || session->lastDelivery == deliveries) return;
+            session->lastDelivery = deliveries;
+            std::deque<uint8_t>& out = session->outbound;
+            out.push_back(0x30);
+            appendRemainingLength(out, 2 + topic.size() + length);
+            out.push_back((uint8_t)(topic.size() >> 8));
+            out.push_back((uint8_t)(topic.size() & 0xFF));
+            out.insert(out.end(), topic.begin(), topic.end());
+            out.insert(out.end(), payload, payload + length);
+        };
+        auto exact = subscribers.find(topic);
+        if (exact != subscribers.end()) {
+            for (Session* session : exact->second) send(session);
+        }
+        for (const std::string& filter : wildcards) {
+            if (!topicMatches(filter, topic)) continue;
+            for (Session* session : subscribers[filter]) send(session);
+        }
+    }
+
+    void unsubscribeAll(Session& session) {
+        for (const std::string& filter : session.subscriptions) {
+            auto found = subscribers.find(filter);
+            if (found == subscribers.end()) continue;
+            found->second.erase(&session);
+            if (found->second.empty()) {
+                subscribers.erase(found);
+                wildcards.erase(filter);
+            }
+        }
+    }
+
+    void handlePacket(Session& session, uint8_t header, const uint8_t* body, size_t length) {
+        switch (header >> 4) {
+            case 1: {  // CONNECT
+                // Variable header is 10 bytes, then the client id string
+                if (length >= 12) {
+                    uint16_t idLength = readU16(body + 10);
+                    if (12 + (size_t)idLength <= length) {
+                        session.clientId.assign((const char*)body + 12, idLength);
+                    }
+                }
+                connectCount++;
+                const uint8_t connack[] = {0x20, 0x02, 0x00, 0x00};
+                session.outbound.insert(session.outbound.end(), connack, connack + sizeof(connack));
+                break;
+            }
+            case 3: {  // PUBLISH
+                uint8_t qos = (header >> 1) & 0x03;
+                if (length < 2) break;
+                uint16_t topicLength = readU16(body);
+                size_t offset = 2 + topicLength;
+                uint16_t packetId = 0;
+                if (qos > 0) {
+                    if (offset + 2 > length) break;
+                    packetId = readU16(body + offset);
+                    offset += 2;
+                }
+                if (offset > length) break;
+                if (chance(faults.publishLoss)) {
+                    lostPublishCount++;
+                    break;
+                }
+                if (header & 0x08) {
+                    duplicateCount++;
+                }
+
+                std::string topic((const char*)body + 2, topicLength);
+                publishCount++;
+                payloadBytes += length - offset;
+
+                if (logPublishes) {
+                    logPayload(topic, body + offset, length - offset);
+                }
+                if (publishHandler) {
+                    publishHandler(topic, body + offset, length - offset);
+                }
+                deliver(topic, body + offset, length - offset);
+
+                if (qos == 1) {
+                    acknowledge(session, packetId);
+                }
+                break;
+            }
+            case 8: {  // SUBSCRIBE
+                if (length < 2) break;
+                uint16_t packetId = readU16(body);
+                std::vector<uint8_t> granted;
+                size_t offset = 2;
+                while (offset + 2 <= length) {
+                    uint16_t topicLength = readU16(body + offset);
+                    offset += 2;
+                    if (offset + topicLength + 1 > length) break;
+                    std::string filter((const char*)body + offset, topicLength);
+                    session.subscriptions.push_back(filter);
+                    subscribers[filter].insert(&session);
+                    if (!filter.empty() && filter.back() == '#') wildcards.insert(filter);
+                    offset += topicLength;
+                    granted.push_back(body[offset] > 1 ? 1 : body[offset]);
+                    offset++;
+                }
+                session.outbound.push_back(0x90);
+                appendRemainingLength(session.outbound, 2 + granted.size());
+                session.outbound.push_back((uint8_t)(packetId >> 8));
+                session.outbound.push_back((uint8_t)(packetId & 0xFF));
+                session.outbound.insert(session.outbound.end(), granted.begin(), granted.end());
+                break;
+            }
+            case 12: {  // PINGREQ
+                session.outbound.push_back(0xD0);
+                session.outbound.push_back(0x00);
+                break;
+            }
+            case 14: {  // DISCONNECT
+                session.open = false;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+public:
+    static LoopbackBroker& instance() {
+        static LoopbackBroker broker;
+        return broker;
+    }
+
+    // Take the broker down (drops every session) or bring it back up
+    void setOnline(bool up) {
+        online = up;
+        if (!up) {
+            for (auto& entry : sessions) {
+                entry.second->open = false;
+            }
+            sessions.clear();
+            subscribers.clear();
+            wildcards.clear();
+        }
+    }
+    bool isOnline() const { return online; }
+
+    void setLogPublishes(bool enabled) { logPublishes = enabled; }
+
+    void setFaults(const Faults& injected, uint32_t seed = 1) {
+        faults = injected;
+        faultRandom.seed(seed);
+    }
+    void onPublish(PublishHandler handler) { publishHandler = handler; }
+
+    // Host-side publish, delivered to subscribed clients (e.g. a command)
+    void publish(const std::string& topic, const char* payload) {
+        deliver(topic, (const uint8_t*)payload, strlen(payload));
+    }
+
+    unsigned long connects() const { return connectCount; }
+    unsigned long publishes() const { return publishCount; }
+    unsigned long long publishedPayloadBytes() const { return payloadBytes; }
+    unsigned long lostPublishes() const { return lostPublishCount; }
+    unsigned long lostAcks() const { return lostAckCount; }
+    unsigned long duplicatePublishes() const { return duplicateCount; }
+    size_t sessionCount() const { return sessions.size(); }
+
+    std::shared_ptr<Session> open() {
+        if (!online) {
+            return nullptr;
+        }
+        std::shared_ptr<Session> session = std::make_shared<Session>();
+        sessions[session.get()] = session;
+        return session;
+    }
+
+    void close(const std::shared_ptr<Session>& session) {
+        if (!session) return;
+        session->open = false;
+        if (sessions.erase(session.get()) > 0) {
+            unsubscribeAll(*session);
+        }
+    }
+
+    // Feed bytes written by a client; complete packets are handled immediately
+    void receive(Session& session, const uint8_t* data, size_t length) {
+        session.inbound.insert(session.inbound.end(), data, data + length);
+
+        while (session.open && session.inbound.size() >= 2) {
+            size_t remaining = 0;
+            size_t multiplier = 1;
+            size_t index = 1;
+            bool complete = false;
+            while (index < session.inbound.size() && index <= 4) {
+                uint8_t digit = session.inbound[index++];
+                remaining += (digit & 0x7F) * multiplier;
+                multiplier *= 128;
+                if ((digit & 0x80) == 0) {
+                    complete = true;
+                    break;
+                }
+            }
+            if (!complete || session.inbound.size() < index + remaining) {
+                return;
+            }
+
+            handlePacket(session, session.inbound[0], session.inbound.data() + index, remaining);
+            session.inbound.erase(session.inbound.begin(), session.inbound.begin() + index + remaining);
+        }
+    }
+};
+
+#endif // NATIVE_LOOPBACK_BROKER_H
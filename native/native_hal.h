@@ -0,0 +1,97 @@
+#ifndef NATIVE_HAL_H
+#define NATIVE_HAL_H
+
+// Host-side implementations of the hal interfaces.
+
+#include <string>
+#include <vector>
+#include "hal.h"
+#include "config.h"
+
+namespace native {
+
+// Replays raw ADC codes from a CSV trace with one column per channel
+// (ph,tds,turbidity,temperature). By default each full sweep of the four
+// channels consumes one row; reading a pin a second time moves to the next row.
+// With setRowPeriod() the row is chosen by board time instead, so any number of
+// reads inside one period (e.g. oversampling) see the same recorded values, and
+// a synthetic kHz trace can be played with a 1000 us period.
+// The trace wraps around at the end so runs can be longer than the recording.
+class ReplayAdc : public hal::AdcSource {
+private:
+    static const int CHANNELS = 4;
+    std::vector<int> samples;   // row-major, CHANNELS codes per row
+    size_t row = 0;
+    bool readThisRow[CHANNELS] = {false, false, false, false};
+    unsigned long rowPeriodMicros = 0;
+
+    static int channelOf(uint8_t pin) {
+        switch (pin) {
+            case PH_PIN: return 0;
+            case TDS_PIN: return 1;
+            case TURBIDITY_PIN: return 2;
+            case TEMP_PIN: return 3;
+            default: return -1;
+        }
+    }
+
+public:
+    // Loads a trace; returns false if the file is missing or has no data rows
+    bool load(const char* path) {
+        FILE* file = fopen(path, "r");
+        if (file == nullptr) {
+            return false;
+        }
+        samples.clear();
+        char line[128];
+        while (fgets(line, sizeof(line), file)) {
+            int ph, tds, turbidity, temp;
+            if (sscanf(line, "%d,%d,%d,%d", &ph, &tds, &turbidity, &temp) == 4) {
+                samples.push_back(ph);
+                samples.push_back(tds);
+                samples.push_back(turbidity);
+                samples.push_back(temp);
+            }
+        }
+        fclose(file);
+        rewind();
+        return !samples.empty();
+    }
+
+    void addRow(int ph, int tds, int turbidity, int temp) {
+        samples.push_back(ph);
+        samples.push_back(tds);
+        samples.push_back(turbidity);
+        samples.push_back(temp);
+    }
+
+    void rewind() {
+        row = 0;
+        for (int i = 0; i < CHANNELS; i++) readThisRow[i] = false;
+    }
+
+    size_t rows() const { return samples.size() / CHANNELS; }
+
+    // 0 selects sweep-driven replay
+    void setRowPeriod(unsigned long micros) { rowPeriodMicros = micros; }
+
+    int read(uint8_t pin) override {
+        int channel = channelOf(pin);
+        if (channel < 0 || samples.empty()) {
+            return 0;
+        }
+        if (rowPeriodMicros > 0) {
+            return samples[((::micros() / rowPeriodMicros) % rows()) * CHANNELS + channel];
+        }
+        if (readThisRow[channel]) {
+            row = (row + 1) % rows();
+            for (int i = 0; i < CHANNELS; i++) readThisRow[i] = false;
+        }
+        readThisRow[channel] = true;
+        return samples[row * CHANNELS + channel];
+    }
+};
+
+}  // namespace native
+
+#endif // NATIVE_HAL_H
@@ -0,0 +1,587 @@
+// Per-stage cost of the acquisition loop on the host.
+// Drives readSensors(), calculateAverages(), printReadings() and
+// publishWaterData() with a recorded ADC trace and reports the latency
+// distribution, heap allocations and console bytes of each stage. Console
+// bytes are also converted to the time the same output holds the UART at
+// SERIAL_BAUD_RATE on the board (10 bits per byte, 240 MHz core clock); with
+// LOG_BUFFERED that UART time is spent by the console drain between stages,
+// not by the stage itself, and the stage time is the cost of buffering.
+// With ADC_OVERSAMPLING the background capture of each SAMPLE_INTERVAL is
+// reported as its own stage, since it runs off the loop on the board.
+// Before timing anything the conversion lookup tables are checked bit-exact
+// against the float path, and both kernels are timed over every ADC code.
+// The averaged readings are also encoded as single JSON messages and as JSON
+// and binary batches to compare message counts and bytes on the wire; binary
+// batches are decoded again and must round-trip at the published precision.
+// The allocation-free JSON writer is checked byte for byte against the
+// snprintf formatting it replaced, and both are timed per message.
+// Calibration is checked against traces/calibration_reference.csv: its cal
+// rows go through the command parser, every check row through the sampling
+// path (calibration tables and TDS temperature compensation), and the
+// calibrated readSensors() is timed next to the factory one.
+// Last, an ADS1115 scanning four inputs is run against the I2C bus model for
+// ADC_SCAN_SECONDS of board time at two bus clocks, with and without
+// pipelined conversions, reporting throughput and bus occupancy; every sweep
+// must return the codes of the voltages applied to the inputs.
+//
+//   usage: program [trace.csv] [iterations] [--csv]
+
+#include <Arduino.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <vector>
+#include "config.h"
+#include "sensors.h"
+#include "mqtt_client.h"
+#include "wifi_manager.h"
+#include "adc_oversampler.h"
+#include "ads1115.h"
+#include "ads1115_sim.h"
+#include "calibration.h"
+#include "command_handler.h"
+#include "conversion_tables.h"
+#include "payload_codec.h"
+#include "native_hal.h"
+
+extern WaterSensors waterSensors;
+extern WiFiManager wifiManager;
+extern MQTTClient mqttClient;
+#if ADC_OVERSAMPLING
+extern OversamplingAdc<ONCHIP_CHANNEL_COUNT, ADC_OVERSAMPLE_RING_BLOCKS> oversampledAdc;
+#endif
+void calculateAverages();
+
+static unsigned long long allocationCount = 0;
+
+void* operator new(size_t size) {
+    allocationCount++;
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+namespace {
+
+const double CPU_HZ = 240e6;
+
+// Bytes the stages wrote to the console
+uint64_t consoleTotal() {
+#if LOG_BUFFERED
+    return hal::consoleBytes();
+#else
+    return Serial.totalBytesWritten();
+#endif
+}
+
+struct StageStats {
+    const char* name;
+    std::vector<uint32_t> nanos;
+    unsigned long long allocations = 0;
+    unsigned long long consoleBytes = 0;
+
+    explicit StageStats(const char* stageName) : name(stageName) {}
+
+    template <typename Fn>
+    void measure(Fn fn) {
+        unsigned long long allocsBefore = allocationCount;
+        uint64_t bytesBefore = consoleTotal();
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        allocations += allocationCount - allocsBefore;
+        nanos.push_back((uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        consoleBytes += consoleTotal() - bytesBefore;
+        hal::flushConsole();
+    }
+
+    uint32_t percentile(double p) const {
+        std::vector<uint32_t> sorted(nanos);
+        std::sort(sorted.begin(), sorted.end());
+        size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+        return sorted[index];
+    }
+
+    void report(bool csv) const {
+        if (nanos.empty()) return;
+        size_t calls = nanos.size();
+        double uartSeconds = (double)consoleBytes / calls * 10.0 / SERIAL_BAUD_RATE;
+        if (csv) {
+            printf("%s,%zu,%.3f,%.3f,%.3f,%.2f,%.1f,%.3f\n", name, calls,
+                   percentile(0.5) / 1000.0, percentile(0.99) / 1000.0,
+                   *std::max_element(nanos.begin(), nanos.end()) / 1000.0,
+                   (double)allocations / calls, (double)consoleBytes / calls, uartSeconds * 1000.0);
+            return;
+        }
+        printf("%-20s %8zu %10.3f %10.3f %10.3f %8.2f %8.1f %10.3f %14.0f\n", name, calls,
+               percentile(0.5) / 1000.0, percentile(0.99) / 1000.0,
+               *std::max_element(nanos.begin(), nanos.end()) / 1000.0,
+               (double)allocations / calls, (double)consoleBytes / calls,
+               uartSeconds * 1000.0, uartSeconds * CPU_HZ);
+    }
+};
+
+// Bytes one QoS 0 publish costs on a TLS 1.2 AES-GCM connection: MQTT fixed
+// header, topic and payload in one record (5 header + 8 nonce + 16 tag)
+size_t wireBytes(const char* topic, size_t payloadLength) {
+    size_t remaining = 2 + strlen(topic) + payloadLength;
+    size_t lengthBytes = remaining < 128 ? 1 : (remaining < 16384 ? 2 : 3);
+    return 1 + lengthBytes + remaining + 29;
+}
+
+// The single-reading message as it was built before JsonWriter (gmtime, a
+// String for the timestamp and printf float formatting); the reference the
+// allocation-free path must match byte for byte
+size_t legacyWaterData(char* json, size_t size, const char* deviceId, const WaterReading& reading) {
+    time_t now = reading.timestamp;
+    now += 19800;
+    struct tm *timInf = gmtime(&now);
+    char timeStr[96];  // Room for any int field, so the format can never truncate
+    snprintf(timeStr, sizeof(timeStr), "%04d-%02d-%02dT%02d:%02d:%02d.000+00:00",
+             timInf->tm_year + 1900, timInf->tm_mon + 1, timInf->tm_mday,
+             timInf->tm_hour, timInf->tm_min, timInf->tm_sec);
+    String time = String(timeStr);
+    return (size_t)snprintf(json, size,
+                            "{\"deviceId\":\"%s\",\"timestamp\":\"%s\",\"ph\":%.2f,\"tds\":%.1f,\"turbidity\":%.2f,\"temperature\":%.1f}",
+                            deviceId, time.c_str(), reading.values[CH_PH], reading.values[CH_TDS],
+                            reading.values[CH_TURBIDITY], reading.values[CH_TEMPERATURE]);
+}
+
+size_t writerWaterData(char* json, size_t size, const WaterReading& reading) {
+    return mqttClient.formatWaterData(json, size, reading);
+}
+
+// Compares both formatters over every converted ADC code of every channel and
+// a spread of timestamps; returns the number of differing messages
+int verifyJsonWriter() {
+    int mismatches = 0;
+    char expected[256], actual[256];
+    for (int raw = 0; raw < conversion::ADC_CODES; raw++) {
+        WaterReading reading;
+        reading.timestamp = 1700000000UL + (uint32_t)raw * 86413UL;
+        reading.values[CH_PH] = conversion::PH_TABLE[raw];
+        reading.values[CH_TDS] = conversion::TDS_TABLE[raw];
+        reading.values[CH_TURBIDITY] = conversion::TURBIDITY_TABLE[raw];
+        reading.values[CH_TEMPERATURE] = conversion::TEMPERATURE_TABLE[raw];
+        legacyWaterData(expected, sizeof(expected), "ESP32_000110", reading);
+        writerWaterData(actual, sizeof(actual), reading);
+        if (strcmp(expected, actual) != 0) {
+            if (mismatches++ == 0) {
+                fprintf(stderr, "expected %s\n     got %s\n", expected, actual);
+            }
+        }
+    }
+    return mismatches;
+}
+
+struct PayloadStats {
+    const char* name;
+    unsigned long messages = 0;
+    unsigned long long payloadBytes = 0;
+    unsigned long long wire = 0;
+
+    explicit PayloadStats(const char* formatName) : name(formatName) {}
+
+    void add(const char* topic, size_t length) {
+        messages++;
+        payloadBytes += length;
+        wire += wireBytes(topic, length);
+    }
+
+    void report(bool csv, size_t readings) const {
+        double hours = readings * (MQTT_PUBLISH_INTERVAL / 1000.0) / 3600.0;
+        if (csv) {
+            printf("%s,%.1f,%.1f,%.0f\n", name, messages / hours, (double)payloadBytes / readings, wire / hours);
+            return;
+        }
+        printf("%-20s %10.1f %14.1f %14.0f\n", name, messages / hours, (double)payloadBytes / readings, wire / hours);
+    }
+};
+
+// ns per conversion of all four channels, over every 12-bit code
+template <typename Fn>
+double timeKernel(Fn convert) {
+    const int rounds = 200;
+    volatile float sink = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (volatile int raw = 0; raw < conversion::ADC_CODES; raw++) {
+            sink = sink + convert(raw);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (rounds * conversion::ADC_CODES);
+}
+
+const char* const CALIBRATION_REFERENCE = "traces/calibration_reference.csv";
+
+struct ReferenceRow {
+    std::string channel, use, fit;
+    float temperature, volts, reference, tolerance;
+};
+
+// Calibrates from the cal rows of the reference set (one command per channel,
+// through CommandHandler) and converts each check row on a fresh WaterSensors.
+// Returns the number of checks out of tolerance, -1 if the set is unusable.
+int checkCalibration(const char* path, Calibration& calibration, size_t& checked) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) return -1;
+    std::vector<ReferenceRow> rows;
+    char line[160];
+    while (fgets(line, sizeof(line), file)) {
+        char channel[24], use[8], fit[8];
+        ReferenceRow row{};
+        if (line[0] == '#' || sscanf(line, "%23[^,],%7[^,],%7[^,]", channel, use, fit) < 2) continue;
+        // The fit column is often empty, which %[^,] does not match
+        const char* rest = strchr(strchr(line, ',') + 1, ',') + 1;
+        if (*rest == ',') fit[0] = '\0';
+        rest = strchr(rest, ',') + 1;
+        if (sscanf(rest, "%f,%f,%f,%f", &row.temperature, &row.volts, &row.reference, &row.tolerance) < 3) continue;
+        row.channel = channel;
+        row.use = use;
+        row.fit = fit;
+        rows.push_back(row);
+    }
+    fclose(file);
+
+    Settings settings;
+    CommandHandler handler(settings, calibration);
+    for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        std::string command = std::string("cal_") + CHANNELS[c].key + "=";
+        bool any = false;
+        for (const ReferenceRow& row : rows) {
+            if (row.channel != CHANNELS[c].key || row.use != "cal") continue;
+            if (!any && !row.fit.empty()) command += row.fit + "/";
+            char point[48];
+            snprintf(point, sizeof(point), "%s%.4f:%.*f", any ? "/" : "", row.volts, CHANNELS[c].decimals + 1,
+                     row.reference);
+            command += point;
+            any = true;
+        }
+        if (!any) continue;
+        handler.handle(command.c_str(), command.size());
+        if (strcmp(handler.lastResult(), "ok") != 0) {
+            fprintf(stderr, "%s: %s\n", command.c_str(), handler.lastResult());
+            return -1;
+        }
+    }
+
+    hal::AdcSource* previous = hal::adcSource;
+    int failures = 0;
+    checked = 0;
+    for (const ReferenceRow& row : rows) {
+        if (row.use != "check") continue;
+        int channel = -1;
+        for (size_t c = 0; c < STANDARD_CHANNEL_COUNT; c++) {
+            if (row.channel == CHANNELS[c].key) channel = (int)c;
+        }
+        if (channel < 0 || CHANNELS[channel].bus != ADC_BUS_ONCHIP) continue;
+        // Readings away from 25 C only hold with compensation built in
+        if (CHANNELS[channel].temperatureCoefficient == 0.0f && row.temperature != 25.0f) continue;
+        // The check voltage on its channel, the temperature probe at row.temperature
+        int codes[4] = {0, 0, 0, 0};
+        codes[channel] = (int)lroundf(row.volts / (VOLTAGE_REF / ADC_RESOLUTION));
+        float temperatureVolts = TEMP_30_VOLTAGE + (row.temperature - 30.0f) / 15.0f * (TEMP_45_VOLTAGE - TEMP_30_VOLTAGE);
+        codes[CH_TEMPERATURE] = (int)lroundf(temperatureVolts / (VOLTAGE_REF / ADC_RESOLUTION));
+        native::ReplayAdc replay;
+        replay.addRow(codes[0], codes[1], codes[2], codes[3]);
+        hal::setAdcSource(&replay);
+        WaterSensors sensors;
+        sensors.setCalibration(calibration);
+        sensors.readSensors();
+        float value = sensors.value(channel);
+        checked++;
+        if (fabsf(value - row.reference) > row.tolerance) {
+            fprintf(stderr, "%s at %.4f V, %.1f C: %.3f, reference %.3f +/- %.3f\n", row.channel.c_str(),
+                    row.volts, row.temperature, value, row.reference, row.tolerance);
+            failures++;
+        }
+    }
+    hal::setAdcSource(previous);
+    return failures;
+}
+
+const unsigned long ADC_SCAN_SECONDS = 10;
+
+struct ScanStats {
+    uint32_t busHz;
+    bool pipelined;
+    double conversionsPerSecond = 0;
+    double busShare = 0;          // Fraction of board time the bus was busy
+    double scanMicros = 0;        // Board time per four-input scan
+    unsigned long ignoredStarts = 0;
+    uint32_t busErrors = 0;
+    bool exact = true;            // Every sweep returned the applied codes
+
+    void report(bool csv) const {
+        if (csv) {
+            printf("%lu,%d,%.1f,%.1f,%.3f,%lu,%lu,%d\n", (unsigned long)busHz, pipelined ? 1 : 0,
+                   conversionsPerSecond, scanMicros, busShare, ignoredStarts, (unsigned long)busErrors, exact ? 1 : 0);
+            return;
+        }
+        printf("%4lu kHz %-10s %10.1f %10.1f %8.1f%% %8lu %8lu\n", (unsigned long)busHz / 1000,
+               pipelined ? "pipelined" : "sequential", conversionsPerSecond, scanMicros, busShare * 100.0,
+               ignoredStarts, (unsigned long)busErrors);
+    }
+};
+
+// Four inputs at ADS1115_PGA and 860 samples/s, one sweep per SAMPLE_INTERVAL
+ScanStats runScan(uint32_t busHz, bool pipelined, uint8_t alertPin) {
+    static const uint8_t inputs[4] = {0, 1, 2, 3};
+    static const float volts[4] = {1.58f, 0.91f, 0.12f, 0.63f};
+    native::Ads1115Sim sim(ADS1115_ADDRESS, alertPin, busHz, [](uint8_t input) { return volts[input]; });
+    hal::setI2cBus(&sim);
+    Ads1115<4, 1024> adc(inputs, ADS1115_ADDRESS, alertPin, ADS1115_PGA, 7, pipelined);
+    ScanStats stats{busHz, pipelined};
+    uint64_t start = native::boardClock().microseconds;
+    stats.exact = adc.begin();
+    uint32_t startConversions = 0;
+    for (unsigned long ms = 0; ms < ADC_SCAN_SECONDS * 1000UL; ms += SAMPLE_INTERVAL) {
+        native::boardClock().advanceMillis(SAMPLE_INTERVAL);
+        adc.beginSweep();
+        if (ms == 0) {
+            startConversions = adc.conversions();   // The first sweep includes the start-up
+            start = native::boardClock().microseconds;
+            continue;
+        }
+        for (uint8_t i = 0; i < 4; i++) {
+            long expected = lroundf(volts[i] / adc.voltsPerCode());
+            stats.exact = stats.exact && labs(adc.read(i) - expected) <= 1;
+        }
+    }
+    adc.end();
+    double seconds = (native::boardClock().microseconds - start) / 1e6;
+    stats.conversionsPerSecond = (adc.conversions() - startConversions) / seconds;
+    stats.scanMicros = 4e6 / stats.conversionsPerSecond;
+    stats.busShare = sim.busMicros() / 1e6 / (ADC_SCAN_SECONDS * SAMPLE_INTERVAL / 1000.0);
+    stats.ignoredStarts = sim.ignoredStarts();
+    stats.busErrors = adc.busErrors();
+    hal::setI2cBus(nullptr);
+    return stats;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const char* tracePath = "traces/reservoir_bench.csv";
+    unsigned long iterations = 10000;
+    bool csv = false;
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0) {
+            csv = true;
+        } else if (positional++ == 0) {
+            tracePath = argv[i];
+        } else {
+            iterations = strtoul(argv[i], nullptr, 10);
+        }
+    }
+
+    int mismatches = conversion::verifyTables();
+    if (mismatches != 0) {
+        fprintf(stderr, "Conversion tables differ from the float path in %d entries\n", mismatches);
+        return 1;
+    }
+    double floatNs = timeKernel([](int raw) {
+        float v = conversion::rawToVoltage(raw);
+        return conversion::voltageToPH(v) + conversion::voltageToTDS(v) +
+               conversion::voltageToTurbidity(v) + conversion::voltageToTemperature(v);
+    });
+    double tableNs = timeKernel([](int raw) {
+        int i = conversion::tableIndex(raw);
+        return conversion::PH_TABLE[i] + conversion::TDS_TABLE[i] +
+               conversion::TURBIDITY_TABLE[i] + conversion::TEMPERATURE_TABLE[i];
+    });
+
+    int jsonMismatches = verifyJsonWriter();
+    if (jsonMismatches != 0) {
+        fprintf(stderr, "JsonWriter output differs from snprintf in %d messages\n", jsonMismatches);
+        return 1;
+    }
+
+    static Calibration referenceCalibration;
+    size_t calibrationChecks = 0;
+    int calibrationFailures = checkCalibration(CALIBRATION_REFERENCE, referenceCalibration, calibrationChecks);
+    if (calibrationFailures < 0) {
+        fprintf(stderr, "Cannot use calibration reference %s\n", CALIBRATION_REFERENCE);
+        return 1;
+    }
+    if (calibrationFailures > 0) {
+        fprintf(stderr, "%d of %zu calibration checks out of tolerance\n", calibrationFailures, calibrationChecks);
+        return 1;
+    }
+
+    native::ReplayAdc adc;
+    if (!adc.load(tracePath)) {
+        fprintf(stderr, "Cannot load ADC trace %s\n", tracePath);
+        return 1;
+    }
+    adc.setRowPeriod(SAMPLE_INTERVAL * 1000UL);
+    hal::setAdcSource(&adc);
+
+    Serial.setEcho(false);
+    Serial.begin(SERIAL_BAUD_RATE);
+    waterSensors.init();
+#if ADC_OVERSAMPLING
+    oversampledAdc.begin(ADC_OVERSAMPLE_RATE_HZ);
+    hal::setAdcSource(&oversampledAdc);
+#endif
+    wifiManager.init();
+    mqttClient.init();
+    // MQTTClient throttles reconnects, so let simulated time pass until it connects
+    for (int ms = 0; ms < 10000 && !mqttClient.isConnected(); ms++) {
+        mqttClient.loop();
+        native::boardClock().advanceMillis(1);
+    }
+    if (!mqttClient.isConnected()) {
+        fprintf(stderr, "Loopback broker connection failed\n");
+        return 1;
+    }
+
+    StageStats capture("adcCapture");
+    StageStats read("readSensors");
+    StageStats print("printReadings");
+    StageStats average("calculateAverages");
+    StageStats publish("publishWaterData");
+    StageStats legacyFormat("formatSnprintf");
+    StageStats writerFormat("formatJsonWriter");
+    int formatMismatches = 0;
+    std::vector<WaterReading> averages;
+
+    for (unsigned long i = 0; i < iterations; i++) {
+        native::boardClock().advanceMillis(SAMPLE_INTERVAL);
+#if ADC_OVERSAMPLING
+        // Runs in the background timer on the board; timed separately here
+        capture.measure([] { oversampledAdc.pump(); });
+#endif
+        read.measure([] { waterSensors.readSensors(); });
+        print.measure([] { waterSensors.printReadings(); });
+
+        // Same cadence as loop(): one publish per MQTT_PUBLISH_INTERVAL worth of samples
+        if ((i + 1) % (MQTT_PUBLISH_INTERVAL / SAMPLE_INTERVAL) == 0) {
+            average.measure([] { calculateAverages(); });
+            WaterReading reading;
+            reading.timestamp = 1744700000UL + (uint32_t)(i + 1) * (SAMPLE_INTERVAL / 1000);
+            waterSensors.copyValues(reading.values);
+            publish.measure([&] { mqttClient.publishWaterData(reading); });
+            char expected[256], actual[256];
+            legacyFormat.measure([&] { legacyWaterData(expected, sizeof(expected), "ESP32_000110", reading); });
+            writerFormat.measure([&] { writerWaterData(actual, sizeof(actual), reading); });
+            if (strcmp(expected, actual) != 0) formatMismatches++;
+            averages.push_back(reading);
+            mqttClient.loop();
+        }
+    }
+
+    if (formatMismatches != 0) {
+        fprintf(stderr, "JsonWriter output differs from snprintf in %d trace messages\n", formatMismatches);
+        return 1;
+    }
+
+    // The same sweeps through the reference calibration
+    StageStats readCalibrated("readCalibrated");
+    waterSensors.setCalibration(referenceCalibration);
+    for (unsigned long i = 0; i < iterations; i++) {
+        native::boardClock().advanceMillis(SAMPLE_INTERVAL);
+#if ADC_OVERSAMPLING
+        oversampledAdc.pump();
+#endif
+        readCalibrated.measure([] { waterSensors.readSensors(); });
+    }
+
+    // Payload formats over the same averages
+    const size_t batchSize = MQTT_BATCH_SIZE > 1 ? MQTT_BATCH_SIZE : 12;
+    char label[2][32];
+    snprintf(label[0], sizeof(label[0]), "json batch x%zu", batchSize);
+    snprintf(label[1], sizeof(label[1]), "binary batch x%zu", batchSize);
+    PayloadStats jsonSingle("json single");
+    PayloadStats jsonBatch(label[0]);
+    PayloadStats binaryBatch(label[1]);
+    static uint8_t encoded[8192];
+    for (size_t first = 0; first < averages.size(); first += batchSize) {
+        size_t count = std::min(batchSize, averages.size() - first);
+        const WaterReading* batch = &averages[first];
+        for (size_t i = 0; i < count; i++) {
+            char json[256];
+            jsonSingle.add(MQTT_DATA_TOPIC, writerWaterData(json, sizeof(json), batch[i]));
+        }
+        jsonBatch.add(MQTT_BATCH_TOPIC, payload::encodeJson((char*)encoded, sizeof(encoded), "ESP32_000110", batch, count));
+
+        size_t length = payload::encodeBinary(encoded, sizeof(encoded), "ESP32_000110", batch, count);
+        binaryBatch.add(MQTT_BATCH_TOPIC, length);
+        char deviceId[32];
+        WaterReading decoded[256];
+        if (payload::decodeBinary(encoded, length, deviceId, sizeof(deviceId), decoded, 256) != count ||
+            strcmp(deviceId, "ESP32_000110") != 0) {
+            fprintf(stderr, "Binary batch at reading %zu does not decode\n", first);
+            return 1;
+        }
+        for (size_t i = 0; i < count; i++) {
+            bool same = decoded[i].timestamp == batch[i].timestamp;
+            for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+                float scale = payload::CHANNEL_SCALE[c];
+                same = same && lroundf(decoded[i].values[c] * scale) == lroundf(batch[i].values[c] * scale);
+            }
+            if (!same) {
+                fprintf(stderr, "Binary batch reading %zu does not round-trip\n", first + i);
+                return 1;
+            }
+        }
+    }
+
+    if (csv) {
+        printf("stage,calls,p50_us,p99_us,max_us,allocs_per_call,console_bytes_per_call,uart_ms_per_call\n");
+    } else {
+        printf("conversion tables bit-exact; 4-channel kernel %.2f ns (float) vs %.2f ns (table)\n",
+               floatNs, tableNs);
+        printf("JsonWriter byte-exact with snprintf over every converted ADC code\n");
+        printf("calibration: %zu reference checks within tolerance\n", calibrationChecks);
+        printf("%zu-row trace, %lu samples, console at %d baud%s\n\n", adc.rows(), iterations, SERIAL_BAUD_RATE,
+               LOG_BUFFERED ? " (buffered: uart time is spent by the drain, off the stage)" : "");
+        printf("%-20s %8s %10s %10s %10s %8s %8s %10s %14s\n", "stage", "calls", "p50 us", "p99 us",
+               "max us", "allocs", "bytes", "uart ms", "uart cycles");
+    }
+    capture.report(csv);
+    read.report(csv);
+    readCalibrated.report(csv);
+    print.report(csv);
+    average.report(csv);
+    publish.report(csv);
+    legacyFormat.report(csv);
+    writerFormat.report(csv);
+
+    if (averages.empty()) return 0;
+    if (csv) {
+        printf("\nformat,messages_per_hour,payload_bytes_per_reading,wire_bytes_per_hour\n");
+    } else {
+        printf("\n%zu averaged readings, binary batches round-trip\n", averages.size());
+        printf("%-20s %10s %14s %14s\n", "payload", "msgs/h", "bytes/reading", "wire bytes/h");
+    }
+    jsonSingle.report(csv, averages.size());
+    jsonBatch.report(csv, averages.size());
+    binaryBatch.report(csv, averages.size());
+
+    // External ADC conversion scheduling
+    ScanStats scans[4] = {runScan(100000, false, 40), runScan(100000, true, 41),
+                          runScan(400000, false, 42), runScan(400000, true, 43)};
+    for (const ScanStats& scan : scans) {
+        if (!scan.exact) {
+            fprintf(stderr, "ADS1115 scan at %lu Hz returned wrong codes\n", (unsigned long)scan.busHz);
+            return 1;
+        }
+    }
+    if (csv) {
+        printf("\nbus_hz,pipelined,conversions_per_s,scan_us,bus_share,ignored_starts,bus_errors,exact\n");
+    } else {
+        printf("\nADS1115, 4 inputs at 860 SPS (%lu us per conversion), %lu s of board time; codes exact\n",
+               (unsigned long)ads1115::conversionMicros(7), ADC_SCAN_SECONDS);
+        printf("%-19s %10s %10s %9s %8s %8s\n", "bus", "conv/s", "scan us", "bus busy", "ignored", "errors");
+    }
+    for (const ScanStats& scan : scans) scan.report(csv);
+    return 0;
+}
@@ -1,155 +1,917 @@
 #include <Arduino.h>
 #include "sensors.h"
+#include "channels.h"
 #include "config.h"
 #include "wifi_manager.h"
 #include "mqtt_client.h"
+#include "hal.h"
+#include "adc_oversampler.h"
+#include "ads1115.h"
+#include "streaming_stats.h"
+#include "outlier_filter.h"
+#include "spsc_queue.h"
+#include "reading.h"
+#include "reading_log.h"
+#include "payload_codec.h"
+#include "power_manager.h"
+#include "power_model.h"
+#include "time_sync.h"
+#include "settings.h"
+#include "calibration.h"
+#include "command_handler.h"
+#include "adaptive_reporter.h"
+#include "metrics.h"
+#include "session_aggregator.h"
+#ifdef NATIVE_BUILD
+#include "flash_emulator.h"
+#endif
+
+// Reconnect caches (access point, TLS session), kept across resets and deep sleep
+HAL_NOINIT WiFiCache wifiCache;
+#if TLS_SESSION_RESUMPTION && TLS_SESSION_PERSIST
+HAL_NOINIT TlsSessionCache tlsSession;
+#elif TLS_SESSION_RESUMPTION
+TlsSessionCache tlsSession;   // Master secret stays out of RTC memory (TLS_SESSION_PERSIST)
+#endif
 
 WaterSensors waterSensors;
-WiFiManager wifiManager;
+WiFiManager wifiManager(wifiCache);
 MQTTClient mqttClient;
 
+#if ADC_OVERSAMPLING
+constexpr auto sensorPins = busPins<ONCHIP_CHANNEL_COUNT>(ADC_BUS_ONCHIP);
+OversamplingAdc<ONCHIP_CHANNEL_COUNT, ADC_OVERSAMPLE_RING_BLOCKS> oversampledAdc(sensorPins.data());
+#endif
+#if EXTERNAL_ADC
+constexpr auto externalInputs = busPins<ADS1115_CHANNEL_COUNT>(ADC_BUS_ADS1115);
+Ads1115<ADS1115_CHANNEL_COUNT, ADS1115_RING_BLOCKS> externalAdc(externalInputs.data(), ADS1115_ADDRESS,
+                                                                ADS1115_ALERT_PIN, ADS1115_PGA,
+                                                                ADS1115_DATA_RATE, ADS1115_PIPELINED);
+#endif
+
 // Variables for timing
 unsigned long lastSampleTime = 0;
 unsigned long lastPublishTime = 0;
+bool sampledOnce = false;  // The first sample has no previous one to be late against
+
+// Hot-path timings (METRICS_ENABLED), reported every METRICS_INTERVAL
+Metrics metrics;
+unsigned long lastMetricsTime = 0;
+unsigned long lastHeapSampleTime = 0;
 
 // Variables for averaging samples
-const int NUM_SAMPLES = 5;
+const int MAX_NUM_SAMPLES = SAMPLE_WINDOW_MAX;  // Largest averaging window the statistics can be set to
+const int NUM_SAMPLES = SAMPLE_WINDOW;          // Default averaging window
 int currentSampleCount = 0;
 
-// Arrays to store multiple readings
-float phReadings[NUM_SAMPLES] = {0};
-float tdsReadings[NUM_SAMPLES] = {0};
-float turbidityReadings[NUM_SAMPLES] = {0};
-float temperatureReadings[NUM_SAMPLES] = {0};
+// Running statistics over the last NUM_SAMPLES readings of every channel
+StreamingStats<SENSOR_CHANNEL_COUNT, MAX_NUM_SAMPLES> sampleStats(NUM_SAMPLES);
+
+// Averaged readings handed from the sampling side to the network side
+SpscQueue<WaterReading, READING_QUEUE_LENGTH> readingQueue;
+
+// Run-time settings and calibration. The network side owns `settings` and
+// `calibration` and changes them on commands; the sampling side works from
+// its own copies, handed over through the queues so it never sees a
+// half-written update.
+Settings settings;
+Settings samplingSettings;
+SettingsStore settingsStore;
+Calibration calibration;
+Calibration samplingCalibration;
+CalibrationStore calibrationStore;
+CommandHandler commandHandler(settings, calibration);
+SpscQueue<Settings, 4> settingsQueue;
+SpscQueue<Calibration, 2> calibrationQueue;
+
+// Network side: which readings are worth publishing (settings.adaptiveReporting).
+// In low-power mode with deep sleep its state does not survive the sleep, so
+// the first reading of each flush is always sent.
+constexpr auto reportDeadbands = channelField(&ChannelSpec::deadband);
+AdaptiveReporter reporter(reportDeadbands.data(), ADAPTIVE_CUSUM_SLACK, ADAPTIVE_CUSUM_LIMIT, ADAPTIVE_HEARTBEAT,
+                          ADAPTIVE_ALARM_HOLD);
+
+// Readings taken before the first NTP sync, held until their timestamps can be corrected
+TimeSync timeSync;
+WaterReading backfill[NTP_BACKFILL_CAPACITY];
+size_t backfillCount = 0;
+
+#if STORE_AND_FORWARD
+// Flash-backed log of readings that could not be published
+#ifdef NATIVE_BUILD
+native::FlashEmulator logStorage(STORE_NATIVE_FLASH_SIZE, 4096);
+#else
+PartitionStorage logStorage(STORE_PARTITION_LABEL);
+#endif
+ReadingLog readingLog(logStorage);
+bool logReady = false;
+unsigned long lastDrainTime = 0;
+#endif
+
+#if MQTT_BATCH_MAX > 1
+// Readings collected on the network side until a batch is full
+WaterReading publishBatch[MQTT_BATCH_MAX];
+size_t publishBatchCount = 0;
+#endif
+
+#if LOW_POWER_MODE
+// Duty-cycle state, kept in RTC memory across deep sleep
+POWER_RTC_STATE PowerState powerState;
+PowerManager powerManager(powerState);
+#endif
+
+#if SESSION_SUMMARIES
+// Network side: session and day aggregates of the averaged readings
+// (settings.sessionReporting), kept through deep sleep in low-power mode
+#if LOW_POWER_MODE
+POWER_RTC_STATE SessionState sessionState;
+#else
+SessionState sessionState;
+#endif
+SessionAggregator sessions(sessionState);
+#endif
+
+#if OUTLIER_FILTER
+// Spike rejection applied to each sample before it reaches the statistics
+HampelFilter<SENSOR_CHANNEL_COUNT, 15> outlierFilter(OUTLIER_WINDOW, OUTLIER_THRESHOLD);
+#endif
+
+// Averages of the last window, one per channel
+float averages[SENSOR_CHANNEL_COUNT];
 
-// Variables to store averages
-float avgPh = 0;
-float avgTds = 0;
-float avgTurbidity = 0;
-float avgTemperature = 0;
+void storeReading(const WaterReading& reading);
+#if SAMPLING_TASKS
+void startTasks();
+#endif
+#if LOW_POWER_MODE
+void runDutyCycle();
+#endif
+
+// Sampling side: puts samplingSettings into effect
+void applySamplingSettings() {
+#if LOW_POWER_MODE
+  // Each window averages one burst
+  sampleStats.setWindow(LOW_POWER_BURST_SAMPLES);
+#else
+  sampleStats.setWindow(samplingSettings.sampleWindow);
+#endif
+  waterSensors.setPhWindowSize(samplingSettings.phWindow);
+#if ADC_OVERSAMPLING || EXTERNAL_ADC
+  // Background capture blocks sized for the time between sweeps
+  uint32_t sweepInterval = LOW_POWER_MODE ? LOW_POWER_BURST_SPACING : samplingSettings.sampleIntervalMs;
+#endif
+#if ADC_OVERSAMPLING
+  oversampledAdc.setSampleInterval(sweepInterval);
+#endif
+#if EXTERNAL_ADC
+  externalAdc.setSampleInterval(sweepInterval);
+#endif
+}
+
+// Sampling side: takes over settings and calibration changed by a command
+// (only the newest matters)
+void pollSettings() {
+  Settings updated;
+  bool received = false;
+  while (settingsQueue.pop(updated)) {
+    samplingSettings = updated;
+    received = true;
+  }
+  if (received) {
+    applySamplingSettings();
+  }
+  received = false;
+  while (calibrationQueue.pop(samplingCalibration)) {
+    received = true;
+  }
+  if (received) {
+    waterSensors.setCalibration(samplingCalibration);
+  }
+}
+
+// Sensors, outlier filter and background ADC capture
+void initSampling() {
+  waterSensors.init();
+  samplingCalibration = calibration;
+  waterSensors.setCalibration(samplingCalibration);
+#if OUTLIER_FILTER
+  for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+    outlierFilter.setMinDeviation(c, CHANNELS[c].minDeviation);
+  }
+#endif
+#if ADC_OVERSAMPLING
+  if (oversampledAdc.begin(ADC_OVERSAMPLE_RATE_HZ)) {
+    hal::setAdcSource(&oversampledAdc);
+  } else {
+    hal::console().println("ADC oversampling unavailable, using single-shot reads.");
+  }
+#endif
+#if EXTERNAL_ADC
+#ifndef NATIVE_BUILD
+  hal::defaultI2c.begin(I2C_SDA_PIN, I2C_SCL_PIN, I2C_CLOCK_HZ);
+#endif
+  if (externalAdc.begin()) {
+    waterSensors.attach(ADC_BUS_ADS1115, &externalAdc);
+  } else {
+    hal::console().println("ADS1115 not responding; its channels read 0.");
+  }
+#endif
+  applySamplingSettings();
+  hal::console().println("Sensors initialized.");
+}
+
+// Mounts the store-and-forward log
+void mountLog() {
+#if STORE_AND_FORWARD
+#ifndef NATIVE_BUILD
+  logReady = logStorage.begin() && readingLog.begin();
+#else
+  logReady = readingLog.begin();
+#endif
+  if (logReady) {
+    hal::console().print("Reading log mounted, ");
+    hal::console().print((unsigned long)readingLog.pending());
+    hal::console().println(" readings pending delivery.");
+  } else {
+    hal::console().println("Reading log unavailable; readings taken offline will be lost.");
+  }
+#endif
+}
 
 void setup()
 {
-  Serial.begin(SERIAL_BAUD_RATE);
-  Serial.println();
-  Serial.println("=======================================");
-  Serial.println(" Water Quality Monitoring System v1.0");
-  Serial.println("=======================================");
+  hal::consoleBegin(SERIAL_BAUD_RATE);
+  // Before the first sample, so readings stamped before NTP sync can be corrected later
+  timeSync.update();
+#if TLS_SESSION_RESUMPTION
+  mqttClient.setSessionCache(tlsSession);
+#endif
+  // Settings changed over MQTT replace the config.h defaults
+  if (settingsStore.load(settings)) {
+    hal::console().println("Settings loaded from NVS.");
+  }
+  samplingSettings = settings;
+  if (calibrationStore.load(calibration)) {
+    hal::console().println("Calibration loaded from NVS.");
+  }
+  mqttClient.setCommandHandler(&commandHandler);
+  reporter.setLimits({ALARM_PH_MIN, ALARM_PH_MAX, ALARM_TURBIDITY_MAX});
+  mqttClient.setMetrics(&metrics);
+  // QoS 1 messages the broker never acknowledged are stored again
+  mqttClient.setUndeliveredHandler(storeReading);
+#if SESSION_SUMMARIES
+  sessions.setLimits({ALARM_PH_MIN, ALARM_PH_MAX, ALARM_TURBIDITY_MAX});
+  mqttClient.setSessionQueue(&sessions);
+#endif
+#if LOW_POWER_MODE
+  powerManager.begin();
+#if SESSION_SUMMARIES
+  // A session aggregated over earlier windows carries on after deep sleep
+  sessions.begin(powerManager.coldBoot());
+#endif
+  if (!powerManager.coldBoot()) {
+    // Timer wake from deep sleep: the network only comes up when a flush is due
+    initSampling();
+    mountLog();
+    runDutyCycle();
+    return;
+  }
+#elif SESSION_SUMMARIES
+  sessions.begin();
+#endif
+  hal::console().println();
+  hal::console().println("=======================================");
+  hal::console().println(" Water Quality Monitoring System v1.0");
+  hal::console().println("=======================================");
   
-  waterSensors.init();
-  Serial.println("Sensors initialized.");
+  initSampling();
   
+#if !LOW_POWER_MODE
+  // WiFi, NTP and MQTT come up in the background (serviceNetwork()) while
+  // sampling starts right away; readings taken before the clock is set are
+  // held and back-dated once NTP sync arrives
   wifiManager.init();
-  
-  // Synchronize time via NTP with ESP32s RTC
   configTime(19800, 0, "pool.ntp.org", "time.nist.gov");
-  Serial.println("Waiting for NTP time sync...");
-  while (time(nullptr) < 100000) {
-    delay(500);
-    Serial.print(".");
-  }
-  Serial.println();
-  Serial.println("Time synchronized.");
+#endif
   
   mqttClient.init();
-  Serial.println("System initialization complete. Starting measurements...");
-  Serial.println();
+  mountLog();
+  hal::console().println("System initialization complete. Starting measurements...");
+  hal::console().println();
+#if SAMPLING_TASKS
+  startTasks();
+#endif
+#if LOW_POWER_MODE
+  power::PowerProfile profile;
+  power::EnergyBudget budget = power::estimate(profile, power::DutyCycle());
+  hal::console().print("Low-power mode, predicted battery life: ");
+  hal::console().print(power::batteryDays(profile, budget), 1);
+  hal::console().println(" days (power_model.h defaults)");
+  
+  // The radio stays off until the first flush
+  runDutyCycle();
+#endif
 }
 
 // Function to calculate averages from collected samples
 void calculateAverages() {
-  float sumPh = 0, sumTds = 0, sumTurbidity = 0, sumTemperature = 0;
+  for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+    averages[c] = sampleStats.mean(c);
+  }
   
-  for (int i = 0; i < NUM_SAMPLES; i++) {
-    sumPh += phReadings[i];
-    sumTds += tdsReadings[i];
-    sumTurbidity += turbidityReadings[i];
-    sumTemperature += temperatureReadings[i];
+  if (LOG_MAX_LEVEL >= LOG_AVERAGES && samplingSettings.logLevel >= LOG_AVERAGES) {
+#if LOG_COMPACT
+    hal::console().print("avg");
+    for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+      hal::console().print(' ');
+      hal::console().print(CHANNELS[c].tag);
+      hal::console().print(' ');
+      hal::console().print(averages[c], CHANNELS[c].decimals);
+    }
+#if OUTLIER_FILTER
+    hal::console().print(" rej ");
+    hal::console().print(outlierFilter.totalRejected());
+#endif
+    hal::console().println();
+#else
+    hal::console().println("===== AVERAGE READINGS =====");
+    for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+      hal::console().print(CHANNELS[c].label);
+      hal::console().print(": ");
+      hal::console().println(averages[c], 2);
+    }
+#if OUTLIER_FILTER
+    // Outliers replaced since the previous publish
+    hal::console().print("Rejected: ");
+    hal::console().println(outlierFilter.totalRejected());
+#endif
+    hal::console().println("===========================");
+#endif
   }
+#if OUTLIER_FILTER
+  outlierFilter.resetCounters();
+#endif
+}
+
+// Takes one sample of every sensor and adds it to the running statistics
+void takeSample() {
+  // Take new readings
+  waterSensors.readSensors();
+  
+  // Add the readings to the running statistics
+  float sample[SENSOR_CHANNEL_COUNT];
+  waterSensors.copyValues(sample);
+#if OUTLIER_FILTER
+  outlierFilter.apply(sample);
+#endif
+  sampleStats.push(sample);
   
-  avgPh = sumPh / NUM_SAMPLES;
-  avgTds = sumTds / NUM_SAMPLES;
-  avgTurbidity = sumTurbidity / NUM_SAMPLES;
-  avgTemperature = sumTemperature / NUM_SAMPLES;
+  // Print the individual readings
+  if (LOG_MAX_LEVEL >= LOG_SAMPLES && samplingSettings.logLevel >= LOG_SAMPLES) {
+#if LOG_COMPACT
+    hal::console().print('#');
+    hal::console().print(currentSampleCount + 1);
+    hal::console().print(' ');
+#else
+    hal::console().print("Sample #");
+    hal::console().print(currentSampleCount + 1);
+    hal::console().print("   readings:");
+#endif
+    waterSensors.printReadings();
+  }
   
-  Serial.println("===== AVERAGE READINGS =====");
-  Serial.print("pH: ");
-  Serial.println(avgPh, 2);
-  Serial.print("TDS: ");
-  Serial.println(avgTds, 2);
-  Serial.print("Turbidity: ");
-  Serial.println(avgTurbidity, 2);
-  Serial.print("Temperature: ");
-  Serial.println(avgTemperature, 2);
-  Serial.println("===========================");
+  // Increment sample count and wrap around if necessary
+  currentSampleCount++;
+  if (currentSampleCount >= (int)sampleStats.window()) {
+    currentSampleCount = 0;
+  }
 }
 
-void loop()
-{
-  unsigned long currentTime = millis();
+// Averages the collected samples into a timestamped reading
+WaterReading averageReading() {
+  // Calculate averages from the collected samples
+  calculateAverages();
+  
+  WaterReading reading;
+  reading.timestamp = (uint32_t)hal::now();
+  for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+    reading.values[c] = averages[c];
+  }
+  return reading;
+}
+
+// Averages the collected samples and hands the result to the network side
+void queueAverages() {
+  WaterReading reading = averageReading();
+  if (!readingQueue.push(reading)) {
+    hal::console().println("Reading queue full, average dropped");
+  }
+}
+
+// Publishes one averaged reading to MQTT with its original timestamp
+bool publishReading(const WaterReading& reading) {
+  return mqttClient.publishWaterData(reading);
+}
+
+// Publishes readings as one batch message, or one message each without batching
+bool publishReadings(const WaterReading* readings, size_t count) {
+#if MQTT_BATCH_MAX > 1
+  if (settings.batchSize > 1) {
+    return mqttClient.publishBatch(readings, count);
+  }
+#endif
+  for (size_t i = 0; i < count; i++) {
+    if (!publishReading(readings[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Keeps a reading that could not be published
+void storeReading(const WaterReading& reading) {
+  // The log outlives the power-on the provisional timestamp is relative to
+  if (TimeSync::provisional(reading.timestamp)) {
+    hal::console().println("Reading lost: taken before the clock was set");
+    return;
+  }
+#if STORE_AND_FORWARD
+  if (logReady && readingLog.append(reading)) {
+    hal::console().print("Reading stored for later delivery (");
+    hal::console().print((unsigned long)readingLog.pending());
+    hal::console().println(" pending)");
+    return;
+  }
+#endif
+  hal::console().println("Reading lost: no room to store it");
+}
+
+#if STORE_AND_FORWARD
+// Publishes up to STORE_DRAIN_BATCH stored readings per STORE_DRAIN_INTERVAL,
+// oldest first, so a long backlog does not flood the broker after an outage
+// (immediate skips the interval, for low-power flushes)
+void drainStoredReadings(bool immediate = false) {
+  if (!logReady || readingLog.pending() == 0) {
+    return;
+  }
+  unsigned long currentTime = hal::millis();
+  if (!immediate && currentTime - lastDrainTime < STORE_DRAIN_INTERVAL) {
+    return;
+  }
+  lastDrainTime = currentTime;
   
+  int sent = 0;
+#if MQTT_BATCH_MAX > 1
+  // Stored readings go out in full batches as well
+  WaterReading readings[MQTT_BATCH_MAX];
+  while (sent < STORE_DRAIN_BATCH) {
+    size_t limit = STORE_DRAIN_BATCH - sent;
+    size_t count = readingLog.peekBatch(readings, limit < settings.batchSize ? limit : settings.batchSize);
+    if (count == 0 || !publishReadings(readings, count)) {
+      break;
+    }
+    readingLog.markSent(count);
+    sent += count;
+  }
+#else
+  WaterReading reading;
+  while (sent < STORE_DRAIN_BATCH && readingLog.peek(reading)) {
+    if (!publishReading(reading)) {
+      break;
+    }
+    readingLog.markSent();
+    sent++;
+  }
+#endif
+  if (sent > 0) {
+    hal::console().print("Delivered ");
+    hal::console().print(sent);
+    hal::console().print(" stored readings, ");
+    hal::console().print((unsigned long)readingLog.pending());
+    hal::console().println(" pending");
+  }
+}
+#endif
+
+// Publishes readings, or stores them for later if that is not possible
+void deliverReadings(const WaterReading* readings, size_t count) {
+  if (wifiManager.isConnected() && mqttClient.isConnected()) {
+    bool published;
+    {
+      ScopedTimer publishTimer(metrics[Metrics::PUBLISH]);
+      published = publishReadings(readings, count);
+    }
+    if (published) {
+      if (count == 1) {
+        hal::console().println("Average data successfully published to MQTT broker");
+      } else {
+        hal::console().print("Batch of ");
+        hal::console().print((unsigned long)count);
+        hal::console().println(" readings successfully published to MQTT broker");
+      }
+      return;
+    }
+    hal::console().println("Failed to publish average data to MQTT broker");
+  } else if (!wifiManager.isConnected()) {
+    hal::console().println("Cannot publish data: WiFi not connected");
+  } else {
+    hal::console().println("Cannot publish data: MQTT not connected");
+  }
+  for (size_t i = 0; i < count; i++) {
+    storeReading(readings[i]);
+  }
+}
+
+// Adaptive reporting: false if the subscriber's last value is still close enough
+bool reportable(const WaterReading& reading) {
+  if (!settings.adaptiveReporting) {
+    return true;
+  }
+  bool escalating = reporter.escalating();
+  AdaptiveReporter::Reason reason = reporter.evaluate(reading);
+  if (reason == AdaptiveReporter::ALARM && !escalating) {
+    hal::console().println("Reading outside safe limits, reporting every reading");
+  }
+  if (reason == AdaptiveReporter::SUPPRESSED) {
+    if (LOG_MAX_LEVEL >= LOG_AVERAGES && settings.logLevel >= LOG_AVERAGES) {
+      hal::console().println("Reading within deadband, not published");
+    }
+    return false;
+  }
+  return true;
+}
+
+// Adds a reading with a valid timestamp to its session; false if it is not to
+// be published (settings.sessionReporting 2 and outside the sessions and the
+// safe limits)
+bool sessionReading(const WaterReading& reading) {
+#if SESSION_SUMMARIES
+  if (settings.sessionReporting == 0) {
+    return true;
+  }
+  if (sessions.add(reading) != OUTSIDE_SESSION || settings.sessionReporting < 2 || sessions.alarm(reading)) {
+    return true;
+  }
+  if (LOG_MAX_LEVEL >= LOG_AVERAGES && settings.logLevel >= LOG_AVERAGES) {
+    hal::console().println("Reading outside the sessions, not published");
+  }
+  return false;
+#else
+  return true;
+#endif
+}
+
+// Closes the open session once the clock has passed its end and publishes
+// the closed session and day summaries
+void serviceSessions() {
+#if SESSION_SUMMARIES
+  if (timeSync.synced()) {
+    sessions.close((uint32_t)hal::now());
+  }
+  SessionSummary summary;
+  while (mqttClient.isConnected() && sessions.peek(summary)) {
+    if (!mqttClient.publishSessionSummary(summary)) {
+      break;
+    }
+    sessions.pop();
+    hal::console().print(summary.name());
+    hal::console().print(" summary published (");
+    hal::console().print((unsigned long)summary.count);
+    hal::console().println(" readings)");
+  }
+#endif
+}
+
+// Publishes a reading with a valid timestamp (or adds it to the current batch)
+// unless session or adaptive reporting leaves it out
+void routeReading(const WaterReading& reading) {
+  if (!sessionReading(reading) || !reportable(reading)) {
+    return;
+  }
+#if MQTT_BATCH_MAX > 1
+  if (settings.batchSize > 1) {
+    publishBatch[publishBatchCount++] = reading;
+    if (publishBatchCount >= settings.batchSize) {
+      deliverReadings(publishBatch, publishBatchCount);
+      publishBatchCount = 0;
+    }
+    return;
+  }
+#endif
+  deliverReadings(&reading, 1);
+}
+
+// Acknowledges a command received on MQTT_COMMAND_TOPIC and puts changed
+// settings into effect (network side now, sampling side at its next sample)
+void serviceCommands() {
+  bool changed = false;
+  bool calibrationChanged = false;
+  if (!commandHandler.takePending(changed, calibrationChanged)) {
+    return;
+  }
+  hal::console().print("Command: ");
+  hal::console().println(commandHandler.lastResult());
+  if (changed) {
+    if (!settingsQueue.push(settings)) {
+      hal::console().println("Settings not handed to sampling, queue full");
+    }
+    if (!settingsStore.save(settings)) {
+      hal::console().println("Settings could not be saved to NVS");
+    }
+    // The next reading is sent in full, whatever the reporter saw before
+    reporter.reset();
+#if MQTT_BATCH_MAX > 1
+    // Readings already collected go out if the batch size dropped below them
+    if (publishBatchCount > 0 && publishBatchCount >= settings.batchSize) {
+      deliverReadings(publishBatch, publishBatchCount);
+      publishBatchCount = 0;
+    }
+#endif
+  }
+  if (calibrationChanged) {
+    if (!calibrationQueue.push(calibration)) {
+      hal::console().println("Calibration not handed to sampling, queue full");
+    }
+    if (!calibrationStore.save(calibration)) {
+      hal::console().println("Calibration could not be saved to NVS");
+    }
+    reporter.reset();
+  }
+  mqttClient.publishStatus(settings, calibration, commandHandler.lastResult());
+}
+
+// Holds a reading taken before the first NTP sync
+void holdReading(const WaterReading& reading) {
+  if (backfillCount == 0) {
+    hal::console().println("Clock not set yet, holding readings until NTP sync");
+  }
+  if (backfillCount >= NTP_BACKFILL_CAPACITY) {
+    hal::console().println("Back-fill buffer full, oldest held reading dropped");
+    memmove(backfill, backfill + 1, (NTP_BACKFILL_CAPACITY - 1) * sizeof(WaterReading));
+    backfillCount--;
+  }
+  backfill[backfillCount++] = reading;
+}
+
+// Once NTP has set the clock, publishes the held readings with corrected timestamps
+void releaseBackfill() {
+  if (backfillCount == 0 || !timeSync.synced()) {
+    return;
+  }
+  hal::console().print("Clock set, back-filling ");
+  hal::console().print((unsigned long)backfillCount);
+  hal::console().println(" readings taken before NTP sync");
+  for (size_t i = 0; i < backfillCount; i++) {
+    if (timeSync.resolve(backfill[i])) {
+      routeReading(backfill[i]);
+    } else {
+      hal::console().println("Reading lost: its timestamp cannot be corrected");
+    }
+  }
+  backfillCount = 0;
+}
+
+// Publishes the metrics every METRICS_INTERVAL (or now if forced) and prints
+// them when 'm' arrives on the console
+void serviceMetrics(bool force = false) {
+#if METRICS_ENABLED
+  unsigned long currentTime = hal::millis();
+  if (currentTime - lastHeapSampleTime >= 1000) {
+    lastHeapSampleTime = currentTime;
+    metrics.sampleHeap();
+  }
+  if (hal::consoleRead() == 'm') {
+    metrics.print(hal::console());
+  }
+  if ((force || currentTime - lastMetricsTime >= METRICS_INTERVAL) && mqttClient.isConnected()) {
+    lastMetricsTime = currentTime;
+    mqttClient.publishMetrics(metrics);
+    metrics.reset();
+  }
+#endif
+}
+
+// Keeps WiFi/MQTT alive and publishes whatever the sampling side has queued
+void serviceNetwork() {
+  ScopedTimer networkTimer(metrics[Metrics::NETWORK]);
   wifiManager.wifi_reconnect();
   if (wifiManager.isConnected()) {
     mqttClient.loop();
   }
+  serviceCommands();
+  
+  timeSync.update();
+  releaseBackfill();
+  WaterReading reading;
+  while (readingQueue.pop(reading)) {
+    if (timeSync.resolve(reading)) {
+      routeReading(reading);
+    } else {
+      holdReading(reading);
+    }
+  }
+  serviceSessions();
+  
+#if STORE_AND_FORWARD
+  if (wifiManager.isConnected() && mqttClient.isConnected()) {
+    drainStoredReadings();
+  }
+#endif
+  serviceMetrics();
+}
+
+#if LOW_POWER_MODE
+// Brings WiFi/MQTT up, sends the buffered readings and any stored backlog,
+// then turns the radio off again
+void flushBuffered() {
+  wifiManager.init();
+  // Let SNTP correct the RTC while the link is up
+  configTime(19800, 0, "pool.ntp.org", "time.nist.gov");
+  mqttClient.init();
+  unsigned long start = hal::millis();
+  // Wait for the broker and for the clock (readings taken before the first
+  // sync need it); an already synchronised RTC stays set across deep sleep
+  while (!(mqttClient.isConnected() && timeSync.synced()) &&
+         hal::millis() - start < LOW_POWER_CONNECT_TIMEOUT) {
+    wifiManager.wifi_reconnect();
+    if (wifiManager.isConnected()) {
+      mqttClient.loop();
+    }
+    serviceCommands();
+    timeSync.update();
+    hal::delay(10);
+  }
+  
+  WaterReading* readings = powerManager.bufferedReadings();
+  size_t count = powerManager.bufferedCount();
+  bool timed = true;
+  for (size_t i = 0; i < count; i++) {
+    timed = timeSync.resolve(readings[i]) && timed;
+  }
+  if (timed) {
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+      if (sessionReading(readings[i]) && reportable(readings[i])) {
+        readings[kept++] = readings[i];
+      }
+    }
+    count = kept;
+    for (size_t i = 0; i < count; i += settings.batchSize) {
+      deliverReadings(&readings[i], count - i < settings.batchSize ? count - i : settings.batchSize);
+    }
+    powerManager.flushed();
+  } else {
+    hal::console().println("Clock not set yet, keeping the buffered readings for the next flush");
+  }
+  serviceSessions();
+  
+#if STORE_AND_FORWARD
+  while (wifiManager.isConnected() && mqttClient.isConnected() && readingLog.pending() > 0 &&
+         hal::millis() - start < LOW_POWER_CONNECT_TIMEOUT) {
+    drainStoredReadings(true);
+    mqttClient.loop();
+    // Gives the acks that free the QoS 1 window time to arrive
+    hal::delay(10);
+  }
+#endif
+  
+#if MQTT_QOS1
+  // Published readings are only delivered once acknowledged; what is still
+  // in flight at the deadline goes back to the log on disconnect
+  unsigned long ackStart = hal::millis();
+  while (mqttClient.isConnected() && mqttClient.delivery().inFlight() > 0 &&
+         hal::millis() - ackStart < LOW_POWER_CONNECT_TIMEOUT) {
+    mqttClient.loop();
+    hal::delay(10);
+  }
+#endif
+  
+  mqttClient.loop();
+  serviceCommands();
+  // Timings of the windows since the last flush (of this wake with deep sleep)
+  serviceMetrics(true);
+  mqttClient.disconnect();
+  wifiManager.shutdown();
+}
+
+// One low-power window: sampling burst, flush when due, then sleep
+void runDutyCycle() {
+  powerManager.beginWindow();
+  pollSettings();
+  
+#if SENSOR_POWER_PIN >= 0
+  pinMode(SENSOR_POWER_PIN, OUTPUT);
+  digitalWrite(SENSOR_POWER_PIN, HIGH);
+  hal::delay(SENSOR_WARMUP_MS);
+#endif
+  
+  // Discard frames captured before the burst (e.g. before the last sleep)
+  hal::beginSweep();
+  for (int i = 0; i < LOW_POWER_BURST_SAMPLES; i++) {
+    hal::delay(LOW_POWER_BURST_SPACING);
+    ScopedTimer sampleTimer(metrics[Metrics::LOOP]);
+    takeSample();
+  }
+#if SENSOR_POWER_PIN >= 0
+  digitalWrite(SENSOR_POWER_PIN, LOW);
+#endif
+  
+  WaterReading reading = averageReading();
+  if (!powerManager.buffer(reading)) {
+    storeReading(reading);
+  }
+  if (powerManager.flushDue()) {
+    flushBuffered();
+  }
+  
+  hal::console().print("Window ");
+  hal::console().print((unsigned long)powerManager.wakes());
+  hal::console().print(" done, ");
+  hal::console().print((unsigned long)powerManager.bufferedCount());
+  hal::console().println(" readings buffered. Sleeping.");
+  // The window's output has to reach the UART before the sleep
+  hal::flushConsole();
+  powerManager.sleepUntilNextWindow();
+}
+
+void loop()
+{
+  // Only reached with light sleep (deep sleep restarts from setup())
+  runDutyCycle();
+}
+#elif SAMPLING_TASKS
+// High-priority sampling on its own core, released at a fixed period so
+// network stalls cannot delay it
+void samplingTask(void *) {
+  uint32_t samplesSincePublish = 0;
+  TickType_t lastWake = xTaskGetTickCount();
+  
+  for (;;) {
+    // Ticks between the release time and now
+    metrics[Metrics::SAMPLE_LATENESS]->record((xTaskGetTickCount() - lastWake) * portTICK_PERIOD_MS * 1000);
+    {
+      ScopedTimer iterationTimer(metrics[Metrics::LOOP]);
+      pollSettings();
+      takeSample();
+      if (++samplesSincePublish >= samplingSettings.samplesPerPublish()) {
+        samplesSincePublish = 0;
+        queueAverages();
+      }
+    }
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(samplingSettings.sampleIntervalMs));
+  }
+}
+
+// WiFi/MQTT (including blocking TLS reconnects) on the other core
+void networkTask(void *) {
+  for (;;) {
+    serviceNetwork();
+    // Console output of both tasks, at the rate the UART takes it
+    hal::drainConsole();
+    vTaskDelay(pdMS_TO_TICKS(NETWORK_TASK_PERIOD));
+  }
+}
+
+void startTasks() {
+  xTaskCreatePinnedToCore(samplingTask, "sampling", SAMPLING_TASK_STACK, nullptr,
+                          SAMPLING_TASK_PRIORITY, nullptr, SAMPLING_TASK_CORE);
+  xTaskCreatePinnedToCore(networkTask, "network", NETWORK_TASK_STACK, nullptr,
+                          NETWORK_TASK_PRIORITY, nullptr, NETWORK_TASK_CORE);
+}
+
+void loop()
+{
+  // All work happens in the sampling and network tasks
+  vTaskDelete(NULL);
+}
+#else
+void loop()
+{
+  ScopedTimer loopTimer(metrics[Metrics::LOOP]);
+  unsigned long currentTime = hal::millis();
+  
+  serviceNetwork();
+  pollSettings();
   
   // Check if it's time to take another sample
-  if (currentTime - lastSampleTime >= SAMPLE_INTERVAL) {
-    lastSampleTime = currentTime;
-    
-    // Take new readings
-    waterSensors.readSensors();
-    
-    // Store the readings in the arrays
-    phReadings[currentSampleCount] = waterSensors.getPH();
-    tdsReadings[currentSampleCount] = waterSensors.getTDS();
-    turbidityReadings[currentSampleCount] = waterSensors.getTurbidity();
-    temperatureReadings[currentSampleCount] = waterSensors.getTemperature();
-    
-    // Print the individual readings
-    Serial.print("Sample #");
-    Serial.print(currentSampleCount + 1);
-    Serial.print("   readings:");
-    waterSensors.printReadings();
-    
-    // Increment sample count and wrap around if necessary
-    currentSampleCount++;
-    if (currentSampleCount >= NUM_SAMPLES) {
-      currentSampleCount = 0;
+  if (currentTime - lastSampleTime >= samplingSettings.sampleIntervalMs) {
+#if METRICS_ENABLED
+    // How much later than one interval after the previous sample
+    if (sampledOnce) {
+      metrics[Metrics::SAMPLE_LATENESS]->record((currentTime - lastSampleTime - samplingSettings.sampleIntervalMs) * 1000);
     }
+#endif
+    sampledOnce = true;
+    lastSampleTime = currentTime;
+    takeSample();
   }
   
   // Check if it's time to publish data to MQTT
-  if (currentTime - lastPublishTime >= MQTT_PUBLISH_INTERVAL) {
+  if (currentTime - lastPublishTime >= samplingSettings.publishIntervalMs) {
     lastPublishTime = currentTime;
-    
-    // Calculate averages from the collected samples
-    calculateAverages();
-    
-    if (wifiManager.isConnected() && mqttClient.isConnected()) {
-      time_t now = time(nullptr);
-      now += 19800; // Add 5 hours 30 minutes in seconds (5*3600 + 30*60 = 19800)
-      struct tm *timInf = gmtime(&now); // Convert adjusted time to struct tm
-      char timeStr[30];
-      
-      // Format: YYYY-MM-DDTHH:MM:SS.000+00:00 (eg: 2025-04-15T17:24:56.000+00:00 )
-      snprintf(timeStr, sizeof(timeStr), "%04d-%02d-%02dT%02d:%02d:%02d.000+00:00",
-               timInf->tm_year + 1900, timInf->tm_mon + 1, timInf->tm_mday,
-               timInf->tm_hour, timInf->tm_min, timInf->tm_sec);
-      String timeString = String(timeStr);
-      
-      // Publish the average values to MQTT
-      bool published = mqttClient.publishWaterData(timeString, avgPh, avgTds, avgTurbidity, avgTemperature);
-      
-      if (published) {
-        Serial.println("Average data successfully published to MQTT broker");
-      } else {
-        Serial.println("Failed to publish average data to MQTT broker");
-      }
-    } else if (!wifiManager.isConnected()) {
-      Serial.println("Cannot publish data: WiFi not connected");
-    } else {
-      Serial.println("Cannot publish data: MQTT not connected");
-    }
+    queueAverages();
   }
-}
\ No newline at end of file
+  
+  hal::drainConsole();
+}
+#endif
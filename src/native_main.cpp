@@ -0,0 +1,161 @@
+// Host entry point for the native build.
+// Replays a recorded ADC trace through the unmodified setup()/loop() against
+// the loopback MQTT broker, advancing simulated board time 1 ms per iteration.
+//
+//   usage: program [trace.csv] [seconds] [outage_start_s outage_length_s] [@s:command ...] [boot=unix_time]
+//                  [loss=p] [ack_loss=p] [latency=ms] [jitter=ms]
+//
+// The optional outage takes the WiFi link down for the given window to
+// exercise the store-and-forward path (an outage starting at 0 also delays
+// NTP sync, so early readings go through the timestamp back-fill).
+// Each @s:command is published on MQTT_COMMAND_TOPIC at s seconds, e.g.
+// @20:"sample_interval=250 publish_interval=1000". boot= sets the time NTP
+// reports at power-on (the host's clock by default), e.g. to run through the
+// close of a collection session. loss= drops that share of the PUBLISH
+// packets (and, unless ack_loss= says otherwise, of the PUBACKs) at the
+// broker, and latency=/jitter= delay the PUBACKs (LoopbackBroker::setFaults).
+
+#include <Arduino.h>
+#include "native_hal.h"
+#include "loopback_broker.h"
+#include <WiFi.h>
+#include "config.h"
+#include "mqtt_client.h"
+#include "adaptive_reporter.h"
+#include "metrics.h"
+#include "session_aggregator.h"
+#if EXTERNAL_ADC
+#include "ads1115_sim.h"
+#endif
+#include <Preferences.h>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+void setup();
+void loop();
+
+extern MQTTClient mqttClient;
+extern AdaptiveReporter reporter;
+extern Metrics metrics;
+#if SESSION_SUMMARIES
+extern SessionAggregator sessions;
+#endif
+
+int main(int argc, char** argv) {
+    std::vector<const char*> args;
+    std::vector<std::pair<unsigned long, std::string>> commands;
+    LoopbackBroker::Faults faults;
+    bool ackLossSet = false;
+    for (int i = 1; i < argc; i++) {
+        const char* colon = strchr(argv[i], ':');
+        if (argv[i][0] == '@' && colon != nullptr) {
+            commands.emplace_back(strtoul(argv[i] + 1, nullptr, 10) * 1000UL, colon + 1);
+        } else if (strncmp(argv[i], "boot=", 5) == 0) {
+            native::bootTime() = (time_t)strtoll(argv[i] + 5, nullptr, 10);
+        } else if (strncmp(argv[i], "loss=", 5) == 0) {
+            faults.publishLoss = atof(argv[i] + 5);
+        } else if (strncmp(argv[i], "ack_loss=", 9) == 0) {
+            faults.ackLoss = atof(argv[i] + 9);
+            ackLossSet = true;
+        } else if (strncmp(argv[i], "latency=", 8) == 0) {
+            faults.latencyMs = strtoul(argv[i] + 8, nullptr, 10);
+        } else if (strncmp(argv[i], "jitter=", 7) == 0) {
+            faults.jitterMs = strtoul(argv[i] + 7, nullptr, 10);
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    const char* tracePath = args.size() > 0 ? args[0] : "traces/reservoir_bench.csv";
+    unsigned long seconds = args.size() > 1 ? strtoul(args[1], nullptr, 10) : 60;
+    unsigned long outageStart = args.size() > 3 ? strtoul(args[2], nullptr, 10) * 1000UL : 0;
+    unsigned long outageEnd = args.size() > 3 ? outageStart + strtoul(args[3], nullptr, 10) * 1000UL : 0;
+
+    native::ReplayAdc adc;
+    if (!adc.load(tracePath)) {
+        fprintf(stderr, "Cannot load ADC trace %s\n", tracePath);
+        return 1;
+    }
+    adc.setRowPeriod(SAMPLE_INTERVAL * 1000UL);  // trace rows are one SAMPLE_INTERVAL apart
+    hal::setAdcSource(&adc);
+#if EXTERNAL_ADC
+    // ADS1115 input n carries trace column n, at the voltage the on-chip code stands for
+    native::Ads1115Sim externalAdc(ADS1115_ADDRESS, ADS1115_ALERT_PIN, I2C_CLOCK_HZ, [&adc](uint8_t input) {
+        static const uint8_t columns[4] = {PH_PIN, TDS_PIN, TURBIDITY_PIN, TEMP_PIN};
+        return adc.read(columns[input]) * (VOLTAGE_REF / ADC_RESOLUTION);
+    });
+    hal::setI2cBus(&externalAdc);
+#endif
+    if (!ackLossSet) faults.ackLoss = faults.publishLoss;
+    LoopbackBroker::instance().setFaults(faults);
+    LoopbackBroker::instance().setLogPublishes(true);
+    unsigned long firstPublishMs = 0;
+    // Readings that reached the broker, once each however often they were sent
+    std::set<std::string> dataMessages;
+    LoopbackBroker::instance().onPublish([&](const std::string& topic, const uint8_t* payload, size_t length) {
+        if (firstPublishMs == 0) firstPublishMs = millis();
+        if (topic == MQTT_DATA_TOPIC || topic == MQTT_BATCH_TOPIC) {
+            dataMessages.emplace((const char*)payload, length);
+        }
+    });
+
+    setup();
+
+    unsigned long end = millis() + seconds * 1000UL;
+    while (millis() < end) {
+        bool outage = millis() >= outageStart && millis() < outageEnd;
+        WiFi.setLinkUp(!outage);
+        // The broker drops the session when keepalives stop arriving
+        LoopbackBroker::instance().setOnline(!outage);
+        for (auto& command : commands) {
+            if (!command.second.empty() && millis() >= command.first) {
+                LoopbackBroker::instance().publish(MQTT_COMMAND_TOPIC, command.second.c_str());
+                command.second.clear();
+            }
+        }
+        loop();
+        native::boardClock().advanceMillis(1);
+    }
+
+    hal::flushConsole();
+    fprintf(stderr, "\n%lu s simulated, %zu trace rows, %lu publishes (%llu payload bytes)\n",
+            seconds, adc.rows(), LoopbackBroker::instance().publishes(),
+            LoopbackBroker::instance().publishedPayloadBytes());
+    fprintf(stderr, "first publish %lu ms after boot, %lu WiFi association attempts, %lu broker connects\n",
+            firstPublishMs, WiFi.associationAttempts(), LoopbackBroker::instance().connects());
+    if (!commands.empty()) {
+        fprintf(stderr, "%lu settings writes to NVS\n", Preferences::writes());
+    }
+    if (reporter.evaluated() > 0) {
+        fprintf(stderr, "adaptive reporting: %lu of %lu readings suppressed (deadband %lu, drift %lu, heartbeat %lu, alarm %lu)\n",
+                (unsigned long)reporter.count(AdaptiveReporter::SUPPRESSED), (unsigned long)reporter.evaluated(),
+                (unsigned long)reporter.count(AdaptiveReporter::DEADBAND), (unsigned long)reporter.count(AdaptiveReporter::DRIFT),
+                (unsigned long)reporter.count(AdaptiveReporter::HEARTBEAT), (unsigned long)reporter.count(AdaptiveReporter::ALARM));
+    }
+#if SESSION_SUMMARIES
+    fprintf(stderr, "session summaries: %lu unpublished, %lu dropped; %lu readings of closed sessions left out; open: %s, %lu readings\n",
+                (unsigned long)sessions.pending(), (unsigned long)sessions.dropped(), (unsigned long)sessions.late(),
+                sessions.current().count > 0 ? sessions.current().name() : "none", (unsigned long)sessions.current().count);
+#endif
+    LoopbackBroker& broker = LoopbackBroker::instance();
+    fprintf(stderr, "%zu distinct reading messages at the broker", dataMessages.size());
+    if (broker.lostPublishes() + broker.lostAcks() + broker.duplicatePublishes() > 0) {
+        fprintf(stderr, "; injected loss: %lu publishes, %lu acks; %lu duplicates received",
+                broker.lostPublishes(), broker.lostAcks(), broker.duplicatePublishes());
+    }
+    fprintf(stderr, "\n");
+#if MQTT_QOS1
+    const ReliablePublisher& delivery = mqttClient.delivery();
+    fprintf(stderr, "QoS 1: %lu delivered, %lu retried, %lu dropped, %zu in flight\n", delivery.delivered(),
+            delivery.retried(), delivery.dropped(), delivery.inFlight());
+#endif
+#if TLS_SESSION_RESUMPTION
+    fprintf(stderr, "TLS handshakes: %lu full, %lu resumed\n", mqttClient.tlsHandshakes(), mqttClient.tlsResumptions());
+#endif
+#if METRICS_ENABLED
+    // The serial dump of the last (unpublished) metrics period, in host time
+    metrics.print(Serial);
+#endif
+    return 0;
+}
@@ -0,0 +1,127 @@
+// Battery-life model for the duty-cycled low-power mode (LOW_POWER_MODE).
+// Uses the same arithmetic as the firmware (power_model.h): prints the charge
+// spent per phase for one configuration, compares it with the always-connected
+// firmware, and sweeps window length against flush interval. Defaults come from
+// config.h; the currents are the PowerProfile defaults unless overridden.
+//
+//   usage: program [--battery mAh] [--window s] [--flush windows] [--burst samples]
+//                  [--spacing ms] [--batch readings] [--light] [--gated]
+//                  [--sensor-ma mA] [--connect-ms ms] [--csv]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "power_model.h"
+
+namespace {
+
+void usage() {
+    fprintf(stderr, "usage: program [--battery mAh] [--window s] [--flush windows] [--burst samples]\n"
+                    "               [--spacing ms] [--batch readings] [--light] [--gated]\n"
+                    "               [--sensor-ma mA] [--connect-ms ms] [--csv]\n");
+}
+
+void printPhase(const char* name, float charge, const power::EnergyBudget& budget, bool csv) {
+    float perDay = charge * 86400.0f / budget.periodSeconds;
+    float share = budget.total() > 0 ? 100.0f * charge / budget.total() : 0;
+    if (csv) {
+        printf("%s,%.3f,%.1f\n", name, perDay, share);
+    } else {
+        printf("%-26s %10.2f %7.1f%%\n", name, perDay, share);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    power::PowerProfile profile;
+    power::DutyCycle cycle;
+    bool csv = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--csv") == 0) {
+            csv = true;
+        } else if (strcmp(arg, "--light") == 0) {
+            cycle.deepSleep = false;
+        } else if (strcmp(arg, "--gated") == 0) {
+            profile.sensorsGated = true;
+        } else if (value == nullptr) {
+            usage();
+            return 1;
+        } else if (strcmp(arg, "--battery") == 0) {
+            profile.batteryMah = atof(value), i++;
+        } else if (strcmp(arg, "--window") == 0) {
+            cycle.windowSeconds = atof(value), i++;
+        } else if (strcmp(arg, "--flush") == 0) {
+            cycle.flushWindows = atoi(value), i++;
+        } else if (strcmp(arg, "--burst") == 0) {
+            cycle.burstSamples = atoi(value), i++;
+        } else if (strcmp(arg, "--spacing") == 0) {
+            cycle.burstSpacingMs = atof(value), i++;
+        } else if (strcmp(arg, "--batch") == 0) {
+            cycle.batchSize = atoi(value), i++;
+        } else if (strcmp(arg, "--sensor-ma") == 0) {
+            profile.sensorCurrent = atof(value), i++;
+        } else if (strcmp(arg, "--connect-ms") == 0) {
+            profile.connectMs = atof(value), i++;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (cycle.windowSeconds <= 0 || cycle.flushWindows <= 0 || cycle.burstSamples <= 0) {
+        usage();
+        return 1;
+    }
+
+    power::EnergyBudget budget = power::estimate(profile, cycle);
+    power::EnergyBudget alwaysOn = power::estimateAlwaysOn(profile, budget.periodSeconds);
+    float days = power::batteryDays(profile, budget);
+    float alwaysOnDays = power::batteryDays(profile, alwaysOn);
+
+    if (csv) {
+        printf("phase,mAh_per_day,share_percent\n");
+    } else {
+        printf("%.0f s window, burst %d x %.0f ms, flush every %d windows, %s sleep, batch %d, sensors %s\n",
+               cycle.windowSeconds, cycle.burstSamples, cycle.burstSpacingMs, cycle.flushWindows,
+               cycle.deepSleep ? "deep" : "light", cycle.batchSize,
+               profile.sensorsGated ? "gated" : "always powered");
+        printf("awake %.0f ms per %.0f s (duty %.3f%%), radio %.0f ms\n\n", budget.awakeMs, budget.periodSeconds,
+               budget.dutyCycle() * 100.0f, budget.radioMs);
+        printf("%-26s %10s %8s\n", "phase", "mAh/day", "share");
+    }
+    printPhase("sampling (boot + burst)", budget.sampling, budget, csv);
+    printPhase("radio (connect + publish)", budget.radio, budget, csv);
+    printPhase("sleep", budget.sleep, budget, csv);
+    printPhase("sensors", budget.sensors, budget, csv);
+    printPhase("regulator", budget.regulator, budget, csv);
+    if (csv) {
+        printf("\naverage_mA,battery_days,always_on_days\n%.4f,%.1f,%.1f\n", budget.averageCurrent(), days,
+               alwaysOnDays);
+        return 0;
+    }
+    printf("%-26s %10.2f   avg %.3f mA\n\n", "total", budget.total() * 86400.0f / budget.periodSeconds,
+           budget.averageCurrent());
+    printf("%.0f mAh battery (%.0f%% usable): %.1f days, always-connected firmware: %.1f days\n\n",
+           profile.batteryMah, profile.usableFraction * 100.0f, days, alwaysOnDays);
+
+    // Battery days over window length x flush interval, everything else as configured
+    const float windows[] = {30, 60, 300, 900};
+    const int flushes[] = {1, 5, 10, 30, 60};
+    printf("battery days   window s \\ flush every");
+    for (int flush : flushes) printf(" %7d", flush);
+    printf("\n");
+    for (float window : windows) {
+        printf("%36.0f", window);
+        for (int flush : flushes) {
+            power::DutyCycle sweep = cycle;
+            sweep.windowSeconds = window;
+            sweep.flushWindows = flush;
+            printf(" %7.1f", power::batteryDays(profile, power::estimate(profile, sweep)));
+        }
+        printf("\n");
+    }
+    return 0;
+}
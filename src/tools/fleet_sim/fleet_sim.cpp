@@ -0,0 +1,608 @@
+// Fleet load test of the publish path: thousands of virtual nodes against one
+// loopback broker, on the simulated board clock.
+//
+// Each node is put together from the firmware's own classes, as in the
+// default (single loop) build of main.cpp: WaterSensors, the outlier filter
+// and StreamingStats on the sampling side, a SpscQueue of averaged readings,
+// and AdaptiveReporter, a ReadingLog for store-and-forward and MQTTClient
+// (PubSubClient over the loopback pipe, TLS handshake times included) on the
+// network side. Nodes replay the ADC trace from their own starting row and
+// boot at random times within --spread, so their publishes interleave.
+//
+// The simulation advances in one-second epochs. The sampling side of every
+// node runs first, split across --threads worker threads; it only touches
+// the node's own state, so results do not depend on the thread count. The
+// network side then runs as board-clock events in time order, because all
+// nodes share the one broker and the one clock. A node is woken when a
+// reading is due, when a stored reading may be drained, when a reconnect may
+// be tried, and at least every KEEPALIVE_POLL_MS. Time a node spends blocked
+// (a TLS handshake) delays only that node: the clock is put back after each
+// wake and the node's next wake comes after the blocked time.
+//
+// Latency runs from the moment a reading is averaged to the moment the broker
+// has taken it in. With --broker-rate the broker takes in at most that many
+// publishes per second, first come first served, which adds its queueing
+// delay (publishes are QoS 0, so this does not slow the nodes down). With
+// --outage the broker is down for a window, sessions drop and readings go to
+// each node's log, and the report describes the reconnect storm and the
+// backlog drain that follow.
+//
+//   usage: program [--nodes n] [--seconds s] [--threads n] [--trace csv]
+//                  [--sample-interval ms] [--publish-interval ms] [--adaptive 0|1]
+//                  [--spread ms] [--outage start_s length_s] [--broker-rate n]
+//                  [--log-kb n] [--seed n] [--timeline out.csv]
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include "config.h"
+#include "hal.h"
+#include "channels.h"
+#include "reading.h"
+#include "sensors.h"
+#include "outlier_filter.h"
+#include "streaming_stats.h"
+#include "spsc_queue.h"
+#include "adaptive_reporter.h"
+#include "reading_log.h"
+#include "mqtt_client.h"
+#include "time_sync.h"
+#include "flash_emulator.h"
+#include "loopback_broker.h"
+
+namespace {
+
+const uint64_t EPOCH_US = 1000000;
+const uint64_t KEEPALIVE_POLL_MS = 5000;       // MQTT_KEEPALIVE is 15 s
+const uint64_t DISCONNECTED_POLL_MS = 100;     // Reconnects are tried 5 s apart
+const uint64_t STORED_FLAG = 1ULL << 63;
+
+struct Options {
+    size_t nodes = 1000;
+    uint64_t seconds = 600;
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    const char* trace = "traces/reservoir_bench.csv";
+    uint32_t sampleIntervalMs = SAMPLE_INTERVAL;
+    uint32_t publishIntervalMs = MQTT_PUBLISH_INTERVAL;
+    bool adaptive = ADAPTIVE_REPORTING;
+    uint64_t spreadMs = MQTT_PUBLISH_INTERVAL;
+    uint64_t outageStart = 0;
+    uint64_t outageLength = 0;
+    double brokerRate = 0;
+    size_t logKb = 16;
+    uint32_t seed = 1;
+    const char* timeline = nullptr;
+};
+
+void usage() {
+    fprintf(stderr, "usage: program [--nodes n] [--seconds s] [--threads n] [--trace csv]\n"
+                    "               [--sample-interval ms] [--publish-interval ms] [--adaptive 0|1]\n"
+                    "               [--spread ms] [--outage start_s length_s] [--broker-rate n]\n"
+                    "               [--log-kb n] [--seed n] [--timeline out.csv]\n");
+}
+
+// Trace rows (ph,tds,turbidity,temperature codes), shared read-only by every node
+std::vector<int> trace;
+size_t traceRows = 0;
+
+bool loadTrace(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) return false;
+    char line[128];
+    while (fgets(line, sizeof(line), file)) {
+        int codes[4];
+        if (sscanf(line, "%d,%d,%d,%d", &codes[0], &codes[1], &codes[2], &codes[3]) == 4) {
+            trace.insert(trace.end(), codes, codes + 4);
+        }
+    }
+    fclose(file);
+    traceRows = trace.size() / 4;
+    return traceRows > 0;
+}
+
+// ADC of whichever node is sampling on this thread: the trace row it is at.
+// Trace column n is input n of the external ADC (as in native_main.cpp).
+class TraceAdc : public hal::AdcSource {
+private:
+    bool byInput;
+
+public:
+    static inline thread_local const int* row = nullptr;
+
+    explicit TraceAdc(bool externalInputs) : byInput(externalInputs) {}
+
+    int read(uint8_t pin) override {
+        int column = -1;
+        if (byInput) {
+            column = pin < 4 ? pin : -1;
+        } else {
+            switch (pin) {
+                case PH_PIN: column = 0; break;
+                case TDS_PIN: column = 1; break;
+                case TURBIDITY_PIN: column = 2; break;
+                case TEMP_PIN: column = 3; break;
+                default: break;
+            }
+        }
+        return column >= 0 && row != nullptr ? row[column] : 0;
+    }
+};
+
+TraceAdc onchipTrace(false);
+#if EXTERNAL_ADC
+TraceAdc externalTrace(true);
+#endif
+
+struct QueuedReading {
+    WaterReading reading;
+    uint64_t averagedUs;
+};
+
+// A publish that reached the broker; averagedUs carries STORED_FLAG for
+// readings that went through the log
+struct Arrival {
+    uint64_t atUs;
+    uint64_t averagedUs;
+};
+
+struct PerSecond {
+    uint32_t publishes = 0;
+    uint64_t payloadBytes = 0;
+    uint32_t connects = 0;
+    uint32_t sessions = 0;
+    uint64_t backlog = 0;
+};
+
+struct FleetStats {
+    std::vector<Arrival> arrivals;
+    std::vector<PerSecond> timeline;
+    uint64_t startUs = 0;
+    uint64_t suppressed = 0;
+    uint64_t stored = 0;
+    uint64_t lost = 0;
+    uint64_t wakes = 0;
+
+    // Set by the node publishing, read by the broker's publish handler
+    uint64_t publishingAveragedUs = 0;
+};
+
+FleetStats fleet;
+Settings settings;
+uint32_t wallBase = 0;           // Unix time at board time 0
+constexpr auto reportDeadbands = channelField(&ChannelSpec::deadband);
+
+class VirtualNode {
+private:
+    // Sampling side
+    WaterSensors sensors;
+#if OUTLIER_FILTER
+    HampelFilter<SENSOR_CHANNEL_COUNT, 15> outlierFilter{OUTLIER_WINDOW, OUTLIER_THRESHOLD};
+#endif
+    StreamingStats<SENSOR_CHANNEL_COUNT, SAMPLE_WINDOW_MAX> sampleStats{SAMPLE_WINDOW};
+    size_t traceRow;
+    uint64_t nextSampleUs;
+    uint64_t nextAverageUs;
+    uint64_t averages = 0;
+
+    // Handed from the sampling side to the network side
+    SpscQueue<QueuedReading, READING_QUEUE_LENGTH> readingQueue;
+
+    // Network side
+    MQTTClient mqttClient;
+#if TLS_SESSION_RESUMPTION
+    TlsSessionCache tlsSession{};
+#endif
+    AdaptiveReporter reporter{reportDeadbands.data(), ADAPTIVE_CUSUM_SLACK, ADAPTIVE_CUSUM_LIMIT, ADAPTIVE_HEARTBEAT,
+                              ADAPTIVE_ALARM_HOLD};
+    native::FlashEmulator logStorage;
+    ReadingLog readingLog{logStorage};
+    bool logReady = false;
+    std::deque<uint64_t> storedAveragedUs;   // Averaging time of each pending log record
+    uint32_t logDropped = 0;
+    uint64_t lastDrainUs = 0;
+
+    static uint64_t now() { return native::boardClock().microseconds; }
+
+    bool publish(const WaterReading& reading, uint64_t averagedUs) {
+        fleet.publishingAveragedUs = averagedUs;
+        return mqttClient.publishWaterData(reading);
+    }
+
+    // Readings the log overwrote before they could be sent
+    void countLogDrops() {
+        while (logDropped < readingLog.dropped()) {
+            logDropped++;
+            fleet.lost++;
+            if (!storedAveragedUs.empty()) storedAveragedUs.pop_front();
+        }
+    }
+
+    // routeReading() and deliverReadings() of main.cpp, one reading at a time
+    void route(const QueuedReading& queued) {
+        if (settings.adaptiveReporting && reporter.evaluate(queued.reading) == AdaptiveReporter::SUPPRESSED) {
+            fleet.suppressed++;
+            return;
+        }
+        if (mqttClient.isConnected() && publish(queued.reading, queued.averagedUs)) {
+            return;
+        }
+        if (logReady && readingLog.append(queued.reading)) {
+            fleet.stored++;
+            storedAveragedUs.push_back(queued.averagedUs);
+            countLogDrops();
+        } else {
+            fleet.lost++;
+        }
+    }
+
+    // drainStoredReadings() of main.cpp
+    void drain() {
+        if (!logReady || readingLog.pending() == 0 || now() - lastDrainUs < STORE_DRAIN_INTERVAL * 1000ULL) {
+            return;
+        }
+        lastDrainUs = now();
+        WaterReading reading;
+        for (int sent = 0; sent < STORE_DRAIN_BATCH && readingLog.peek(reading); sent++) {
+            countLogDrops();
+            uint64_t averagedUs = storedAveragedUs.empty() ? now() : storedAveragedUs.front();
+            if (!publish(reading, averagedUs | STORED_FLAG)) break;
+            readingLog.markSent();
+            if (!storedAveragedUs.empty()) storedAveragedUs.pop_front();
+        }
+    }
+
+    void service() {
+        mqttClient.loop();
+        const QueuedReading* next;
+        while ((next = readingQueue.peek()) != nullptr && next->averagedUs <= now()) {
+            QueuedReading queued;
+            readingQueue.pop(queued);
+            route(queued);
+        }
+        if (mqttClient.isConnected()) drain();
+    }
+
+    void schedule(uint64_t atUs) {
+        native::boardClock().schedule(atUs, [this] { wake(); });
+    }
+
+public:
+    VirtualNode(size_t logBytes, size_t firstRow, uint64_t bootUs)
+        : traceRow(firstRow), logStorage(logBytes, 4096) {
+        nextSampleUs = bootUs + settings.sampleIntervalMs * 1000ULL;
+        nextAverageUs = bootUs + settings.publishIntervalMs * 1000ULL;
+        sensors.init();
+#if EXTERNAL_ADC
+        sensors.attach(ADC_BUS_ADS1115, &externalTrace);
+#endif
+        sensors.setPhWindowSize(settings.phWindow);
+        sampleStats.setWindow(settings.sampleWindow);
+#if OUTLIER_FILTER
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            outlierFilter.setMinDeviation(c, CHANNELS[c].minDeviation);
+        }
+#endif
+        reporter.setLimits({ALARM_PH_MIN, ALARM_PH_MAX, ALARM_TURBIDITY_MAX});
+#if TLS_SESSION_RESUMPTION
+        mqttClient.setSessionCache(tlsSession);
+#endif
+        mqttClient.init();
+        logReady = readingLog.begin();
+        schedule(bootUs);
+    }
+
+    // Sampling side: every sample and average due before endUs, as loop()
+    // takes them (a sample first when both fall due together)
+    void sampleUntil(uint64_t endUs) {
+        while (nextSampleUs < endUs || nextAverageUs < endUs) {
+            if (nextSampleUs <= nextAverageUs) {
+                TraceAdc::row = &trace[traceRow * 4];
+                traceRow = (traceRow + 1) % traceRows;
+                sensors.readSensors();
+                float sample[SENSOR_CHANNEL_COUNT];
+                sensors.copyValues(sample);
+#if OUTLIER_FILTER
+                outlierFilter.apply(sample);
+#endif
+                sampleStats.push(sample);
+                nextSampleUs += settings.sampleIntervalMs * 1000ULL;
+            } else {
+                QueuedReading queued;
+                queued.averagedUs = nextAverageUs;
+                queued.reading.timestamp = wallBase + (uint32_t)(nextAverageUs / 1000000ULL);
+                for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+                    queued.reading.values[c] = sampleStats.mean(c);
+                }
+                readingQueue.push(queued);
+                averages++;
+                nextAverageUs += settings.publishIntervalMs * 1000ULL;
+            }
+        }
+    }
+
+    // Network side, as a board-clock event
+    void wake() {
+        native::BoardClock& clock = native::boardClock();
+        uint64_t start = clock.microseconds;
+        fleet.wakes++;
+        service();
+        uint64_t blockedUntil = clock.microseconds;
+        clock.microseconds = start;
+
+        bool connected = mqttClient.isConnected();
+        uint64_t next = start + (connected ? KEEPALIVE_POLL_MS : DISCONNECTED_POLL_MS) * 1000ULL;
+        const QueuedReading* queued = readingQueue.peek();
+        next = std::min(next, queued != nullptr ? queued->averagedUs : nextAverageUs);
+        if (connected && logReady && readingLog.pending() > 0) {
+            next = std::min(next, lastDrainUs + (uint64_t)STORE_DRAIN_INTERVAL * 1000);
+        }
+        schedule(std::max(next, std::max(blockedUntil, start + 1)));
+    }
+
+    uint64_t averaged() const { return averages; }
+    size_t backlog() const { return logReady ? readingLog.pending() : 0; }
+    uint32_t queueDrops() const { return readingQueue.dropCount(); }
+#if TLS_SESSION_RESUMPTION
+    unsigned long fullHandshakes() const { return mqttClient.tlsHandshakes(); }
+    unsigned long resumedHandshakes() const { return mqttClient.tlsResumptions(); }
+#endif
+};
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (value == nullptr) return false;
+        i++;
+        if (strcmp(arg, "--nodes") == 0) {
+            options.nodes = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--seconds") == 0) {
+            options.seconds = strtoull(value, nullptr, 10);
+        } else if (strcmp(arg, "--threads") == 0) {
+            options.threads = std::max(1ul, strtoul(value, nullptr, 10));
+        } else if (strcmp(arg, "--trace") == 0) {
+            options.trace = value;
+        } else if (strcmp(arg, "--sample-interval") == 0) {
+            options.sampleIntervalMs = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--publish-interval") == 0) {
+            options.publishIntervalMs = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--adaptive") == 0) {
+            options.adaptive = atoi(value) != 0;
+        } else if (strcmp(arg, "--spread") == 0) {
+            options.spreadMs = strtoull(value, nullptr, 10);
+        } else if (strcmp(arg, "--outage") == 0 && i + 1 < argc) {
+            options.outageStart = strtoull(value, nullptr, 10);
+            options.outageLength = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(arg, "--broker-rate") == 0) {
+            options.brokerRate = atof(value);
+        } else if (strcmp(arg, "--log-kb") == 0) {
+            options.logKb = strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--seed") == 0) {
+            options.seed = (uint32_t)strtoul(value, nullptr, 10);
+        } else if (strcmp(arg, "--timeline") == 0) {
+            options.timeline = value;
+        } else {
+            return false;
+        }
+    }
+    return options.nodes > 0 && options.nodes < (1u << 24) && options.seconds > 0 &&
+           options.sampleIntervalMs > 0 && options.publishIntervalMs > 0 && options.logKb >= 8;
+}
+
+// Latency percentiles in ms of one kind of reading
+void printLatencies(const char* label, std::vector<uint64_t>& latencies) {
+    if (latencies.empty()) {
+        printf("  %-8s %10d\n", label, 0);
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto at = [&](double q) {
+        size_t rank = (size_t)std::ceil(q * latencies.size());
+        return latencies[rank > 0 ? rank - 1 : 0] / 1000.0;
+    };
+    printf("  %-8s %10zu %10.1f %10.1f %10.1f %10.1f %10.1f\n", label, latencies.size(), at(0.5), at(0.9),
+           at(0.99), at(0.999), latencies.back() / 1000.0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+    if (!loadTrace(options.trace)) {
+        fprintf(stderr, "Cannot load ADC trace %s\n", options.trace);
+        return 1;
+    }
+    settings.sampleIntervalMs = options.sampleIntervalMs;
+    settings.publishIntervalMs = options.publishIntervalMs;
+    settings.adaptiveReporting = options.adaptive;
+
+    // Console output of the nodes is dropped; the link and the clock are shared
+    Serial.setEcho(false);
+    hal::setAdcSource(&onchipTrace);
+    LoopbackBroker& broker = LoopbackBroker::instance();
+    native::BoardClock& clock = native::boardClock();
+    WiFi.begin("fleet", nullptr);
+    configTime(19800, 0, "pool.ntp.org", "time.nist.gov");
+    while (TimeSync::provisional((uint32_t)hal::now())) {
+        clock.advanceMillis(100);
+        WiFi.status();
+    }
+    fleet.startUs = clock.microseconds;
+    wallBase = (uint32_t)(hal::now() - clock.microseconds / 1000000ULL);
+
+    std::mt19937 random(options.seed);
+    std::vector<std::unique_ptr<VirtualNode>> nodes;
+    nodes.reserve(options.nodes);
+    for (size_t i = 0; i < options.nodes; i++) {
+        // The device ID comes from the last three bytes of the MAC address
+        const uint8_t mac[6] = {0x24, 0x6F, 0x28, (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i};
+        WiFi.setMacAddress(mac);
+        uint64_t bootUs = fleet.startUs + (options.spreadMs > 0 ? random() % (options.spreadMs * 1000ULL) : 0);
+        nodes.emplace_back(new VirtualNode(options.logKb * 1024, random() % traceRows, bootUs));
+    }
+
+    uint64_t endUs = fleet.startUs + options.seconds * EPOCH_US;
+    if (options.outageLength > 0) {
+        uint64_t down = fleet.startUs + options.outageStart * EPOCH_US;
+        clock.schedule(down, [&broker] { broker.setOnline(false); });
+        clock.schedule(down + options.outageLength * EPOCH_US, [&broker] { broker.setOnline(true); });
+    }
+    broker.onPublish([&clock](const std::string&, const uint8_t*, size_t length) {
+        fleet.arrivals.push_back({clock.microseconds, fleet.publishingAveragedUs});
+        size_t second = (size_t)((clock.microseconds - fleet.startUs) / EPOCH_US);
+        if (second < fleet.timeline.size()) {
+            fleet.timeline[second].publishes++;
+            fleet.timeline[second].payloadBytes += length;
+        }
+    });
+    fleet.timeline.resize(options.seconds);
+
+    double samplingSeconds = 0, networkSeconds = 0;
+    unsigned long connects = broker.connects();
+    auto wallStart = std::chrono::steady_clock::now();
+    for (uint64_t epoch = fleet.startUs, second = 0; epoch < endUs; epoch += EPOCH_US, second++) {
+        uint64_t until = epoch + EPOCH_US;
+
+        // Sampling side of every node, a contiguous share per thread
+        auto t0 = std::chrono::steady_clock::now();
+        size_t threads = std::min(options.threads, nodes.size());
+        auto share = [&](size_t t) {
+            for (size_t i = t * nodes.size() / threads; i < (t + 1) * nodes.size() / threads; i++) {
+                nodes[i]->sampleUntil(until);
+            }
+        };
+        std::vector<std::thread> workers;
+        for (size_t t = 1; t < threads; t++) workers.emplace_back(share, t);
+        share(0);
+        for (std::thread& worker : workers) worker.join();
+
+        // Network side, every wake before the next epoch in time order
+        auto t1 = std::chrono::steady_clock::now();
+        clock.advanceTo(until - 1);
+        hal::flushConsole();
+        auto t2 = std::chrono::steady_clock::now();
+        samplingSeconds += std::chrono::duration<double>(t1 - t0).count();
+        networkSeconds += std::chrono::duration<double>(t2 - t1).count();
+
+        PerSecond& row = fleet.timeline[second];
+        row.connects = (uint32_t)(broker.connects() - connects);
+        connects = broker.connects();
+        row.sessions = (uint32_t)broker.sessionCount();
+        for (auto& node : nodes) row.backlog += node->backlog();
+    }
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+    // Broker ingest in arrival order: each publish waits for the ones before it
+    std::sort(fleet.arrivals.begin(), fleet.arrivals.end(),
+              [](const Arrival& a, const Arrival& b) { return a.atUs < b.atUs; });
+    std::vector<uint64_t> live, stored;
+    double brokerFreeUs = 0, busyUs = 0;
+    double serviceUs = options.brokerRate > 0 ? 1e6 / options.brokerRate : 0;
+    for (const Arrival& arrival : fleet.arrivals) {
+        double done = std::max((double)arrival.atUs, brokerFreeUs) + serviceUs;
+        brokerFreeUs = done;
+        busyUs += serviceUs;
+        uint64_t averagedUs = arrival.averagedUs & ~STORED_FLAG;
+        uint64_t latency = (uint64_t)done > averagedUs ? (uint64_t)done - averagedUs : 0;
+        ((arrival.averagedUs & STORED_FLAG) ? stored : live).push_back(latency);
+    }
+
+    uint32_t peakPublishes = 0;
+    uint64_t payloadBytes = 0;
+    for (const PerSecond& row : fleet.timeline) {
+        peakPublishes = std::max(peakPublishes, row.publishes);
+        payloadBytes += row.payloadBytes;
+    }
+    uint64_t averaged = 0;
+    for (auto& node : nodes) {
+        averaged += node->averaged();
+        fleet.lost += node->queueDrops();
+    }
+
+    printf("%zu nodes, %llu s simulated in %.1f s on %zu threads (%.0fx real time)\n", nodes.size(),
+           (unsigned long long)options.seconds, wallSeconds, std::min(options.threads, nodes.size()),
+           options.seconds / wallSeconds);
+    printf("  sampling side %.2f s, network side %.2f s for %llu wakes\n", samplingSeconds, networkSeconds,
+           (unsigned long long)fleet.wakes);
+    printf("broker: %zu publishes, %.1f MB payload; mean %.1f/s, peak %u/s; %lu connects",
+           fleet.arrivals.size(), payloadBytes / 1e6, fleet.arrivals.size() / (double)options.seconds,
+           peakPublishes, broker.connects());
+#if TLS_SESSION_RESUMPTION
+    unsigned long full = 0, resumed = 0;
+    for (auto& node : nodes) {
+        full += node->fullHandshakes();
+        resumed += node->resumedHandshakes();
+    }
+    printf(" (%lu full TLS handshakes, %lu resumed)", full, resumed);
+#endif
+    printf("\n");
+    if (options.brokerRate > 0) {
+        printf("  at %.0f publishes/s the broker is busy %.1f%% of the time\n", options.brokerRate,
+               100.0 * busyUs / (options.seconds * 1e6));
+    }
+    printf("  host: %.0f publishes taken in per wall-clock second of the network side\n",
+           fleet.arrivals.size() / networkSeconds);
+    printf("readings: %llu averaged, %llu suppressed by adaptive reporting, %zu published live,\n"
+           "  %llu stored, %zu of them delivered later, %llu lost\n",
+           (unsigned long long)averaged, (unsigned long long)fleet.suppressed, live.size(),
+           (unsigned long long)fleet.stored, stored.size(), (unsigned long long)fleet.lost);
+    printf("latency (ms)  %10s %10s %10s %10s %10s %10s\n", "count", "p50", "p90", "p99", "p99.9", "max");
+    printLatencies("live", live);
+    printLatencies("stored", stored);
+
+    if (options.outageLength > 0 && options.outageStart + options.outageLength < options.seconds) {
+        size_t back = (size_t)(options.outageStart + options.outageLength);
+        size_t reconnected = 0, drained = 0;
+        uint32_t peakConnects = 0, stormPublishes = 0;
+        uint64_t stormConnects = 0;
+        for (size_t s = back; s < fleet.timeline.size(); s++) {
+            const PerSecond& row = fleet.timeline[s];
+            if (reconnected == 0) stormConnects += row.connects;
+            if (reconnected == 0 && row.sessions == nodes.size()) reconnected = s;
+            if (drained == 0 && row.backlog == 0) drained = s;
+            peakConnects = std::max(peakConnects, row.connects);
+            stormPublishes = std::max(stormPublishes, row.publishes);
+        }
+        printf("outage: broker down %llu s from %llu s, %llu readings pending at its end\n",
+               (unsigned long long)options.outageLength, (unsigned long long)options.outageStart,
+               (unsigned long long)fleet.timeline[back - 1].backlog);
+        if (reconnected > 0) {
+            printf("  every node reconnected %zu s later, %llu connects, peak %u/s\n", reconnected + 1 - back,
+                   (unsigned long long)stormConnects, peakConnects);
+        } else {
+            printf("  not every node had reconnected by the end of the run\n");
+        }
+        if (drained > 0) {
+            printf("  backlog drained %zu s after the broker came back, peak %u publishes/s\n",
+                   drained + 1 - back, stormPublishes);
+        } else {
+            printf("  backlog not drained by the end of the run, peak %u publishes/s\n", stormPublishes);
+        }
+    }
+
+    if (options.timeline != nullptr) {
+        FILE* out = fopen(options.timeline, "w");
+        if (out == nullptr) {
+            fprintf(stderr, "Cannot write %s\n", options.timeline);
+            return 1;
+        }
+        fprintf(out, "second,publishes,payload_bytes,connects,sessions,backlog\n");
+        for (size_t s = 0; s < fleet.timeline.size(); s++) {
+            const PerSecond& row = fleet.timeline[s];
+            fprintf(out, "%zu,%u,%llu,%u,%u,%llu\n", s, row.publishes, (unsigned long long)row.payloadBytes,
+                    row.connects, row.sessions, (unsigned long long)row.backlog);
+        }
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,690 @@
+// Columnar archive of published readings, with block-skipping range queries.
+// An archive is a directory with one file per field, so a query reads only
+// the columns it needs, straight from memory-mapped files:
+//
+//   archive.meta   magic, version, channel keys, committed row/device counts
+//   time.col       uint32 Unix time (UTC) per row
+//   device.col     uint16 line of devices.txt per row
+//   <key>.col      float per row, one file per channel of channels.h
+//   blocks.idx     per BLOCK_ROWS rows: time range and per-channel min/max
+//   devices.txt    device IDs, one per line
+//
+// ingest appends readings in the publishWaterData() schema (any text holding
+// the data messages as flat JSON objects, such as a subscriber log or the
+// "[broker]" lines of a native run; other objects are skipped) without
+// rewriting what is stored: the columns grow at the end, the summary of the
+// last, partial block is rewritten in place, and the meta file is replaced
+// last. Rows beyond the committed count (an interrupted ingest) are cut off
+// by the next one. The firmware publishes local time labelled +00:00 (see
+// JsonWriter::timestamp); --export reads the naive UTC timestamps of the
+// analytics/mongoRetrieve.py export instead.
+//
+// query prints the rows in a time range (UTC) that meet any of the given
+// thresholds as CSV that report_replay reads. Blocks whose summaries rule out
+// every threshold or the time range are skipped without touching their rows;
+// --scan reads every block, for comparison.
+//
+//   usage: program ingest [--export] archive [file...]
+//          program query [--from t] [--to t] [--above key=v] [--below key=v]
+//                        [--unsafe-ph] [--high-turbidity] [--count] [--scan] archive
+//          program info archive
+//   t is YYYY-MM-DD or YYYY-MM-DDTHH:MM:SS
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "channels.h"
+#include "reading.h"
+
+namespace {
+
+const char MAGIC[8] = {'W', 'Q', 'A', 'R', 'C', 'H', 0, 0};
+const uint32_t FORMAT_VERSION = 1;
+const uint32_t BLOCK_ROWS = 1024;
+const size_t KEY_LENGTH = 32;
+const int32_t FIRMWARE_UTC_OFFSET = 19800;    // JsonWriter::timestamp()
+
+struct MetaHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t channels;
+    uint32_t blockRows;
+    uint32_t devices;
+    uint64_t rows;
+};
+
+// Zone map of one block
+struct BlockSummary {
+    uint32_t minTime;
+    uint32_t maxTime;
+    float min[SENSOR_CHANNEL_COUNT];
+    float max[SENSOR_CHANNEL_COUNT];
+};
+
+void usage() {
+    fprintf(stderr, "usage: program ingest [--export] archive [file...]\n"
+                    "       program query [--from t] [--to t] [--above key=v] [--below key=v]\n"
+                    "                     [--unsafe-ph] [--high-turbidity] [--count] [--scan] archive\n"
+                    "       program info archive\n"
+                    "t is YYYY-MM-DD or YYYY-MM-DDTHH:MM:SS\n");
+}
+
+std::string columnPath(const std::string& dir, const char* name) { return dir + "/" + name + ".col"; }
+
+// Days since 1970-01-01 of a civil date (proleptic Gregorian)
+int64_t daysFromCivil(int64_t y, int mo, int d) {
+    y -= mo <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (mo + (mo > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// "YYYY-MM-DD HH:MM:SS" of a Unix time
+void formatTime(uint32_t unixTime, char* out, size_t size) {
+    int64_t days = unixTime / 86400;
+    uint32_t second = unixTime % 86400;
+    days += 719468;
+    int64_t era = days / 146097;
+    int64_t doe = days - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    int d = (int)(doy - (153 * mp + 2) / 5 + 1);
+    int mo = (int)(mp < 10 ? mp + 3 : mp - 9);
+    int y = (int)(yoe + era * 400 + (mo <= 2));
+    snprintf(out, size, "%04d-%02d-%02d %02u:%02u:%02u", y, mo, d, second / 3600, second / 60 % 60, second % 60);
+}
+
+// Value of count digits at text, or -1
+int digits(const char* text, int count) {
+    int value = 0;
+    for (int i = 0; i < count; i++) {
+        if (text[i] < '0' || text[i] > '9') return -1;
+        value = value * 10 + (text[i] - '0');
+    }
+    return value;
+}
+
+// Seconds since the epoch of "YYYY-MM-DD[THH:MM:SS]" read as UTC (anything
+// after the seconds is ignored); false if malformed
+bool parseTime(const char* text, int64_t& seconds) {
+    // Checked field by field, so nothing past the end of a short text is read
+    int y = digits(text, 4);
+    if (y < 0 || text[4] != '-') return false;
+    int mo = digits(text + 5, 2);
+    if (mo < 1 || mo > 12 || text[7] != '-') return false;
+    int d = digits(text + 8, 2);
+    if (d < 1 || d > 31) return false;
+    int h = 0, mi = 0, s = 0;
+    if (text[10] == 'T' || text[10] == ' ') {
+        if ((h = digits(text + 11, 2)) < 0 || text[13] != ':') return false;
+        if ((mi = digits(text + 14, 2)) < 0 || text[16] != ':') return false;
+        if ((s = digits(text + 17, 2)) < 0) return false;
+    } else if (text[10] != '\0' && text[10] != '"') {
+        return false;
+    }
+    seconds = daysFromCivil(y, mo, d) * 86400 + h * 3600 + mi * 60 + s;
+    return true;
+}
+
+int channelOf(const char* key, size_t length) {
+    for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        if (strlen(CHANNELS[c].key) == length && memcmp(CHANNELS[c].key, key, length) == 0) return (int)c;
+    }
+    return -1;
+}
+
+// Read-only view of a file
+class MappedFile {
+private:
+    void* base = nullptr;
+    size_t length = 0;
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() {
+        if (base != nullptr) munmap(base, length);
+    }
+
+    // Maps the first bytes bytes; false if the file is shorter
+    bool map(const std::string& path, size_t bytes) {
+        if (bytes == 0) return true;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        bool ok = fstat(fd, &info) == 0 && (size_t)info.st_size >= bytes;
+        if (ok) {
+            base = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+            ok = base != MAP_FAILED;
+            if (!ok) base = nullptr;
+        }
+        close(fd);
+        length = ok ? bytes : 0;
+        return ok;
+    }
+
+    template <typename T>
+    const T* as() const { return static_cast<const T*>(base); }
+};
+
+// Committed state of an archive and, once mapped, its columns
+class Archive {
+public:
+    std::string dir;
+    MetaHeader header{};
+    std::vector<std::string> devices;
+
+    MappedFile time;
+    MappedFile device;
+    MappedFile values[SENSOR_CHANNEL_COUNT];
+    MappedFile summaries;
+
+    uint64_t rows() const { return header.rows; }
+    size_t blocks() const { return (size_t)((header.rows + header.blockRows - 1) / header.blockRows); }
+
+    // Reads archive.meta and devices.txt; false with a message if the archive
+    // is unreadable or was made for other channels. missing is set when there
+    // is no archive at all.
+    bool load(const std::string& path, bool& missing) {
+        dir = path;
+        missing = false;
+        FILE* file = fopen((dir + "/archive.meta").c_str(), "rb");
+        if (file == nullptr) {
+            missing = true;
+            return false;
+        }
+        bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                  header.version == FORMAT_VERSION && header.blockRows == BLOCK_ROWS;
+        if (!ok) {
+            fclose(file);
+            fprintf(stderr, "%s: not an archive of this version\n", dir.c_str());
+            return false;
+        }
+        ok = header.channels == SENSOR_CHANNEL_COUNT;
+        for (size_t c = 0; ok && c < SENSOR_CHANNEL_COUNT; c++) {
+            char key[KEY_LENGTH];
+            ok = fread(key, sizeof(key), 1, file) == 1 && strncmp(key, CHANNELS[c].key, sizeof(key)) == 0;
+        }
+        fclose(file);
+        if (!ok) {
+            fprintf(stderr, "%s: archived channels differ from channels.h\n", dir.c_str());
+            return false;
+        }
+
+        file = fopen((dir + "/devices.txt").c_str(), "r");
+        char line[128];
+        while (file != nullptr && devices.size() < header.devices && fgets(line, sizeof(line), file) != nullptr) {
+            line[strcspn(line, "\n")] = '\0';
+            devices.push_back(line);
+        }
+        if (file != nullptr) fclose(file);
+        if (devices.size() != header.devices) {
+            fprintf(stderr, "%s: devices.txt is short\n", dir.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool mapColumns() {
+        bool ok = time.map(columnPath(dir, "time"), header.rows * sizeof(uint32_t)) &&
+                  device.map(columnPath(dir, "device"), header.rows * sizeof(uint16_t)) &&
+                  summaries.map(dir + "/blocks.idx", blocks() * sizeof(BlockSummary));
+        for (size_t c = 0; ok && c < SENSOR_CHANNEL_COUNT; c++) {
+            ok = values[c].map(columnPath(dir, CHANNELS[c].key), header.rows * sizeof(float));
+        }
+        if (!ok) fprintf(stderr, "%s: column files are shorter than archive.meta says\n", dir.c_str());
+        return ok;
+    }
+
+    const BlockSummary& summary(size_t block) const { return summaries.as<BlockSummary>()[block]; }
+};
+
+// Appends to an archive; nothing is visible to readers until commit()
+class ArchiveWriter {
+private:
+    Archive& archive;
+    std::map<std::string, uint16_t> deviceNumbers;
+    FILE* time = nullptr;
+    FILE* device = nullptr;
+    FILE* values[SENSOR_CHANNEL_COUNT] = {};
+    std::vector<BlockSummary> pending;        // From the first block this ingest touches
+    size_t firstPendingBlock = 0;
+    uint64_t rows;
+    size_t committedDevices;
+
+    // Opens a column for appending after its committed rows
+    FILE* openColumn(const std::string& path, size_t bytes) {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+        if (fd < 0 || ftruncate(fd, (off_t)bytes) != 0 || lseek(fd, 0, SEEK_END) < 0) {
+            if (fd >= 0) close(fd);
+            return nullptr;
+        }
+        return fdopen(fd, "ab");
+    }
+
+    static bool flush(FILE* file) { return fflush(file) == 0 && fsync(fileno(file)) == 0; }
+
+public:
+    explicit ArchiveWriter(Archive& target) : archive(target), rows(target.header.rows),
+                                              committedDevices(target.devices.size()) {}
+
+    ~ArchiveWriter() {
+        for (FILE* file : {time, device}) {
+            if (file != nullptr) fclose(file);
+        }
+        for (FILE* file : values) {
+            if (file != nullptr) fclose(file);
+        }
+    }
+
+    bool begin() {
+        for (size_t i = 0; i < archive.devices.size(); i++) deviceNumbers[archive.devices[i]] = (uint16_t)i;
+        time = openColumn(columnPath(archive.dir, "time"), rows * sizeof(uint32_t));
+        device = openColumn(columnPath(archive.dir, "device"), rows * sizeof(uint16_t));
+        bool ok = time != nullptr && device != nullptr;
+        for (size_t c = 0; ok && c < SENSOR_CHANNEL_COUNT; c++) {
+            values[c] = openColumn(columnPath(archive.dir, CHANNELS[c].key), rows * sizeof(float));
+            ok = values[c] != nullptr;
+        }
+        // The last block may be partial; its summary is extended and rewritten
+        firstPendingBlock = (size_t)(rows / BLOCK_ROWS);
+        if (ok && rows % BLOCK_ROWS != 0) {
+            FILE* index = fopen((archive.dir + "/blocks.idx").c_str(), "rb");
+            BlockSummary last;
+            ok = index != nullptr && fseek(index, (long)(firstPendingBlock * sizeof(last)), SEEK_SET) == 0 &&
+                 fread(&last, sizeof(last), 1, index) == 1;
+            if (index != nullptr) fclose(index);
+            if (ok) pending.push_back(last);
+        }
+        if (!ok) fprintf(stderr, "%s: cannot open the archive for appending\n", archive.dir.c_str());
+        return ok;
+    }
+
+    bool append(const char* deviceId, const WaterReading& reading) {
+        auto found = deviceNumbers.find(deviceId);
+        uint16_t number;
+        if (found != deviceNumbers.end()) {
+            number = found->second;
+        } else if (archive.devices.size() < UINT16_MAX) {
+            number = (uint16_t)archive.devices.size();
+            deviceNumbers[deviceId] = number;
+            archive.devices.push_back(deviceId);
+        } else {
+            return false;
+        }
+        if (rows % BLOCK_ROWS == 0) {
+            BlockSummary fresh;
+            fresh.minTime = UINT32_MAX;
+            fresh.maxTime = 0;
+            for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+                fresh.min[c] = INFINITY;
+                fresh.max[c] = -INFINITY;
+            }
+            pending.push_back(fresh);
+        }
+        BlockSummary& block = pending.back();
+        block.minTime = std::min(block.minTime, reading.timestamp);
+        block.maxTime = std::max(block.maxTime, reading.timestamp);
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            block.min[c] = std::min(block.min[c], reading.values[c]);
+            block.max[c] = std::max(block.max[c], reading.values[c]);
+        }
+        fwrite(&reading.timestamp, sizeof(reading.timestamp), 1, time);
+        fwrite(&number, sizeof(number), 1, device);
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) fwrite(&reading.values[c], sizeof(float), 1, values[c]);
+        rows++;
+        return true;
+    }
+
+    // Columns, then summaries and devices, then the meta file that makes them count
+    bool commit() {
+        bool ok = flush(time) && flush(device);
+        for (size_t c = 0; ok && c < SENSOR_CHANNEL_COUNT; c++) ok = flush(values[c]);
+
+        int fd = ::open((archive.dir + "/blocks.idx").c_str(), O_WRONLY | O_CREAT, 0644);
+        size_t bytes = pending.size() * sizeof(BlockSummary);
+        off_t offset = (off_t)(firstPendingBlock * sizeof(BlockSummary));
+        ok = ok && fd >= 0 && pwrite(fd, pending.data(), bytes, offset) == (ssize_t)bytes && fsync(fd) == 0;
+        if (fd >= 0) close(fd);
+
+        FILE* names = fopen((archive.dir + "/devices.txt").c_str(), committedDevices == 0 ? "w" : "a");
+        for (size_t i = committedDevices; ok && names != nullptr && i < archive.devices.size(); i++) {
+            fprintf(names, "%s\n", archive.devices[i].c_str());
+        }
+        ok = ok && names != nullptr && flush(names);
+        if (names != nullptr) fclose(names);
+
+        MetaHeader header;
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = FORMAT_VERSION;
+        header.channels = SENSOR_CHANNEL_COUNT;
+        header.blockRows = BLOCK_ROWS;
+        header.devices = (uint32_t)archive.devices.size();
+        header.rows = rows;
+        std::string temporary = archive.dir + "/archive.meta.tmp";
+        FILE* meta = ok ? fopen(temporary.c_str(), "wb") : nullptr;
+        ok = meta != nullptr && fwrite(&header, sizeof(header), 1, meta) == 1;
+        for (size_t c = 0; ok && c < SENSOR_CHANNEL_COUNT; c++) {
+            char key[KEY_LENGTH] = {};
+            strncpy(key, CHANNELS[c].key, sizeof(key) - 1);
+            ok = fwrite(key, sizeof(key), 1, meta) == 1;
+        }
+        ok = ok && flush(meta);
+        if (meta != nullptr) fclose(meta);
+        ok = ok && rename(temporary.c_str(), (archive.dir + "/archive.meta").c_str()) == 0;
+        if (ok) archive.header = header;
+        return ok;
+    }
+
+    uint64_t rowCount() const { return rows; }
+};
+
+// Calls found(deviceId, reading) for every flat object in text that holds a
+// deviceId, a timestamp and every channel
+template <typename Found>
+size_t scanMessages(const std::string& text, int32_t utcOffset, Found found) {
+    size_t skipped = 0;
+    for (size_t begin = text.find('{'); begin != std::string::npos; begin = text.find('{', begin + 1)) {
+        size_t end = text.find_first_of("{}", begin + 1);
+        if (end == std::string::npos) break;
+        if (text[end] == '{') continue;     // Not flat (a batch message)
+        std::string deviceId;
+        int64_t seconds = -1;
+        WaterReading reading;
+        bool seen[SENSOR_CHANNEL_COUNT] = {};
+        const char* p = text.c_str() + begin + 1;
+        const char* stop = text.c_str() + end;
+        while (p < stop) {
+            const char* key = (const char*)memchr(p, '"', (size_t)(stop - p));
+            if (key == nullptr) break;
+            const char* keyEnd = (const char*)memchr(key + 1, '"', (size_t)(stop - key - 1));
+            if (keyEnd == nullptr) break;
+            const char* value = keyEnd + 1;
+            while (value < stop && (*value == ':' || *value == ' ')) value++;
+            const char* valueEnd;
+            if (value < stop && *value == '"') {
+                valueEnd = (const char*)memchr(value + 1, '"', (size_t)(stop - value - 1));
+                if (valueEnd == nullptr) break;
+                size_t length = (size_t)(keyEnd - key - 1);
+                if (length == 8 && memcmp(key + 1, "deviceId", 8) == 0) {
+                    deviceId.assign(value + 1, valueEnd);
+                } else if (length == 9 && memcmp(key + 1, "timestamp", 9) == 0 && parseTime(value + 1, seconds)) {
+                    seconds -= utcOffset;
+                }
+                valueEnd++;
+            } else {
+                valueEnd = value;
+                while (valueEnd < stop && *valueEnd != ',') valueEnd++;
+                int c = channelOf(key + 1, (size_t)(keyEnd - key - 1));
+                char* parsed;
+                if (c >= 0) {
+                    reading.values[c] = strtof(value, &parsed);
+                    seen[c] = parsed != value;
+                }
+            }
+            p = valueEnd;
+        }
+        bool complete = !deviceId.empty() && seconds >= 0 && seconds <= UINT32_MAX;
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) complete = complete && seen[c];
+        if (!complete) {
+            skipped++;
+            continue;
+        }
+        reading.timestamp = (uint32_t)seconds;
+        found(deviceId, reading);
+        begin = end;
+    }
+    return skipped;
+}
+
+bool readAll(FILE* file, std::string& text) {
+    char chunk[1 << 16];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) text.append(chunk, n);
+    return !ferror(file);
+}
+
+int ingest(int argc, char** argv) {
+    int32_t utcOffset = FIRMWARE_UTC_OFFSET;
+    std::vector<const char*> paths;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--export") == 0) {
+            utcOffset = 0;
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            usage();
+            return 1;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty()) {
+        usage();
+        return 1;
+    }
+    std::string dir = paths[0];
+    paths.erase(paths.begin());
+
+    Archive archive;
+    bool missing;
+    if (!archive.load(dir, missing)) {
+        if (!missing) return 1;
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            fprintf(stderr, "Cannot create %s\n", dir.c_str());
+            return 1;
+        }
+        archive.header.blockRows = BLOCK_ROWS;
+    }
+    uint64_t before = archive.rows();
+    ArchiveWriter writer(archive);
+    if (!writer.begin()) return 1;
+
+    size_t skipped = 0;
+    bool full = false;
+    auto add = [&](const std::string& deviceId, const WaterReading& reading) {
+        full = full || !writer.append(deviceId.c_str(), reading);
+    };
+    if (paths.empty()) paths.push_back("-");
+    for (const char* path : paths) {
+        FILE* file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+        std::string text;
+        if (file == nullptr || !readAll(file, text)) {
+            fprintf(stderr, "Cannot read %s\n", path);
+            return 1;
+        }
+        if (file != stdin) fclose(file);
+        skipped += scanMessages(text, utcOffset, add);
+    }
+    if (full) {
+        fprintf(stderr, "More than %u devices; readings of the others were left out\n", UINT16_MAX);
+    }
+    if (!writer.commit()) {
+        fprintf(stderr, "%s: commit failed; the archive is unchanged\n", dir.c_str());
+        return 1;
+    }
+    fprintf(stderr, "%llu readings appended (%zu objects skipped), %llu in %s\n",
+            (unsigned long long)(writer.rowCount() - before), skipped, (unsigned long long)writer.rowCount(),
+            dir.c_str());
+    return 0;
+}
+
+struct Threshold {
+    size_t channel;
+    bool above;          // value > limit, else value < limit
+    float limit;
+};
+
+bool parseThreshold(const char* text, bool above, std::vector<Threshold>& thresholds) {
+    const char* equals = strchr(text, '=');
+    int c = equals != nullptr ? channelOf(text, (size_t)(equals - text)) : -1;
+    if (c < 0) {
+        fprintf(stderr, "Unknown threshold %s (key=value, key from channels.h)\n", text);
+        return false;
+    }
+    thresholds.push_back({(size_t)c, above, strtof(equals + 1, nullptr)});
+    return true;
+}
+
+int query(int argc, char** argv) {
+    int64_t from = 0, to = UINT32_MAX;
+    std::vector<Threshold> thresholds;
+    bool countOnly = false, scanAll = false;
+    const char* dir = nullptr;
+    for (int i = 0; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = true;
+        if (strcmp(arg, "--count") == 0) {
+            countOnly = true;
+        } else if (strcmp(arg, "--scan") == 0) {
+            scanAll = true;
+        } else if (strcmp(arg, "--unsafe-ph") == 0) {
+            thresholds.push_back({CH_PH, false, ALARM_PH_MIN});
+            thresholds.push_back({CH_PH, true, ALARM_PH_MAX});
+        } else if (strcmp(arg, "--high-turbidity") == 0) {
+            thresholds.push_back({CH_TURBIDITY, true, ALARM_TURBIDITY_MAX});
+        } else if (strncmp(arg, "--", 2) != 0) {
+            dir = arg;
+        } else if (value == nullptr) {
+            ok = false;
+        } else if (strcmp(arg, "--from") == 0) {
+            ok = parseTime(value, from), i++;
+        } else if (strcmp(arg, "--to") == 0) {
+            ok = parseTime(value, to), i++;
+            // A bare date runs to the end of that day
+            if (ok && strlen(value) == 10) to += 86399;
+        } else if (strcmp(arg, "--above") == 0) {
+            ok = parseThreshold(value, true, thresholds), i++;
+        } else if (strcmp(arg, "--below") == 0) {
+            ok = parseThreshold(value, false, thresholds), i++;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            usage();
+            return 1;
+        }
+    }
+    if (dir == nullptr) {
+        usage();
+        return 1;
+    }
+
+    Archive archive;
+    bool missing;
+    if (!archive.load(dir, missing)) {
+        if (missing) fprintf(stderr, "%s: no archive\n", dir);
+        return 1;
+    }
+    if (!archive.mapColumns()) return 1;
+
+    auto start = std::chrono::steady_clock::now();
+    const uint32_t* times = archive.time.as<uint32_t>();
+    const uint16_t* devices = archive.device.as<uint16_t>();
+    const float* values[SENSOR_CHANNEL_COUNT];
+    for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) values[c] = archive.values[c].as<float>();
+
+    if (!countOnly) {
+        printf("deviceId,timestamp");
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) printf(",%s", CHANNELS[c].key);
+        printf("\n");
+    }
+    uint64_t matched = 0;
+    size_t blocksRead = 0;
+    for (size_t b = 0; b < archive.blocks(); b++) {
+        const BlockSummary& block = archive.summary(b);
+        if (!scanAll) {
+            bool possible = block.maxTime >= from && block.minTime <= to;
+            bool anyThreshold = thresholds.empty();
+            for (const Threshold& t : thresholds) {
+                anyThreshold = anyThreshold || (t.above ? block.max[t.channel] > t.limit
+                                                        : block.min[t.channel] < t.limit);
+            }
+            if (!possible || !anyThreshold) continue;
+        }
+        blocksRead++;
+        uint64_t first = (uint64_t)b * BLOCK_ROWS;
+        uint64_t last = std::min<uint64_t>(first + BLOCK_ROWS, archive.rows());
+        for (uint64_t r = first; r < last; r++) {
+            if (times[r] < from || times[r] > to) continue;
+            bool hit = thresholds.empty();
+            for (const Threshold& t : thresholds) {
+                float v = values[t.channel][r];
+                hit = hit || (t.above ? v > t.limit : v < t.limit);
+            }
+            if (!hit) continue;
+            matched++;
+            if (countOnly) continue;
+            char stamp[32];
+            formatTime(times[r], stamp, sizeof(stamp));
+            printf("%s,%s", archive.devices[devices[r]].c_str(), stamp);
+            for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) printf(",%.*f", CHANNELS[c].decimals, values[c][r]);
+            printf("\n");
+        }
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (countOnly) printf("%llu\n", (unsigned long long)matched);
+    fprintf(stderr, "%llu rows matched; read %zu of %zu blocks in %.2f ms\n", (unsigned long long)matched, blocksRead,
+            archive.blocks(), ms);
+    return 0;
+}
+
+int info(int argc, char** argv) {
+    if (argc != 1) {
+        usage();
+        return 1;
+    }
+    Archive archive;
+    bool missing;
+    if (!archive.load(argv[0], missing)) {
+        if (missing) fprintf(stderr, "%s: no archive\n", argv[0]);
+        return 1;
+    }
+    if (!archive.mapColumns()) return 1;
+    uint32_t first = UINT32_MAX, last = 0;
+    for (size_t b = 0; b < archive.blocks(); b++) {
+        first = std::min(first, archive.summary(b).minTime);
+        last = std::max(last, archive.summary(b).maxTime);
+    }
+    size_t bytes = archive.rows() * (sizeof(uint32_t) + sizeof(uint16_t) + SENSOR_CHANNEL_COUNT * sizeof(float)) +
+                   archive.blocks() * sizeof(BlockSummary);
+    printf("%llu readings from %zu devices in %zu blocks of %u\n", (unsigned long long)archive.rows(),
+           archive.devices.size(), archive.blocks(), BLOCK_ROWS);
+    if (archive.rows() > 0) {
+        char a[32], b[32];
+        formatTime(first, a, sizeof(a));
+        formatTime(last, b, sizeof(b));
+        printf("%s to %s UTC\n", a, b);
+        printf("%zu bytes of columns and summaries, %.1f per reading\n", bytes, (double)bytes / archive.rows());
+    }
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+    if (strcmp(argv[1], "ingest") == 0) return ingest(argc - 2, argv + 2);
+    if (strcmp(argv[1], "query") == 0) return query(argc - 2, argv + 2);
+    if (strcmp(argv[1], "info") == 0) return info(argc - 2, argv + 2);
+    usage();
+    return 1;
+}
@@ -0,0 +1,301 @@
+// Replay harness for adaptive reporting (adaptive_reporter.h).
+// Runs recorded readings through the same AdaptiveReporter as the firmware and
+// measures what it saves against what it costs: messages published versus a
+// subscriber that holds the last published value of each channel (RMS and
+// largest error per channel over all readings, suppressed ones included).
+// Defaults come from config.h; --sweep scales all deadbands together.
+//
+// Input is either CSV with a header naming the channel keys of channels.h
+// (ph, tds, turbidity and temperature columns: the analytics/output reading
+// exports), or anything else holding flat JSON objects with those keys: the
+// collected_data.json export of analytics/mongoRetrieve.py, or the "[broker]"
+// lines of a native run. A timestamp ("YYYY-MM-DD HH:MM:SS" or ISO 8601,
+// offset ignored) is used when present, otherwise readings are --interval
+// seconds apart.
+//
+//   usage: program [--interval s] [--deadband-ph v] [--deadband-tds v]
+//                  [--deadband-turbidity v] [--deadband-temperature v]
+//                  [--slack deadbands] [--limit deadbands] [--heartbeat s]
+//                  [--hold readings] [--sweep] [--csv] file.csv...
+
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "adaptive_reporter.h"
+#include "channels.h"
+
+namespace {
+
+struct Options {
+    std::array<float, SENSOR_CHANNEL_COUNT> deadband = channelField(&ChannelSpec::deadband);
+    float slack = ADAPTIVE_CUSUM_SLACK;
+    float limit = ADAPTIVE_CUSUM_LIMIT;
+    uint32_t heartbeat = ADAPTIVE_HEARTBEAT;
+    uint32_t hold = ADAPTIVE_ALARM_HOLD;
+    uint32_t interval = MQTT_PUBLISH_INTERVAL / 1000;
+    bool sweep = false;
+    bool csv = false;
+};
+
+struct Result {
+    size_t readings = 0;
+    size_t published = 0;
+    uint32_t reasons[AdaptiveReporter::ALARM + 1] = {};
+    double rmse[SENSOR_CHANNEL_COUNT] = {};
+    double maxError[SENSOR_CHANNEL_COUNT] = {};
+};
+
+void usage() {
+    fprintf(stderr, "usage: program [--interval s] [--deadband-ph v] [--deadband-tds v]\n"
+                    "               [--deadband-turbidity v] [--deadband-temperature v]\n"
+                    "               [--slack deadbands] [--limit deadbands] [--heartbeat s]\n"
+                    "               [--hold readings] [--sweep] [--csv] file.csv...\n");
+}
+
+// Splits one CSV line on commas (no quoting in the analytics exports)
+std::vector<std::string> fields(const char* line) {
+    std::vector<std::string> out(1);
+    for (const char* p = line; *p != '\0' && *p != '\n' && *p != '\r'; p++) {
+        if (*p == ',') {
+            out.emplace_back();
+        } else {
+            out.back() += *p;
+        }
+    }
+    return out;
+}
+
+// Seconds since the epoch of "YYYY-MM-DD HH:MM:SS" (as UTC), 0 if malformed
+uint32_t parseTimestamp(const std::string& text) {
+    int y, mo, d, h, mi, s;
+    if (sscanf(text.c_str(), "%d-%d-%d%*[ T]%d:%d:%d", &y, &mo, &d, &h, &mi, &s) != 6) {
+        return 0;
+    }
+    // Days from civil date (proleptic Gregorian)
+    y -= mo <= 2;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long doy = (153 * (mo + (mo > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    long days = era * 146097 + doe - 719468;
+    return (uint32_t)(days * 86400 + h * 3600 + mi * 60 + s);
+}
+
+bool endsWith(const char* text, const char* suffix) {
+    size_t n = strlen(text), m = strlen(suffix);
+    return n >= m && strcmp(text + n - m, suffix) == 0;
+}
+
+// Value of "key": in one flat JSON object [begin, end), or nullptr
+const char* jsonValue(const std::string& text, size_t begin, size_t end, const char* key) {
+    std::string quoted = std::string("\"") + key + "\"";
+    size_t at = text.find(quoted, begin);
+    if (at == std::string::npos || at >= end) return nullptr;
+    at += quoted.size();
+    while (at < end && (text[at] == ' ' || text[at] == ':' || text[at] == '"')) at++;
+    return at < end ? text.c_str() + at : nullptr;
+}
+
+bool loadJson(const char* path, uint32_t interval, std::vector<WaterReading>& readings) {
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+    std::string text;
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) text.append(chunk, n);
+    fclose(file);
+
+    for (size_t begin = text.find('{'); begin != std::string::npos; begin = text.find('{', begin + 1)) {
+        size_t end = text.find('}', begin);
+        if (end == std::string::npos) break;
+        WaterReading reading;
+        bool complete = true;
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            const char* value = jsonValue(text, begin, end, CHANNELS[c].key);
+            complete = complete && value != nullptr;
+            reading.values[c] = complete ? strtof(value, nullptr) : 0.0f;
+        }
+        const char* timestamp = jsonValue(text, begin, end, "timestamp");
+        uint32_t seconds = timestamp != nullptr ? parseTimestamp(std::string(timestamp, 19)) : 0;
+        reading.timestamp = seconds != 0 ? seconds : (uint32_t)(readings.size() * interval);
+        if (complete) readings.push_back(reading);
+    }
+    return true;
+}
+
+bool load(const char* path, uint32_t interval, std::vector<WaterReading>& readings) {
+    if (!endsWith(path, ".csv")) {
+        return loadJson(path, interval, readings);
+    }
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+    char line[512];
+    int column[SENSOR_CHANNEL_COUNT];
+    int timeColumn = -1;
+    bool header = false;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        std::vector<std::string> row = fields(line);
+        if (!header) {
+            for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+                column[c] = -1;
+                for (size_t i = 0; i < row.size(); i++) {
+                    if (row[i] == CHANNELS[c].key) column[c] = (int)i;
+                }
+                if (column[c] < 0) {
+                    fclose(file);
+                    fprintf(stderr, "%s: no %s column\n", path, CHANNELS[c].key);
+                    return false;
+                }
+            }
+            for (size_t i = 0; i < row.size(); i++) {
+                if (row[i] == "timestamp") timeColumn = (int)i;
+            }
+            header = true;
+            continue;
+        }
+        WaterReading reading;
+        reading.timestamp = timeColumn >= 0 && timeColumn < (int)row.size() ? parseTimestamp(row[timeColumn])
+                                                                            : (uint32_t)(readings.size() * interval);
+        bool complete = true;
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            complete = complete && column[c] < (int)row.size() && !row[column[c]].empty();
+            reading.values[c] = complete ? strtof(row[column[c]].c_str(), nullptr) : 0.0f;
+        }
+        if (complete) readings.push_back(reading);
+    }
+    fclose(file);
+    return header;
+}
+
+Result replay(const std::vector<WaterReading>& readings, const Options& options, float scale) {
+    float deadbands[SENSOR_CHANNEL_COUNT];
+    for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        deadbands[c] = options.deadband[c] * scale;
+    }
+    AdaptiveReporter reporter(deadbands, options.slack, options.limit, options.heartbeat, options.hold);
+    reporter.setLimits({ALARM_PH_MIN, ALARM_PH_MAX, ALARM_TURBIDITY_MAX});
+
+    Result result;
+    float held[SENSOR_CHANNEL_COUNT] = {};
+    for (const WaterReading& reading : readings) {
+        AdaptiveReporter::Reason reason = reporter.evaluate(reading);
+        result.reasons[reason]++;
+        if (reason != AdaptiveReporter::SUPPRESSED) {
+            result.published++;
+            memcpy(held, reading.values, sizeof(held));
+        }
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            double error = fabs((double)reading.values[c] - held[c]);
+            result.rmse[c] += error * error;
+            if (error > result.maxError[c]) result.maxError[c] = error;
+        }
+    }
+    result.readings = readings.size();
+    for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        result.rmse[c] = result.readings > 0 ? sqrt(result.rmse[c] / result.readings) : 0;
+    }
+    return result;
+}
+
+void printResult(const char* path, float scale, const Result& r, bool csv) {
+    double reduction = r.readings > 0 ? 100.0 * (1.0 - (double)r.published / r.readings) : 0;
+    if (csv) {
+        printf("%s,%.2f,%zu,%zu,%.1f", path, scale, r.readings, r.published, reduction);
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            printf(",%.4f,%.4f", r.rmse[c], r.maxError[c]);
+        }
+        printf("\n");
+        return;
+    }
+    printf("%s (deadbands x%.2f): %zu readings, %zu published, %.1f%% fewer messages\n", path, scale, r.readings,
+           r.published, reduction);
+    printf("  reasons:");
+    for (int reason = AdaptiveReporter::FIRST; reason <= AdaptiveReporter::ALARM; reason++) {
+        printf(" %s %u", AdaptiveReporter::name((AdaptiveReporter::Reason)reason), r.reasons[reason]);
+    }
+    printf("\n  %-12s %10s %10s\n", "channel", "rmse", "max error");
+    for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        printf("  %-12s %10.4f %10.4f\n", CHANNELS[c].key, r.rmse[c], r.maxError[c]);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    std::vector<const char*> paths;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--csv") == 0) {
+            options.csv = true;
+        } else if (strcmp(arg, "--sweep") == 0) {
+            options.sweep = true;
+        } else if (strncmp(arg, "--", 2) != 0) {
+            paths.push_back(arg);
+        } else if (value == nullptr) {
+            usage();
+            return 1;
+        } else if (strcmp(arg, "--interval") == 0) {
+            options.interval = (uint32_t)atoi(value), i++;
+        } else if (strcmp(arg, "--deadband-ph") == 0) {
+            options.deadband[CH_PH] = atof(value), i++;
+        } else if (strcmp(arg, "--deadband-tds") == 0) {
+            options.deadband[CH_TDS] = atof(value), i++;
+        } else if (strcmp(arg, "--deadband-turbidity") == 0) {
+            options.deadband[CH_TURBIDITY] = atof(value), i++;
+        } else if (strcmp(arg, "--deadband-temperature") == 0) {
+            options.deadband[CH_TEMPERATURE] = atof(value), i++;
+        } else if (strcmp(arg, "--slack") == 0) {
+            options.slack = atof(value), i++;
+        } else if (strcmp(arg, "--limit") == 0) {
+            options.limit = atof(value), i++;
+        } else if (strcmp(arg, "--heartbeat") == 0) {
+            options.heartbeat = (uint32_t)atoi(value), i++;
+        } else if (strcmp(arg, "--hold") == 0) {
+            options.hold = (uint32_t)atoi(value), i++;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (paths.empty()) {
+        usage();
+        return 1;
+    }
+
+    if (options.csv) {
+        printf("file,deadband_scale,readings,published,reduction_pct");
+        for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            printf(",%s_rmse,%s_max_error", CHANNELS[c].key, CHANNELS[c].key);
+        }
+        printf("\n");
+    }
+    static const float SWEEP[] = {0.0f, 0.25f, 0.5f, 1.0f, 2.0f, 4.0f};
+    for (const char* path : paths) {
+        std::vector<WaterReading> readings;
+        if (!load(path, options.interval, readings)) {
+            fprintf(stderr, "Cannot load readings from %s\n", path);
+            return 1;
+        }
+        if (options.sweep) {
+            for (float scale : SWEEP) {
+                printResult(path, scale, replay(readings, options, scale), options.csv);
+            }
+        } else {
+            printResult(path, 1.0f, replay(readings, options, 1.0f), options.csv);
+        }
+    }
+    return 0;
+}
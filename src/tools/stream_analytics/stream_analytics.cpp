@@ -0,0 +1,941 @@
+// Streaming replacement for the statistics of analytics/analyze.py.
+// Reads the collected_data.json export of analytics/mongoRetrieve.py in one
+// pass and writes the same CSVs analyze.py writes to analytics/output (plots
+// excepted): basic_statistics, daily_session_mean, session_trends,
+// correlation_matrix and the high-turbidity and unsafe-pH anomalies. Like
+// analyze.py it keeps only readings inside the Morning, Afternoon and Evening
+// sessions of local time (UTC+05:30 by default) and reads every node's records
+// as one data set.
+//
+// The file is mapped and cut into chunks at record boundaries; worker threads
+// parse chunks into column blocks and reduce each block with tight loops
+// (sums, cross products, min/max, per day/session runs, value counts). Values
+// are held as integers of 1e-6, so every sum is exact: merging chunks is
+// addition, and the results do not depend on the chunk size or thread count.
+// Quantiles come from exact value counts, so they match the sorted-array
+// interpolation of pandas. Chunks are merged in file order, so the anomaly
+// rows and the --smoothed output (the moving average analyze.py plots, over
+// the channels of channels.h) keep the input order.
+//
+// Numbers are printed as pandas prints them (Python repr of a double); a
+// channel whose values are all integer literals prints its anomaly rows as
+// integers, as pandas does for an int64 column. Fields outside the channel
+// table are not carried into the anomaly files. Records missing a channel or
+// the timestamp are skipped (pandas would keep them with gaps).
+//
+// --synthesize writes a year (or any number of days) of session readings for
+// --nodes nodes in the export format, formatted by the firmware's JsonWriter,
+// for analytics/benchmark_stream.py.
+//
+//   usage: program [--jobs n] [--out dir] [--smoothed] [--window n]
+//                  [--utc-offset minutes] [collected_data.json]
+//          program --synthesize days [--nodes n] [--interval s] [--seed n]
+//                  [--start YYYY-MM-DD] out.json
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "config.h"
+#include "channels.h"
+#include "json_writer.h"
+#include "reading.h"
+
+namespace {
+
+const size_t CHANNELS_USED = SENSOR_CHANNEL_COUNT;
+const int64_t FIXED_SCALE = 1000000;          // Values are integers of 1e-6
+const int FIXED_DIGITS = 6;
+const size_t CHUNK_BYTES = 16u << 20;
+const size_t BLOCK_ROWS = 1024;
+const size_t CHUNKS_AHEAD_PER_JOB = 2;        // Parsed chunks waiting to be merged
+
+// pandas sorts group keys, so sessions are numbered in name order
+enum Session { AFTERNOON, EVENING, MORNING, SESSION_COUNT, OUTSIDE_SESSION = SESSION_COUNT };
+const char* const SESSION_NAMES[SESSION_COUNT] = {"Afternoon", "Evening", "Morning"};
+const int32_t SESSION_START[SESSION_COUNT] = {12 * 3600, 18 * 3600, 6 * 3600};   // Local seconds of day
+const int32_t SESSION_LENGTH = 2 * 3600;
+
+// Anomaly rules of analyze.py
+const int64_t TURBIDITY_LIMIT = 2 * FIXED_SCALE;
+const int64_t PH_LOW = 65 * FIXED_SCALE / 10;
+const int64_t PH_HIGH = 85 * FIXED_SCALE / 10;
+
+typedef __int128 Wide;
+
+struct Options {
+    const char* input = "analytics/collected_data.json";
+    std::string out = "analytics/output";
+    unsigned jobs = 0;
+    bool smoothed = false;
+    size_t window = 10;
+    int32_t utcOffset = 330 * 60;
+};
+
+struct SynthOptions {
+    int days = 365;
+    int nodes = 1;
+    int interval = 5;
+    uint32_t seed = 1;
+    const char* start = "2025-01-01";
+};
+
+void usage() {
+    fprintf(stderr, "usage: program [--jobs n] [--out dir] [--smoothed] [--window n]\n"
+                    "               [--utc-offset minutes] [collected_data.json]\n"
+                    "       program --synthesize days [--nodes n] [--interval s] [--seed n]\n"
+                    "               [--start YYYY-MM-DD] out.json\n");
+}
+
+// Days since 1970-01-01 of a civil date (proleptic Gregorian)
+int64_t daysFromCivil(int64_t y, int mo, int d) {
+    y -= mo <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (mo + (mo > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+void civilFromDays(int64_t days, int& y, int& mo, int& d) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t doe = days - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    d = (int)(doy - (153 * mp + 2) / 5 + 1);
+    mo = (int)(mp < 10 ? mp + 3 : mp - 9);
+    y = (int)(yoe + era * 400 + (mo <= 2));
+}
+
+int64_t floorDiv(int64_t a, int64_t b) { return a / b - (a % b != 0 && (a < 0) != (b < 0)); }
+
+// Session of a local time; 07:59:59.5 is after 07:59:59, so outside
+Session sessionOf(int32_t secondOfDay, uint32_t micros) {
+    for (int s = 0; s < SESSION_COUNT; s++) {
+        int32_t into = secondOfDay - SESSION_START[s];
+        if (into >= 0 && (into < SESSION_LENGTH - 1 || (into == SESSION_LENGTH - 1 && micros == 0))) {
+            return (Session)s;
+        }
+    }
+    return OUTSIDE_SESSION;
+}
+
+// Python's repr() of a double: shortest round-trip digits, positional for
+// decimal exponents -4 to 15, else d.ddde+XX. NaN prints empty, as in to_csv.
+std::string pyRepr(double value) {
+    if (std::isnan(value)) return "";
+    if (std::isinf(value)) return value > 0 ? "inf" : "-inf";
+    char buffer[64];
+    std::to_chars_result r = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::scientific);
+    *r.ptr = '\0';
+    bool negative = buffer[0] == '-';
+    const char* p = buffer + negative;
+    std::string digits;
+    for (; *p != 'e'; p++) {
+        if (*p != '.') digits += *p;
+    }
+    int exponent = atoi(p + 1);
+    std::string out = negative ? "-" : "";
+    if (exponent >= -4 && exponent < 16) {
+        if (exponent < 0) {
+            out += "0." + std::string((size_t)(-exponent - 1), '0') + digits;
+        } else if ((size_t)exponent + 1 >= digits.size()) {
+            out += digits + std::string((size_t)exponent + 1 - digits.size(), '0') + ".0";
+        } else {
+            out += digits.substr(0, (size_t)exponent + 1) + "." + digits.substr((size_t)exponent + 1);
+        }
+        return out;
+    }
+    out += digits.substr(0, 1);
+    if (digits.size() > 1) out += "." + digits.substr(1);
+    char tail[16];
+    snprintf(tail, sizeof(tail), "e%c%02d", exponent < 0 ? '-' : '+', abs(exponent));
+    return out + tail;
+}
+
+inline const char* skipSpace(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) p++;
+    return p;
+}
+
+// Powers of ten as ujson, the JSON reader of pandas, holds them
+const double NEGATIVE_POW10[16] = {1, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001, 0.00000001,
+                                   0.000000001, 0.0000000001, 0.00000000001, 0.000000000001, 0.0000000000001,
+                                   0.00000000000001, 0.000000000000001};
+const int UJSON_MAX_DECIMALS = 15;
+
+// A JSON number twice: as an integer of 1e-6 (rounded half away from zero
+// past six decimals) for exact sums, and as the double pandas reads.
+// read_json does not round correctly: it adds the fraction digits times a
+// rounded power of ten to the whole part, so 2.53 reads as 2.5300000000000002.
+// integer is cleared by a fraction or an exponent, exact by any digit lost
+// to the rounding.
+bool parseNumber(const char*& p, const char* end, int64_t& fixed, double& value, bool& integer, bool& exact) {
+    bool negative = p < end && *p == '-';
+    if (negative) p++;
+    int64_t whole = 0;
+    const char* digits = p;
+    while (p < end && *p >= '0' && *p <= '9') whole = whole * 10 + (*p++ - '0');
+    if (p == digits || p - digits > 9) return false;
+    int64_t fraction = 0;
+    int places = 0;
+    bool roundUp = false;
+    double fractionDigits = 0.0;
+    int decimals = 0;
+    if (p < end && *p == '.') {
+        integer = false;
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+            int digit = *p - '0';
+            if (decimals < UJSON_MAX_DECIMALS) {
+                fractionDigits = fractionDigits * 10.0 + digit;
+                decimals++;
+            }
+            if (places < FIXED_DIGITS) {
+                fraction = fraction * 10 + digit;
+            } else if (places == FIXED_DIGITS) {
+                roundUp = digit >= 5;
+                exact = exact && digit == 0;
+            } else {
+                exact = exact && digit == 0;
+            }
+            places++;
+        }
+    }
+    value = ((double)whole + fractionDigits * NEGATIVE_POW10[decimals]) * (negative ? -1.0 : 1.0);
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        // Rare in the exports; the fixed-point value is rounded from the double
+        integer = false;
+        p++;
+        bool negativeExponent = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+')) p++;
+        double exponent = 0.0;
+        while (p < end && *p >= '0' && *p <= '9') exponent = exponent * 10.0 + (*p++ - '0');
+        value *= pow(10.0, negativeExponent ? -exponent : exponent);
+        double scaled = value * FIXED_SCALE;
+        if (!(fabs(scaled) < 9e15)) return false;
+        fixed = llround(scaled);
+        exact = exact && (double)fixed == scaled;
+        return true;
+    }
+    for (int i = places < FIXED_DIGITS ? places : FIXED_DIGITS; i < FIXED_DIGITS; i++) fraction *= 10;
+    fixed = whole * FIXED_SCALE + fraction + roundUp;
+    if (negative) fixed = -fixed;
+    return true;
+}
+
+inline int digits2(const char* p) { return (p[0] - '0') * 10 + (p[1] - '0'); }
+
+// "YYYY-MM-DDTHH:MM:SS[.ffffff]" (naive, as UTC; a trailing offset is ignored)
+bool parseTimestamp(const char* p, const char* end, int64_t& seconds, uint32_t& micros) {
+    if (end - p < 19 || p[4] != '-' || p[7] != '-' || (p[10] != 'T' && p[10] != ' ') || p[13] != ':' ||
+        p[16] != ':') {
+        return false;
+    }
+    int year = digits2(p) * 100 + digits2(p + 2);
+    seconds = daysFromCivil(year, digits2(p + 5), digits2(p + 8)) * 86400 + digits2(p + 11) * 3600 +
+              digits2(p + 14) * 60 + digits2(p + 17);
+    micros = 0;
+    p += 19;
+    if (p < end && *p == '.') {
+        uint32_t scale = 100000;
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, scale /= 10) micros += (uint32_t)(*p - '0') * scale;
+    }
+    return true;
+}
+
+// Exact sums over a set of rows
+struct Sums {
+    uint64_t n = 0;
+    Wide sum[CHANNELS_USED] = {};
+
+    void add(const Sums& other) {
+        n += other.n;
+        for (size_t c = 0; c < CHANNELS_USED; c++) sum[c] += other.sum[c];
+    }
+
+    double mean(size_t c) const {
+        return n > 0 ? (double)((long double)sum[c] / (long double)n / FIXED_SCALE) : NAN;
+    }
+};
+
+// Sums and cross products (upper triangle)
+struct Moments : Sums {
+    Wide cross[CHANNELS_USED][CHANNELS_USED] = {};
+
+    void add(const Moments& other) {
+        Sums::add(other);
+        for (size_t a = 0; a < CHANNELS_USED; a++) {
+            for (size_t b = a; b < CHANNELS_USED; b++) cross[a][b] += other.cross[a][b];
+        }
+    }
+
+    // n times the co-moment of a and b (n Sxy - Sx Sy), in 1e-12 units
+    Wide coMoment(size_t a, size_t b) const {
+        return (Wide)n * cross[std::min(a, b)][std::max(a, b)] - sum[a] * sum[b];
+    }
+
+    double stdDev(size_t c) const {
+        if (n < 2) return NAN;
+        long double variance = (long double)coMoment(c, c) / ((long double)n * (n - 1));
+        return (double)(sqrtl(variance) / FIXED_SCALE);
+    }
+
+    double correlation(size_t a, size_t b) const {
+        long double va = (long double)coMoment(a, a), vb = (long double)coMoment(b, b);
+        if (n < 2 || va <= 0 || vb <= 0) return NAN;
+        if (a == b) return 1.0;
+        long double r = (long double)coMoment(a, b) / sqrtl(va * vb);
+        return (double)std::max(-1.0L, std::min(1.0L, r));
+    }
+};
+
+struct Anomaly {
+    std::string deviceId;
+    int64_t utc;
+    uint32_t micros;
+    uint8_t rules;               // HIGH_TURBIDITY, UNSAFE_PH
+    int64_t values[CHANNELS_USED];
+    double read[CHANNELS_USED];  // As pandas reads them
+};
+const uint8_t HIGH_TURBIDITY = 1;
+const uint8_t UNSAFE_PH = 2;
+
+// A session reading, kept for the moving average
+struct Sample {
+    int64_t utc;
+    uint32_t micros;
+    int64_t values[CHANNELS_USED];
+};
+
+// Occurrences of each value as pandas reads it
+typedef std::unordered_map<double, uint64_t> ValueCounts;
+
+// Everything one chunk contributes
+struct ChunkResult {
+    Moments moments;
+    std::map<int64_t, Sums> groups;          // day * SESSION_COUNT + session
+    ValueCounts counts[CHANNELS_USED];
+    std::vector<Anomaly> anomalies;
+    std::vector<Sample> samples;
+    uint64_t records = 0;
+    uint64_t skipped = 0;
+    uint64_t inexact = 0;
+    bool nonInteger[CHANNELS_USED] = {};
+};
+
+// Session rows of a chunk in columns, reduced a block at a time
+class BlockReducer {
+private:
+    int64_t columns[CHANNELS_USED][BLOCK_ROWS];
+    double reads[CHANNELS_USED][BLOCK_ROWS];
+    int64_t groupKeys[BLOCK_ROWS];
+    size_t rows = 0;
+    ChunkResult& result;
+
+public:
+    explicit BlockReducer(ChunkResult& target) : result(target) {}
+
+    void add(const int64_t* values, const double* read, int64_t groupKey) {
+        for (size_t c = 0; c < CHANNELS_USED; c++) {
+            columns[c][rows] = values[c];
+            reads[c][rows] = read[c];
+        }
+        groupKeys[rows] = groupKey;
+        if (++rows == BLOCK_ROWS) flush();
+    }
+
+    void flush() {
+        if (rows == 0) return;
+        Moments& m = result.moments;
+        m.n += rows;
+        for (size_t c = 0; c < CHANNELS_USED; c++) {
+            const int64_t* x = columns[c];
+            int64_t sum = 0;
+            for (size_t i = 0; i < rows; i++) sum += x[i];
+            m.sum[c] += sum;
+        }
+        for (size_t a = 0; a < CHANNELS_USED; a++) {
+            for (size_t b = a; b < CHANNELS_USED; b++) {
+                const int64_t* x = columns[a];
+                const int64_t* y = columns[b];
+                Wide cross = 0;
+                for (size_t i = 0; i < rows; i++) cross += (Wide)x[i] * y[i];
+                m.cross[a][b] += cross;
+            }
+        }
+        // Readings arrive in time order, so a block is a few runs of one day and session
+        for (size_t i = 0; i < rows;) {
+            size_t j = i + 1;
+            while (j < rows && groupKeys[j] == groupKeys[i]) j++;
+            Sums& group = result.groups[groupKeys[i]];
+            group.n += j - i;
+            for (size_t c = 0; c < CHANNELS_USED; c++) {
+                int64_t sum = 0;
+                for (size_t k = i; k < j; k++) sum += columns[c][k];
+                group.sum[c] += sum;
+            }
+            i = j;
+        }
+        for (size_t c = 0; c < CHANNELS_USED; c++) {
+            ValueCounts& counts = result.counts[c];
+            for (size_t i = 0; i < rows; i++) counts[reads[c][i]]++;
+        }
+        rows = 0;
+    }
+};
+
+// Offset just past the first '}' at or after pos (records are flat objects)
+size_t recordBoundary(const char* data, size_t size, size_t pos) {
+    if (pos >= size) return size;
+    const void* brace = memchr(data + pos, '}', size - pos);
+    return brace != nullptr ? (size_t)((const char*)brace - data) + 1 : size;
+}
+
+void parseChunk(const char* p, const char* end, const Options& options, bool keepSamples, ChunkResult& result) {
+    std::unique_ptr<BlockReducer> reducer(new BlockReducer(result));
+    for (;;) {
+        p = (const char*)memchr(p, '{', (size_t)(end - p));
+        if (p == nullptr) break;
+        p++;
+        const char* device = nullptr;
+        size_t deviceLength = 0;
+        int64_t utc = 0;
+        uint32_t micros = 0;
+        bool haveTime = false, valid = true;
+        bool seen[CHANNELS_USED] = {};
+        bool integer[CHANNELS_USED];
+        int64_t values[CHANNELS_USED];
+        double read[CHANNELS_USED];
+        for (size_t c = 0; c < CHANNELS_USED; c++) integer[c] = true;
+        bool exact = true;
+
+        for (;;) {
+            p = skipSpace(p, end);
+            if (p >= end) {
+                valid = false;
+                break;
+            }
+            if (*p == '}') {
+                p++;
+                break;
+            }
+            if (*p == ',') {
+                p++;
+                continue;
+            }
+            if (*p != '"') {
+                valid = false;
+                break;
+            }
+            const char* key = ++p;
+            while (p < end && *p != '"') p++;
+            size_t keyLength = (size_t)(p - key);
+            p = skipSpace(p + 1, end);
+            if (p >= end || *p != ':') {
+                valid = false;
+                break;
+            }
+            p = skipSpace(p + 1, end);
+            if (p < end && *p == '"') {
+                const char* text = ++p;
+                while (p < end && *p != '"') p++;
+                if (keyLength == 8 && memcmp(key, "deviceId", 8) == 0) {
+                    device = text;
+                    deviceLength = (size_t)(p - text);
+                } else if (keyLength == 9 && memcmp(key, "timestamp", 9) == 0) {
+                    haveTime = parseTimestamp(text, p, utc, micros);
+                }
+                p++;
+                continue;
+            }
+            int channel = -1;
+            for (size_t c = 0; c < CHANNELS_USED; c++) {
+                if (strlen(CHANNELS[c].key) == keyLength && memcmp(key, CHANNELS[c].key, keyLength) == 0) {
+                    channel = (int)c;
+                }
+            }
+            if (channel < 0 || !(seen[channel] = parseNumber(p, end, values[channel], read[channel], integer[channel], exact))) {
+                while (p < end && *p != ',' && *p != '}') p++;   // Other fields, null
+            }
+        }
+        if (!valid) break;
+
+        // pandas types a column from every record: one fraction or gap makes it float
+        result.records++;
+        bool complete = haveTime;
+        for (size_t c = 0; c < CHANNELS_USED; c++) {
+            complete = complete && seen[c];
+            result.nonInteger[c] = result.nonInteger[c] || !integer[c] || !seen[c];
+        }
+        result.inexact += !exact;
+        if (!complete) {
+            result.skipped++;
+            continue;
+        }
+        int64_t local = utc + options.utcOffset;
+        int64_t day = floorDiv(local, 86400);
+        Session session = sessionOf((int32_t)(local - day * 86400), micros);
+        if (session == OUTSIDE_SESSION) continue;
+
+        reducer->add(values, read, day * SESSION_COUNT + session);
+
+        uint8_t rules = 0;
+        if (values[CH_TURBIDITY] > TURBIDITY_LIMIT) rules |= HIGH_TURBIDITY;
+        if (values[CH_PH] < PH_LOW || values[CH_PH] > PH_HIGH) rules |= UNSAFE_PH;
+        if (rules != 0) {
+            Anomaly anomaly;
+            anomaly.deviceId.assign(device != nullptr ? device : "", deviceLength);
+            anomaly.utc = utc;
+            anomaly.micros = micros;
+            anomaly.rules = rules;
+            memcpy(anomaly.values, values, sizeof(values));
+            memcpy(anomaly.read, read, sizeof(read));
+            result.anomalies.push_back(anomaly);
+        }
+        if (keepSamples) {
+            Sample sample;
+            sample.utc = utc;
+            sample.micros = micros;
+            memcpy(sample.values, values, sizeof(values));
+            result.samples.push_back(sample);
+        }
+    }
+    reducer->flush();
+}
+
+// "2025-04-14 12:18:55+05:30", its date and time columns
+struct LocalTime {
+    char timestamp[64];
+    char date[16];
+    char time[24];
+};
+
+LocalTime localTime(int64_t utc, uint32_t micros, int32_t offset) {
+    LocalTime out;
+    int64_t local = utc + offset;
+    int64_t day = floorDiv(local, 86400);
+    int32_t second = (int32_t)(local - day * 86400);
+    int y, mo, d;
+    civilFromDays(day, y, mo, d);
+    snprintf(out.date, sizeof(out.date), "%04d-%02d-%02d", y, mo, d);
+    snprintf(out.time, sizeof(out.time), "%02d:%02d:%02d", second / 3600, second / 60 % 60, second % 60);
+    if (micros != 0) snprintf(out.time + 8, sizeof(out.time) - 8, ".%06u", micros);
+    int32_t minutes = (offset < 0 ? -offset : offset) / 60;
+    snprintf(out.timestamp, sizeof(out.timestamp), "%s %s%c%02d:%02d", out.date, out.time, offset < 0 ? '-' : '+',
+             minutes / 60, minutes % 60);
+    return out;
+}
+
+FILE* openOutput(const Options& options, const char* name) {
+    std::string path = options.out + "/" + name;
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) fprintf(stderr, "Cannot write %s\n", path.c_str());
+    return file;
+}
+
+void writeChannelHeader(FILE* file, const char* first) {
+    fputs(first, file);
+    for (size_t c = 0; c < CHANNELS_USED; c++) fprintf(file, ",%s", CHANNELS[c].key);
+    fputc('\n', file);
+}
+
+typedef std::vector<std::pair<double, uint64_t>> SortedCounts;
+
+// Value at position rank of the sorted values
+double orderStatistic(const SortedCounts& sorted, uint64_t rank) {
+    uint64_t seen = 0;
+    for (const auto& entry : sorted) {
+        seen += entry.second;
+        if (rank < seen) return entry.first;
+    }
+    return NAN;
+}
+
+// Value at quantile q of n counted values, interpolated between sorted
+// neighbours as numpy's "linear" method (the pandas default) does
+double quantile(const SortedCounts& sorted, uint64_t n, double q) {
+    double position = q * (double)(n - 1);
+    uint64_t below = (uint64_t)floor(position);
+    double gamma = position - (double)below;
+    double a = orderStatistic(sorted, below);
+    double b = orderStatistic(sorted, std::min(below + 1, n - 1));
+    double diff = b - a;
+    return gamma >= 0.5 ? b - diff * (1.0 - gamma) : a + diff * gamma;
+}
+
+bool writeStatistics(const Options& options, const Moments& m, ValueCounts* counts) {
+    FILE* file = openOutput(options, "basic_statistics.csv");
+    if (file == nullptr) return false;
+    SortedCounts sorted[CHANNELS_USED];
+    for (size_t c = 0; c < CHANNELS_USED; c++) {
+        sorted[c].assign(counts[c].begin(), counts[c].end());
+        std::sort(sorted[c].begin(), sorted[c].end());
+    }
+    writeChannelHeader(file, "");
+    const char* rows[] = {"count", "mean", "std", "min", "25%", "50%", "75%", "max"};
+    for (size_t r = 0; r < 8; r++) {
+        fputs(rows[r], file);
+        for (size_t c = 0; c < CHANNELS_USED; c++) {
+            double value = NAN;
+            switch (r) {
+                case 0: value = (double)m.n; break;
+                case 1: value = m.mean(c); break;
+                case 2: value = m.stdDev(c); break;
+                case 3: value = m.n > 0 ? orderStatistic(sorted[c], 0) : NAN; break;
+                case 7: value = m.n > 0 ? orderStatistic(sorted[c], m.n - 1) : NAN; break;
+                default: value = m.n > 0 ? quantile(sorted[c], m.n, 0.25 * (double)(r - 3)) : NAN; break;
+            }
+            fprintf(file, ",%s", pyRepr(value).c_str());
+        }
+        fputc('\n', file);
+    }
+    fclose(file);
+    return true;
+}
+
+bool writeGroups(const Options& options, const std::map<int64_t, Sums>& groups) {
+    FILE* daily = openOutput(options, "daily_session_mean.csv");
+    FILE* trends = openOutput(options, "session_trends.csv");
+    if (daily == nullptr || trends == nullptr) {
+        if (daily != nullptr) fclose(daily);
+        if (trends != nullptr) fclose(trends);
+        return false;
+    }
+    Sums sessions[SESSION_COUNT];
+    writeChannelHeader(daily, "date,session");
+    for (const auto& entry : groups) {
+        int64_t day = floorDiv(entry.first, SESSION_COUNT);
+        int session = (int)(entry.first - day * SESSION_COUNT);
+        sessions[session].add(entry.second);
+        int y, mo, d;
+        civilFromDays(day, y, mo, d);
+        fprintf(daily, "%04d-%02d-%02d,%s", y, mo, d, SESSION_NAMES[session]);
+        for (size_t c = 0; c < CHANNELS_USED; c++) fprintf(daily, ",%s", pyRepr(entry.second.mean(c)).c_str());
+        fputc('\n', daily);
+    }
+    writeChannelHeader(trends, "session");
+    for (int s = 0; s < SESSION_COUNT; s++) {
+        if (sessions[s].n == 0) continue;
+        fputs(SESSION_NAMES[s], trends);
+        for (size_t c = 0; c < CHANNELS_USED; c++) fprintf(trends, ",%s", pyRepr(sessions[s].mean(c)).c_str());
+        fputc('\n', trends);
+    }
+    fclose(daily);
+    fclose(trends);
+    return true;
+}
+
+bool writeCorrelation(const Options& options, const Moments& m) {
+    FILE* file = openOutput(options, "correlation_matrix.csv");
+    if (file == nullptr) return false;
+    writeChannelHeader(file, "");
+    for (size_t a = 0; a < CHANNELS_USED; a++) {
+        fputs(CHANNELS[a].key, file);
+        for (size_t b = 0; b < CHANNELS_USED; b++) fprintf(file, ",%s", pyRepr(m.correlation(a, b)).c_str());
+        fputc('\n', file);
+    }
+    fclose(file);
+    return true;
+}
+
+// One file per rule, rows in file order
+bool writeAnomalies(const Options& options, const std::vector<Anomaly>& anomalies, const bool* nonInteger) {
+    const char* names[2] = {"high_turbidity_anomalies.csv", "unsafe_ph_anomalies.csv"};
+    const uint8_t rules[2] = {HIGH_TURBIDITY, UNSAFE_PH};
+    for (int f = 0; f < 2; f++) {
+        FILE* file = openOutput(options, names[f]);
+        if (file == nullptr) return false;
+        fputs("deviceId,timestamp", file);
+        for (size_t c = 0; c < CHANNELS_USED; c++) fprintf(file, ",%s", CHANNELS[c].key);
+        fputs(",date,time,session\n", file);
+        for (const Anomaly& anomaly : anomalies) {
+            if (!(anomaly.rules & rules[f])) continue;
+            LocalTime t = localTime(anomaly.utc, anomaly.micros, options.utcOffset);
+            int64_t local = anomaly.utc + options.utcOffset;
+            Session session = sessionOf((int32_t)(local - floorDiv(local, 86400) * 86400), anomaly.micros);
+            fprintf(file, "%s,%s", anomaly.deviceId.c_str(), t.timestamp);
+            for (size_t c = 0; c < CHANNELS_USED; c++) {
+                if (nonInteger[c]) {
+                    fprintf(file, ",%s", pyRepr(anomaly.read[c]).c_str());
+                } else {
+                    fprintf(file, ",%lld", (long long)(anomaly.values[c] / FIXED_SCALE));
+                }
+            }
+            fprintf(file, ",%s,%s,%s\n", t.date, t.time, SESSION_NAMES[session]);
+        }
+        fclose(file);
+    }
+    return true;
+}
+
+// Trailing moving average over the session readings in file order (pandas
+// rolling(window).mean(): empty until the window is full)
+class SmoothedWriter {
+private:
+    FILE* file;
+    const Options& options;
+    std::vector<int64_t> history;            // window x channels, ring
+    int64_t sums[CHANNELS_USED] = {};
+    uint64_t seen = 0;
+
+public:
+    SmoothedWriter(FILE* out, const Options& opts)
+        : file(out), options(opts), history(opts.window * CHANNELS_USED, 0) {
+        fputs("timestamp", file);
+        for (size_t c = 0; c < CHANNELS_USED; c++) fprintf(file, ",%s_smooth", CHANNELS[c].key);
+        fputc('\n', file);
+    }
+
+    void add(const std::vector<Sample>& samples) {
+        for (const Sample& sample : samples) {
+            int64_t* slot = &history[(seen % options.window) * CHANNELS_USED];
+            for (size_t c = 0; c < CHANNELS_USED; c++) {
+                sums[c] += sample.values[c] - slot[c];
+                slot[c] = sample.values[c];
+            }
+            seen++;
+            fputs(localTime(sample.utc, sample.micros, options.utcOffset).timestamp, file);
+            for (size_t c = 0; c < CHANNELS_USED; c++) {
+                double mean = seen >= options.window
+                                  ? (double)((long double)sums[c] / (long double)options.window / FIXED_SCALE)
+                                  : NAN;
+                fprintf(file, ",%s", pyRepr(mean).c_str());
+            }
+            fputc('\n', file);
+        }
+    }
+};
+
+// Parses the chunks on a pool of threads and merges them in file order,
+// holding at most CHUNKS_AHEAD_PER_JOB parsed chunks per thread
+int analyze(const Options& options) {
+    int fd = open(options.input, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open %s\n", options.input);
+        return 1;
+    }
+    struct stat info;
+    fstat(fd, &info);
+    size_t size = (size_t)info.st_size;
+    const char* data = nullptr;
+    if (size > 0) {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            fprintf(stderr, "Cannot map %s\n", options.input);
+            return 1;
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        data = (const char*)mapped;
+    }
+
+    size_t chunkCount = (size + CHUNK_BYTES - 1) / CHUNK_BYTES;
+    unsigned jobs = options.jobs > 0 ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+    jobs = (unsigned)std::min<size_t>(jobs, std::max<size_t>(chunkCount, 1));
+    std::vector<std::unique_ptr<ChunkResult>> results(chunkCount);
+    std::atomic<size_t> nextChunk{0};
+    size_t merged = 0;
+    std::mutex lock;
+    std::condition_variable changed;
+    FILE* smoothedFile = options.smoothed ? openOutput(options, "smoothed_readings.csv") : nullptr;
+    if (options.smoothed && smoothedFile == nullptr) return 1;
+
+    auto worker = [&]() {
+        for (size_t k; (k = nextChunk.fetch_add(1)) < chunkCount;) {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                changed.wait(guard, [&] { return k < merged + jobs * CHUNKS_AHEAD_PER_JOB; });
+            }
+            size_t begin = k == 0 ? 0 : recordBoundary(data, size, k * CHUNK_BYTES);
+            size_t end = recordBoundary(data, size, (k + 1) * CHUNK_BYTES);
+            std::unique_ptr<ChunkResult> result(new ChunkResult());
+            if (begin < end) parseChunk(data + begin, data + end, options, options.smoothed, *result);
+            std::lock_guard<std::mutex> guard(lock);
+            results[k] = std::move(result);
+            changed.notify_all();
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned j = 0; j < jobs; j++) pool.emplace_back(worker);
+
+    ChunkResult total;
+    std::unique_ptr<SmoothedWriter> smoothed;
+    if (smoothedFile != nullptr) smoothed.reset(new SmoothedWriter(smoothedFile, options));
+    for (size_t k = 0; k < chunkCount; k++) {
+        std::unique_ptr<ChunkResult> chunk;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [&] { return results[k] != nullptr; });
+            chunk = std::move(results[k]);
+        }
+        total.moments.add(chunk->moments);
+        for (const auto& group : chunk->groups) total.groups[group.first].add(group.second);
+        for (size_t c = 0; c < CHANNELS_USED; c++) {
+            for (const auto& count : chunk->counts[c]) total.counts[c][count.first] += count.second;
+            total.nonInteger[c] = total.nonInteger[c] || chunk->nonInteger[c];
+        }
+        total.anomalies.insert(total.anomalies.end(), chunk->anomalies.begin(), chunk->anomalies.end());
+        total.records += chunk->records;
+        total.skipped += chunk->skipped;
+        total.inexact += chunk->inexact;
+        if (smoothed) smoothed->add(chunk->samples);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            merged++;
+        }
+        changed.notify_all();
+    }
+    for (std::thread& thread : pool) thread.join();
+    if (data != nullptr) munmap((void*)data, size);
+    close(fd);
+    if (smoothedFile != nullptr) fclose(smoothedFile);
+
+    bool ok = writeStatistics(options, total.moments, total.counts) &&
+              writeGroups(options, total.groups) && writeCorrelation(options, total.moments) &&
+              writeAnomalies(options, total.anomalies, total.nonInteger);
+    fprintf(stderr, "%llu records, %llu in sessions, %llu skipped (incomplete), %zu anomalies, %u threads\n",
+            (unsigned long long)total.records, (unsigned long long)total.moments.n,
+            (unsigned long long)total.skipped, total.anomalies.size(), jobs);
+    if (total.inexact > 0) {
+        fprintf(stderr, "%llu readings had more than %d decimals and were rounded\n",
+                (unsigned long long)total.inexact, FIXED_DIGITS);
+    }
+    return ok ? 0 : 1;
+}
+
+// Session readings of every node, a reading per interval, in the export
+// layout of mongoRetrieve.py (naive UTC timestamps). Temperature follows the
+// season and the time of day; turbidity spikes and pH excursions are rare.
+int synthesize(const char* path, const SynthOptions& o, int32_t utcOffset) {
+    int y, mo, d;
+    if (sscanf(o.start, "%d-%d-%d", &y, &mo, &d) != 3 || o.days <= 0 || o.nodes <= 0 || o.interval <= 0) {
+        usage();
+        return 1;
+    }
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return 1;
+    }
+    std::mt19937 random(o.seed);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    const Session order[SESSION_COUNT] = {MORNING, AFTERNOON, EVENING};
+    const float sessionWarmth[SESSION_COUNT] = {-2.0f, 2.0f, 0.0f};   // Afternoon, Evening, Morning
+
+    int64_t firstDay = daysFromCivil(y, mo, d);
+    uint64_t written = 0;
+    fputs("[\n", file);
+    for (int64_t day = firstDay; day < firstDay + o.days; day++) {
+        float season = 2.0f * sinf(2.0f * (float)M_PI * (float)(day - firstDay) / 365.0f);
+        for (Session session : order) {
+            int64_t start = day * 86400 + SESSION_START[session] - utcOffset;
+            for (int32_t t = 0; t < SESSION_LENGTH; t += o.interval) {
+                for (int node = 0; node < o.nodes; node++) {
+                    WaterReading reading;
+                    reading.timestamp = (uint32_t)(start + t);
+                    reading.values[CH_PH] = 7.2f + 0.12f * noise(random);
+                    if (uniform(random) < 0.0002f) reading.values[CH_PH] += uniform(random) < 0.5f ? -1.0f : 1.5f;
+                    reading.values[CH_TDS] = 319.5f + 6.8f * noise(random);
+                    reading.values[CH_TURBIDITY] = 1.5f + 0.08f * noise(random);
+                    if (uniform(random) < 0.003f) reading.values[CH_TURBIDITY] += 0.6f + 0.4f * uniform(random);
+                    reading.values[CH_TEMPERATURE] = 25.0f + season + sessionWarmth[session] + 0.5f * noise(random);
+                    for (size_t c = STANDARD_CHANNEL_COUNT; c < CHANNELS_USED; c++) reading.values[c] = noise(random);
+
+                    char deviceId[24], json[512];
+                    snprintf(deviceId, sizeof(deviceId), "ESP32_%06d", 110 + node);
+                    LocalTime utc = localTime(reading.timestamp, 0, 0);
+                    std::string timestamp = std::string(utc.date) + "T" + utc.time;
+                    JsonWriter writer(json, sizeof(json));
+                    writer.beginObject();
+                    writer.key("deviceId");
+                    writer.string(deviceId);
+                    writer.key("timestamp");
+                    writer.string(timestamp.c_str());
+                    for (size_t c = 0; c < CHANNELS_USED; c++) {
+                        writer.key(CHANNELS[c].key);
+                        writer.number(reading.values[c], CHANNELS[c].decimals);
+                    }
+                    writer.endObject();
+                    fprintf(file, "%s    %s", written++ > 0 ? ",\n" : "", json);
+                }
+            }
+        }
+    }
+    fputs("\n]\n", file);
+    fclose(file);
+    fprintf(stderr, "%llu readings from %d nodes over %d days\n", (unsigned long long)written, o.nodes, o.days);
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    SynthOptions synth;
+    bool synthesizing = false;
+    const char* path = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--smoothed") == 0) {
+            options.smoothed = true;
+        } else if (strncmp(arg, "--", 2) != 0) {
+            path = arg;
+        } else if (value == nullptr) {
+            usage();
+            return 1;
+        } else if (strcmp(arg, "--jobs") == 0) {
+            options.jobs = (unsigned)atoi(value), i++;
+        } else if (strcmp(arg, "--out") == 0) {
+            options.out = value, i++;
+        } else if (strcmp(arg, "--window") == 0) {
+            options.window = (size_t)std::max(1, atoi(value)), i++;
+        } else if (strcmp(arg, "--utc-offset") == 0) {
+            options.utcOffset = atoi(value) * 60, i++;
+        } else if (strcmp(arg, "--synthesize") == 0) {
+            synthesizing = true;
+            synth.days = atoi(value), i++;
+        } else if (strcmp(arg, "--nodes") == 0) {
+            synth.nodes = atoi(value), i++;
+        } else if (strcmp(arg, "--interval") == 0) {
+            synth.interval = atoi(value), i++;
+        } else if (strcmp(arg, "--seed") == 0) {
+            synth.seed = (uint32_t)strtoul(value, nullptr, 10), i++;
+        } else if (strcmp(arg, "--start") == 0) {
+            synth.start = value, i++;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (synthesizing) {
+        if (path == nullptr) {
+            usage();
+            return 1;
+        }
+        return synthesize(path, synth, options.utcOffset);
+    }
+    if (path != nullptr) options.input = path;
+    return analyze(options);
+}
@@ -0,0 +1,237 @@
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include "calibration.h"
+#include "command_handler.h"
+#include "native_hal.h"
+#include "sensors.h"
+
+// Host tests of the multi-point calibration (calibration.h) against the
+// reference buffer and standard solutions of traces/calibration_reference.csv.
+// Run with: pio test -e native
+
+void setUp() {}
+void tearDown() {}
+
+static const float VOLTS_PER_CODE = VOLTAGE_REF / ADC_RESOLUTION;
+
+static CalibrationCurve makeCurve(const float* volts, const float* values, size_t count, uint8_t degree) {
+    CalibrationCurve curve;
+    curve.count = (uint8_t)count;
+    curve.degree = degree;
+    for (size_t i = 0; i < count; i++) {
+        curve.volts[i] = volts[i];
+        curve.values[i] = values[i];
+    }
+    return curve;
+}
+
+// pH 4.01 / 7.00 / 10.01 technical buffers
+static const float PH_VOLTS[] = {0.905f, 1.578f, 2.232f};
+static const float PH_VALUES[] = {4.01f, 7.00f, 10.01f};
+
+// TDS standards (ppm at factor 0.5) and formazin dilutions (NTU) at 25 C
+static const float TDS_VOLTS[] = {0.0f, 0.2299f, 0.8605f, 2.0634f};
+static const float TDS_VALUES[] = {0.0f, 100.0f, 342.0f, 1000.0f};
+static const float TURBIDITY_VOLTS[] = {0.0f, 0.8484f, 1.9453f, 3.2368f};
+static const float TURBIDITY_VALUES[] = {0.0f, 10.0f, 40.0f, 100.0f};
+
+void test_piecewise_through_points() {
+    CalibrationCurve curve = makeCurve(PH_VOLTS, PH_VALUES, 3, 0);
+    TEST_ASSERT_TRUE(curve.fit());
+    for (size_t i = 0; i < 3; i++) TEST_ASSERT_FLOAT_WITHIN(1e-4f, PH_VALUES[i], curve.evaluate(PH_VOLTS[i]));
+    // Halfway along a segment, and extended along the end segments
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, (4.01f + 7.00f) / 2, curve.evaluate((0.905f + 1.578f) / 2));
+    float lowSlope = (7.00f - 4.01f) / (1.578f - 0.905f);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 4.01f - 0.405f * lowSlope, curve.evaluate(0.5f));
+    float highSlope = (10.01f - 7.00f) / (2.232f - 1.578f);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 10.01f + 0.468f * highSlope, curve.evaluate(2.7f));
+}
+
+void test_fit_sorts_points() {
+    const float volts[] = {2.232f, 0.905f, 1.578f};
+    const float values[] = {10.01f, 4.01f, 7.00f};
+    CalibrationCurve curve = makeCurve(volts, values, 3, 0);
+    TEST_ASSERT_TRUE(curve.fit());
+    for (size_t i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_FLOAT(PH_VOLTS[i], curve.volts[i]);
+        TEST_ASSERT_EQUAL_FLOAT(PH_VALUES[i], curve.values[i]);
+    }
+}
+
+void test_fit_rejects_unusable_points() {
+    CalibrationCurve one = makeCurve(PH_VOLTS, PH_VALUES, 1, 0);
+    TEST_ASSERT_FALSE(one.fit());
+
+    const float same[] = {1.0f, 1.0f, 2.0f};
+    CalibrationCurve duplicate = makeCurve(same, PH_VALUES, 3, 0);
+    TEST_ASSERT_FALSE(duplicate.fit());
+
+    // Three points cannot determine a cubic
+    CalibrationCurve cubic = makeCurve(PH_VOLTS, PH_VALUES, 3, 3);
+    TEST_ASSERT_FALSE(cubic.fit());
+}
+
+// Four points and degree 3: the polynomial passes through all of them
+void test_cubic_through_tds_standards() {
+    CalibrationCurve curve = makeCurve(TDS_VOLTS, TDS_VALUES, 4, 3);
+    TEST_ASSERT_TRUE(curve.fit());
+    for (size_t i = 0; i < 4; i++) TEST_ASSERT_FLOAT_WITHIN(0.05f, TDS_VALUES[i], curve.evaluate(TDS_VOLTS[i]));
+}
+
+// Least squares recovers an exact quadratic from more points than it needs
+void test_quadratic_least_squares() {
+    const float volts[] = {0.0f, 0.5f, 1.0f, 1.5f, 2.0f, 2.5f};
+    float values[6];
+    for (size_t i = 0; i < 6; i++) values[i] = 1.5f + 4.0f * volts[i] + 2.0f * volts[i] * volts[i];
+    CalibrationCurve curve = makeCurve(volts, values, 6, 2);
+    TEST_ASSERT_TRUE(curve.fit());
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 1.5f, curve.coefficients[0]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 4.0f, curve.coefficients[1]);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 2.0f, curve.coefficients[2]);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, curve.coefficients[3]);
+}
+
+// The resampled table stays within a small fraction of the curve everywhere
+void test_table_follows_curve() {
+    CalibrationCurve curve = makeCurve(TURBIDITY_VOLTS, TURBIDITY_VALUES, 4, 2);
+    TEST_ASSERT_TRUE(curve.fit());
+    static CalibrationTable table;
+    table.build(curve, false);
+    for (int code = 0; code < conversion::ADC_CODES; code += 7) {
+        float expected = curve.evaluate(conversion::rawToVoltage(code));
+        if (expected < 0.0f) expected = 0.0f;
+        TEST_ASSERT_FLOAT_WITHIN(0.05f, expected, table.at((float)code));
+    }
+    // Below code 0 the value is held; past the last code (a compensated
+    // position can be) the last segment is extended
+    TEST_ASSERT_EQUAL_FLOAT(table.at(0.0f), table.at(-100.0f));
+    float last = table.at(4095.0f), slope = table.at(4095.0f) - table.at(4094.0f);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, last + 905.0f * slope, table.at(5000.0f));
+}
+
+void test_table_clamps_non_negative_channels() {
+    const float volts[] = {1.0f, 2.0f};
+    const float values[] = {0.0f, 10.0f};
+    CalibrationCurve curve = makeCurve(volts, values, 2, 0);
+    TEST_ASSERT_TRUE(curve.fit());
+    static CalibrationTable table;
+    table.build(curve, false);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, table.at(0.5f / VOLTS_PER_CODE));
+    table.build(curve, true);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, -5.0f, table.at(0.5f / VOLTS_PER_CODE));
+}
+
+// The channel value after one sweep with the given probe voltages
+static float sweep(const Calibration& calibration, size_t channel, float volts, float temperature) {
+    int codes[4] = {0, 0, 0, 0};
+    codes[channel] = (int)lroundf(volts / VOLTS_PER_CODE);
+    float temperatureVolts = TEMP_30_VOLTAGE + (temperature - 30.0f) / 15.0f * (TEMP_45_VOLTAGE - TEMP_30_VOLTAGE);
+    codes[CH_TEMPERATURE] = (int)lroundf(temperatureVolts / VOLTS_PER_CODE);
+    native::ReplayAdc replay;
+    replay.addRow(codes[0], codes[1], codes[2], codes[3]);
+    hal::AdcSource* previous = hal::adcSource;
+    hal::setAdcSource(&replay);
+    static WaterSensors sensors;
+    sensors = WaterSensors();
+    sensors.setCalibration(calibration);
+    sensors.readSensors();
+    hal::setAdcSource(previous);
+    return sensors.value(channel);
+}
+
+// Calibration commands as an operator sends them after measuring the solutions
+static Calibration referenceCalibration() {
+    Settings settings;
+    Calibration calibration;
+    CommandHandler handler(settings, calibration);
+    const char* commands[] = {
+        "cal_ph=0.905:4.01/1.578:7.00/2.232:10.01",
+        "cal_tds=poly3/0:0/0.2299:100/0.8605:342/2.0634:1000",
+        "cal_turbidity=poly2/0:0/0.8484:10/1.9453:40/3.2368:100",
+    };
+    for (const char* command : commands) {
+        handler.handle(command, strlen(command));
+        TEST_ASSERT_EQUAL_STRING("ok", handler.lastResult());
+    }
+    return calibration;
+}
+
+// pH 6.86 and 9.18 buffers, read through the 4.01/7.00/10.01 calibration
+void test_ph_buffers() {
+    Calibration calibration = referenceCalibration();
+    TEST_ASSERT_FLOAT_WITHIN(0.02f, 4.01f, sweep(calibration, CH_PH, 0.905f, 25.0f));
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 6.86f, sweep(calibration, CH_PH, 1.545f, 25.0f));
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 9.18f, sweep(calibration, CH_PH, 2.050f, 25.0f));
+}
+
+void test_turbidity_standards() {
+    Calibration calibration = referenceCalibration();
+    TEST_ASSERT_FLOAT_WITHIN(0.3f, 4.0f, sweep(calibration, CH_TURBIDITY, 0.4606f, 25.0f));
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 20.0f, sweep(calibration, CH_TURBIDITY, 1.2992f, 25.0f));
+}
+
+// The 707 ppm (1413 uS/cm) standard read at 15, 25 and 35 C: the probe voltage
+// changes ~2 %/C, the compensated value does not
+void test_tds_temperature_compensation() {
+    Calibration calibration = referenceCalibration();
+    TEST_ASSERT_FLOAT_WITHIN(5.0f, 500.0f, sweep(calibration, CH_TDS, 1.2421f, 25.0f));
+    TEST_ASSERT_FLOAT_WITHIN(7.0f, 707.0f, sweep(calibration, CH_TDS, 1.6425f, 25.0f));
+#if TDS_TEMPERATURE_COMPENSATION
+    TEST_ASSERT_FLOAT_WITHIN(7.0f, 707.0f, sweep(calibration, CH_TDS, 1.3140f, 15.0f));
+    TEST_ASSERT_FLOAT_WITHIN(7.0f, 707.0f, sweep(calibration, CH_TDS, 1.9711f, 35.0f));
+#endif
+}
+
+// cal_<channel>=factory goes back to the conversion tables
+void test_factory_restores_tables() {
+    Calibration calibration = referenceCalibration();
+    Settings settings;
+    CommandHandler handler(settings, calibration);
+    const char* command = "cal_ph=factory";
+    handler.handle(command, strlen(command));
+    TEST_ASSERT_EQUAL_STRING("ok", handler.lastResult());
+    TEST_ASSERT_FALSE(calibration.curves[CH_PH].calibrated());
+    TEST_ASSERT_TRUE(calibration.curves[CH_TDS].calibrated());
+    int code = (int)lroundf(1.578f / VOLTS_PER_CODE);
+    TEST_ASSERT_EQUAL_FLOAT(conversion::PH_TABLE[code], sweep(calibration, CH_PH, 1.578f, 25.0f));
+}
+
+void test_bad_calibration_rejected_whole() {
+    Calibration calibration = referenceCalibration();
+    Calibration before = calibration;
+    Settings settings;
+    CommandHandler handler(settings, calibration);
+    const char* command = "cal_tds=factory cal_ph=1.0:4/1.0:7";
+    handler.handle(command, strlen(command));
+    TEST_ASSERT_EQUAL_STRING("error: bad calibration for cal_ph", handler.lastResult());
+    TEST_ASSERT_TRUE(calibration == before);
+}
+
+void test_store_round_trip() {
+    Calibration calibration = referenceCalibration();
+    CalibrationStore store;
+    TEST_ASSERT_TRUE(store.save(calibration));
+    Calibration loaded;
+    CalibrationStore reloaded;
+    TEST_ASSERT_TRUE(reloaded.load(loaded));
+    TEST_ASSERT_TRUE(loaded == calibration);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_piecewise_through_points);
+    RUN_TEST(test_fit_sorts_points);
+    RUN_TEST(test_fit_rejects_unusable_points);
+    RUN_TEST(test_cubic_through_tds_standards);
+    RUN_TEST(test_quadratic_least_squares);
+    RUN_TEST(test_table_follows_curve);
+    RUN_TEST(test_table_clamps_non_negative_channels);
+    RUN_TEST(test_ph_buffers);
+    RUN_TEST(test_turbidity_standards);
+    RUN_TEST(test_tds_temperature_compensation);
+    RUN_TEST(test_factory_restores_tables);
+    RUN_TEST(test_bad_calibration_rejected_whole);
+    RUN_TEST(test_store_round_trip);
+    return UNITY_END();
+}
@@ -0,0 +1,87 @@
+#include <unity.h>
+#include <string.h>
+#include "channels.h"
+#include "conversion_tables.h"
+
+// Host tests of the compile-time conversion tables (conversion_tables.h).
+// Run with: pio test -e native
+
+void setUp() {}
+void tearDown() {}
+
+// Entries whose bits differ from convert() evaluated at run time
+static int tableMismatches(const conversion::Table& table, float (*convert)(float), int& firstRaw) {
+    int mismatches = 0;
+    firstRaw = -1;
+    for (volatile int raw = 0; raw < conversion::ADC_CODES; raw++) {
+        float expected = convert(conversion::rawToVoltage(raw));
+        if (memcmp(&table[raw], &expected, sizeof(float)) != 0) {
+            if (mismatches++ == 0) firstRaw = raw;
+        }
+    }
+    return mismatches;
+}
+
+static void assertBitExact(const conversion::Table& table, float (*convert)(float)) {
+    int firstRaw;
+    int mismatches = tableMismatches(table, convert, firstRaw);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(-1, firstRaw, "first differing ADC code");
+    TEST_ASSERT_EQUAL_INT(0, mismatches);
+}
+
+void test_ph_table_bit_exact() {
+    assertBitExact(conversion::PH_TABLE, conversion::voltageToPH);
+}
+
+void test_tds_table_bit_exact() {
+    assertBitExact(conversion::TDS_TABLE, conversion::voltageToTDS);
+}
+
+void test_turbidity_table_bit_exact() {
+    assertBitExact(conversion::TURBIDITY_TABLE, conversion::voltageToTurbidity);
+}
+
+void test_temperature_table_bit_exact() {
+    assertBitExact(conversion::TEMPERATURE_TABLE, conversion::voltageToTemperature);
+}
+
+void test_verify_tables_reports_no_mismatch() {
+    TEST_ASSERT_EQUAL_INT(0, conversion::verifyTables());
+}
+
+// Oversampled or external codes may fall outside 0..4095
+void test_table_index_clamps() {
+    TEST_ASSERT_EQUAL_INT(0, conversion::tableIndex(-1));
+    TEST_ASSERT_EQUAL_INT(0, conversion::tableIndex(0));
+    TEST_ASSERT_EQUAL_INT(2048, conversion::tableIndex(2048));
+    TEST_ASSERT_EQUAL_INT(conversion::ADC_CODES - 1, conversion::tableIndex(conversion::ADC_CODES - 1));
+    TEST_ASSERT_EQUAL_INT(conversion::ADC_CODES - 1, conversion::tableIndex(conversion::ADC_CODES));
+    TEST_ASSERT_EQUAL_INT(conversion::ADC_CODES - 1, conversion::tableIndex(65535));
+}
+
+// Each channel's table is the one generated from its own float conversion
+void test_channel_tables_match_conversions() {
+    for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        assertBitExact(*CHANNELS[c].table, CHANNELS[c].convert);
+    }
+}
+
+// pH 7 buffer voltage lands on pH 7 within one ADC step
+void test_ph_neutral_point() {
+    int raw = (int)(PH_7_VOLTAGE / (VOLTAGE_REF / ADC_RESOLUTION) + 0.5f);
+    float step = (VOLTAGE_REF / ADC_RESOLUTION) / -PH_CALIBRATION_SLOPE;
+    TEST_ASSERT_FLOAT_WITHIN(step, 7.0f, conversion::PH_TABLE[raw]);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_ph_table_bit_exact);
+    RUN_TEST(test_tds_table_bit_exact);
+    RUN_TEST(test_turbidity_table_bit_exact);
+    RUN_TEST(test_temperature_table_bit_exact);
+    RUN_TEST(test_verify_tables_reports_no_mismatch);
+    RUN_TEST(test_table_index_clamps);
+    RUN_TEST(test_channel_tables_match_conversions);
+    RUN_TEST(test_ph_neutral_point);
+    return UNITY_END();
+}
@@ -0,0 +1,126 @@
+#include <unity.h>
+#include "outlier_filter.h"
+
+// Host tests of the Hampel outlier filter (outlier_filter.h).
+// Run with: pio test -e native
+
+void setUp() {}
+void tearDown() {}
+
+static const float QUIET[] = {7.00f, 7.02f, 6.98f, 7.01f, 6.99f, 7.00f, 7.02f};
+
+// Fills the history of channel 0 with a quiet signal
+template <size_t Capacity>
+static void prime(HampelFilter<1, Capacity>& filter) {
+    for (float v : QUIET) {
+        float x = v;
+        TEST_ASSERT_EQUAL_size_t(0, filter.apply(&x));
+        TEST_ASSERT_EQUAL_FLOAT(v, x);
+    }
+}
+
+void test_spike_replaced_by_median() {
+    HampelFilter<1, 7> filter(7, 3.0f);
+    prime(filter);
+    float spike = 9.5f;
+    TEST_ASSERT_EQUAL_size_t(1, filter.apply(&spike));
+    TEST_ASSERT_EQUAL_FLOAT(7.00f, spike);
+    TEST_ASSERT_EQUAL_UINT32(1, filter.rejected(0));
+}
+
+void test_values_inside_the_limit_pass() {
+    HampelFilter<1, 7> filter(7, 3.0f);
+    prime(filter);
+    float x = 7.03f;
+    TEST_ASSERT_EQUAL_size_t(0, filter.apply(&x));
+    TEST_ASSERT_EQUAL_FLOAT(7.03f, x);
+    TEST_ASSERT_EQUAL_UINT32(0, filter.totalRejected());
+}
+
+// Too few samples for a median: nothing is rejected
+void test_no_rejection_before_three_samples() {
+    HampelFilter<1, 7> filter;
+    float values[] = {1.0f, 100.0f, -50.0f};
+    for (float v : values) {
+        float x = v;
+        TEST_ASSERT_EQUAL_size_t(0, filter.apply(&x));
+        TEST_ASSERT_EQUAL_FLOAT(v, x);
+    }
+}
+
+// A flat, quantised signal has MAD 0; the minimum deviation keeps one code of
+// noise from being rejected
+void test_min_deviation_guards_zero_mad() {
+    HampelFilter<1, 5> filter(5, 3.0f);
+    filter.setMinDeviation(0, 0.15f);
+    for (int i = 0; i < 5; i++) {
+        float x = 7.0f;
+        filter.apply(&x);
+    }
+    float step = 7.1f;
+    TEST_ASSERT_EQUAL_size_t(0, filter.apply(&step));
+    TEST_ASSERT_EQUAL_FLOAT(7.1f, step);
+    float spike = 7.5f;
+    TEST_ASSERT_EQUAL_size_t(1, filter.apply(&spike));
+}
+
+// Raw values still enter the history, so a real step is taken once it fills
+// half the window
+void test_step_change_accepted() {
+    HampelFilter<1, 5> filter(5, 3.0f);
+    filter.setMinDeviation(0, 0.1f);
+    for (int i = 0; i < 5; i++) {
+        float x = 7.0f;
+        filter.apply(&x);
+    }
+    size_t rejectedSteps = 0;
+    float x = 0.0f;
+    for (int i = 0; i < 5; i++) {
+        x = 8.0f;
+        rejectedSteps += filter.apply(&x);
+    }
+    TEST_ASSERT_EQUAL_FLOAT(8.0f, x);
+    TEST_ASSERT_LESS_OR_EQUAL(3, rejectedSteps);
+    TEST_ASSERT_GREATER_THAN(0, rejectedSteps);
+}
+
+// Channels are filtered and counted independently
+void test_channels_independent() {
+    HampelFilter<2, 5> filter(5, 3.0f);
+    float quiet[][2] = {{7.0f, 300.0f}, {7.01f, 301.0f}, {6.99f, 299.0f}, {7.0f, 300.5f}, {7.02f, 299.5f}};
+    for (auto& row : quiet) filter.apply(row);
+    float values[2] = {7.01f, 900.0f};
+    TEST_ASSERT_EQUAL_size_t(1, filter.apply(values));
+    TEST_ASSERT_EQUAL_FLOAT(7.01f, values[0]);
+    TEST_ASSERT_EQUAL_FLOAT(300.0f, values[1]);
+    TEST_ASSERT_EQUAL_UINT32(0, filter.rejected(0));
+    TEST_ASSERT_EQUAL_UINT32(1, filter.rejected(1));
+
+    filter.resetCounters();
+    TEST_ASSERT_EQUAL_UINT32(0, filter.totalRejected());
+}
+
+void test_window_clamped_and_restarted() {
+    HampelFilter<1, 7> filter(2);
+    TEST_ASSERT_EQUAL_size_t(3, filter.window());
+    filter.setWindow(50);
+    TEST_ASSERT_EQUAL_size_t(7, filter.window());
+    prime(filter);
+    // History restarts, so the next values are not compared with the old ones
+    filter.setWindow(5);
+    float x = 20.0f;
+    TEST_ASSERT_EQUAL_size_t(0, filter.apply(&x));
+    TEST_ASSERT_EQUAL_FLOAT(20.0f, x);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_spike_replaced_by_median);
+    RUN_TEST(test_values_inside_the_limit_pass);
+    RUN_TEST(test_no_rejection_before_three_samples);
+    RUN_TEST(test_min_deviation_guards_zero_mad);
+    RUN_TEST(test_step_change_accepted);
+    RUN_TEST(test_channels_independent);
+    RUN_TEST(test_window_clamped_and_restarted);
+    return UNITY_END();
+}
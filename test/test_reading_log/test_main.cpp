@@ -0,0 +1,193 @@
+#include <unity.h>
+#include "flash_emulator.h"
+#include "reading_log.h"
+
+// Host tests of the flash store-and-forward log (reading_log.h) on the NOR
+// flash stand-in. Run with: pio test -e native
+
+static const size_t SECTOR_BYTES = 256;
+static const size_t SECTORS = 4;
+static const size_t HEADER_BYTES = 16;
+static const size_t RECORD_BYTES = (6 + 2 * SENSOR_CHANNEL_COUNT + 3) / 4 * 4;
+static const size_t SLOTS = (SECTOR_BYTES - HEADER_BYTES) / RECORD_BYTES;
+
+void setUp() {}
+void tearDown() {}
+
+static WaterReading makeReading(uint32_t n) {
+    WaterReading reading;
+    reading.timestamp = 1790000000UL + n * 5;
+    reading.values[CH_PH] = 7.0f + (n % 50) * 0.01f;
+    reading.values[CH_TDS] = 300.0f + n * 0.1f;
+    reading.values[CH_TURBIDITY] = 1.5f;
+    reading.values[CH_TEMPERATURE] = 25.0f - (n % 300) * 0.1f;  // Goes below zero
+    for (size_t c = STANDARD_CHANNEL_COUNT; c < SENSOR_CHANNEL_COUNT; c++) reading.values[c] = 1.0f;
+    return reading;
+}
+
+// The reading as published: each channel rounded to its decimals
+static void assertReading(uint32_t n, const WaterReading& reading) {
+    WaterReading expected = makeReading(n);
+    TEST_ASSERT_EQUAL_UINT32(expected.timestamp, reading.timestamp);
+    for (size_t c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        TEST_ASSERT_FLOAT_WITHIN(0.5f / channelScale(c) + 1e-4f, expected.values[c], reading.values[c]);
+    }
+}
+
+// Drains everything pending and checks it is readings first..last in order
+static void assertDrains(ReadingLog& log, uint32_t first, uint32_t last) {
+    WaterReading reading;
+    for (uint32_t n = first; n <= last; n++) {
+        TEST_ASSERT_TRUE(log.peek(reading));
+        assertReading(n, reading);
+        TEST_ASSERT_TRUE(log.markSent());
+    }
+    TEST_ASSERT_FALSE(log.peek(reading));
+    TEST_ASSERT_EQUAL_UINT32(0, log.pending());
+}
+
+void test_append_and_drain_in_order() {
+    native::FlashEmulator flash(SECTOR_BYTES * SECTORS, SECTOR_BYTES);
+    ReadingLog log(flash);
+    TEST_ASSERT_TRUE(log.begin());
+    TEST_ASSERT_EQUAL_size_t(SECTORS * SLOTS, log.capacity());
+    for (uint32_t n = 0; n < 20; n++) TEST_ASSERT_TRUE(log.append(makeReading(n)));
+    TEST_ASSERT_EQUAL_UINT32(20, log.pending());
+    assertDrains(log, 0, 19);
+}
+
+// Values keep exactly the published precision, negative temperatures included
+void test_precision_and_sign() {
+    native::FlashEmulator flash(SECTOR_BYTES * SECTORS, SECTOR_BYTES);
+    ReadingLog log(flash);
+    log.begin();
+    WaterReading reading = makeReading(0);
+    reading.values[CH_PH] = 6.987f;
+    reading.values[CH_TEMPERATURE] = -3.26f;
+    log.append(reading);
+    WaterReading stored;
+    TEST_ASSERT_TRUE(log.peek(stored));
+    TEST_ASSERT_EQUAL_FLOAT(6.99f, stored.values[CH_PH]);
+    TEST_ASSERT_EQUAL_FLOAT(-3.3f, stored.values[CH_TEMPERATURE]);
+}
+
+// Past capacity the head erases the oldest sector: its readings are dropped
+// and counted, the rest drain in order, and erases go round every sector
+void test_wrap_around_drops_oldest_sector() {
+    native::FlashEmulator flash(SECTOR_BYTES * SECTORS, SECTOR_BYTES);
+    ReadingLog log(flash);
+    log.begin();
+    const uint32_t total = (uint32_t)(SECTORS * SLOTS * 3 + 7);
+    for (uint32_t n = 0; n < total; n++) TEST_ASSERT_TRUE(log.append(makeReading(n)));
+
+    // The head sector always has a free slot, so at most SECTORS - 1 sectors and
+    // the part of the head sector written are pending
+    uint32_t pending = log.pending();
+    TEST_ASSERT_EQUAL_UINT32(total, pending + log.dropped());
+    TEST_ASSERT_LESS_OR_EQUAL((SECTORS - 1) * SLOTS + SLOTS - 1, pending);
+    TEST_ASSERT_GREATER_THAN((SECTORS - 2) * SLOTS, pending);
+    assertDrains(log, total - pending, total - 1);
+
+    uint32_t least = flash.eraseCount(0), most = flash.eraseCount(0);
+    for (size_t s = 1; s < SECTORS; s++) {
+        if (flash.eraseCount(s) < least) least = flash.eraseCount(s);
+        if (flash.eraseCount(s) > most) most = flash.eraseCount(s);
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(1, most - least);
+}
+
+// A record whose bytes no longer match its CRC is skipped and counted
+void test_corrupted_record_skipped() {
+    native::FlashEmulator flash(SECTOR_BYTES * SECTORS, SECTOR_BYTES);
+    ReadingLog log(flash);
+    log.begin();
+    for (uint32_t n = 0; n < 3; n++) log.append(makeReading(n));
+
+    // Clear one bit of the second record's timestamp (sector 0, slot 1)
+    uint8_t flipped = 0xFE;
+    TEST_ASSERT_TRUE(flash.write(HEADER_BYTES + RECORD_BYTES + 2, &flipped, 1));
+
+    WaterReading reading;
+    TEST_ASSERT_TRUE(log.peek(reading));
+    assertReading(0, reading);
+    log.markSent();
+    TEST_ASSERT_TRUE(log.peek(reading));
+    assertReading(2, reading);
+    TEST_ASSERT_EQUAL_UINT32(1, log.dropped());
+    log.markSent();
+    TEST_ASSERT_EQUAL_UINT32(0, log.pending());
+}
+
+// After a reset, begin() finds the unsent readings again, also across sectors
+// and after a wrap-around, and appends carry on behind them
+void test_remount_rebuilds_cursors() {
+    native::FlashEmulator flash(SECTOR_BYTES * SECTORS, SECTOR_BYTES);
+    const uint32_t written = (uint32_t)(SECTORS * SLOTS + SLOTS / 2);
+    uint32_t dropped;
+    {
+        ReadingLog log(flash);
+        log.begin();
+        for (uint32_t n = 0; n < written; n++) log.append(makeReading(n));
+        dropped = log.dropped();
+        WaterReading reading;
+        for (int i = 0; i < 3; i++) {
+            log.peek(reading);
+            log.markSent();
+        }
+    }
+    ReadingLog log(flash);
+    TEST_ASSERT_TRUE(log.begin());
+    TEST_ASSERT_EQUAL_UINT32(written - dropped - 3, log.pending());
+    log.append(makeReading(written));
+    assertDrains(log, dropped + 3, written);
+}
+
+// Reset just after the last slot of a sector was written
+void test_remount_with_full_head_sector() {
+    native::FlashEmulator flash(SECTOR_BYTES * SECTORS, SECTOR_BYTES);
+    {
+        ReadingLog log(flash);
+        log.begin();
+        for (uint32_t n = 0; n < SLOTS; n++) log.append(makeReading(n));
+    }
+    ReadingLog log(flash);
+    TEST_ASSERT_TRUE(log.begin());
+    TEST_ASSERT_EQUAL_UINT32(SLOTS, log.pending());
+    log.append(makeReading(SLOTS));
+    assertDrains(log, 0, SLOTS);
+}
+
+void test_batch_peek_and_mark() {
+    native::FlashEmulator flash(SECTOR_BYTES * SECTORS, SECTOR_BYTES);
+    ReadingLog log(flash);
+    log.begin();
+    for (uint32_t n = 0; n < SLOTS + 4; n++) log.append(makeReading(n));
+
+    WaterReading batch[8];
+    TEST_ASSERT_EQUAL_size_t(8, log.peekBatch(batch, 8));
+    for (uint32_t i = 0; i < 8; i++) assertReading(i, batch[i]);
+    // Peeking consumes nothing
+    TEST_ASSERT_EQUAL_UINT32(SLOTS + 4, log.pending());
+    TEST_ASSERT_TRUE(log.markSent(8));
+    assertDrains(log, 8, SLOTS + 3);
+}
+
+void test_too_small_storage_rejected() {
+    native::FlashEmulator flash(SECTOR_BYTES, SECTOR_BYTES);
+    ReadingLog log(flash);
+    TEST_ASSERT_FALSE(log.begin());
+    TEST_ASSERT_FALSE(log.append(makeReading(0)));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_append_and_drain_in_order);
+    RUN_TEST(test_precision_and_sign);
+    RUN_TEST(test_wrap_around_drops_oldest_sector);
+    RUN_TEST(test_corrupted_record_skipped);
+    RUN_TEST(test_remount_rebuilds_cursors);
+    RUN_TEST(test_remount_with_full_head_sector);
+    RUN_TEST(test_batch_peek_and_mark);
+    RUN_TEST(test_too_small_storage_rejected);
+    return UNITY_END();
+}
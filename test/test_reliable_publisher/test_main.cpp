@@ -0,0 +1,316 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory>
+#include <set>
+#include <vector>
+#include "native_hal.h"
+#include <PubSubClient.h>
+#include <WiFiClientSecure.h>
+#include "reliable_publisher.h"
+
+// Host tests of the QoS 1 in-flight window (reliable_publisher.h) against the
+// loopback broker, with PUBLISH packets and PUBACKs lost on the way.
+// Run with: pio test -e native
+
+static const char* const TOPIC = "test/readings";
+
+// The broker pipe, noting the packet id and DUP flag of each QoS 1 PUBLISH
+class TappedTransport : public Client {
+public:
+    WiFiClientSecure pipe;
+    std::vector<uint16_t> packetIds;
+    std::vector<bool> duplicates;
+
+    int connect(IPAddress ip, uint16_t port) override { return pipe.connect(ip, port); }
+    int connect(const char* host, uint16_t port) override { return pipe.connect(host, port); }
+
+    using Print::write;
+    size_t write(uint8_t c) override { return write(&c, 1); }
+
+    size_t write(const uint8_t* buf, size_t size) override {
+        if (size > 0 && (buf[0] & 0xF6) == 0x32) {
+            size_t offset = 1;
+            while (offset < size && (buf[offset] & 0x80)) offset++;
+            offset++;
+            size_t topicLength = (buf[offset] << 8) | buf[offset + 1];
+            offset += 2 + topicLength;
+            packetIds.push_back((uint16_t)((buf[offset] << 8) | buf[offset + 1]));
+            duplicates.push_back((buf[0] & 0x08) != 0);
+        }
+        return pipe.write(buf, size);
+    }
+
+    int available() override { return pipe.available(); }
+    int read() override { return pipe.read(); }
+    int read(uint8_t* buf, size_t size) override { return pipe.read(buf, size); }
+    int peek() override { return pipe.peek(); }
+    void flush() override { pipe.flush(); }
+    void stop() override { pipe.stop(); }
+    uint8_t connected() override { return pipe.connected(); }
+    operator bool() override { return connected(); }
+};
+
+// Which reading each slot carries, and what became of it
+class Outcomes : public DeliveryListener {
+public:
+    int carrying[MQTT_INFLIGHT_WINDOW];
+    std::vector<int> acknowledged;
+    std::vector<int> handedBack;
+
+    void delivered(size_t slot) override { acknowledged.push_back(carrying[slot]); }
+    void undelivered(size_t slot) override { handedBack.push_back(carrying[slot]); }
+};
+
+struct Link {
+    LoopbackBroker broker;
+    TappedTransport transport;
+    ReliablePublisher publisher{transport};
+    PubSubClient client{publisher};
+    Outcomes outcomes;
+    std::multiset<int> received;           // Readings taken in by the broker, repeats included
+
+    Link() {
+        transport.pipe.setBroker(&broker);
+        publisher.setListener(&outcomes);
+        broker.onPublish([this](const std::string&, const uint8_t* payload, size_t length) {
+            std::string text((const char*)payload, length);
+            received.insert(atoi(text.c_str() + strlen("reading ")));
+        });
+    }
+
+    bool connect() { return client.connect("test", nullptr, nullptr); }
+
+    bool publish(int reading) {
+        char payload[24];
+        int length = snprintf(payload, sizeof(payload), "reading %d", reading);
+        size_t slot;
+        if (!publisher.publish(TOPIC, (const uint8_t*)payload, (size_t)length, false, &slot)) {
+            return false;
+        }
+        outcomes.carrying[slot] = reading;
+        return true;
+    }
+
+    // Lets ms of board time pass, reading acks and retransmitting as main.cpp does
+    void run(unsigned long ms) {
+        for (unsigned long t = 0; t < ms; t += 10) {
+            native::boardClock().advanceMillis(10);
+            client.loop();
+            publisher.poll();
+        }
+    }
+
+    void setLoss(double publishLoss, double ackLoss) {
+        LoopbackBroker::Faults faults;
+        faults.publishLoss = publishLoss;
+        faults.ackLoss = ackLoss;
+        broker.setFaults(faults);
+    }
+};
+
+// Time for a message to use up all of its retries (the timeout doubles each time)
+static unsigned long retryBudgetMs() {
+    return ((unsigned long)MQTT_ACK_TIMEOUT << (MQTT_MAX_RETRIES + 1)) + 1000;
+}
+
+void setUp() {
+    WiFi.begin("test");
+    native::boardClock().advanceMillis(5000);
+}
+
+void tearDown() {}
+
+void test_window_pipelines_and_fills() {
+    std::unique_ptr<Link> link(new Link());
+    TEST_ASSERT_TRUE(link->connect());
+    for (int i = 0; i < (int)MQTT_INFLIGHT_WINDOW; i++) {
+        TEST_ASSERT_TRUE(link->publish(i));
+    }
+    // All sent before any ack has been read
+    TEST_ASSERT_EQUAL_size_t(MQTT_INFLIGHT_WINDOW, link->received.size());
+    TEST_ASSERT_TRUE(link->publisher.windowFull());
+    TEST_ASSERT_FALSE(link->publish(99));
+
+    link->run(100);
+    TEST_ASSERT_EQUAL_size_t(0, link->publisher.inFlight());
+    TEST_ASSERT_EQUAL_UINT32(MQTT_INFLIGHT_WINDOW, link->publisher.delivered());
+    TEST_ASSERT_EQUAL_UINT32(0, link->publisher.retried());
+    TEST_ASSERT_EQUAL_UINT32(0, link->publisher.dropped());
+    TEST_ASSERT_EQUAL_size_t(MQTT_INFLIGHT_WINDOW, link->outcomes.acknowledged.size());
+}
+
+void test_lost_ack_is_retransmitted_with_dup() {
+    std::unique_ptr<Link> link(new Link());
+    TEST_ASSERT_TRUE(link->connect());
+    link->setLoss(0.0, 1.0);
+    TEST_ASSERT_TRUE(link->publish(7));
+    link->run(MQTT_ACK_TIMEOUT - 100);
+    TEST_ASSERT_EQUAL_UINT32(0, link->publisher.retried());
+
+    link->setLoss(0.0, 0.0);
+    link->run(200);
+    TEST_ASSERT_EQUAL_UINT32(1, link->publisher.retried());
+    TEST_ASSERT_EQUAL_UINT32(1, link->publisher.delivered());
+    TEST_ASSERT_EQUAL_size_t(0, link->publisher.inFlight());
+    TEST_ASSERT_EQUAL_UINT32(1, link->broker.duplicatePublishes());
+    TEST_ASSERT_EQUAL_size_t(2, link->transport.packetIds.size());
+    TEST_ASSERT_EQUAL_UINT16(link->transport.packetIds[0], link->transport.packetIds[1]);
+    TEST_ASSERT_FALSE(link->transport.duplicates[0]);
+    TEST_ASSERT_TRUE(link->transport.duplicates[1]);
+    // The broker got it twice, the subscriber can tell by the content
+    TEST_ASSERT_EQUAL_size_t(2, link->received.count(7));
+}
+
+void test_resend_after_connack() {
+    std::unique_ptr<Link> link(new Link());
+    TEST_ASSERT_TRUE(link->connect());
+    link->setLoss(1.0, 0.0);
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(link->publish(i));
+    }
+    TEST_ASSERT_EQUAL_size_t(0, link->received.size());
+
+    // The connection drops; the window waits for the next one
+    link->broker.setOnline(false);
+    link->run(1000);
+    TEST_ASSERT_FALSE(link->client.connected());
+    TEST_ASSERT_EQUAL_size_t(3, link->publisher.inFlight());
+    TEST_ASSERT_FALSE(link->publish(3));
+
+    link->setLoss(0.0, 0.0);
+    link->broker.setOnline(true);
+    TEST_ASSERT_TRUE(link->connect());
+    TEST_ASSERT_EQUAL_UINT32(3, link->publisher.retried());
+    TEST_ASSERT_EQUAL_UINT32(3, link->broker.duplicatePublishes());
+    link->run(100);
+    TEST_ASSERT_EQUAL_UINT32(3, link->publisher.delivered());
+    TEST_ASSERT_EQUAL_UINT32(0, link->publisher.dropped());
+    TEST_ASSERT_EQUAL_size_t(0, link->publisher.inFlight());
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_size_t(1, link->received.count(i));
+    }
+}
+
+void test_packet_ids_wrap_around_in_flight_ones() {
+    std::unique_ptr<Link> link(new Link());
+    TEST_ASSERT_TRUE(link->connect());
+    // The first message stays unacknowledged while the ids wrap past it
+    link->setLoss(0.0, 1.0);
+    TEST_ASSERT_TRUE(link->publish(0));
+    link->setLoss(0.0, 0.0);
+    const int total = 65536 + 8;
+    for (int i = 1; i < total; i++) {
+        TEST_ASSERT_TRUE(link->publish(i));
+        link->client.loop();
+    }
+    TEST_ASSERT_EQUAL_size_t(1, link->publisher.inFlight());
+    const std::vector<uint16_t>& ids = link->transport.packetIds;
+    TEST_ASSERT_EQUAL_size_t(total, ids.size());
+    TEST_ASSERT_EQUAL_UINT16(1, ids[0]);
+    TEST_ASSERT_EQUAL_UINT16(65535, ids[65534]);
+    // 0 is not a packet id and 1 is still taken
+    TEST_ASSERT_EQUAL_UINT16(2, ids[65535]);
+    for (size_t i = 1; i < ids.size(); i++) {
+        TEST_ASSERT_TRUE(ids[i] != 0 && ids[i] != ids[0]);
+    }
+
+    link->run(MQTT_ACK_TIMEOUT + 100);
+    TEST_ASSERT_EQUAL_size_t(0, link->publisher.inFlight());
+    TEST_ASSERT_EQUAL_UINT32(total, link->publisher.delivered());
+    TEST_ASSERT_EQUAL_UINT32(1, link->publisher.retried());
+    TEST_ASSERT_EQUAL_UINT16(1, ids.back());
+    TEST_ASSERT_TRUE(link->transport.duplicates.back());
+}
+
+void test_out_of_retries_is_handed_back() {
+    std::unique_ptr<Link> link(new Link());
+    TEST_ASSERT_TRUE(link->connect());
+    link->setLoss(1.0, 0.0);
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(link->publish(i));
+    }
+    link->run(retryBudgetMs());
+    TEST_ASSERT_EQUAL_size_t(0, link->publisher.inFlight());
+    TEST_ASSERT_EQUAL_UINT32(0, link->publisher.delivered());
+    TEST_ASSERT_EQUAL_UINT32(3 * MQTT_MAX_RETRIES, link->publisher.retried());
+    TEST_ASSERT_EQUAL_UINT32(3, link->publisher.dropped());
+    TEST_ASSERT_EQUAL_size_t(3, link->outcomes.handedBack.size());
+    std::set<int> handedBack(link->outcomes.handedBack.begin(), link->outcomes.handedBack.end());
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_size_t(1, handedBack.count(i));
+    }
+}
+
+void test_abandon_hands_back_in_flight() {
+    std::unique_ptr<Link> link(new Link());
+    TEST_ASSERT_TRUE(link->connect());
+    TEST_ASSERT_TRUE(link->publish(0));
+    link->run(100);
+    link->setLoss(0.0, 1.0);
+    TEST_ASSERT_TRUE(link->publish(1));
+    TEST_ASSERT_TRUE(link->publish(2));
+    link->run(100);
+
+    link->publisher.abandon();
+    link->client.disconnect();
+    TEST_ASSERT_EQUAL_size_t(0, link->publisher.inFlight());
+    TEST_ASSERT_EQUAL_UINT32(1, link->publisher.delivered());
+    TEST_ASSERT_EQUAL_size_t(2, link->outcomes.handedBack.size());
+    TEST_ASSERT_EQUAL_INT(1, link->outcomes.handedBack[0]);
+    TEST_ASSERT_EQUAL_INT(2, link->outcomes.handedBack[1]);
+}
+
+// Store-and-forward as main.cpp does it: readings the window does not take,
+// or hands back, wait in a log and are published again later
+void test_lossy_link_loses_no_reading() {
+    std::unique_ptr<Link> link(new Link());
+    LoopbackBroker::Faults faults;
+    faults.publishLoss = 0.5;
+    faults.ackLoss = 0.2;
+    faults.latencyMs = 500;
+    faults.jitterMs = 2000;
+    link->broker.setFaults(faults, 42);
+    TEST_ASSERT_TRUE(link->connect());
+
+    const int total = 600;
+    std::vector<int> log;
+    unsigned long accepted = 0;
+    for (int next = 0; next < total || !log.empty() || !link->outcomes.handedBack.empty() ||
+                       link->publisher.inFlight() > 0;) {
+        TEST_ASSERT_LESS_OR_EQUAL(100000, native::boardClock().microseconds / 1000000ULL);
+        if (next < total) {
+            log.push_back(next++);
+        }
+        log.insert(log.end(), link->outcomes.handedBack.begin(), link->outcomes.handedBack.end());
+        link->outcomes.handedBack.clear();
+        while (!log.empty() && link->publish(log.front())) {
+            log.erase(log.begin());
+            accepted++;
+        }
+        link->run(1000);
+    }
+    // Drain the PUBACKs still on their way
+    link->run(faults.latencyMs + faults.jitterMs + 100);
+
+    TEST_ASSERT_GREATER_THAN(0, link->publisher.retried());
+    TEST_ASSERT_GREATER_THAN(0, link->publisher.dropped());
+    TEST_ASSERT_GREATER_THAN(0, link->broker.duplicatePublishes());
+    TEST_ASSERT_EQUAL_UINT32(accepted, link->publisher.delivered() + link->publisher.dropped());
+    TEST_ASSERT_EQUAL_size_t(link->publisher.delivered(), link->outcomes.acknowledged.size());
+    for (int i = 0; i < total; i++) {
+        TEST_ASSERT_TRUE_MESSAGE(link->received.count(i) > 0, "reading lost");
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_window_pipelines_and_fills);
+    RUN_TEST(test_lost_ack_is_retransmitted_with_dup);
+    RUN_TEST(test_resend_after_connack);
+    RUN_TEST(test_packet_ids_wrap_around_in_flight_ones);
+    RUN_TEST(test_out_of_retries_is_handed_back);
+    RUN_TEST(test_abandon_hands_back_in_flight);
+    RUN_TEST(test_lossy_link_loses_no_reading);
+    return UNITY_END();
+}
@@ -0,0 +1,160 @@
+#include <unity.h>
+#include <stdint.h>
+#include <thread>
+#include "spsc_queue.h"
+#include "adc_oversampler.h"
+
+// Host tests of the lock-free single-producer/single-consumer queue
+// (spsc_queue.h), also used for the ADC block ring (adc_oversampler.h).
+// Run with: pio test -e native
+
+void setUp() {}
+void tearDown() {}
+
+void test_fifo_order() {
+    SpscQueue<int, 4> queue;
+    TEST_ASSERT_TRUE(queue.empty());
+    for (int i = 1; i <= 3; i++) TEST_ASSERT_TRUE(queue.push(i));
+    TEST_ASSERT_EQUAL_size_t(3, queue.size());
+    int value = 0;
+    for (int i = 1; i <= 3; i++) {
+        TEST_ASSERT_TRUE(queue.pop(value));
+        TEST_ASSERT_EQUAL_INT(i, value);
+    }
+    TEST_ASSERT_FALSE(queue.pop(value));
+    TEST_ASSERT_TRUE(queue.empty());
+}
+
+// A full queue refuses the new element and counts it; the queued ones stay
+void test_full_queue_drops_newest() {
+    SpscQueue<int, 4> queue;
+    for (int i = 0; i < 4; i++) TEST_ASSERT_TRUE(queue.push(i));
+    TEST_ASSERT_FALSE(queue.push(99));
+    TEST_ASSERT_FALSE(queue.push(100));
+    TEST_ASSERT_EQUAL_UINT32(2, queue.dropCount());
+    TEST_ASSERT_EQUAL_size_t(4, queue.size());
+    int value = -1;
+    TEST_ASSERT_TRUE(queue.pop(value));
+    TEST_ASSERT_EQUAL_INT(0, value);
+    TEST_ASSERT_TRUE(queue.push(4));
+    for (int i = 1; i <= 4; i++) {
+        TEST_ASSERT_TRUE(queue.pop(value));
+        TEST_ASSERT_EQUAL_INT(i, value);
+    }
+}
+
+// Indices run on past the capacity; slots are reused in order
+void test_wraps_around_many_times() {
+    SpscQueue<uint32_t, 8> queue;
+    uint32_t next = 0, expected = 0, value;
+    for (int round = 0; round < 1000; round++) {
+        for (int i = 0; i < 5; i++) TEST_ASSERT_TRUE(queue.push(next++));
+        for (int i = 0; i < 5; i++) {
+            TEST_ASSERT_TRUE(queue.pop(value));
+            TEST_ASSERT_EQUAL_UINT32(expected++, value);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, queue.dropCount());
+}
+
+void test_peek_and_release() {
+    SpscQueue<int, 2> queue;
+    TEST_ASSERT_NULL(queue.peek());
+    queue.push(5);
+    queue.push(6);
+    const int* front = queue.peek();
+    TEST_ASSERT_NOT_NULL(front);
+    TEST_ASSERT_EQUAL_INT(5, *front);
+    TEST_ASSERT_EQUAL_size_t(2, queue.size());
+    queue.release();
+    TEST_ASSERT_EQUAL_INT(6, *queue.peek());
+    queue.release();
+    TEST_ASSERT_NULL(queue.peek());
+}
+
+// The ADC block ring: frames are summed on the capture side, and a full ring
+// makes the open block longer instead of dropping frames
+void test_block_ring() {
+    BlockRing<4, 4> ring;
+    ring.setIntervalFrames(4);   // Two intervals in 4 blocks: 2 frames each
+    TEST_ASSERT_EQUAL_UINT32(2, ring.framesPerBlock());
+    uint16_t codes[4];
+    for (uint16_t f = 0; f < 30; f++) {
+        for (size_t c = 0; c < 4; c++) codes[c] = (uint16_t)(f * 10 + c);
+        ring.add(codes);
+    }
+    Decimator<4> decimator;
+    int means[4];
+    ring.drainInto(decimator);
+    TEST_ASSERT_EQUAL_UINT32(8, decimator.emit(means));
+    for (size_t c = 0; c < 4; c++) TEST_ASSERT_EQUAL_INT(35 + c, means[c]);
+
+    // Frames 8-29 waited in the open block, handed over with the next frame
+    for (size_t c = 0; c < 4; c++) codes[c] = (uint16_t)(300 + c);
+    ring.add(codes);
+    ring.drainInto(decimator);
+    TEST_ASSERT_EQUAL_UINT32(23, decimator.emit(means));
+    for (size_t c = 0; c < 4; c++) TEST_ASSERT_EQUAL_INT(190 + c, means[c]);
+    TEST_ASSERT_EQUAL_UINT32(0, ring.dropCount());
+}
+
+// Producer and consumer on two threads: every element arrives once, in
+// order and intact (each carries its sequence number twice). A third thread
+// reading size() meanwhile never sees more than the capacity.
+void test_two_threads() {
+    struct Item {
+        uint32_t sequence;
+        uint32_t check;
+    };
+    static SpscQueue<Item, 64> queue;
+    const uint32_t items = 200000;
+
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < items;) {
+            if (queue.push({i, ~i})) {
+                i++;
+            } else {
+                std::this_thread::yield();  // Full; on one core the consumer must run
+            }
+        }
+    });
+
+    std::atomic<bool> done{false};
+    std::atomic<size_t> largest{0};
+    std::thread observer([&] {
+        while (!done.load()) {
+            size_t size = queue.size();
+            if (size > largest.load()) largest.store(size);
+        }
+    });
+
+    uint32_t expected = 0;
+    bool intact = true;
+    Item item;
+    while (expected < items) {
+        if (!queue.pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        intact = intact && item.sequence == expected && item.check == ~expected;
+        expected++;
+    }
+    producer.join();
+    done.store(true);
+    observer.join();
+
+    TEST_ASSERT_TRUE(intact);
+    TEST_ASSERT_LESS_OR_EQUAL(64, largest.load());
+    TEST_ASSERT_TRUE(queue.empty());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo_order);
+    RUN_TEST(test_full_queue_drops_newest);
+    RUN_TEST(test_wraps_around_many_times);
+    RUN_TEST(test_peek_and_release);
+    RUN_TEST(test_block_ring);
+    RUN_TEST(test_two_threads);
+    return UNITY_END();
+}
@@ -0,0 +1,144 @@
+#include <unity.h>
+#include <math.h>
+#include <stdlib.h>
+#include "streaming_stats.h"
+
+// Host tests of the sliding-window statistics (streaming_stats.h).
+// Run with: pio test -e native
+
+void setUp() {}
+void tearDown() {}
+
+// Window statistics computed the slow way, in double
+struct Reference {
+    double mean, variance, min, max;
+};
+
+static Reference reference(const float* values, size_t end, size_t window) {
+    size_t start = end > window ? end - window : 0;
+    size_t n = end - start;
+    Reference r = {0.0, 0.0, values[start], values[start]};
+    for (size_t i = start; i < end; i++) {
+        r.mean += values[i];
+        if (values[i] < r.min) r.min = values[i];
+        if (values[i] > r.max) r.max = values[i];
+    }
+    r.mean /= n;
+    for (size_t i = start; i < end && n > 1; i++) {
+        r.variance += (values[i] - r.mean) * (values[i] - r.mean);
+    }
+    if (n > 1) r.variance /= n - 1;
+    return r;
+}
+
+// Long random walks around an offset (as a TDS channel at ~300 ppm), well past
+// the periodic resync, against the brute-force statistics of every window
+void test_window_matches_brute_force() {
+    const size_t pushes = 1000;
+    static float values[2][pushes];
+    StreamingStats<2, 16> stats(10);
+    srand(7);
+    float walk[2] = {7.0f, 300.0f};
+    for (size_t i = 0; i < pushes; i++) {
+        walk[0] += ((rand() % 2001) - 1000) * 0.0001f;
+        walk[1] += ((rand() % 2001) - 1000) * 0.01f;
+        values[0][i] = walk[0];
+        values[1][i] = walk[1];
+        stats.push(walk);
+
+        for (size_t c = 0; c < 2; c++) {
+            Reference r = reference(values[c], i + 1, 10);
+            TEST_ASSERT_EQUAL_size_t(i + 1 < 10 ? i + 1 : 10, stats.count());
+            TEST_ASSERT_FLOAT_WITHIN(fabs(r.mean) * 1e-5 + 1e-5, r.mean, stats.mean(c));
+            TEST_ASSERT_FLOAT_WITHIN(r.variance * 1e-2 + fabs(r.mean) * 1e-5, r.variance, stats.variance(c));
+            TEST_ASSERT_EQUAL_FLOAT((float)r.min, stats.min(c));
+            TEST_ASSERT_EQUAL_FLOAT((float)r.max, stats.max(c));
+            TEST_ASSERT_EQUAL_FLOAT(values[c][i], stats.last(c));
+        }
+    }
+}
+
+// A reading of exactly 0.0 is a value like any other, not an empty slot
+void test_zero_is_a_reading() {
+    StreamingStats<1, 5> stats;
+    stats.push(0.0f);
+    stats.push(4.0f);
+    TEST_ASSERT_EQUAL_size_t(2, stats.count());
+    TEST_ASSERT_EQUAL_FLOAT(2.0f, stats.mean());
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.min());
+    TEST_ASSERT_EQUAL_FLOAT(8.0f, stats.variance());
+}
+
+void test_grow_window_keeps_history() {
+    StreamingStats<1, 8> stats(2);
+    for (int i = 1; i <= 6; i++) stats.push((float)i);
+    TEST_ASSERT_EQUAL_size_t(2, stats.count());
+    TEST_ASSERT_EQUAL_FLOAT(5.5f, stats.mean());
+
+    stats.setWindow(8);
+    TEST_ASSERT_EQUAL_size_t(6, stats.count());
+    TEST_ASSERT_EQUAL_FLOAT(3.5f, stats.mean());
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, stats.min());
+    TEST_ASSERT_EQUAL_FLOAT(6.0f, stats.max());
+}
+
+void test_shrink_window() {
+    StreamingStats<1, 8> stats;
+    for (int i = 1; i <= 8; i++) stats.push((float)i);
+    stats.setWindow(3);
+    TEST_ASSERT_EQUAL_size_t(3, stats.count());
+    TEST_ASSERT_EQUAL_FLOAT(7.0f, stats.mean());
+    TEST_ASSERT_EQUAL_FLOAT(6.0f, stats.min());
+    stats.push(0.0f);
+    TEST_ASSERT_EQUAL_FLOAT(5.0f, stats.mean());
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.min());
+    TEST_ASSERT_EQUAL_FLOAT(8.0f, stats.max());
+}
+
+void test_window_is_clamped() {
+    StreamingStats<1, 4> stats;
+    stats.setWindow(0);
+    TEST_ASSERT_EQUAL_size_t(1, stats.window());
+    stats.setWindow(100);
+    TEST_ASSERT_EQUAL_size_t(4, stats.window());
+}
+
+void test_ewma() {
+    StreamingStats<1, 4> stats;
+    stats.setEwmaAlpha(0.5f);
+    stats.push(10.0f);
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, stats.ewma());
+    stats.push(20.0f);
+    TEST_ASSERT_EQUAL_FLOAT(15.0f, stats.ewma());
+    stats.push(20.0f);
+    TEST_ASSERT_EQUAL_FLOAT(17.5f, stats.ewma());
+    // Out of range alphas are ignored
+    stats.setEwmaAlpha(0.0f);
+    stats.push(17.5f);
+    TEST_ASSERT_EQUAL_FLOAT(17.5f, stats.ewma());
+}
+
+void test_clear() {
+    StreamingStats<1, 4> stats;
+    stats.push(3.0f);
+    stats.push(5.0f);
+    stats.clear();
+    TEST_ASSERT_EQUAL_size_t(0, stats.count());
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.mean());
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.variance());
+    stats.push(-2.0f);
+    TEST_ASSERT_EQUAL_FLOAT(-2.0f, stats.mean());
+    TEST_ASSERT_EQUAL_FLOAT(-2.0f, stats.max());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_window_matches_brute_force);
+    RUN_TEST(test_zero_is_a_reading);
+    RUN_TEST(test_grow_window_keeps_history);
+    RUN_TEST(test_shrink_window);
+    RUN_TEST(test_window_is_clamped);
+    RUN_TEST(test_ewma);
+    RUN_TEST(test_clear);
+    return UNITY_END();
+}